@@ -0,0 +1,135 @@
+#include "AckTracker.h"
+
+#include <string.h>
+#include <strings.h>
+
+// Parses the decimal number at s (leading spaces allowed)
+static uint32_t parseUint(const char* s) {
+  while (*s == ' ') s++;
+  uint32_t v = 0;
+  while (*s >= '0' && *s <= '9') v = v * 10 + (uint32_t)(*s++ - '0');
+  return v;
+}
+
+AckTracker::AckTracker(uint32_t timeoutMs, AckCallback cb, void* ctx)
+  : timeoutMs_(timeoutMs), cb_(cb), ctx_(ctx), count_(0) {
+  memset(rx_, 0, sizeof(rx_));
+}
+
+bool AckTracker::add(uint8_t link, uint32_t firstSeq, uint32_t count, uint32_t now) {
+  if (count_ >= ACK_MAX_BATCHES) return false;
+  Entry& e = entries_[count_++];
+  memset(&e.batch, 0, sizeof(e.batch));
+  e.batch.link = link;
+  e.batch.firstSeq = firstSeq;
+  e.batch.count = count;
+  e.sentAt = now;
+  e.state = WAITING;
+  return true;
+}
+
+bool AckTracker::waiting(uint8_t link) const {
+  for (size_t i = 0; i < count_; i++) {
+    if (entries_[i].batch.link == link && entries_[i].state != SETTLED) return true;
+  }
+  return false;
+}
+
+AckTracker::Entry* AckTracker::find(uint8_t link, State state) {
+  // Responses on one link arrive in request order
+  for (size_t i = 0; i < count_; i++) {
+    if (entries_[i].batch.link == link && entries_[i].state == state) return &entries_[i];
+  }
+  return 0;
+}
+
+void AckTracker::onData(uint8_t link, const uint8_t* data, size_t len) {
+  if (link >= ACK_MAX_LINKS) return;
+  RxState& rx = rx_[link];
+  for (size_t i = 0; i < len; i++) {
+    char c = (char)data[i];
+    bool bodyByte = rx.inBody;
+    if (c == '\n') {
+      onLine(link, rx);
+    } else if (c != '\r' && rx.len < sizeof(rx.text) - 1) {
+      rx.text[rx.len++] = c;
+    }
+
+    // Bodies usually do not end in a newline; Content-Length says when
+    // they are complete
+    if (bodyByte && ++rx.bodyRead >= rx.contentLength) {
+      if (rx.len > 0) onLine(link, rx);
+      endResponse(link);
+    }
+  }
+  report();
+}
+
+void AckTracker::onLine(uint8_t link, RxState& rx) {
+  rx.text[rx.len] = '\0';
+  rx.len = 0;
+  const char* line = rx.text;
+
+  if (rx.inBody) {
+    const char* ack = strstr(line, "\"ack\":");
+    Entry* e = find(link, RESPONDING);
+    if (ack && e) e->batch.ackSeq = parseUint(ack + 6);
+    const char* fences = strstr(line, "\"fences\":");
+    if (fences && e) e->batch.fenceVersion = parseUint(fences + 9);
+    return;
+  }
+
+  if (strncmp(line, "HTTP/1.", 7) == 0) {
+    rx.contentLength = 0;
+    Entry* e = find(link, WAITING);
+    if (e) {
+      e->state = RESPONDING;
+      e->batch.status = (uint16_t)parseUint(line + 8);
+    }
+  } else if (strncasecmp(line, "Content-Length:", 15) == 0) {
+    rx.contentLength = parseUint(line + 15);
+  } else if (*line == '\0') {
+    // End of the headers
+    rx.inBody = true;
+    rx.bodyRead = 0;
+    if (rx.contentLength == 0) endResponse(link);
+  }
+}
+
+void AckTracker::endResponse(uint8_t link) {
+  rx_[link].inBody = false;
+  rx_[link].contentLength = 0;
+
+  Entry* e = find(link, RESPONDING);
+  if (!e) return;
+  AckedBatch& b = e->batch;
+  bool success = b.status >= 200 && b.status < 300;
+  // Numbered readings only count as delivered once the server confirms
+  // it has stored them
+  if (b.firstSeq != 0 && b.count > 0) success = success && b.ackSeq >= b.firstSeq;
+  b.ok = success;
+  e->state = SETTLED;
+}
+
+void AckTracker::poll(uint32_t now) {
+  for (size_t i = 0; i < count_; i++) {
+    Entry& e = entries_[i];
+    if (e.state != SETTLED && now - e.sentAt >= timeoutMs_) {
+      e.batch.ok = false;
+      e.state = SETTLED;
+      // Whatever arrives later on this link belongs to no one
+      memset(&rx_[e.batch.link], 0, sizeof(RxState));
+    }
+  }
+  report();
+}
+
+void AckTracker::report() {
+  while (count_ > 0 && entries_[0].state == SETTLED) {
+    AckedBatch batch = entries_[0].batch;
+    count_--;
+    memmove(entries_, entries_ + 1, count_ * sizeof(Entry));
+    // The callback may add() or clear()
+    if (cb_) cb_(batch, ctx_);
+  }
+}
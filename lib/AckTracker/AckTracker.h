@@ -0,0 +1,91 @@
+#ifndef ACK_TRACKER_H
+#define ACK_TRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Batches that may be waiting for a server response at the same time
+#ifndef ACK_MAX_BATCHES
+#define ACK_MAX_BATCHES 4
+#endif
+// SIM800 links are numbered 0..5
+#define ACK_MAX_LINKS 6
+
+// An uploaded batch of stored readings and how it ended
+struct AckedBatch {
+  uint8_t link;
+  uint32_t firstSeq;  // 0 for readings without sequence numbers
+  uint32_t count;
+  uint16_t status;    // HTTP status, 0 if there was no response in time
+  uint32_t ackSeq;    // highest sequence number the server confirmed, 0 if none
+  uint32_t fenceVersion;  // geofence image the server has, 0 if it named none
+  bool ok;            // 2xx, and for numbered readings an ack body
+};
+
+typedef void (*AckCallback)(const AckedBatch& batch, void* ctx);
+
+// Matches server responses to the batches sent on each modem link.
+//
+// A batch is added once its last byte has been accepted by the modem
+// (SEND OK). The data received on its link (see AtDataHandler) is parsed
+// as an HTTP response: the status line, Content-Length, and a body such
+// as {"ack":1234} naming the highest sequence number of the batch the
+// server has stored (see tools/ingest_server.py), and optionally
+// "fences":N, the version of the server's geofence image. The batch is settled
+// when the body is complete, or when timeoutMs pass without that.
+//
+// Batches are reported in the order they were added, each one only after
+// all earlier ones have been reported, so a caller acknowledging storage
+// up to each batch's ack never skips over a failed one.
+class AckTracker {
+public:
+  AckTracker(uint32_t timeoutMs, AckCallback cb, void* ctx);
+
+  // False if ACK_MAX_BATCHES are already waiting
+  bool add(uint8_t link, uint32_t firstSeq, uint32_t count, uint32_t now);
+
+  // Call with the data received on each link
+  void onData(uint8_t link, const uint8_t* data, size_t len);
+
+  // Expires batches whose response is overdue and reports settled ones
+  void poll(uint32_t now);
+
+  // Forgets every waiting batch without reporting it
+  void clear() { count_ = 0; }
+
+  bool waiting(uint8_t link) const;
+  bool idle() const { return count_ == 0; }
+  size_t outstanding() const { return count_; }
+
+private:
+  enum State { WAITING, RESPONDING, SETTLED };
+
+  struct Entry {
+    AckedBatch batch;
+    uint32_t sentAt;
+    State state;
+  };
+
+  // Response parser state per link
+  struct RxState {
+    char text[48];            // start of the current line
+    uint8_t len;
+    bool inBody;
+    uint32_t contentLength;
+    uint32_t bodyRead;
+  };
+
+  Entry* find(uint8_t link, State state);
+  void onLine(uint8_t link, RxState& rx);
+  void endResponse(uint8_t link);
+  void report();
+
+  uint32_t timeoutMs_;
+  AckCallback cb_;
+  void* ctx_;
+  Entry entries_[ACK_MAX_BATCHES];  // oldest first
+  size_t count_;
+  RxState rx_[ACK_MAX_LINKS];
+};
+
+#endif
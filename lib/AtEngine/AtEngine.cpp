@@ -0,0 +1,345 @@
+#include "AtEngine.h"
+
+#include <string.h>
+
+// Returns true if 'line' contains any of the '|' separated tokens.
+static bool matchesAny(const char* line, const char* tokens) {
+  if (!tokens || !*tokens) return false;
+  const char* start = tokens;
+  while (*start) {
+    const char* end = strchr(start, '|');
+    size_t len = end ? (size_t)(end - start) : strlen(start);
+    if (len > 0) {
+      for (const char* p = line; *p; p++) {
+        if (strncmp(p, start, len) == 0) return true;
+      }
+    }
+    if (!end) break;
+    start = end + 1;
+  }
+  return false;
+}
+
+// Returns true if 'line' starts with 'pattern' ('#' matches a digit).
+static bool matchesUrc(const char* line, const char* pattern) {
+  for (; *pattern; pattern++, line++) {
+    if (*pattern == '#') {
+      if (*line < '0' || *line > '9') return false;
+    } else if (*line != *pattern) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parses the decimal number at s; false if there is none
+static bool parseNumber(const char*& s, size_t& out) {
+  if (*s < '0' || *s > '9') return false;
+  out = 0;
+  while (*s >= '0' && *s <= '9') {
+    out = out * 10 + (size_t)(*s++ - '0');
+    if (out > AT_MAX_DATA_FRAME) return false;
+  }
+  return true;
+}
+
+AtEngine::AtEngine(SerialPort& port)
+  : port_(port), head_(0), count_(0), inFlight_(false),
+    queuedAt_(0), sentAt_(0), haveQueuedAt_(false), lineLen_(0),
+    dataRemaining_(0), dataLink_(0), wakeIdleMs_(0), wakeGuardMs_(0),
+    lastActivity_(0), wakeSentAt_(0), waking_(false), urcCount_(0),
+    failToken_("ERROR|FAIL"), lineCb_(0), lineCtx_(0), dataCb_(0), dataCtx_(0) {
+  line_[0] = '\0';
+}
+
+bool AtEngine::addUrcHandler(const char* pattern, AtUrcHandler handler, void* ctx) {
+  if (urcCount_ >= AT_MAX_URC_HANDLERS) return false;
+  UrcEntry& u = urcs_[urcCount_++];
+  u.pattern = pattern;
+  u.handler = handler;
+  u.ctx = ctx;
+  return true;
+}
+
+AtEngine::Entry* AtEngine::push() {
+  if (count_ >= AT_QUEUE_SIZE) return 0;
+  Entry* e = &queue_[(head_ + count_) % AT_QUEUE_SIZE];
+  count_++;
+  memset(e, 0, sizeof(Entry));
+  return e;
+}
+
+bool AtEngine::enqueue(const char* command, const char* expect, uint32_t timeoutMs,
+                       AtCallback cb, void* ctx, uint32_t settleMs, uint8_t flags) {
+  if (strlen(command) >= AT_MAX_COMMAND_LEN) return false;
+  Entry* e = push();
+  if (!e) return false;
+  e->kind = ENTRY_COMMAND;
+  strcpy(e->text, command);
+  e->expect = expect;
+  e->timeoutMs = timeoutMs;
+  e->settleMs = settleMs;
+  e->flags = flags;
+  e->cb = cb;
+  e->ctx = ctx;
+  return true;
+}
+
+bool AtEngine::enqueuePayload(const uint8_t* data, size_t len, const char* expect,
+                              uint32_t timeoutMs, AtCallback cb, void* ctx) {
+  Entry* e = push();
+  if (!e) return false;
+  e->kind = ENTRY_PAYLOAD;
+  e->payload = data;
+  e->payloadLen = len;
+  e->expect = expect;
+  e->timeoutMs = timeoutMs;
+  e->cb = cb;
+  e->ctx = ctx;
+  return true;
+}
+
+bool AtEngine::enqueueStream(AtPayloadWriter writer, void* writerCtx, const char* expect,
+                             uint32_t timeoutMs, AtCallback cb, void* ctx) {
+  Entry* e = push();
+  if (!e) return false;
+  e->kind = ENTRY_STREAM;
+  e->writer = writer;
+  e->writerCtx = writerCtx;
+  e->expect = expect;
+  e->timeoutMs = timeoutMs;
+  e->cb = cb;
+  e->ctx = ctx;
+  return true;
+}
+
+bool AtEngine::enqueueWait(uint32_t durationMs, AtCallback cb, void* ctx,
+                           const char* expect) {
+  Entry* e = push();
+  if (!e) return false;
+  e->kind = ENTRY_WAIT;
+  e->expect = expect;
+  e->timeoutMs = durationMs;
+  e->cb = cb;
+  e->ctx = ctx;
+  return true;
+}
+
+void AtEngine::start(uint32_t now) {
+  Entry& e = queue_[head_];
+  switch (e.kind) {
+    case ENTRY_COMMAND:
+      port_.println(e.text);
+      break;
+    case ENTRY_PAYLOAD:
+      port_.write(e.payload, e.payloadLen);
+      break;
+    case ENTRY_STREAM:
+      e.writer(port_, e.writerCtx);
+      break;
+    case ENTRY_WAIT:
+      break;
+  }
+  inFlight_ = true;
+  sentAt_ = now;
+  lastActivity_ = now;
+}
+
+void AtEngine::complete(AtResult result, const char* line) {
+  Entry& e = queue_[head_];
+  AtCallback cb = e.cb;
+  void* ctx = e.ctx;
+  bool fatal = result != AT_RESULT_OK && !(e.flags & AT_FLAG_OPTIONAL);
+
+  head_ = (head_ + 1) % AT_QUEUE_SIZE;
+  count_--;
+  inFlight_ = false;
+  haveQueuedAt_ = false;
+
+  // Empty the queue before any callback runs, so callbacks are free to
+  // queue their own recovery commands.
+  AtCallback droppedCb[AT_QUEUE_SIZE];
+  void* droppedCtx[AT_QUEUE_SIZE];
+  uint8_t dropped = 0;
+  if (fatal) dropped = drain(droppedCb, droppedCtx);
+
+  if (cb) cb(result, line ? line : "", ctx);
+  for (uint8_t i = 0; i < dropped; i++) {
+    if (droppedCb[i]) droppedCb[i](AT_RESULT_ABORTED, "", droppedCtx[i]);
+  }
+}
+
+uint8_t AtEngine::drain(AtCallback* cbs, void** ctxs) {
+  uint8_t n = 0;
+  while (count_ > 0) {
+    Entry& e = queue_[head_];
+    cbs[n] = e.cb;
+    ctxs[n] = e.ctx;
+    n++;
+    head_ = (head_ + 1) % AT_QUEUE_SIZE;
+    count_--;
+  }
+  head_ = 0;
+  return n;
+}
+
+void AtEngine::abort() {
+  if (inFlight_) {
+    // complete() drains everything behind the in-flight entry
+    complete(AT_RESULT_ABORTED, "");
+    return;
+  }
+  AtCallback droppedCb[AT_QUEUE_SIZE];
+  void* droppedCtx[AT_QUEUE_SIZE];
+  uint8_t dropped = drain(droppedCb, droppedCtx);
+  haveQueuedAt_ = false;
+  for (uint8_t i = 0; i < dropped; i++) {
+    if (droppedCb[i]) droppedCb[i](AT_RESULT_ABORTED, "", droppedCtx[i]);
+  }
+}
+
+bool AtEngine::dispatchUrc(const char* line) {
+  bool matched = false;
+  for (uint8_t i = 0; i < urcCount_; i++) {
+    if (!matchesUrc(line, urcs_[i].pattern)) continue;
+    matched = true;
+    if (urcs_[i].handler) urcs_[i].handler(line, urcs_[i].ctx);
+  }
+  return matched;
+}
+
+// "+IPD,<len>" (the ':' already consumed) or "+RECEIVE,<link>,<len>:"
+bool AtEngine::startData(const char* header) {
+  size_t link = 0;
+  size_t len;
+  const char* p;
+  if (strncmp(header, "+IPD,", 5) == 0) {
+    p = header + 5;
+    if (!parseNumber(p, len) || *p) return false;
+  } else if (strncmp(header, "+RECEIVE,", 9) == 0) {
+    p = header + 9;
+    if (!parseNumber(p, link) || *p++ != ',') return false;
+    if (!parseNumber(p, len) || strcmp(p, ":") != 0) return false;
+  } else {
+    return false;
+  }
+  dataLink_ = (uint8_t)link;
+  dataRemaining_ = len;
+  return true;
+}
+
+void AtEngine::handleLine(const char* line) {
+  if (lineCb_) lineCb_(line, lineCtx_);
+
+  if (strncmp(line, "+RECEIVE,", 9) == 0 && startData(line)) return;
+  if (dispatchUrc(line)) {
+    // A URC only completes a command that is waiting for exactly it
+    if (inFlight_ && matchesAny(line, queue_[head_].expect)) complete(AT_RESULT_OK, line);
+    return;
+  }
+  if (!inFlight_) return;
+
+  Entry& e = queue_[head_];
+
+  // Ignore the modem echoing our own command back
+  if (e.kind == ENTRY_COMMAND && strcmp(line, e.text) == 0) return;
+
+  if (matchesAny(line, e.expect)) {
+    complete(AT_RESULT_OK, line);
+  } else if (e.kind != ENTRY_WAIT && matchesAny(line, failToken_)) {
+    complete(AT_RESULT_ERROR, line);
+  }
+}
+
+void AtEngine::handlePrompt() {
+  if (lineCb_) lineCb_(">", lineCtx_);
+  complete(AT_RESULT_OK, ">");
+}
+
+void AtEngine::poll(uint32_t now) {
+  uint8_t data[64];
+  size_t dataLen = 0;
+
+  while (port_.available() > 0) {
+    int c = port_.read();
+    if (c < 0) break;
+    lastActivity_ = now;
+
+    // Received data is passed on in chunks, never parsed as lines
+    if (dataRemaining_ > 0) {
+      data[dataLen++] = (uint8_t)c;
+      dataRemaining_--;
+      if (dataLen == sizeof(data) || dataRemaining_ == 0) {
+        if (dataCb_) dataCb_(dataLink_, data, dataLen, dataCtx_);
+        dataLen = 0;
+      }
+      continue;
+    }
+
+    // "+IPD,<len>:" is followed by the data on the same line
+    if (c == ':' && lineLen_ > 5 && strncmp(line_, "+IPD,", 5) == 0) {
+      line_[lineLen_] = '\0';
+      if (startData(line_)) {
+        lineLen_ = 0;
+        continue;
+      }
+    }
+
+    if (c == '\r') continue;
+    if (c == '\n') {
+      if (lineLen_ > 0) {
+        line_[lineLen_] = '\0';
+        lineLen_ = 0;
+        handleLine(line_);
+      }
+      continue;
+    }
+
+    // The CIPSEND prompt is "> " with no line terminator
+    if (c == '>' && lineLen_ == 0 && inFlight_) {
+      const char* expect = queue_[head_].expect;
+      if (expect && strcmp(expect, ">") == 0) {
+        handlePrompt();
+        continue;
+      }
+    }
+
+    // Overlong lines are truncated; the tail is dropped until the newline
+    if (lineLen_ < AT_LINE_BUFFER_SIZE - 1) {
+      line_[lineLen_++] = (char)c;
+    }
+  }
+
+  if (dataLen > 0 && dataCb_) dataCb_(dataLink_, data, dataLen, dataCtx_);
+
+  if (inFlight_) {
+    Entry& e = queue_[head_];
+    if (now - sentAt_ >= e.timeoutMs) {
+      // A wait succeeds when it runs out; anything else has timed out
+      complete(e.kind == ENTRY_WAIT ? AT_RESULT_OK : AT_RESULT_TIMEOUT, "");
+    }
+    return;
+  }
+
+  if (count_ == 0) return;
+
+  if (!haveQueuedAt_) {
+    queuedAt_ = now;
+    haveQueuedAt_ = true;
+  }
+  if (now - queuedAt_ < queue_[head_].settleMs) return;
+
+  if (waking_) {
+    if (now - wakeSentAt_ < wakeGuardMs_) return;
+    waking_ = false;
+  } else if (wakeIdleMs_ && now - lastActivity_ >= wakeIdleMs_ &&
+             queue_[head_].kind != ENTRY_WAIT) {
+    // The modem may be asleep and would lose the start of the command
+    port_.println("AT");
+    wakeSentAt_ = now;
+    lastActivity_ = now;
+    waking_ = true;
+    return;
+  }
+  start(now);
+}
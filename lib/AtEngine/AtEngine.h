@@ -0,0 +1,185 @@
+#ifndef AT_ENGINE_H
+#define AT_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <SerialPort.h>
+
+// Queue depth and buffer sizes for the SIM800 command engine
+#ifndef AT_QUEUE_SIZE
+#define AT_QUEUE_SIZE 12
+#endif
+#ifndef AT_MAX_COMMAND_LEN
+#define AT_MAX_COMMAND_LEN 96
+#endif
+#ifndef AT_LINE_BUFFER_SIZE
+#define AT_LINE_BUFFER_SIZE 128
+#endif
+#ifndef AT_MAX_URC_HANDLERS
+#define AT_MAX_URC_HANDLERS 8
+#endif
+// Largest received-data frame accepted; the SIM800 sends at most 1460
+#define AT_MAX_DATA_FRAME 2048
+
+enum AtResult {
+  AT_RESULT_OK,
+  AT_RESULT_ERROR,
+  AT_RESULT_TIMEOUT,
+  AT_RESULT_ABORTED
+};
+
+// Command flags
+#define AT_FLAG_NONE      0x00
+#define AT_FLAG_OPTIONAL  0x01  // failure does not abort the rest of the queue
+
+// Called once per command when it completes. 'line' is the line that
+// completed it (or an empty string on timeout/abort).
+typedef void (*AtCallback)(AtResult result, const char* line, void* ctx);
+
+// Called for every complete line received from the modem (for logging).
+typedef void (*AtLineCallback)(const char* line, void* ctx);
+
+// Produces a streamed payload directly on the port when its turn comes.
+typedef void (*AtPayloadWriter)(SerialPort& port, void* ctx);
+
+// Called for an unsolicited result code matching a registered pattern.
+typedef void (*AtUrcHandler)(const char* line, void* ctx);
+
+// Called with bytes received on a connection ("+IPD" / "+RECEIVE"
+// frames), possibly split across several calls.
+typedef void (*AtDataHandler)(uint8_t link, const uint8_t* data, size_t len, void* ctx);
+
+// Non-blocking AT command engine.
+//
+// Commands are queued with an expected result token and a timeout, then
+// driven by poll() from loop(). Nothing in here ever waits: each poll()
+// drains whatever bytes the modem has sent, advances at most the current
+// command, and returns.
+//
+// Three kinds of entries share the queue:
+//   - commands:  a text line sent with CRLF, completed by 'expect' or a fail token
+//   - payloads:  raw bytes sent without CRLF (after a CIPSEND '>' prompt),
+//                either from a buffer or produced on the fly by a writer
+//   - waits:     nothing sent, succeed after durationMs or as soon as a line
+//                matches 'expect' (lets output such as the server response
+//                be collected without blocking)
+//
+// 'expect' may list alternatives separated by '|', e.g.
+// "CONNECT OK|ALREADY CONNECT".
+//
+// Modem output is parsed incrementally into a fixed line buffer and each
+// complete line is routed once:
+//   - lines matching a registered URC pattern go to its handlers (and
+//     complete the current command only if it expects exactly that)
+//   - everything else goes to the command in flight
+// Received TCP data is framed by "+IPD,<len>:" (AT+CIPHEAD=1) or
+// "+RECEIVE,<link>,<len>:" (AT+CIPMUX=1); the payload bytes bypass line
+// parsing entirely and go to the data handler, so server output can
+// never complete or fail a command.
+//
+// When a command fails (error token or timeout) the remaining queue is
+// dropped, each dropped entry's callback firing with AT_RESULT_ABORTED,
+// unless the failing command was marked AT_FLAG_OPTIONAL.
+class AtEngine {
+public:
+  explicit AtEngine(SerialPort& port);
+
+  bool enqueue(const char* command, const char* expect, uint32_t timeoutMs,
+               AtCallback cb = 0, void* ctx = 0,
+               uint32_t settleMs = 0, uint8_t flags = AT_FLAG_NONE);
+  bool enqueuePayload(const uint8_t* data, size_t len, const char* expect,
+                      uint32_t timeoutMs, AtCallback cb = 0, void* ctx = 0);
+  bool enqueueStream(AtPayloadWriter writer, void* writerCtx, const char* expect,
+                     uint32_t timeoutMs, AtCallback cb = 0, void* ctx = 0);
+  bool enqueueWait(uint32_t durationMs, AtCallback cb = 0, void* ctx = 0,
+                   const char* expect = 0);
+
+  void poll(uint32_t now);
+
+  // Drops every queued command; all of them complete as ABORTED.
+  void abort();
+
+  bool busy() const { return count_ > 0; }
+  uint8_t pending() const { return count_; }
+  uint8_t freeSlots() const { return AT_QUEUE_SIZE - count_; }
+
+  // Registers a handler for lines starting with 'pattern', in which '#'
+  // matches any digit (e.g. "#, CLOSED"). A null handler just swallows
+  // the URC. False if the table is full.
+  bool addUrcHandler(const char* pattern, AtUrcHandler handler, void* ctx);
+  void setDataHandler(AtDataHandler handler, void* ctx) { dataCb_ = handler; dataCtx_ = ctx; }
+
+  // For a modem in automatic sleep (SIM800 AT+CSCLK=2), which loses the
+  // first bytes it receives after idling: a command started once the
+  // line has been quiet for idleMs is preceded by a bare "AT" and sent
+  // guardMs after it. 0 turns this off.
+  void setWakeup(uint32_t idleMs, uint32_t guardMs) { wakeIdleMs_ = idleMs; wakeGuardMs_ = guardMs; }
+
+  void setLineCallback(AtLineCallback cb, void* ctx) { lineCb_ = cb; lineCtx_ = ctx; }
+  void setFailToken(const char* token) { failToken_ = token; }
+
+private:
+  enum EntryKind { ENTRY_COMMAND, ENTRY_PAYLOAD, ENTRY_STREAM, ENTRY_WAIT };
+
+  struct Entry {
+    EntryKind kind;
+    char text[AT_MAX_COMMAND_LEN];
+    const uint8_t* payload;
+    size_t payloadLen;
+    AtPayloadWriter writer;
+    void* writerCtx;
+    const char* expect;
+    uint32_t timeoutMs;
+    uint32_t settleMs;
+    uint8_t flags;
+    AtCallback cb;
+    void* ctx;
+  };
+
+  Entry* push();
+  void start(uint32_t now);
+  void complete(AtResult result, const char* line);
+  uint8_t drain(AtCallback* cbs, void** ctxs);
+  void handleLine(const char* line);
+  void handlePrompt();
+  bool dispatchUrc(const char* line);
+  bool startData(const char* header);
+
+  SerialPort& port_;
+  Entry queue_[AT_QUEUE_SIZE];
+  uint8_t head_;
+  uint8_t count_;
+
+  bool inFlight_;
+  uint32_t queuedAt_;
+  uint32_t sentAt_;
+  bool haveQueuedAt_;
+
+  char line_[AT_LINE_BUFFER_SIZE];
+  size_t lineLen_;
+
+  size_t dataRemaining_;
+  uint8_t dataLink_;
+
+  uint32_t wakeIdleMs_;
+  uint32_t wakeGuardMs_;
+  uint32_t lastActivity_;  // last byte sent or received
+  uint32_t wakeSentAt_;
+  bool waking_;
+
+  struct UrcEntry {
+    const char* pattern;
+    AtUrcHandler handler;
+    void* ctx;
+  };
+  UrcEntry urcs_[AT_MAX_URC_HANDLERS];
+  uint8_t urcCount_;
+
+  const char* failToken_;
+  AtLineCallback lineCb_;
+  void* lineCtx_;
+  AtDataHandler dataCb_;
+  void* dataCtx_;
+};
+
+#endif
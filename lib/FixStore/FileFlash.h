@@ -0,0 +1,97 @@
+#ifndef FILE_FLASH_H
+#define FILE_FLASH_H
+
+#include <stdio.h>
+#include <string.h>
+#include "FlashDevice.h"
+
+// NOR flash emulated in a host file, for power-loss tests. Follows the
+// same rules as RamFlash, and can lose power part-way through a write:
+// after cutPowerAfter(n), the next n bytes are programmed and the write
+// they belong to stops there, as does everything after it. A new
+// FileFlash on the same file is the device after power comes back.
+class FileFlash : public FlashDevice {
+public:
+  FileFlash(const char* path, uint32_t size, uint32_t sectorSize = 4096)
+    : file_(0), size_(size), sectorSize_(sectorSize), powered_(true), budget_(0), limited_(false),
+      bytesWritten_(0) {
+    file_ = fopen(path, "r+b");
+    if (!file_) file_ = fopen(path, "w+b");
+    if (!file_) return;
+    // Grows a new or short file to 'size', erased
+    fseek(file_, 0, SEEK_END);
+    long have = ftell(file_);
+    uint8_t ff[256];
+    memset(ff, 0xFF, sizeof(ff));
+    for (uint32_t at = have > 0 ? (uint32_t)have : 0; at < size_; at += sizeof(ff)) {
+      uint32_t n = size_ - at < sizeof(ff) ? size_ - at : sizeof(ff);
+      fwrite(ff, 1, n, file_);
+    }
+    fflush(file_);
+  }
+
+  ~FileFlash() override {
+    if (file_) fclose(file_);
+  }
+
+  bool ok() const { return file_ != 0; }
+
+  // Power fails once 'bytes' more bytes have been programmed
+  void cutPowerAfter(uint32_t bytes) {
+    budget_ = bytes;
+    limited_ = true;
+  }
+  bool powered() const { return powered_; }
+  uint32_t bytesWritten() const { return bytesWritten_; }
+
+  uint32_t size() const override { return size_; }
+  uint32_t sectorSize() const override { return sectorSize_; }
+
+  bool read(uint32_t addr, void* buf, size_t len) override {
+    if (!file_ || !powered_ || addr + len > size_) return false;
+    return fseek(file_, addr, SEEK_SET) == 0 && fread(buf, 1, len, file_) == len;
+  }
+
+  bool write(uint32_t addr, const void* buf, size_t len) override {
+    if (!file_ || !powered_ || addr + len > size_) return false;
+    uint8_t cell[64];
+    const uint8_t* p = (const uint8_t*)buf;
+    for (size_t done = 0; done < len;) {
+      size_t n = len - done < sizeof(cell) ? len - done : sizeof(cell);
+      if (limited_ && n > budget_) n = budget_;
+      if (n == 0) break;
+      if (fseek(file_, addr + done, SEEK_SET) != 0 || fread(cell, 1, n, file_) != n) return false;
+      for (size_t i = 0; i < n; i++) cell[i] &= p[done + i];
+      if (fseek(file_, addr + done, SEEK_SET) != 0 || fwrite(cell, 1, n, file_) != n) return false;
+      done += n;
+      bytesWritten_ += n;
+      if (limited_) budget_ -= n;
+    }
+    fflush(file_);
+    if (limited_ && budget_ == 0) powered_ = false;
+    return powered_;
+  }
+
+  bool eraseSector(uint32_t addr) override {
+    if (!file_ || !powered_ || addr % sectorSize_ != 0 || addr + sectorSize_ > size_) return false;
+    uint8_t ff[256];
+    memset(ff, 0xFF, sizeof(ff));
+    if (fseek(file_, addr, SEEK_SET) != 0) return false;
+    for (uint32_t at = 0; at < sectorSize_; at += sizeof(ff)) {
+      if (fwrite(ff, 1, sizeof(ff), file_) != sizeof(ff)) return false;
+    }
+    fflush(file_);
+    return true;
+  }
+
+private:
+  FILE* file_;
+  uint32_t size_;
+  uint32_t sectorSize_;
+  bool powered_;
+  uint32_t budget_;
+  bool limited_;
+  uint32_t bytesWritten_;
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include "FixStore.h"
+
+#include <string.h>
+
+#define SECTOR_MAGIC 0x31535047UL  // "GPS1"
+#define HEADER_SIZE 32
+#define RECORD_SIZE 32
+#define CURSOR_ENTRY_SIZE 8
+
+struct DiskRecord {
+  StoredFix fix;
+  uint32_t crc;
+};
+
+static_assert(sizeof(StoredFix) == 28, "StoredFix layout is part of the flash format");
+static_assert(sizeof(DiskRecord) == RECORD_SIZE, "record must fill its slot exactly");
+
+// CRC-32 (IEEE), nibble table: small and fast enough for 28 byte records
+static uint32_t crc32(const void* data, size_t len) {
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  const uint8_t* p = (const uint8_t*)data;
+  uint32_t crc = 0xFFFFFFFF;
+  while (len--) {
+    crc ^= *p++;
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+static bool isErased(const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    if (p[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+FixStore::FixStore(FlashDevice& flash)
+  : flash_(flash), sectorSize_(0), sectorCount_(0),
+    ackedSeq_(0), cursorSector_(0), cursorOffset_(0),
+    haveData_(false), headIndex_(0), headSectorSeq_(0), headFirstSeq_(0), headSlot_(0),
+    headClosed_(true), tailIndex_(0), oldestSeq_(1), nextSeq_(1), dropped_(0),
+    pinned_(false), pinSeq_(0),
+    cacheIndex_(0), cacheFirst_(0), cacheEnd_(0), staged_(0) {
+}
+
+bool FixStore::mountCursor() {
+  uint32_t maxSeq[2] = { 0, 0 };
+  uint32_t usedEnd[2] = { 0, 0 };
+  bool valid[2] = { false, false };
+
+  uint8_t buf[64];
+  for (uint8_t s = 0; s < 2; s++) {
+    uint32_t base = s * sectorSize_;
+    for (uint32_t off = 0; off < sectorSize_; off += sizeof(buf)) {
+      if (!flash_.read(base + off, buf, sizeof(buf))) return false;
+      for (uint32_t i = 0; i < sizeof(buf); i += CURSOR_ENTRY_SIZE) {
+        if (isErased(buf + i, CURSOR_ENTRY_SIZE)) continue;
+        usedEnd[s] = off + i + CURSOR_ENTRY_SIZE;
+        uint32_t seq, inv;
+        memcpy(&seq, buf + i, 4);
+        memcpy(&inv, buf + i + 4, 4);
+        if (seq != ~inv) continue;  // torn entry
+        if (!valid[s] || seq > maxSeq[s]) maxSeq[s] = seq;
+        valid[s] = true;
+      }
+    }
+  }
+
+  if (!valid[0] && !valid[1]) {
+    // Fresh or unreadable cursor: start over in sector 0
+    ackedSeq_ = 0;
+    cursorSector_ = 0;
+    cursorOffset_ = 0;
+    return usedEnd[0] == 0 || flash_.eraseSector(0);
+  }
+
+  cursorSector_ = (valid[1] && (!valid[0] || maxSeq[1] > maxSeq[0])) ? 1 : 0;
+  ackedSeq_ = maxSeq[cursorSector_];
+  cursorOffset_ = usedEnd[cursorSector_];
+  return true;
+}
+
+bool FixStore::readHeader(uint32_t dataIndex, SectorHeader& h) {
+  if (!flash_.read(sectorAddr(dataIndex), &h, sizeof(h))) return false;
+  return h.magic == SECTOR_MAGIC && h.crc == crc32(&h, 12);
+}
+
+bool FixStore::begin() {
+  sectorSize_ = flash_.sectorSize();
+  sectorCount_ = sectorSize_ ? flash_.size() / sectorSize_ : 0;
+  if (sectorCount_ < 4 || sectorSize_ < HEADER_SIZE + RECORD_SIZE) return false;
+
+  staged_ = 0;
+  dropped_ = 0;
+  pinned_ = false;
+  cacheEnd_ = 0;
+  if (!mountCursor()) return false;
+
+  // The valid sectors form one contiguous run of the ring; the newest is
+  // the head and the oldest the tail
+  haveData_ = false;
+  uint32_t tailSectorSeq = 0;
+  for (uint32_t i = 0; i < dataSectors(); i++) {
+    SectorHeader h;
+    if (!readHeader(i, h)) continue;
+    if (!haveData_ || h.sectorSeq > headSectorSeq_) {
+      headIndex_ = i;
+      headSectorSeq_ = h.sectorSeq;
+      headFirstSeq_ = h.firstSeq;
+    }
+    if (!haveData_ || h.sectorSeq < tailSectorSeq) {
+      tailIndex_ = i;
+      tailSectorSeq = h.sectorSeq;
+      oldestSeq_ = h.firstSeq;
+    }
+    haveData_ = true;
+  }
+
+  if (!haveData_) {
+    // Next openSector() lands on data sector 0
+    headIndex_ = dataSectors() - 1;
+    headSectorSeq_ = 0;
+    headClosed_ = true;
+    nextSeq_ = ackedSeq_ + 1;
+    oldestSeq_ = nextSeq_;
+    return true;
+  }
+
+  // Find the end of the log inside the head sector
+  headClosed_ = false;
+  uint32_t slot = 0;
+  for (; slot < recordsPerSector(); slot++) {
+    DiskRecord r;
+    if (!flash_.read(sectorAddr(headIndex_) + HEADER_SIZE + slot * RECORD_SIZE, &r, sizeof(r))) return false;
+    if (isErased(&r, sizeof(r))) break;
+    if (r.crc != crc32(&r.fix, sizeof(r.fix)) || r.fix.seq != headFirstSeq_ + slot) {
+      // Torn write: never append after it, continue in a fresh sector
+      headClosed_ = true;
+      break;
+    }
+  }
+  headSlot_ = slot;
+  if (headSlot_ >= recordsPerSector()) headClosed_ = true;
+  nextSeq_ = headFirstSeq_ + headSlot_;
+
+  // Keep sequence numbers increasing even if the cursor is ahead of the data
+  if (ackedSeq_ >= nextSeq_) {
+    nextSeq_ = ackedSeq_ + 1;
+    headClosed_ = true;
+  }
+  return true;
+}
+
+uint32_t FixStore::sectorEndSeq(uint32_t dataIndex) {
+  if (dataIndex == headIndex_) return headFirstSeq_ + headSlot_;
+  SectorHeader next;
+  if (!readHeader((dataIndex + 1) % dataSectors(), next)) return headFirstSeq_ + headSlot_;
+  return next.firstSeq;
+}
+
+bool FixStore::locate(uint32_t seq, uint32_t& dataIndex, uint32_t& slot) {
+  if (!haveData_ || seq < oldestSeq_ || seq >= headFirstSeq_ + headSlot_) return false;
+
+  if (seq < cacheFirst_ || seq >= cacheEnd_) {
+    uint32_t i = tailIndex_;
+    for (uint32_t n = 0; n < dataSectors(); n++) {
+      SectorHeader h;
+      if (!readHeader(i, h)) return false;
+      uint32_t end = sectorEndSeq(i);
+      if (seq >= h.firstSeq && seq < end) {
+        cacheIndex_ = i;
+        cacheFirst_ = h.firstSeq;
+        cacheEnd_ = end;
+        break;
+      }
+      if (i == headIndex_) return false;
+      i = (i + 1) % dataSectors();
+    }
+    if (seq < cacheFirst_ || seq >= cacheEnd_) return false;
+  }
+
+  dataIndex = cacheIndex_;
+  slot = seq - cacheFirst_;
+  return true;
+}
+
+bool FixStore::openSector(uint32_t firstSeq) {
+  uint32_t idx = (headIndex_ + 1) % dataSectors();
+
+  if (haveData_ && idx == tailIndex_) {
+    // Ring is full: recycle the oldest sector, undelivered fixes and all,
+    // unless it holds pinned ones
+    uint32_t end = sectorEndSeq(tailIndex_);
+    if (pinned_ && end > pinSeq_) return false;
+    uint32_t from = oldestSeq_ > ackedSeq_ ? oldestSeq_ : ackedSeq_ + 1;
+    if (end > from) dropped_ += end - from;
+
+    tailIndex_ = (tailIndex_ + 1) % dataSectors();
+    oldestSeq_ = end;
+  }
+
+  cacheEnd_ = 0;
+  if (!flash_.eraseSector(sectorAddr(idx))) return false;
+
+  SectorHeader h;
+  h.magic = SECTOR_MAGIC;
+  h.sectorSeq = headSectorSeq_ + 1;
+  h.firstSeq = firstSeq;
+  h.crc = crc32(&h, 12);
+  if (!flash_.write(sectorAddr(idx), &h, sizeof(h))) return false;
+
+  headIndex_ = idx;
+  headSectorSeq_ = h.sectorSeq;
+  headFirstSeq_ = firstSeq;
+  headSlot_ = 0;
+  headClosed_ = false;
+  if (!haveData_) {
+    haveData_ = true;
+    tailIndex_ = idx;
+    oldestSeq_ = firstSeq;
+  }
+  return true;
+}
+
+bool FixStore::append(const StoredFix& fix) {
+  if (staged_ >= FIXSTORE_STAGE_RECORDS && !flush()) {
+    dropped_++;
+    return false;
+  }
+
+  stage_[staged_] = fix;
+  stage_[staged_].seq = nextSeq_++;
+  staged_++;
+
+  if (staged_ >= FIXSTORE_STAGE_RECORDS) flush();
+  return true;
+}
+
+bool FixStore::flush() {
+  uint8_t done = 0;
+  bool ok = true;
+
+  while (done < staged_) {
+    if (headClosed_ || !haveData_ || headSlot_ >= recordsPerSector()) {
+      if (!openSector(stage_[done].seq)) {
+        ok = false;
+        break;
+      }
+    }
+
+    uint32_t n = staged_ - done;
+    if (n > recordsPerSector() - headSlot_) n = recordsPerSector() - headSlot_;
+
+    DiskRecord recs[FIXSTORE_STAGE_RECORDS];
+    for (uint32_t i = 0; i < n; i++) {
+      recs[i].fix = stage_[done + i];
+      recs[i].crc = crc32(&recs[i].fix, sizeof(recs[i].fix));
+    }
+
+    uint32_t addr = sectorAddr(headIndex_) + HEADER_SIZE + headSlot_ * RECORD_SIZE;
+    if (!flash_.write(addr, recs, n * RECORD_SIZE)) {
+      // Whatever landed is unknown; resume in a fresh sector next time
+      headClosed_ = true;
+      ok = false;
+      break;
+    }
+    headSlot_ += n;
+    done += n;
+    if (cacheIndex_ == headIndex_) cacheEnd_ = 0;
+  }
+
+  // Keep whatever did not make it for the next attempt
+  memmove(stage_, stage_ + done, (staged_ - done) * sizeof(StoredFix));
+  staged_ -= done;
+  return ok;
+}
+
+bool FixStore::read(uint32_t seq, StoredFix& out) {
+  uint32_t stagedFirst = nextSeq_ - staged_;
+  if (seq >= stagedFirst && seq < nextSeq_) {
+    out = stage_[seq - stagedFirst];
+    return true;
+  }
+
+  uint32_t idx, slot;
+  if (!locate(seq, idx, slot)) return false;
+
+  DiskRecord r;
+  if (!flash_.read(sectorAddr(idx) + HEADER_SIZE + slot * RECORD_SIZE, &r, sizeof(r))) return false;
+  if (r.crc != crc32(&r.fix, sizeof(r.fix)) || r.fix.seq != seq) return false;
+  out = r.fix;
+  return true;
+}
+
+bool FixStore::acknowledge(uint32_t seq) {
+  if (seq <= ackedSeq_) return true;
+
+  if (cursorOffset_ + CURSOR_ENTRY_SIZE > sectorSize_) {
+    // The full sector keeps the previous value until the new entry lands
+    uint8_t other = cursorSector_ ^ 1;
+    if (!flash_.eraseSector(other * sectorSize_)) return false;
+    cursorSector_ = other;
+    cursorOffset_ = 0;
+  }
+
+  uint32_t entry[2] = { seq, ~seq };
+  if (!flash_.write(cursorSector_ * sectorSize_ + cursorOffset_, entry, sizeof(entry))) {
+    cursorOffset_ += CURSOR_ENTRY_SIZE;  // never reuse a possibly torn slot
+    return false;
+  }
+  cursorOffset_ += CURSOR_ENTRY_SIZE;
+  ackedSeq_ = seq;
+  return true;
+}
+
+uint32_t FixStore::firstPending() const {
+  uint32_t first = ackedSeq_ + 1;
+  if (first < oldestSeq_) first = oldestSeq_;
+  if (first > nextSeq_) first = nextSeq_;
+  return first;
+}
@@ -0,0 +1,136 @@
+#ifndef FIX_STORE_H
+#define FIX_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FlashDevice.h"
+
+// Records appended between flushes are staged in RAM and written together
+// (8 records = one 256 byte flash page). A page is what the flash programs
+// in one operation, and erases are per sector however a sector is filled,
+// so staging a whole sector (127 records, 3.5 KB) would not save a single
+// erase; it would only cost the RAM and put that many more readings at
+// risk when power fails before a flush.
+#ifndef FIXSTORE_STAGE_RECORDS
+#define FIXSTORE_STAGE_RECORDS 8
+#endif
+
+#define FIXSTORE_FLAG_VALID   0x01  // position is meaningful
+#define FIXSTORE_FLAG_UTC     0x02  // utc holds a GPS time
+#define FIXSTORE_FLAG_CACHED  0x04  // repeated last known position
+#define FIXSTORE_FLAG_ESTIMATED 0x08  // dead-reckoned through a GPS outage
+#define FIXSTORE_FLAG_FENCE   0x10  // taken where the track crossed a geofence
+
+// One fix as it lives on flash. 28 bytes; a CRC32 brings it to 32.
+struct StoredFix {
+  uint32_t seq;         // assigned by the store, dense and increasing
+  uint32_t ts;          // millis() when taken
+  uint32_t utc;         // GPS UTC, seconds since 1970
+  int32_t lat_e7;       // degrees * 1e7
+  int32_t lng_e7;
+  int32_t alt_dm;       // metres * 10
+  uint16_t speed_e2;    // km/h * 100
+  uint8_t satellites;
+  uint8_t flags;        // FIXSTORE_FLAG_*
+};
+
+// Persistent, log-structured ring buffer of fixes on raw flash.
+//
+// Region layout (in flash sectors):
+//   0..1   ack cursor: append-only {seq, ~seq} entries, ping-ponging
+//          between the two sectors when one fills up
+//   2..N   data ring: each sector starts with a header {magic, sectorSeq,
+//          firstSeq, crc} followed by 32 byte CRC-protected records
+//
+// Appends are staged in RAM and written a page at a time. The ring is
+// written strictly in order, so every data sector is erased equally
+// often. When it fills up, the oldest sector is recycled even if its
+// fixes were never acknowledged; those are counted in dropped(). The
+// exception is a pinned range (a batch being uploaded, which has to read
+// back the same on every pass): its sectors are kept, and new fixes wait
+// in RAM or are dropped instead until it is unpinned.
+//
+// Power loss at any point leaves a mountable store: a torn record or
+// header fails its CRC and is treated as the end of the log, and the ack
+// cursor always has an older valid entry to fall back to.
+class FixStore {
+public:
+  explicit FixStore(FlashDevice& flash);
+
+  // Mounts the store, formatting the region if it holds nothing valid
+  bool begin();
+
+  // Adds a fix (its seq is assigned here); written on the next flush
+  bool append(const StoredFix& fix);
+  bool flush();
+
+  // Reads the fix with the given sequence number (staged ones included)
+  bool read(uint32_t seq, StoredFix& out);
+
+  // Durably marks everything up to and including seq as delivered
+  bool acknowledge(uint32_t seq);
+
+  // Keeps fixes from seq on readable until unpin(); flush() fails rather
+  // than recycle a sector holding one
+  void pin(uint32_t seq) { pinned_ = true; pinSeq_ = seq; }
+  void unpin() { pinned_ = false; }
+
+  // Sequence number of the oldest undelivered fix still stored
+  uint32_t firstPending() const;
+  // Sequence number the next appended fix will get
+  uint32_t nextSeq() const { return nextSeq_; }
+  uint32_t pending() const { return nextSeq_ - firstPending(); }
+  uint32_t acked() const { return ackedSeq_; }
+  uint32_t dropped() const { return dropped_; }  // undelivered fixes lost, old or new
+
+private:
+  struct SectorHeader {
+    uint32_t magic;
+    uint32_t sectorSeq;
+    uint32_t firstSeq;
+    uint32_t crc;
+  };
+
+  uint32_t dataSectors() const { return sectorCount_ - 2; }
+  uint32_t sectorAddr(uint32_t dataIndex) const { return (dataIndex + 2) * sectorSize_; }
+  uint32_t recordsPerSector() const { return (sectorSize_ - 32) / 32; }
+
+  bool readHeader(uint32_t dataIndex, SectorHeader& h);
+  uint32_t sectorEndSeq(uint32_t dataIndex);
+  bool locate(uint32_t seq, uint32_t& dataIndex, uint32_t& slot);
+  bool openSector(uint32_t firstSeq);
+  bool mountCursor();
+
+  FlashDevice& flash_;
+  uint32_t sectorSize_;
+  uint32_t sectorCount_;
+
+  // Ack cursor
+  uint32_t ackedSeq_;
+  uint8_t cursorSector_;
+  uint32_t cursorOffset_;
+
+  // Data ring
+  bool haveData_;
+  uint32_t headIndex_;
+  uint32_t headSectorSeq_;
+  uint32_t headFirstSeq_;
+  uint32_t headSlot_;
+  bool headClosed_;
+  uint32_t tailIndex_;
+  uint32_t oldestSeq_;
+  uint32_t nextSeq_;
+  uint32_t dropped_;
+  bool pinned_;
+  uint32_t pinSeq_;
+
+  // Lookup cache for sequential reads
+  uint32_t cacheIndex_;
+  uint32_t cacheFirst_;
+  uint32_t cacheEnd_;
+
+  StoredFix stage_[FIXSTORE_STAGE_RECORDS];
+  uint8_t staged_;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef FLASH_DEVICE_H
+#define FLASH_DEVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// NOR flash as seen by the fix store: erase sets a whole sector to 0xFF,
+// writes can only clear bits. Addresses are relative to the region.
+class FlashDevice {
+public:
+  virtual ~FlashDevice() {}
+
+  virtual uint32_t size() const = 0;
+  virtual uint32_t sectorSize() const = 0;
+
+  virtual bool read(uint32_t addr, void* buf, size_t len) = 0;
+  virtual bool write(uint32_t addr, const void* buf, size_t len) = 0;
+  virtual bool eraseSector(uint32_t addr) = 0;
+};
+
+#ifdef ESP32
+#include <esp_partition.h>
+
+// A raw data partition from the partition table (see partitions.csv)
+class PartitionFlash : public FlashDevice {
+public:
+  PartitionFlash() : part_(0) {}
+
+  bool begin(const char* label) {
+    part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    return part_ != 0;
+  }
+
+  uint32_t size() const override { return part_ ? part_->size : 0; }
+  uint32_t sectorSize() const override { return SPI_FLASH_SEC_SIZE; }
+
+  bool read(uint32_t addr, void* buf, size_t len) override {
+    return esp_partition_read(part_, addr, buf, len) == ESP_OK;
+  }
+  bool write(uint32_t addr, const void* buf, size_t len) override {
+    return esp_partition_write(part_, addr, buf, len) == ESP_OK;
+  }
+  bool eraseSector(uint32_t addr) override {
+    return esp_partition_erase_range(part_, addr, SPI_FLASH_SEC_SIZE) == ESP_OK;
+  }
+
+private:
+  const esp_partition_t* part_;
+};
+#endif
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef RAM_FLASH_H
+#define RAM_FLASH_H
+
+#include <string.h>
+#include <vector>
+#include "FlashDevice.h"
+
+// NOR flash emulated in host memory, for native runs. Keeps the real
+// part's rules: erase sets a sector to 0xFF and writes can only clear
+// bits, so the store sees exactly what it would on the device.
+class RamFlash : public FlashDevice {
+public:
+  RamFlash(uint32_t size, uint32_t sectorSize = 4096)
+    : mem_(size, 0xFF), sectorSize_(sectorSize), writes_(0), erases_(0) {}
+
+  uint32_t size() const override { return (uint32_t)mem_.size(); }
+  uint32_t sectorSize() const override { return sectorSize_; }
+
+  bool read(uint32_t addr, void* buf, size_t len) override {
+    if (addr + len > mem_.size()) return false;
+    memcpy(buf, &mem_[addr], len);
+    return true;
+  }
+
+  bool write(uint32_t addr, const void* buf, size_t len) override {
+    if (addr + len > mem_.size()) return false;
+    const uint8_t* p = (const uint8_t*)buf;
+    for (size_t i = 0; i < len; i++) mem_[addr + i] &= p[i];
+    writes_++;
+    return true;
+  }
+
+  bool eraseSector(uint32_t addr) override {
+    if (addr % sectorSize_ != 0 || addr + sectorSize_ > mem_.size()) return false;
+    memset(&mem_[addr], 0xFF, sectorSize_);
+    erases_++;
+    return true;
+  }
+
+  uint32_t writes() const { return writes_; }
+  uint32_t erases() const { return erases_; }
+
+private:
+  std::vector<uint8_t> mem_;
+  uint32_t sectorSize_;
+  uint32_t writes_;
+  uint32_t erases_;
+};
+
+#endif
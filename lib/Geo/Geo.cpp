@@ -0,0 +1,108 @@
+#include "Geo.h"
+
+#include <math.h>
+
+void geoOffsetM(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7,
+                float& east, float& north) {
+  // Longitude deltas wrap at the antimeridian
+  int64_t dlng = (int64_t)lng2_e7 - lng1_e7;
+  if (dlng > 1800000000) dlng -= 3600000000LL;
+  else if (dlng < -1800000000) dlng += 3600000000LL;
+
+  float meanLat = ((float)lat1_e7 + (float)lat2_e7) * 0.5e-7f * (float)(M_PI / 180.0);
+  east = (float)dlng * GEO_M_PER_E7 * cosf(meanLat);
+  north = (float)(lat2_e7 - lat1_e7) * GEO_M_PER_E7;
+}
+
+float geoDistanceM(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7) {
+  float east, north;
+  geoOffsetM(lat1_e7, lng1_e7, lat2_e7, lng2_e7, east, north);
+  return sqrtf(east * east + north * north);
+}
+
+// cos(n degrees) * 32768 for n = 0..90
+static const uint16_t cosTable[91] = {
+  32767, 32763, 32748, 32723, 32688, 32643, 32588, 32524, 32449, 32365,
+  32270, 32166, 32052, 31928, 31795, 31651, 31499, 31336, 31164, 30983,
+  30792, 30592, 30382, 30163, 29935, 29698, 29452, 29197, 28932, 28660,
+  28378, 28088, 27789, 27482, 27166, 26842, 26510, 26170, 25822, 25466,
+  25102, 24730, 24351, 23965, 23571, 23170, 22763, 22348, 21926, 21498,
+  21063, 20622, 20174, 19720, 19261, 18795, 18324, 17847, 17364, 16877,
+  16384, 15886, 15384, 14876, 14365, 13848, 13328, 12803, 12275, 11743,
+  11207, 10668, 10126, 9580, 9032, 8481, 7927, 7371, 6813, 6252,
+  5690, 5126, 4560, 3993, 3425, 2856, 2286, 1715, 1144, 572,
+  0
+};
+
+int32_t geoCosQ15(int32_t lat_e7) {
+  uint32_t a = lat_e7 < 0 ? (uint32_t)(-(int64_t)lat_e7) : (uint32_t)lat_e7;
+  if (a >= 900000000u) return 0;
+  uint32_t deg = a / 10000000u;
+  uint32_t frac = a % 10000000u;
+  int32_t c0 = cosTable[deg];
+  int32_t c1 = cosTable[deg + 1];
+  return c0 + (int32_t)((int64_t)(c1 - c0) * frac / 10000000);
+}
+
+void geoFrameInit(GeoFrame& frame, int32_t lat_e7, int32_t lng_e7) {
+  frame.lat0_e7 = lat_e7;
+  frame.lng0_e7 = lng_e7;
+  frame.cosLat_q15 = geoCosQ15(lat_e7);
+}
+
+static int64_t clampSpan(int64_t d) {
+  if (d > 100000000) return 100000000;
+  if (d < -100000000) return -100000000;
+  return d;
+}
+
+void geoFrameOffsetCm(const GeoFrame& frame, int32_t lat_e7, int32_t lng_e7,
+                      int32_t& east, int32_t& north) {
+  int64_t dlng = (int64_t)lng_e7 - frame.lng0_e7;
+  if (dlng > 1800000000) dlng -= 3600000000LL;
+  else if (dlng < -1800000000) dlng += 3600000000LL;
+  dlng = clampSpan(dlng);
+  int64_t dlat = clampSpan((int64_t)lat_e7 - frame.lat0_e7);
+
+  // 1e-7 degree of latitude is 1.11319 cm
+  east = (int32_t)(((dlng * frame.cosLat_q15) >> 15) * 111319 / 100000);
+  north = (int32_t)(dlat * 111319 / 100000);
+}
+
+static uint64_t isqrt64(uint64_t v) {
+  uint64_t r = 0;
+  uint64_t bit = 1ULL << 62;
+  while (bit > v) bit >>= 2;
+  while (bit) {
+    if (v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return r;
+}
+
+uint32_t geoSegmentDistanceCm(int32_t px, int32_t py, int32_t bx, int32_t by) {
+  int64_t len2 = (int64_t)bx * bx + (int64_t)by * by;
+  int64_t dot = (int64_t)px * bx + (int64_t)py * by;
+  if (len2 == 0 || dot <= 0) {
+    return (uint32_t)isqrt64((uint64_t)((int64_t)px * px + (int64_t)py * py));
+  }
+  if (dot >= len2) {
+    int64_t dx = (int64_t)px - bx;
+    int64_t dy = (int64_t)py - by;
+    return (uint32_t)isqrt64((uint64_t)(dx * dx + dy * dy));
+  }
+  int64_t cross = (int64_t)px * by - (int64_t)py * bx;
+  if (cross < 0) cross = -cross;
+  return (uint32_t)(cross / (int64_t)isqrt64((uint64_t)len2));
+}
+
+uint32_t headingDelta(uint32_t a, uint32_t b, uint32_t full) {
+  uint32_t d = a > b ? a - b : b - a;
+  d %= full;
+  return d > full / 2 ? full - d : d;
+}
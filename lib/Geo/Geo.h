@@ -0,0 +1,48 @@
+#ifndef GEO_H
+#define GEO_H
+
+#include <stdint.h>
+
+// Small-distance geometry on fixed-point coordinates (degrees * 1e7).
+//
+// Uses the equirectangular approximation, which is well under 1% off for
+// the few-kilometre spans a tracker compares; it needs one cosf() and no
+// trigonometry per point beyond that.
+
+// Metres per 1e-7 degree of latitude
+#define GEO_M_PER_E7 0.0111319f
+
+// Local east/north offset of point 2 from point 1, in metres
+void geoOffsetM(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7,
+                float& east, float& north);
+
+// Distance between two points in metres
+float geoDistanceM(int32_t lat1_e7, int32_t lng1_e7, int32_t lat2_e7, int32_t lng2_e7);
+
+// Fixed-point variants for per-fix work on the FPU-less core. Offsets
+// are in centimetres in a local frame whose longitude scale is fixed by
+// the frame's latitude; spans are clamped to 10 degrees.
+struct GeoFrame {
+  int32_t lat0_e7;
+  int32_t lng0_e7;
+  int32_t cosLat_q15;   // cos(lat0) * 32768
+};
+
+// cos(lat) * 32768 from a 1-degree table with linear interpolation
+int32_t geoCosQ15(int32_t lat_e7);
+
+void geoFrameInit(GeoFrame& frame, int32_t lat_e7, int32_t lng_e7);
+
+// East/north offset of a point from the frame origin, in cm
+void geoFrameOffsetCm(const GeoFrame& frame, int32_t lat_e7, int32_t lng_e7,
+                      int32_t& east, int32_t& north);
+
+// Distance in cm from point (px, py) to the segment from the origin to
+// (bx, by), all in the same local frame
+uint32_t geoSegmentDistanceCm(int32_t px, int32_t py, int32_t bx, int32_t by);
+
+// Smallest difference between two headings, in the same unit as 'full'
+// (e.g. 3600 for tenths of a degree); always in [0, full / 2]
+uint32_t headingDelta(uint32_t a, uint32_t b, uint32_t full);
+
+#endif
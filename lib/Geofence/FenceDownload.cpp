@@ -0,0 +1,66 @@
+#include "FenceDownload.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+FenceDownload::FenceDownload(FenceStore& store)
+  : store_(store), state_(IDLE), startedAt_(0), status_(0), contentLength_(0), received_(0),
+    lineLen_(0) {}
+
+void FenceDownload::begin(uint32_t now) {
+  state_ = HEAD;
+  startedAt_ = now;
+  status_ = 0;
+  contentLength_ = 0;
+  received_ = 0;
+  lineLen_ = 0;
+}
+
+void FenceDownload::fail() {
+  if (store_.writing()) store_.abort();
+  state_ = FAILED;
+}
+
+void FenceDownload::cancel() {
+  if (active()) fail();
+}
+
+void FenceDownload::onLine() {
+  line_[lineLen_] = '\0';
+  lineLen_ = 0;
+
+  if (strncmp(line_, "HTTP/1.", 7) == 0) {
+    const char* code = strchr(line_, ' ');
+    status_ = code ? (uint16_t)strtoul(code + 1, 0, 10) : 0;
+  } else if (strncasecmp(line_, "Content-Length:", 15) == 0) {
+    contentLength_ = (uint32_t)strtoul(line_ + 15, 0, 10);
+  } else if (line_[0] == '\0') {
+    // End of the head
+    if (status_ != 200 || contentLength_ == 0 || contentLength_ > store_.capacity() ||
+        !store_.beginWrite()) {
+      fail();
+      return;
+    }
+    state_ = BODY;
+  }
+}
+
+void FenceDownload::onData(const uint8_t* data, size_t len) {
+  while (len > 0 && state_ == HEAD) {
+    char c = (char)*data++;
+    len--;
+    if (c == '\n') onLine();
+    else if (c != '\r' && lineLen_ < sizeof(line_) - 1) line_[lineLen_++] = c;
+  }
+  if (state_ != BODY || len == 0) return;
+
+  size_t n = contentLength_ - received_ < len ? contentLength_ - received_ : len;
+  if (!store_.write(data, n)) {
+    fail();
+    return;
+  }
+  received_ += n;
+  if (received_ < contentLength_) return;
+  state_ = store_.commit() ? DONE : FAILED;
+}
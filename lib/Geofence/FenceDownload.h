@@ -0,0 +1,45 @@
+#ifndef FENCE_DOWNLOAD_H
+#define FENCE_DOWNLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FenceStore.h"
+
+// Receives the HTTP response to a fence image request straight into a
+// FenceStore: the status line and Content-Length are picked out of the
+// head, and the body is written to flash as it arrives, so no RAM holds
+// the image. A 200 with a body that fits and commits is DONE; anything
+// else ends FAILED and leaves the mounted image as it was.
+class FenceDownload {
+public:
+  enum State { IDLE, HEAD, BODY, DONE, FAILED };
+
+  explicit FenceDownload(FenceStore& store);
+
+  // Expects a response from now on
+  void begin(uint32_t now);
+  void onData(const uint8_t* data, size_t len);
+  // Gives up on the response, e.g. after a timeout
+  void cancel();
+
+  State state() const { return state_; }
+  bool active() const { return state_ == HEAD || state_ == BODY; }
+  uint32_t startedAt() const { return startedAt_; }
+  uint16_t status() const { return status_; }
+  uint32_t received() const { return received_; }
+
+private:
+  void onLine();
+  void fail();
+
+  FenceStore& store_;
+  State state_;
+  uint32_t startedAt_;
+  uint16_t status_;
+  uint32_t contentLength_;
+  uint32_t received_;
+  char line_[48];          // start of the current head line
+  uint8_t lineLen_;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "FenceEngine.h"
+
+#include <string.h>
+
+// Polygon vertices read from flash at a time
+#define VERTEX_CHUNK 16
+
+FenceEngine::FenceEngine(FenceStore& store, FenceCallback cb, void* ctx)
+  : store_(store), cb_(cb), ctx_(ctx), fences_(0), primed_(false), cell_(-1), cellFirst_(0),
+    cellCount_(0), fixes_(0), tests_(0), events_(0), cellLoads_(0) {
+  memset(inside_, 0, sizeof(inside_));
+  memset(listed_, 0, sizeof(listed_));
+}
+
+void FenceEngine::begin() {
+  // Fences past FENCE_MAX_FENCES are ignored
+  fences_ = 0;
+  if (store_.valid()) {
+    uint16_t count = store_.header().fenceCount;
+    fences_ = count < FENCE_MAX_FENCES ? count : FENCE_MAX_FENCES;
+  }
+  primed_ = false;
+  cell_ = -2;  // no cell, not even "outside the grid"
+  cellCount_ = 0;
+  memset(inside_, 0, sizeof(inside_));
+  memset(listed_, 0, sizeof(listed_));
+}
+
+void FenceEngine::setInside(uint16_t index, bool in) {
+  if (in) inside_[index / 32] |= 1UL << (index % 32);
+  else inside_[index / 32] &= ~(1UL << (index % 32));
+}
+
+// Grid cell of a point, -1 outside the grid
+int32_t FenceEngine::cellOf(int32_t lat_e7, int32_t lng_e7) const {
+  const FenceImageHeader& h = store_.header();
+  if (lat_e7 < h.lat0_e7 || lng_e7 < h.lng0_e7) return -1;
+  uint32_t row = (uint32_t)(((int64_t)lat_e7 - h.lat0_e7) / h.cellLat_e7);
+  uint32_t col = (uint32_t)(((int64_t)lng_e7 - h.lng0_e7) / h.cellLng_e7);
+  if (row >= h.rows || col >= h.cols) return -1;
+  return (int32_t)(row * h.cols + col);
+}
+
+// Reads fence 'slot' of the current cell; false (and index past the set)
+// if the image does not hold it
+bool FenceEngine::readCandidate(uint32_t slot, Candidate& out) {
+  const FenceImageHeader& h = store_.header();
+  out.index = 0xFFFF;
+  uint16_t index;
+  if (!store_.read(h.idsOffset + (cellFirst_ + slot) * 2, &index, 2) || index >= fences_) return false;
+  if (!store_.read(h.fencesOffset + index * sizeof(FenceEntry), &out.entry, sizeof(FenceEntry))) {
+    return false;
+  }
+  if (out.entry.type == FENCE_CIRCLE) {
+    int32_t circle[3];
+    if (!store_.read(out.entry.dataOffset, circle, sizeof(circle))) return false;
+    geoFrameInit(out.frame, circle[0], circle[1]);
+    out.radiusCm = circle[2];
+  }
+  out.index = index;
+  return true;
+}
+
+// Moves to another cell: caches its fences and leaves every fence it
+// does not list
+void FenceEngine::loadCell(int32_t cell, const FenceEvent& at) {
+  const FenceImageHeader& h = store_.header();
+  cell_ = cell;
+  cellLoads_++;
+  cellCount_ = 0;
+  memset(listed_, 0, sizeof(listed_));
+
+  uint32_t range[2];
+  if (cell >= 0 && store_.read(sizeof(FenceImageHeader) + (uint32_t)cell * 4, range, sizeof(range)) &&
+      range[1] >= range[0] && range[1] <= (h.fencesOffset - h.idsOffset) / 2) {
+    cellFirst_ = range[0];
+    cellCount_ = range[1] - range[0];
+  }
+
+  uint16_t ids[32];
+  for (uint32_t k = 0; k < cellCount_; k += 32) {
+    uint32_t n = cellCount_ - k < 32 ? cellCount_ - k : 32;
+    if (!store_.read(h.idsOffset + (cellFirst_ + k) * 2, ids, n * 2)) {
+      cellCount_ = k;
+      break;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      if (ids[i] < fences_) listed_[ids[i] / 32] |= 1UL << (ids[i] % 32);
+    }
+  }
+  for (uint32_t k = 0; k < cellCount_ && k < FENCE_CELL_CACHE; k++) readCandidate(k, cache_[k]);
+
+  for (uint16_t w = 0; w < sizeof(inside_) / sizeof(inside_[0]); w++) {
+    uint32_t gone = inside_[w] & ~listed_[w];
+    while (gone) {
+      uint16_t bit = 0;
+      while (!((gone >> bit) & 1)) bit++;
+      gone &= ~(1UL << bit);
+      uint16_t index = (uint16_t)(w * 32 + bit);
+      setInside(index, false);
+      FenceEntry e;
+      if (store_.read(h.fencesOffset + index * sizeof(FenceEntry), &e, sizeof(e))) report(e, false, at);
+    }
+  }
+}
+
+// Even-odd rule; a point on an edge may count either way
+bool FenceEngine::containsPolygon(const FenceEntry& e, int32_t lat_e7, int32_t lng_e7) {
+  if (e.vertices < 3) return false;
+  int32_t v[2 * VERTEX_CHUNK];
+  if (!store_.read(e.dataOffset + (e.vertices - 1) * 8u, v, 8)) return false;
+  int64_t prevLat = v[0], prevLng = v[1];
+  int64_t lat = lat_e7, lng = lng_e7;
+
+  bool in = false;
+  for (uint32_t i = 0; i < e.vertices; i += VERTEX_CHUNK) {
+    uint32_t n = e.vertices - i < VERTEX_CHUNK ? e.vertices - i : VERTEX_CHUNK;
+    if (!store_.read(e.dataOffset + i * 8, v, n * 8)) return false;
+    for (uint32_t j = 0; j < n; j++) {
+      int64_t curLat = v[2 * j], curLng = v[2 * j + 1];
+      if ((curLat > lat) != (prevLat > lat)) {
+        // Does the edge cross the parallel east of the point?
+        int64_t dLat = curLat - prevLat;
+        int64_t lhs = (lat - prevLat) * (curLng - prevLng);
+        int64_t rhs = (lng - prevLng) * dLat;
+        if (dLat > 0 ? lhs > rhs : lhs < rhs) in = !in;
+      }
+      prevLat = curLat;
+      prevLng = curLng;
+    }
+  }
+  return in;
+}
+
+bool FenceEngine::contains(const Candidate& c, int32_t lat_e7, int32_t lng_e7) {
+  const FenceEntry& e = c.entry;
+  if (lat_e7 < e.minLat_e7 || lat_e7 > e.maxLat_e7 || lng_e7 < e.minLng_e7 || lng_e7 > e.maxLng_e7) {
+    return false;
+  }
+  tests_++;
+  if (e.type == FENCE_CIRCLE) {
+    int32_t east, north;
+    geoFrameOffsetCm(c.frame, lat_e7, lng_e7, east, north);
+    return (int64_t)east * east + (int64_t)north * north <= (int64_t)c.radiusCm * c.radiusCm;
+  }
+  if (e.type == FENCE_POLYGON) return containsPolygon(e, lat_e7, lng_e7);
+  return false;
+}
+
+void FenceEngine::report(const FenceEntry& e, bool enter, const FenceEvent& at) {
+  if (!primed_) return;
+  events_++;
+  if (!cb_) return;
+  FenceEvent event = at;
+  event.fenceId = e.id;
+  event.enter = enter;
+  cb_(event, ctx_);
+}
+
+uint32_t FenceEngine::update(uint32_t ms, int32_t lat_e7, int32_t lng_e7) {
+  if (fences_ == 0) return 0;
+  fixes_++;
+  uint32_t before = events_;
+  FenceEvent at = { 0, false, ms, lat_e7, lng_e7 };
+
+  int32_t cell = cellOf(lat_e7, lng_e7);
+  if (cell != cell_) loadCell(cell, at);
+
+  for (uint32_t k = 0; k < cellCount_; k++) {
+    Candidate overflow;
+    const Candidate* c = &cache_[k];
+    if (k >= FENCE_CELL_CACHE) {
+      readCandidate(k, overflow);
+      c = &overflow;
+    }
+    if (c->index >= fences_) continue;
+
+    bool in = contains(*c, lat_e7, lng_e7);
+    if (in == inside(c->index)) continue;
+    setInside(c->index, in);
+    report(c->entry, in, at);
+  }
+  primed_ = true;
+  return events_ - before;
+}
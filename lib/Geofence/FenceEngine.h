@@ -0,0 +1,99 @@
+#ifndef FENCE_ENGINE_H
+#define FENCE_ENGINE_H
+
+#include <stdint.h>
+#include <Geo.h>
+#include "FenceStore.h"
+
+// Largest fence set; one bit of state per fence
+#ifndef FENCE_MAX_FENCES
+#define FENCE_MAX_FENCES 1024
+#endif
+
+// Fences of the current grid cell kept in RAM (40 bytes each); further
+// ones in a crowded cell are read from flash on every fix
+#ifndef FENCE_CELL_CACHE
+#define FENCE_CELL_CACHE 32
+#endif
+
+struct FenceEvent {
+  uint32_t fenceId;
+  bool enter;             // false: exit
+  uint32_t ms;            // of the fix
+  int32_t lat_e7;
+  int32_t lng_e7;
+};
+
+typedef void (*FenceCallback)(const FenceEvent& event, void* ctx);
+
+// Evaluates fixes against the fence set in a FenceStore.
+//
+// The grid cell of a fix names the only fences it can be in. When the
+// cell changes, its fence entries (and circle frames) are read into RAM,
+// and every fence the track was in that the new cell does not list is
+// left at once. Each fix then costs a bounding-box test per fence of its
+// cell, plus for those it falls into a circle distance check or an
+// even-odd crossing count over the polygon, read from flash a few
+// vertices at a time. All integer arithmetic.
+//
+// The first fix after begin() or a new image only sets the state, so a
+// fence the tracker starts out in is not reported as entered.
+class FenceEngine {
+public:
+  FenceEngine(FenceStore& store, FenceCallback cb, void* ctx);
+
+  // Starts over with the store's current image (after mounting it or
+  // receiving a new one)
+  void begin();
+
+  // One fix; calls back for every fence entered or left. Returns the
+  // number of events.
+  uint32_t update(uint32_t ms, int32_t lat_e7, int32_t lng_e7);
+
+  bool inside(uint16_t index) const { return (inside_[index / 32] >> (index % 32)) & 1; }
+  uint16_t fenceCount() const { return fences_; }
+
+  uint32_t fixes() const { return fixes_; }
+  uint32_t tests() const { return tests_; }        // fences tested beyond the bounding box
+  uint32_t events() const { return events_; }
+  uint32_t cellLoads() const { return cellLoads_; }
+
+private:
+  struct Candidate {
+    uint16_t index;
+    FenceEntry entry;
+    GeoFrame frame;       // circles: centred on the circle
+    int32_t radiusCm;
+  };
+
+  int32_t cellOf(int32_t lat_e7, int32_t lng_e7) const;
+  void loadCell(int32_t cell, const FenceEvent& at);
+  bool readCandidate(uint32_t slot, Candidate& out);
+  bool contains(const Candidate& c, int32_t lat_e7, int32_t lng_e7);
+  bool containsPolygon(const FenceEntry& e, int32_t lat_e7, int32_t lng_e7);
+  void report(const FenceEntry& e, bool enter, const FenceEvent& at);
+  void setInside(uint16_t index, bool in);
+
+  FenceStore& store_;
+  FenceCallback cb_;
+  void* ctx_;
+  uint16_t fences_;
+  bool primed_;
+
+  // The current cell: its id list in the image, and the first of its
+  // fences
+  int32_t cell_;
+  uint32_t cellFirst_;
+  uint32_t cellCount_;
+  Candidate cache_[FENCE_CELL_CACHE];
+
+  uint32_t inside_[(FENCE_MAX_FENCES + 31) / 32];
+  uint32_t listed_[(FENCE_MAX_FENCES + 31) / 32];  // in the current cell
+
+  uint32_t fixes_;
+  uint32_t tests_;
+  uint32_t events_;
+  uint32_t cellLoads_;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#include "FenceImage.h"
+
+// Nibble table: the CRC only runs when an image is received or mounted
+uint32_t fenceCrc32(const void* data, size_t len, uint32_t crc) {
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+bool fenceImageHeaderValid(const FenceImageHeader& h, uint32_t capacity) {
+  if (h.magic != FENCE_IMAGE_MAGIC) return false;
+  if (h.length < sizeof(h) || h.length > capacity) return false;
+  if (h.cols == 0 || h.rows == 0 || h.cellLat_e7 == 0 || h.cellLng_e7 == 0) return false;
+
+  uint64_t cells = (uint64_t)h.cols * h.rows;
+  uint64_t idsOffset = sizeof(h) + (cells + 1) * 4;
+  if (h.idsOffset < idsOffset || h.idsOffset > h.length) return false;
+  if (h.fencesOffset < h.idsOffset || h.fencesOffset % 4 != 0) return false;
+  return (uint64_t)h.fencesOffset + (uint64_t)h.fenceCount * sizeof(FenceEntry) <= h.length;
+}
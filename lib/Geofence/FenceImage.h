@@ -0,0 +1,71 @@
+#ifndef FENCE_IMAGE_H
+#define FENCE_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A compiled fence set as the server sends it and the device keeps it on
+// flash (see tools/ingest_server.py, which compiles it from JSON).
+//
+// Layout (little-endian; offsets are from the start of the image):
+//
+//   FenceImageHeader
+//   cell starts   uint32[cols * rows + 1], right after the header: the
+//                 fences of cell (row, col) are ids[start[c] .. start[c+1])
+//                 with c = row * cols + col
+//   ids           uint16 fence indices, at idsOffset
+//   fences        FenceEntry[fenceCount], at fencesOffset
+//   data          per fence, at its dataOffset: a circle is centre lat,
+//                 lng (degrees * 1e7) and radius in cm, three int32; a
+//                 polygon is 'vertices' lat, lng pairs of int32
+//
+// The grid is a uniform one over the bounding box of all fences; a fence
+// is listed in every cell its own bounding box touches, so the cell of a
+// point names every fence the point can be in. Fences must not cross the
+// antimeridian.
+
+#define FENCE_IMAGE_MAGIC 0x31464E47UL  // "GNF1"
+
+#define FENCE_CIRCLE  1
+#define FENCE_POLYGON 2
+
+struct FenceImageHeader {
+  uint32_t magic;
+  uint32_t version;       // of the fence set, chosen by the server
+  uint32_t length;        // whole image, header included
+  uint32_t crc;           // CRC-32 of everything after the header
+  uint16_t fenceCount;
+  uint16_t cols;
+  uint16_t rows;
+  uint16_t reserved;
+  int32_t lat0_e7;        // south-west corner of the grid
+  int32_t lng0_e7;
+  uint32_t cellLat_e7;    // cell size
+  uint32_t cellLng_e7;
+  uint32_t idsOffset;
+  uint32_t fencesOffset;
+};
+
+struct FenceEntry {
+  uint32_t id;            // the server's, reported in events
+  uint8_t type;           // FENCE_CIRCLE / FENCE_POLYGON
+  uint8_t reserved;
+  uint16_t vertices;      // polygon vertex count
+  int32_t minLat_e7;      // bounding box
+  int32_t minLng_e7;
+  int32_t maxLat_e7;
+  int32_t maxLng_e7;
+  uint32_t dataOffset;
+};
+
+static_assert(sizeof(FenceImageHeader) == 48, "FenceImageHeader layout is part of the image format");
+static_assert(sizeof(FenceEntry) == 28, "FenceEntry layout is part of the image format");
+
+// CRC-32 (IEEE) continued from 'crc' (0 to start), as zlib.crc32() does
+uint32_t fenceCrc32(const void* data, size_t len, uint32_t crc = 0);
+
+// Checks the header's own fields against each other and 'capacity';
+// the CRC is checked separately
+bool fenceImageHeaderValid(const FenceImageHeader& h, uint32_t capacity);
+
+#endif
@@ -0,0 +1,115 @@
+#include "FenceStore.h"
+
+#include <string.h>
+
+#define SLOT_MAGIC 0x544C5346UL  // "FSLT"
+#define SLOT_HEADER_SIZE 16
+
+static_assert(SLOT_HEADER_SIZE % 4 == 0, "images start word-aligned");
+
+FenceStore::FenceStore(FlashDevice& flash)
+  : flash_(flash), slotSize_(0), active_(-1), generation_(0), writing_(false), written_(0),
+    erasedTo_(0) {
+  memset(&header_, 0, sizeof(header_));
+}
+
+uint32_t FenceStore::capacity() const {
+  return slotSize_ > SLOT_HEADER_SIZE ? slotSize_ - SLOT_HEADER_SIZE : 0;
+}
+
+// Reads the image header of a slot and checks it and the CRC of the rest
+bool FenceStore::checkImage(int slot, FenceImageHeader& out) {
+  uint32_t base = slotBase(slot) + SLOT_HEADER_SIZE;
+  if (!flash_.read(base, &out, sizeof(out))) return false;
+  if (!fenceImageHeaderValid(out, capacity())) return false;
+
+  uint8_t buf[256];
+  uint32_t crc = 0;
+  for (uint32_t at = sizeof(out); at < out.length;) {
+    uint32_t n = out.length - at < sizeof(buf) ? out.length - at : sizeof(buf);
+    if (!flash_.read(base + at, buf, n)) return false;
+    crc = fenceCrc32(buf, n, crc);
+    at += n;
+  }
+  return crc == out.crc;
+}
+
+bool FenceStore::begin() {
+  uint32_t sector = flash_.sectorSize();
+  slotSize_ = sector ? flash_.size() / 2 / sector * sector : 0;
+  active_ = -1;
+  writing_ = false;
+  if (slotSize_ == 0) return false;
+
+  for (int slot = 0; slot < 2; slot++) {
+    SlotHeader sh;
+    if (!flash_.read(slotBase(slot), &sh, sizeof(sh))) continue;
+    if (sh.magic != SLOT_MAGIC || sh.crc != fenceCrc32(&sh, 12)) continue;
+    if (active_ >= 0 && (int32_t)(sh.generation - generation_) <= 0) continue;
+
+    FenceImageHeader h;
+    if (!checkImage(slot, h) || h.length != sh.length) continue;
+    active_ = slot;
+    generation_ = sh.generation;
+    header_ = h;
+  }
+  return valid();
+}
+
+bool FenceStore::read(uint32_t offset, void* buf, size_t len) {
+  if (!valid() || offset > header_.length || len > header_.length - offset) return false;
+  return flash_.read(slotBase(active_) + SLOT_HEADER_SIZE + offset, buf, len);
+}
+
+bool FenceStore::beginWrite() {
+  if (slotSize_ == 0) return false;
+  writing_ = true;
+  written_ = 0;
+  erasedTo_ = 0;
+  return true;
+}
+
+bool FenceStore::write(const void* data, size_t len) {
+  if (!writing_) return false;
+  if (len > capacity() - written_) {
+    writing_ = false;
+    return false;
+  }
+
+  int slot = active_ == 0 ? 1 : 0;
+  uint32_t end = SLOT_HEADER_SIZE + written_ + len;
+  while (erasedTo_ < end) {
+    if (!flash_.eraseSector(slotBase(slot) + erasedTo_)) {
+      writing_ = false;
+      return false;
+    }
+    erasedTo_ += flash_.sectorSize();
+  }
+  if (!flash_.write(slotBase(slot) + SLOT_HEADER_SIZE + written_, data, len)) {
+    writing_ = false;
+    return false;
+  }
+  written_ += len;
+  return true;
+}
+
+bool FenceStore::commit() {
+  if (!writing_) return false;
+  writing_ = false;
+
+  int slot = active_ == 0 ? 1 : 0;
+  FenceImageHeader h;
+  if (!checkImage(slot, h) || h.length != written_) return false;
+
+  SlotHeader sh;
+  sh.magic = SLOT_MAGIC;
+  sh.generation = valid() ? generation_ + 1 : 1;
+  sh.length = h.length;
+  sh.crc = fenceCrc32(&sh, 12);
+  if (!flash_.write(slotBase(slot), &sh, sizeof(sh))) return false;
+
+  active_ = slot;
+  generation_ = sh.generation;
+  header_ = h;
+  return true;
+}
@@ -0,0 +1,65 @@
+#ifndef FENCE_STORE_H
+#define FENCE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <FlashDevice.h>
+#include "FenceImage.h"
+
+// The fence image on flash, in two slots so a new one can be received
+// while the current one stays in use.
+//
+// Each slot is a 16 byte slot header {magic, generation, length, crc}
+// followed by the image. A new image is written into the slot not in use,
+// erasing sectors as the data reaches them; only once commit() has read
+// it back and checked its CRC is the slot header written, with the next
+// generation. Mounting picks the valid slot with the newest generation,
+// so a download cut short by a reset leaves the previous image in place.
+class FenceStore {
+public:
+  explicit FenceStore(FlashDevice& flash);
+
+  // Mounts the newest valid image; false if there is none
+  bool begin();
+
+  bool valid() const { return active_ >= 0; }
+  const FenceImageHeader& header() const { return header_; }
+  uint32_t version() const { return valid() ? header_.version : 0; }
+
+  // Reads from the mounted image; false outside it
+  bool read(uint32_t offset, void* buf, size_t len);
+
+  // Receiving a new image. The mounted one is not touched until commit()
+  // succeeds; on false from write() or commit() the new one is dropped.
+  bool beginWrite();
+  bool write(const void* data, size_t len);
+  bool commit();
+  void abort() { writing_ = false; }
+  bool writing() const { return writing_; }
+
+  // Largest image a slot can take
+  uint32_t capacity() const;
+
+private:
+  struct SlotHeader {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t length;
+    uint32_t crc;
+  };
+
+  uint32_t slotBase(int slot) const { return (uint32_t)slot * slotSize_; }
+  bool checkImage(int slot, FenceImageHeader& out);
+
+  FlashDevice& flash_;
+  uint32_t slotSize_;
+  int active_;             // -1 if nothing is mounted
+  uint32_t generation_;
+  FenceImageHeader header_;
+
+  bool writing_;
+  uint32_t written_;       // image bytes so far
+  uint32_t erasedTo_;      // slot-relative end of the erased area
+};
+
+#endif
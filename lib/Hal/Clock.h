@@ -0,0 +1,30 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+// Millisecond time source. The tracker only reads time and waits through
+// this, so a host build can run it on a virtual clock (see SimClock).
+class Clock {
+public:
+  virtual ~Clock() {}
+
+  // Milliseconds since start; wraps after ~49 days
+  virtual uint32_t millis() = 0;
+
+  // Blocks for ms milliseconds
+  virtual void delay(uint32_t ms) = 0;
+};
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+// The Arduino core's millis() and delay()
+class ArduinoClock : public Clock {
+public:
+  uint32_t millis() override { return ::millis(); }
+  void delay(uint32_t ms) override { ::delay(ms); }
+};
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef NEOPIXEL_LED_H
+#define NEOPIXEL_LED_H
+
+#ifdef ARDUINO
+#include <Adafruit_NeoPixel.h>
+#include "StatusLed.h"
+
+// StatusLed on the first pixel of a NeoPixel strip (the ESP32-C3
+// DevKitM's built-in RGB LED is a strip of one)
+class NeoPixelLed : public StatusLed {
+public:
+  explicit NeoPixelLed(Adafruit_NeoPixel& pixels) : pixels_(pixels) {}
+
+  void set(uint8_t r, uint8_t g, uint8_t b) override {
+    pixels_.setPixelColor(0, pixels_.Color(r, g, b));
+    pixels_.show();
+  }
+
+private:
+  Adafruit_NeoPixel& pixels_;
+};
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef STATUS_LED_H
+#define STATUS_LED_H
+
+#include <stdint.h>
+
+// The single RGB status LED
+class StatusLed {
+public:
+  virtual ~StatusLed() {}
+
+  virtual void set(uint8_t r, uint8_t g, uint8_t b) = 0;
+
+  void off() { set(0, 0, 0); }
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "LedEngine.h"
+
+LedEngine::LedEngine(StatusLed& led) : led_(led), count_(0), r_(0), g_(0), b_(0), writes_(0) {}
+
+void LedEngine::remove(uint8_t i) {
+  active_[i] = active_[--count_];
+}
+
+void LedEngine::start(const LedPattern& pattern, uint32_t now) {
+  for (uint8_t i = 0; i < count_; i++) {
+    if (active_[i].pattern == &pattern) {
+      active_[i].start = now;
+      return;
+    }
+  }
+  if (count_ == LED_MAX_ACTIVE) {
+    uint8_t lowest = 0;
+    for (uint8_t i = 1; i < count_; i++) {
+      if (active_[i].pattern->priority < active_[lowest].pattern->priority) lowest = i;
+    }
+    if (active_[lowest].pattern->priority >= pattern.priority) return;
+    remove(lowest);
+  }
+  active_[count_].pattern = &pattern;
+  active_[count_].start = now;
+  count_++;
+}
+
+void LedEngine::stop(const LedPattern& pattern) {
+  for (uint8_t i = 0; i < count_; i++) {
+    if (active_[i].pattern == &pattern) {
+      remove(i);
+      return;
+    }
+  }
+}
+
+bool LedEngine::running(const LedPattern& pattern) const {
+  for (uint8_t i = 0; i < count_; i++) {
+    if (active_[i].pattern == &pattern) return true;
+  }
+  return false;
+}
+
+void LedEngine::tick(uint32_t now) {
+  const Active* shown = 0;
+  uint8_t i = 0;
+  while (i < count_) {
+    const LedPattern& p = *active_[i].pattern;
+    uint32_t elapsed = now - active_[i].start;
+    uint32_t period = (uint32_t)p.onMs + p.offMs;
+    if (period == 0 || (p.count && elapsed >= period * p.count)) {
+      remove(i);
+      continue;
+    }
+    if (elapsed % period < p.onMs &&
+        (!shown || p.priority > shown->pattern->priority ||
+         (p.priority == shown->pattern->priority &&
+          (int32_t)(active_[i].start - shown->start) > 0))) {
+      shown = &active_[i];
+    }
+    i++;
+  }
+
+  uint8_t r = 0, g = 0, b = 0;
+  if (shown) {
+    r = shown->pattern->r;
+    g = shown->pattern->g;
+    b = shown->pattern->b;
+  }
+  if (r == r_ && g == g_ && b == b_) return;
+  r_ = r;
+  g_ = g;
+  b_ = b;
+  led_.set(r, g, b);
+  writes_++;
+}
+
+bool LedEngine::nextChange(uint32_t now, uint32_t& at) const {
+  bool any = false;
+  uint32_t soonest = 0;
+  for (uint8_t i = 0; i < count_; i++) {
+    const LedPattern& p = *active_[i].pattern;
+    uint32_t elapsed = now - active_[i].start;
+    uint32_t period = (uint32_t)p.onMs + p.offMs;
+    uint32_t in = 0;  // an empty pattern is dropped by the next tick()
+    if (period) {
+      uint32_t phase = elapsed % period;
+      in = phase < p.onMs ? p.onMs - phase : period - phase;
+    }
+    if (!any || in < soonest) soonest = in;
+    any = true;
+  }
+  at = now + soonest;
+  return any;
+}
@@ -0,0 +1,64 @@
+#ifndef LED_ENGINE_H
+#define LED_ENGINE_H
+
+#include <stdint.h>
+#include <StatusLed.h>
+
+// Patterns that can run at the same time
+#ifndef LED_MAX_ACTIVE
+#define LED_MAX_ACTIVE 4
+#endif
+
+// A blink pattern: 'count' blinks of onMs lit and offMs dark, or repeated
+// until stopped if count is 0. A higher priority wins while both are lit.
+struct LedPattern {
+  uint8_t r, g, b;
+  uint16_t onMs;
+  uint16_t offMs;
+  uint8_t count;
+  uint8_t priority;
+};
+
+// Plays LedPatterns on the status LED without blocking.
+//
+// start() and stop() only note what should be shown; tick() works out the
+// colour from the elapsed time and writes the LED only when it changes,
+// so calling it on every loop() pass costs a few comparisons. Of the
+// patterns that are lit at the moment, the one with the highest priority
+// (the latest started on a tie) is shown, so a state such as "uploading"
+// lets shorter events show through its dark phases. Patterns are
+// identified by address and are expected to be static.
+class LedEngine {
+public:
+  explicit LedEngine(StatusLed& led);
+
+  // (Re)starts a pattern. With every slot taken it replaces the lowest
+  // priority pattern, if that is below its own.
+  void start(const LedPattern& pattern, uint32_t now);
+  void stop(const LedPattern& pattern);
+  bool running(const LedPattern& pattern) const;
+
+  // Drops finished patterns and updates the LED
+  void tick(uint32_t now);
+
+  // When tick() next has something to do; false if nothing is running
+  bool nextChange(uint32_t now, uint32_t& at) const;
+
+  uint32_t writes() const { return writes_; }
+
+private:
+  struct Active {
+    const LedPattern* pattern;
+    uint32_t start;
+  };
+
+  void remove(uint8_t i);
+
+  StatusLed& led_;
+  Active active_[LED_MAX_ACTIVE];
+  uint8_t count_;
+  uint8_t r_, g_, b_;  // as last written
+  uint32_t writes_;
+};
+
+#endif
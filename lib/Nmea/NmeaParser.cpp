@@ -0,0 +1,266 @@
+#include "NmeaParser.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static int hexValue(uint8_t c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Digits with an optional sign and decimal point, scaled to 'decimals'
+// places (further decimals are dropped). False if empty, not a number or
+// too large for an int32_t once scaled.
+static bool parseFixed(const char* s, size_t len, uint8_t decimals, int32_t& out) {
+  size_t i = 0;
+  bool negative = len > 0 && s[0] == '-';
+  if (negative) i = 1;
+  if (i >= len) return false;
+
+  int32_t v = 0;
+  int frac = -1;  // decimals seen, -1 before the point
+  for (; i < len; i++) {
+    char c = s[i];
+    if (c == '.') {
+      if (frac >= 0) return false;
+      frac = 0;
+      continue;
+    }
+    if (c < '0' || c > '9') return false;
+    if (frac >= 0) {
+      if (frac >= decimals) continue;
+      frac++;
+    }
+    if (v > (INT32_MAX - 9) / 10) return false;
+    v = v * 10 + (c - '0');
+  }
+  for (int f = frac < 0 ? 0 : frac; f < decimals; f++) {
+    if (v > INT32_MAX / 10) return false;
+    v *= 10;
+  }
+  out = negative ? -v : v;
+  return true;
+}
+
+// "ddmm.mmmmm" or "dddmm.mmmmm" to degrees * 1e7
+static bool parseCoordinate(const char* s, size_t len, int32_t& out) {
+  size_t dot = 0;
+  while (dot < len && s[dot] != '.') dot++;
+  if (dot < 3) return false;
+
+  int32_t degrees = 0;
+  if (dot > 5) return false;
+  for (size_t i = 0; i + 2 < dot; i++) {
+    if (s[i] < '0' || s[i] > '9') return false;
+    degrees = degrees * 10 + (s[i] - '0');
+  }
+  int32_t minutes_e5;
+  if (!parseFixed(s + dot - 2, len - (dot - 2), 5, minutes_e5)) return false;
+  if (degrees > 180 || minutes_e5 < 0 || minutes_e5 >= 6000000) return false;
+  // minutes * 1e5 / 60 * 1e2, rounded
+  out = degrees * 10000000 + (minutes_e5 * 10 + 3) / 6;
+  return true;
+}
+
+// "hhmmss.ss"
+static bool parseTime(const char* s, size_t len, NmeaFix& fix, uint32_t& hhmmsscc) {
+  int32_t v;
+  if (len < 6 || !parseFixed(s, len, 2, v) || v < 0) return false;
+  uint8_t hour = (uint8_t)(v / 1000000);
+  uint8_t minute = (uint8_t)(v / 10000 % 100);
+  uint8_t second = (uint8_t)(v / 100 % 100);
+  if (hour > 23 || minute > 59 || second > 60) return false;
+  fix.hour = hour;
+  fix.minute = minute;
+  fix.second = second;
+  fix.centisecond = (uint8_t)(v % 100);
+  fix.hasTime = true;
+  hhmmsscc = (uint32_t)v;
+  return true;
+}
+
+// "ddmmyy"
+static bool parseDate(const char* s, size_t len, NmeaFix& fix) {
+  int32_t v;
+  if (len != 6 || !parseFixed(s, len, 0, v) || v < 0) return false;
+  uint8_t day = (uint8_t)(v / 10000);
+  uint8_t month = (uint8_t)(v / 100 % 100);
+  if (day < 1 || day > 31 || month < 1 || month > 12) return false;
+  fix.day = day;
+  fix.month = month;
+  fix.year = (uint16_t)(2000 + v % 100);
+  fix.hasDate = true;
+  return true;
+}
+
+NmeaParser::NmeaParser()
+  : state_(IDLE), sentence_(SENTENCE_RMC), fieldIndex_(0), fieldLen_(0),
+    checksum_(0), received_(0), workTime_(0), workStatusOk_(false), rmcTime_(0), haveRmc_(false),
+    sentences_(0), skipped_(0), checksumErrors_(0), malformed_(0) {
+  memset(&work_, 0, sizeof(work_));
+  memset(&rmc_, 0, sizeof(rmc_));
+  memset(&fix_, 0, sizeof(fix_));
+}
+
+// $GxRMC,time,status,lat,N/S,lng,E/W,knots,course,date,...
+void NmeaParser::parseRmcField(const char* s, size_t len) {
+  int32_t v;
+  switch (fieldIndex_) {
+    case 0: parseTime(s, len, work_, workTime_); break;
+    case 1: workStatusOk_ = len == 1 && s[0] == 'A'; break;
+    case 2: parseCoordinate(s, len, work_.lat_e7); break;
+    case 3: if (len == 1 && s[0] == 'S') work_.lat_e7 = -work_.lat_e7; break;
+    case 4: parseCoordinate(s, len, work_.lng_e7); break;
+    case 5: if (len == 1 && s[0] == 'W') work_.lng_e7 = -work_.lng_e7; break;
+    case 6:
+      // Knots * 1000 to mm/s
+      if (parseFixed(s, len, 3, v) && v >= 0) {
+        work_.speed_mms = (uint32_t)v * 1852 / 3600;
+        work_.hasMotion = true;
+      }
+      break;
+    case 7: if (parseFixed(s, len, 2, v) && v >= 0) work_.course_e2 = (uint32_t)v; break;
+    case 8: parseDate(s, len, work_); break;
+    default: break;
+  }
+}
+
+// $GxGGA,time,lat,N/S,lng,E/W,quality,satellites,hdop,altitude,M,...
+void NmeaParser::parseGgaField(const char* s, size_t len) {
+  int32_t v;
+  switch (fieldIndex_) {
+    case 0: parseTime(s, len, work_, workTime_); break;
+    case 1: parseCoordinate(s, len, work_.lat_e7); break;
+    case 2: if (len == 1 && s[0] == 'S') work_.lat_e7 = -work_.lat_e7; break;
+    case 3: parseCoordinate(s, len, work_.lng_e7); break;
+    case 4: if (len == 1 && s[0] == 'W') work_.lng_e7 = -work_.lng_e7; break;
+    case 5: if (parseFixed(s, len, 0, v) && v >= 0 && v < 10) work_.quality = (uint8_t)v; break;
+    case 6: if (parseFixed(s, len, 0, v) && v >= 0 && v < 100) work_.satellites = (uint8_t)v; break;
+    case 7: if (parseFixed(s, len, 2, v) && v >= 0 && v < 65536) work_.hdop_e2 = (uint16_t)v; break;
+    case 8: if (parseFixed(s, len, 1, v)) work_.alt_dm = v; break;
+    default: break;
+  }
+}
+
+void NmeaParser::endField() {
+  if (sentence_ == SENTENCE_RMC) parseRmcField(field_, fieldLen_);
+  else parseGgaField(field_, fieldLen_);
+  if (fieldIndex_ < 255) fieldIndex_++;
+  fieldLen_ = 0;
+}
+
+// A checksummed sentence: an RMC waits for the GGA of the same epoch,
+// a GGA completes the fix
+bool NmeaParser::commit() {
+  if (sentence_ == SENTENCE_RMC) {
+    rmc_ = work_;
+    rmc_.valid = workStatusOk_;
+    rmcTime_ = workTime_;
+    haveRmc_ = work_.hasTime;
+    return false;
+  }
+
+  fix_ = work_;
+  fix_.valid = work_.quality > 0;
+  if (haveRmc_ && work_.hasTime && rmcTime_ == workTime_) {
+    fix_.valid = fix_.valid && rmc_.valid;
+    fix_.hasMotion = rmc_.hasMotion;
+    fix_.speed_mms = rmc_.speed_mms;
+    fix_.course_e2 = rmc_.course_e2;
+    fix_.hasDate = rmc_.hasDate;
+    fix_.year = rmc_.year;
+    fix_.month = rmc_.month;
+    fix_.day = rmc_.day;
+  }
+  haveRmc_ = false;
+  return true;
+}
+
+bool NmeaParser::encode(uint8_t b) {
+  // A '$' always starts a sentence, whatever came before
+  if (b == '$') {
+    state_ = ADDRESS;
+    fieldLen_ = 0;
+    checksum_ = 0;
+    return false;
+  }
+
+  switch (state_) {
+    case IDLE:
+    case SKIP:
+      return false;
+
+    case ADDRESS:
+      if (b != ',') {
+        checksum_ ^= b;
+        if (fieldLen_ < 5) field_[fieldLen_++] = (char)b;
+        else fieldLen_ = 6;  // too long for a talker + sentence ID
+        return false;
+      }
+      checksum_ ^= b;
+      if (fieldLen_ == 5 && field_[2] == 'R' && field_[3] == 'M' && field_[4] == 'C') {
+        sentence_ = SENTENCE_RMC;
+      } else if (fieldLen_ == 5 && field_[2] == 'G' && field_[3] == 'G' && field_[4] == 'A') {
+        sentence_ = SENTENCE_GGA;
+      } else {
+        skipped_++;
+        state_ = SKIP;
+        return false;
+      }
+      memset(&work_, 0, sizeof(work_));
+      workTime_ = 0;
+      workStatusOk_ = false;
+      fieldIndex_ = 0;
+      fieldLen_ = 0;
+      state_ = FIELDS;
+      return false;
+
+    case FIELDS:
+      if (b == '*') {
+        endField();
+        state_ = CHECKSUM1;
+        return false;
+      }
+      if (b < 0x20 || b > 0x7E) {
+        state_ = IDLE;  // cut short
+        return false;
+      }
+      checksum_ ^= b;
+      if (b == ',') {
+        endField();
+      } else if (fieldLen_ < NMEA_MAX_FIELD) {
+        field_[fieldLen_++] = (char)b;
+      } else {
+        malformed_++;   // no RMC or GGA field is this long
+        state_ = SKIP;
+      }
+      return false;
+
+    case CHECKSUM1: {
+      int h = hexValue(b);
+      if (h < 0) {
+        state_ = IDLE;
+        return false;
+      }
+      received_ = (uint8_t)(h << 4);
+      state_ = CHECKSUM2;
+      return false;
+    }
+
+    case CHECKSUM2: {
+      int h = hexValue(b);
+      state_ = IDLE;
+      if (h < 0) return false;
+      received_ |= (uint8_t)h;
+      if (received_ != checksum_) {
+        checksumErrors_++;
+        return false;
+      }
+      sentences_++;
+      return commit();
+    }
+  }
+  return false;
+}
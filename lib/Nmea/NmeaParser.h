@@ -0,0 +1,87 @@
+#ifndef NMEA_PARSER_H
+#define NMEA_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest field that is parsed ("dddmm.mmmmm" plus some slack); a sentence
+// with a longer field is dropped
+#define NMEA_MAX_FIELD 15
+
+// One epoch's solution: GGA, plus date and motion from the RMC of the same
+// epoch if it came first (as the NEO-7M sends them)
+struct NmeaFix {
+  bool valid;            // GGA fix quality > 0, and RMC status A if there was one
+  int32_t lat_e7;        // degrees * 1e7
+  int32_t lng_e7;
+  int32_t alt_dm;        // metres above mean sea level * 10
+  uint8_t quality;       // GGA fix quality, 0 = no fix
+  uint8_t satellites;    // used in the solution
+  uint16_t hdop_e2;      // HDOP * 100, 0 if not reported
+  bool hasMotion;        // speed and course from RMC
+  uint32_t speed_mms;    // ground speed, mm/s
+  uint32_t course_e2;    // degrees * 100
+  bool hasTime;
+  bool hasDate;          // from RMC
+  uint16_t year;
+  uint8_t month, day, hour, minute, second, centisecond;
+};
+
+// Byte-at-a-time NMEA 0183 front end.
+//
+// The sentence is recognised from its address field ("GPRMC", "GNGGA",
+// ...); anything other than RMC and GGA is skipped up to the next '$'
+// without being checksummed or split into fields, so the GSV/GSA/VTG/GLL
+// traffic of a default receiver costs one comparison per byte. RMC and GGA
+// are parsed field by field, with integer arithmetic only, into an
+// NmeaFix; nothing is committed unless the checksum matches.
+class NmeaParser {
+public:
+  NmeaParser();
+
+  // Returns true when b completes a valid GGA; fix() then holds the
+  // epoch's solution until the next one
+  bool encode(uint8_t b);
+
+  const NmeaFix& fix() const { return fix_; }
+
+  uint32_t sentences() const { return sentences_; }       // parsed and checksummed
+  uint32_t skipped() const { return skipped_; }           // not RMC or GGA
+  uint32_t checksumErrors() const { return checksumErrors_; }
+  uint32_t malformed() const { return malformed_; }       // dropped for an overlong field
+
+private:
+  enum State { IDLE, ADDRESS, FIELDS, CHECKSUM1, CHECKSUM2, SKIP };
+  enum Sentence { SENTENCE_RMC, SENTENCE_GGA };
+
+  void endField();
+  void parseRmcField(const char* s, size_t len);
+  void parseGgaField(const char* s, size_t len);
+  bool commit();
+
+  State state_;
+  Sentence sentence_;
+  uint8_t fieldIndex_;
+  uint8_t fieldLen_;
+  char field_[NMEA_MAX_FIELD];
+  uint8_t checksum_;
+  uint8_t received_;
+
+  // The sentence being parsed
+  NmeaFix work_;
+  uint32_t workTime_;    // hhmmsscc, to pair RMC with GGA
+  bool workStatusOk_;
+
+  // The RMC waiting for its GGA
+  NmeaFix rmc_;
+  uint32_t rmcTime_;
+  bool haveRmc_;
+
+  NmeaFix fix_;
+  uint32_t sentences_;
+  uint32_t skipped_;
+  uint32_t checksumErrors_;
+  uint32_t malformed_;
+};
+
+#endif
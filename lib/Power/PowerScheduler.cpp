@@ -0,0 +1,35 @@
+#include "PowerScheduler.h"
+
+PowerScheduler::PowerScheduler(uint32_t minSleepMs, uint32_t maxSleepMs)
+  : minSleepMs_(minSleepMs), maxSleepMs_(maxSleepMs), now_(0),
+    remaining_(maxSleepMs), held_(false), sleeps_(0), sleptMs_(0) {}
+
+void PowerScheduler::begin(uint32_t now) {
+  now_ = now;
+  remaining_ = maxSleepMs_;
+  held_ = false;
+}
+
+void PowerScheduler::deadline(uint32_t at) {
+  int32_t left = (int32_t)(at - now_);
+  uint32_t ms = left > 0 ? (uint32_t)left : 0;
+  if (ms < remaining_) remaining_ = ms;
+}
+
+void PowerScheduler::deadlineEvery(uint32_t last, uint32_t periodMs, uint32_t leadMs) {
+  if (periodMs == 0) return;
+  // Position in the cycle, counted from leadMs before an occurrence
+  uint32_t r = (now_ - last + leadMs) % periodMs;
+  // Awake from leadMs before an expected occurrence to leadMs after it
+  deadline(now_ + (r < 2 * leadMs ? 0 : periodMs - r));
+}
+
+uint32_t PowerScheduler::sleepFor() const {
+  if (held_ || remaining_ < minSleepMs_) return 0;
+  return remaining_;
+}
+
+void PowerScheduler::slept(uint32_t ms) {
+  sleeps_++;
+  sleptMs_ += ms;
+}
@@ -0,0 +1,58 @@
+#ifndef POWER_SCHEDULER_H
+#define POWER_SCHEDULER_H
+
+#include <stdint.h>
+
+// Decides how long loop() may sleep.
+//
+// Every pass starts with begin(now), then reports each upcoming
+// deadline (next upload, next status line, next expected GPS burst, ...)
+// and calls hold() for any work that must not be slept through, such as
+// a command waiting for the modem. sleepFor() then gives the time to the
+// earliest deadline, or 0 to keep running.
+//
+// Deadlines are millis() values and compare wrap-safely; one that has
+// already passed means "now". Nothing in here touches hardware, so a wake
+// timeline can be replayed on a host.
+class PowerScheduler {
+public:
+  // Sleeps shorter than minSleepMs are not worth the wake-up cost;
+  // maxSleepMs bounds a sleep when there is no deadline at all
+  PowerScheduler(uint32_t minSleepMs, uint32_t maxSleepMs);
+
+  void begin(uint32_t now);
+
+  // Something is due at 'at'
+  void deadline(uint32_t at);
+
+  // An event that repeats every periodMs and was last seen at 'last'
+  // (e.g. the receiver's fix bursts). Keeps the CPU awake from leadMs
+  // before each expected occurrence until leadMs after it, so a slightly
+  // late one is not slept through.
+  void deadlineEvery(uint32_t last, uint32_t periodMs, uint32_t leadMs);
+
+  // Keeps the CPU awake for this pass
+  void hold() { held_ = true; }
+  bool held() const { return held_; }
+
+  // Milliseconds to sleep, or 0 to keep running
+  uint32_t sleepFor() const;
+
+  // Records a finished sleep, measured by the caller (a wake-up source
+  // may have cut it short)
+  void slept(uint32_t ms);
+
+  uint32_t sleeps() const { return sleeps_; }
+  uint64_t sleptMs() const { return sleptMs_; }
+
+private:
+  uint32_t minSleepMs_;
+  uint32_t maxSleepMs_;
+  uint32_t now_;
+  uint32_t remaining_;   // to the earliest deadline seen this pass
+  bool held_;
+  uint32_t sleeps_;
+  uint64_t sleptMs_;
+};
+
+#endif
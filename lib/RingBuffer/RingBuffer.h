@@ -0,0 +1,50 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+
+// Fixed-capacity FIFO of POD records, sized at compile time.
+//
+// Elements are addressed by age: [0] is the oldest. Nothing is ever
+// constructed, copied around or destroyed in bulk, so clear() and
+// dropFront() are O(1) regardless of capacity. Not thread-safe; use
+// SpscQueue to hand data between tasks.
+template <typename T, size_t N>
+class RingBuffer {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+  RingBuffer() : tail_(0), count_(0) {}
+
+  // Returns false (and drops v) when the buffer is full
+  bool push(const T& v) {
+    if (count_ == N) return false;
+    buf_[(tail_ + count_) & (N - 1)] = v;
+    count_++;
+    return true;
+  }
+
+  // Forgets the n oldest elements
+  void dropFront(size_t n) {
+    if (n > count_) n = count_;
+    tail_ = (tail_ + n) & (N - 1);
+    count_ -= n;
+  }
+
+  void clear() { tail_ = 0; count_ = 0; }
+
+  T& operator[](size_t i) { return buf_[(tail_ + i) & (N - 1)]; }
+  const T& operator[](size_t i) const { return buf_[(tail_ + i) & (N - 1)]; }
+
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  bool full() const { return count_ == N; }
+  static size_t capacity() { return N; }
+
+private:
+  T buf_[N];
+  size_t tail_;
+  size_t count_;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "SamplingPolicy.h"
+
+#include <Geo.h>
+
+FixedIntervalPolicy::FixedIntervalPolicy(uint32_t intervalMs)
+  : intervalMs_(intervalMs), lastMs_(0), haveLast_(false) {}
+
+bool FixedIntervalPolicy::accept(const TrackPoint& p) {
+  if (!haveLast_) {
+    reason_ = SAMPLE_FIRST;
+  } else if (p.ms - lastMs_ >= intervalMs_) {
+    reason_ = SAMPLE_HEARTBEAT;
+  } else {
+    reason_ = SAMPLE_SKIP;
+    return false;
+  }
+  lastMs_ = p.ms;
+  haveLast_ = true;
+  return true;
+}
+
+AdaptivePolicy::AdaptivePolicy(const AdaptiveSamplingConfig& config)
+  : config_(config), haveLast_(false) {}
+
+AdaptiveSamplingConfig AdaptivePolicy::defaults() {
+  AdaptiveSamplingConfig c;
+  c.minIntervalMs = 1000;
+  c.maxIntervalMs = 60000;
+  c.maxDistanceM = 250;
+  c.headingDelta_e1 = 200;   // 20 degrees
+  c.speedDelta_e1 = 150;     // 15 km/h
+  c.movingSpeed_e1 = 50;     // 5 km/h
+  return c;
+}
+
+SampleReason AdaptivePolicy::classify(const TrackPoint& p) const {
+  if (!haveLast_) return SAMPLE_FIRST;
+
+  uint32_t dt = p.ms - last_.ms;
+  if (dt < config_.minIntervalMs) return SAMPLE_SKIP;
+  if (dt >= config_.maxIntervalMs) return SAMPLE_HEARTBEAT;
+
+  bool moving = p.speed_e1 >= config_.movingSpeed_e1;
+  bool wasMoving = last_.speed_e1 >= config_.movingSpeed_e1;
+
+  // Starting and stopping are always worth a point
+  if (moving != wasMoving) return SAMPLE_SPEED;
+  if (!moving) return SAMPLE_SKIP;  // parked: position changes are jitter
+
+  uint32_t dv = p.speed_e1 > last_.speed_e1 ? p.speed_e1 - last_.speed_e1
+                                            : last_.speed_e1 - p.speed_e1;
+  if (dv >= config_.speedDelta_e1) return SAMPLE_SPEED;
+
+  if (headingDelta(p.course_e1, last_.course_e1, 3600) >= config_.headingDelta_e1) {
+    return SAMPLE_HEADING;
+  }
+
+  float d = geoDistanceM(last_.lat_e7, last_.lng_e7, p.lat_e7, p.lng_e7);
+  if (d >= (float)config_.maxDistanceM) return SAMPLE_DISTANCE;
+
+  return SAMPLE_SKIP;
+}
+
+bool AdaptivePolicy::accept(const TrackPoint& p) {
+  reason_ = classify(p);
+  if (reason_ == SAMPLE_SKIP) return false;
+  last_ = p;
+  haveLast_ = true;
+  return true;
+}
@@ -0,0 +1,90 @@
+#ifndef SAMPLING_POLICY_H
+#define SAMPLING_POLICY_H
+
+#include <stdint.h>
+
+// A fix as seen by a sampling policy
+struct TrackPoint {
+  uint32_t ms;          // millis() when the fix was parsed
+  int32_t lat_e7;       // degrees * 1e7
+  int32_t lng_e7;
+  uint16_t speed_e1;    // km/h * 10
+  uint16_t course_e1;   // degrees * 10, [0, 3600); meaningless when stopped
+};
+
+// Why a point was kept (or not)
+enum SampleReason {
+  SAMPLE_SKIP,          // not kept
+  SAMPLE_FIRST,         // nothing kept yet
+  SAMPLE_HEARTBEAT,     // maximum interval reached
+  SAMPLE_DISTANCE,      // travelled far enough in a straight line
+  SAMPLE_HEADING,       // turned
+  SAMPLE_SPEED          // sped up, slowed down, started or stopped
+};
+
+// Decides which of the incoming fixes are worth storing and uploading.
+//
+// accept() is called with every fix in order; when it returns true the
+// caller keeps the point and the policy takes it as the new reference.
+// Policies do no I/O and use no Arduino APIs, so they run unchanged on a
+// host against recorded tracks.
+class SamplingPolicy {
+public:
+  virtual ~SamplingPolicy() {}
+
+  virtual bool accept(const TrackPoint& p) = 0;
+
+  // Forgets the reference point; the next fix is always accepted
+  virtual void reset() = 0;
+
+  SampleReason reason() const { return reason_; }
+
+protected:
+  SamplingPolicy() : reason_(SAMPLE_SKIP) {}
+  SampleReason reason_;
+};
+
+// Keeps one fix per interval regardless of motion
+class FixedIntervalPolicy : public SamplingPolicy {
+public:
+  explicit FixedIntervalPolicy(uint32_t intervalMs);
+
+  bool accept(const TrackPoint& p) override;
+  void reset() override { haveLast_ = false; }
+
+private:
+  uint32_t intervalMs_;
+  uint32_t lastMs_;
+  bool haveLast_;
+};
+
+// Keeps a fix when the vehicle has moved in a way the last kept point no
+// longer describes: it turned, changed speed, or went far in a straight
+// line. Parked vehicles only produce the heartbeat.
+struct AdaptiveSamplingConfig {
+  uint32_t minIntervalMs;     // never keep fixes closer together than this
+  uint32_t maxIntervalMs;     // heartbeat: always keep one fix this often
+  uint32_t maxDistanceM;      // keep after this far even on a straight road
+  uint16_t headingDelta_e1;   // turn that triggers a point, degrees * 10
+  uint16_t speedDelta_e1;     // speed change that triggers a point, km/h * 10
+  uint16_t movingSpeed_e1;    // below this the vehicle counts as stopped
+};
+
+class AdaptivePolicy : public SamplingPolicy {
+public:
+  explicit AdaptivePolicy(const AdaptiveSamplingConfig& config);
+
+  bool accept(const TrackPoint& p) override;
+  void reset() override { haveLast_ = false; }
+
+  static AdaptiveSamplingConfig defaults();
+
+private:
+  SampleReason classify(const TrackPoint& p) const;
+
+  AdaptiveSamplingConfig config_;
+  TrackPoint last_;
+  bool haveLast_;
+};
+
+#endif
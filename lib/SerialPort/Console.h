@@ -0,0 +1,47 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "SerialPort.h"
+
+// Arduino Print-style text output on a SerialPort, for the debug console.
+// Integers are printed in decimal, floating point values with a fixed
+// number of decimals (2 unless given), lines end in CRLF.
+class Console {
+public:
+  explicit Console(SerialPort& port) : port_(port) {}
+
+  SerialPort& port() { return port_; }
+
+  size_t write(const uint8_t* data, size_t len) { return port_.write(data, len); }
+
+  size_t print(const char* s) { return port_.print(s); }
+  size_t print(char c) { return port_.write((uint8_t)c); }
+  size_t print(int v) { return format("%d", v); }
+  size_t print(unsigned v) { return format("%u", v); }
+  size_t print(long v) { return format("%ld", v); }
+  size_t print(unsigned long v) { return format("%lu", v); }
+  size_t print(double v, int digits = 2) { return format("%.*f", digits, v); }
+
+  size_t println() { return port_.print("\r\n"); }
+  template <typename T>
+  size_t println(T v) { return print(v) + println(); }
+  size_t println(double v, int digits) { return print(v, digits) + println(); }
+
+private:
+  size_t format(const char* fmt, ...) {
+    char buf[32];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n < 0) return 0;
+    if ((size_t)n >= sizeof(buf)) n = sizeof(buf) - 1;
+    return port_.write((const uint8_t*)buf, (size_t)n);
+  }
+
+  SerialPort& port_;
+};
+
+#endif
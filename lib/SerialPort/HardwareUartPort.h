@@ -0,0 +1,47 @@
+#ifndef HARDWARE_UART_PORT_H
+#define HARDWARE_UART_PORT_H
+
+#if defined(ARDUINO) && defined(ESP32)
+#include <Arduino.h>
+#include "SerialPort.h"
+
+// SerialPort backend on an ESP32 hardware UART.
+//
+// The UART driver keeps its own RX/TX ring buffers, filled from the FIFO
+// interrupt, so bytes are not lost while the application is busy. The RX
+// timeout raises a receive event after the line has been idle for a few
+// symbols, i.e. once per burst (an NMEA sentence, a modem reply), which a
+// task can block on instead of polling.
+class HardwareUartPort : public SerialPort {
+public:
+  explicit HardwareUartPort(HardwareSerial& uart) : uart_(uart) {}
+
+  // Buffer sizes must be set before the driver is installed by begin()
+  void begin(unsigned long baud, int8_t rxPin, int8_t txPin,
+             size_t rxBuffer = 1024, size_t txBuffer = 1024, uint8_t rxTimeoutSymbols = 2) {
+    uart_.setRxBufferSize(rxBuffer);
+    uart_.setTxBufferSize(txBuffer);
+    uart_.begin(baud, SERIAL_8N1, rxPin, txPin);
+    uart_.setRxTimeout(rxTimeoutSymbols);
+  }
+
+  void setBaud(unsigned long baud) { uart_.updateBaudRate(baud); }
+
+  HardwareSerial& uart() { return uart_; }
+
+  int available() override { return uart_.available(); }
+  int read() override { return uart_.read(); }
+  size_t read(uint8_t* buf, size_t len) override {
+    size_t avail = (size_t)uart_.available();
+    if (len > avail) len = avail;
+    return len ? uart_.read(buf, len) : 0;
+  }
+  size_t write(const uint8_t* data, size_t len) override { return uart_.write(data, len); }
+  using SerialPort::write;
+
+private:
+  HardwareSerial& uart_;
+};
+#endif
+
+#endif
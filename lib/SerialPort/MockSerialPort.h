@@ -0,0 +1,55 @@
+#ifndef MOCK_SERIAL_PORT_H
+#define MOCK_SERIAL_PORT_H
+
+#include <string>
+#include "SerialPort.h"
+
+// In-memory SerialPort for host-side runs: bytes queued with feed() are
+// returned by read(), everything written is captured in sent().
+class MockSerialPort : public SerialPort {
+public:
+  MockSerialPort() : pos_(0), maxPerPoll_(0), servedThisPoll_(0) {}
+
+  void feed(const char* s) { rx_.append(s); }
+  void feed(const uint8_t* data, size_t len) { rx_.append((const char*)data, len); }
+
+  // Limits how many bytes available() reports until nextPoll() is
+  // called, to mimic data trickling in at line rate (0 = no limit)
+  void setMaxBytesPerPoll(size_t n) { maxPerPoll_ = n; }
+  void nextPoll() { servedThisPoll_ = 0; }
+
+  const std::string& sent() const { return tx_; }
+  void clearSent() { tx_.clear(); }
+  size_t pendingRx() const { return rx_.size() - pos_; }
+
+  int available() override {
+    size_t n = rx_.size() - pos_;
+    if (maxPerPoll_) {
+      size_t room = maxPerPoll_ - servedThisPoll_;
+      if (n > room) n = room;
+    }
+    return (int)n;
+  }
+
+  int read() override {
+    if (available() <= 0) return -1;
+    servedThisPoll_++;
+    return (uint8_t)rx_[pos_++];
+  }
+  using SerialPort::read;
+
+  size_t write(const uint8_t* data, size_t len) override {
+    tx_.append((const char*)data, len);
+    return len;
+  }
+  using SerialPort::write;
+
+private:
+  std::string rx_;
+  size_t pos_;
+  std::string tx_;
+  size_t maxPerPoll_;
+  size_t servedThisPoll_;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Minimal byte-stream interface shared by the modem and GPS drivers.
+// Keeps the protocol code free of Arduino types so it can run on a host.
+class SerialPort {
+public:
+  virtual ~SerialPort() {}
+
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual size_t write(const uint8_t* data, size_t len) = 0;
+
+  // Reads up to len bytes that are already available; never waits
+  virtual size_t read(uint8_t* buf, size_t len) {
+    size_t n = 0;
+    while (n < len && available() > 0) {
+      int c = read();
+      if (c < 0) break;
+      buf[n++] = (uint8_t)c;
+    }
+    return n;
+  }
+
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t println(const char* s) { return print(s) + print("\r\n"); }
+};
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+// Adapts any Arduino Stream (HardwareSerial, SoftwareSerial) to SerialPort.
+class StreamSerialPort : public SerialPort {
+public:
+  explicit StreamSerialPort(Stream& stream) : stream_(stream) {}
+
+  int available() override { return stream_.available(); }
+  int read() override { return stream_.read(); }
+  size_t write(const uint8_t* data, size_t len) override { return stream_.write(data, len); }
+  using SerialPort::read;
+  using SerialPort::write;
+
+private:
+  Stream& stream_;
+};
+#endif
+
+#endif
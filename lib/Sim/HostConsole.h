@@ -0,0 +1,32 @@
+#ifndef HOST_CONSOLE_H
+#define HOST_CONSOLE_H
+
+#include <stdio.h>
+#include <SerialPort.h>
+
+// Debug console of a native run: output goes to stdout, or nowhere when
+// quiet. There is no input.
+class HostConsole : public SerialPort {
+public:
+  explicit HostConsole(bool echo) : echo_(echo), bytes_(0) {}
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  using SerialPort::read;
+
+  size_t write(const uint8_t* data, size_t len) override {
+    bytes_ += len;
+    if (echo_) fwrite(data, 1, len, stdout);
+    return len;
+  }
+  using SerialPort::write;
+
+  void setEcho(bool echo) { echo_ = echo; }
+  unsigned long bytes() const { return bytes_; }
+
+private:
+  bool echo_;
+  unsigned long bytes_;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <Clock.h>
+
+// Virtual time for native runs. It stands still until the run loop moves
+// it on, and delay() just moves it forward, so an hour of operation takes
+// only as long as the work done in it.
+class SimClock : public Clock {
+public:
+  explicit SimClock(uint32_t start = 0) : now_(start) {}
+
+  uint32_t millis() override { return now_; }
+  void delay(uint32_t ms) override { now_ += ms; }
+
+  void advance(uint32_t ms) { now_ += ms; }
+  void set(uint32_t ms) { now_ = ms; }
+
+private:
+  uint32_t now_;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "SimFences.h"
+
+#include <math.h>
+#include <string.h>
+
+static int32_t toE7(double degrees) {
+  return (int32_t)lround(degrees * 1e7);
+}
+
+static void put(std::vector<uint8_t>& out, size_t at, const void* data, size_t len) {
+  memcpy(&out[at], data, len);
+}
+
+std::vector<uint8_t> buildFenceImage(const std::vector<SimFence>& fences, uint32_t version) {
+  size_t n = fences.size();
+  std::vector<FenceEntry> entries(n);
+  int64_t minLat = INT32_MAX, minLng = INT32_MAX, maxLat = INT32_MIN, maxLng = INT32_MIN;
+  for (size_t i = 0; i < n; i++) {
+    const SimFence& f = fences[i];
+    FenceEntry& e = entries[i];
+    memset(&e, 0, sizeof(e));
+    e.id = f.id;
+    e.type = f.type;
+    if (f.type == FENCE_CIRCLE) {
+      // 1% margin for the device's approximate distances
+      double dLat = f.radiusM * 1.01 / 111319.5;
+      double dLng = dLat / cos(f.lat * M_PI / 180.0);
+      e.minLat_e7 = toE7(f.lat - dLat);
+      e.maxLat_e7 = toE7(f.lat + dLat);
+      e.minLng_e7 = toE7(f.lng - dLng);
+      e.maxLng_e7 = toE7(f.lng + dLng);
+    } else {
+      e.vertices = (uint16_t)(f.vertices.size() / 2);
+      e.minLat_e7 = e.minLng_e7 = INT32_MAX;
+      e.maxLat_e7 = e.maxLng_e7 = INT32_MIN;
+      for (size_t v = 0; v + 1 < f.vertices.size(); v += 2) {
+        int32_t lat = toE7(f.vertices[v]), lng = toE7(f.vertices[v + 1]);
+        if (lat < e.minLat_e7) e.minLat_e7 = lat;
+        if (lat > e.maxLat_e7) e.maxLat_e7 = lat;
+        if (lng < e.minLng_e7) e.minLng_e7 = lng;
+        if (lng > e.maxLng_e7) e.maxLng_e7 = lng;
+      }
+    }
+    if (e.minLat_e7 < minLat) minLat = e.minLat_e7;
+    if (e.minLng_e7 < minLng) minLng = e.minLng_e7;
+    if (e.maxLat_e7 > maxLat) maxLat = e.maxLat_e7;
+    if (e.maxLng_e7 > maxLng) maxLng = e.maxLng_e7;
+  }
+  if (n == 0) minLat = minLng = maxLat = maxLng = 0;
+
+  // About two cells per fence, square on the ground
+  int64_t spanLat = maxLat - minLat + 1, spanLng = maxLng - minLng + 1;
+  double cells = n * 2.0 < 1 ? 1 : n * 2.0 > 16384 ? 16384 : n * 2.0;
+  double midLat = (minLat + maxLat) / 2e7;
+  double heightM = spanLat * 0.0111319, widthM = spanLng * 0.0111319 * cos(midLat * M_PI / 180.0);
+  double cellM = sqrt(heightM * widthM / cells);
+  int64_t rows = cellM > 0 ? (int64_t)ceil(heightM / cellM) : 1;
+  int64_t cols = cellM > 0 ? (int64_t)ceil(widthM / cellM) : 1;
+  rows = rows < 1 ? 1 : rows > 1024 ? 1024 : rows;
+  cols = cols < 1 ? 1 : cols > 1024 ? 1024 : cols;
+  int64_t cellLat = (spanLat + rows - 1) / rows, cellLng = (spanLng + cols - 1) / cols;
+
+  std::vector<std::vector<uint16_t> > lists((size_t)(rows * cols));
+  for (size_t i = 0; i < n; i++) {
+    const FenceEntry& e = entries[i];
+    int64_t r0 = (e.minLat_e7 - minLat) / cellLat, r1 = (e.maxLat_e7 - minLat) / cellLat;
+    int64_t c0 = (e.minLng_e7 - minLng) / cellLng, c1 = (e.maxLng_e7 - minLng) / cellLng;
+    if (r1 >= rows) r1 = rows - 1;
+    if (c1 >= cols) c1 = cols - 1;
+    for (int64_t r = r0; r <= r1; r++) {
+      for (int64_t c = c0; c <= c1; c++) lists[(size_t)(r * cols + c)].push_back((uint16_t)i);
+    }
+  }
+
+  FenceImageHeader h;
+  memset(&h, 0, sizeof(h));
+  h.magic = FENCE_IMAGE_MAGIC;
+  h.version = version;
+  h.fenceCount = (uint16_t)n;
+  h.rows = (uint16_t)rows;
+  h.cols = (uint16_t)cols;
+  h.lat0_e7 = (int32_t)minLat;
+  h.lng0_e7 = (int32_t)minLng;
+  h.cellLat_e7 = (uint32_t)cellLat;
+  h.cellLng_e7 = (uint32_t)cellLng;
+
+  size_t ids = 0;
+  for (size_t c = 0; c < lists.size(); c++) ids += lists[c].size();
+  h.idsOffset = (uint32_t)(sizeof(h) + (lists.size() + 1) * 4);
+  h.fencesOffset = (uint32_t)((h.idsOffset + ids * 2 + 3) & ~(size_t)3);
+  size_t dataAt = h.fencesOffset + n * sizeof(FenceEntry);
+  size_t length = dataAt;
+  for (size_t i = 0; i < n; i++) {
+    length += fences[i].type == FENCE_CIRCLE ? 12 : entries[i].vertices * 8;
+  }
+  h.length = (uint32_t)length;
+
+  std::vector<uint8_t> out(length, 0);
+  uint32_t start = 0;
+  size_t idAt = h.idsOffset;
+  for (size_t c = 0; c < lists.size(); c++) {
+    put(out, sizeof(h) + c * 4, &start, 4);
+    for (size_t k = 0; k < lists[c].size(); k++, idAt += 2) put(out, idAt, &lists[c][k], 2);
+    start += (uint32_t)lists[c].size();
+  }
+  put(out, sizeof(h) + lists.size() * 4, &start, 4);
+
+  for (size_t i = 0; i < n; i++) {
+    const SimFence& f = fences[i];
+    entries[i].dataOffset = (uint32_t)dataAt;
+    if (f.type == FENCE_CIRCLE) {
+      int32_t circle[3] = { toE7(f.lat), toE7(f.lng), (int32_t)lround(f.radiusM * 100) };
+      put(out, dataAt, circle, sizeof(circle));
+      dataAt += sizeof(circle);
+    } else {
+      for (size_t v = 0; v + 1 < f.vertices.size(); v += 2, dataAt += 8) {
+        int32_t pair[2] = { toE7(f.vertices[v]), toE7(f.vertices[v + 1]) };
+        put(out, dataAt, pair, sizeof(pair));
+      }
+    }
+    put(out, h.fencesOffset + i * sizeof(FenceEntry), &entries[i], sizeof(FenceEntry));
+  }
+
+  h.crc = fenceCrc32(&out[sizeof(h)], length - sizeof(h));
+  put(out, 0, &h, sizeof(h));
+  return out;
+}
@@ -0,0 +1,21 @@
+#ifndef SIM_FENCES_H
+#define SIM_FENCES_H
+
+#include <stdint.h>
+#include <vector>
+#include <FenceImage.h>
+
+// A fence as the server defines it
+struct SimFence {
+  uint32_t id;
+  uint8_t type;                     // FENCE_CIRCLE / FENCE_POLYGON
+  double lat, lng, radiusM;         // circle
+  std::vector<double> vertices;     // polygon: lat, lng, lat, lng, ...
+};
+
+// Compiles fences into a FenceImage, as tools/ingest_server.py does:
+// a grid of about two cells per fence, square in metres, over the
+// bounding box of them all
+std::vector<uint8_t> buildFenceImage(const std::vector<SimFence>& fences, uint32_t version);
+
+#endif
@@ -0,0 +1,290 @@
+#include "SimIngest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <TelemetryBinary.h>
+#include <TelemetryJson.h>
+
+// RFC 1951 length and distance code bases and extra bits
+static const uint16_t lengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+namespace {
+
+class BitReader {
+public:
+  BitReader(const uint8_t* p, size_t len) : p_(p), len_(len), pos_(0), bit_(0), error_(false) {}
+
+  // 'count' bits, least significant first
+  uint32_t bits(uint8_t count) {
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < count; i++) v |= (uint32_t)bit() << i;
+    return v;
+  }
+
+  // A Huffman code, most significant bit first
+  uint32_t code(uint8_t count) {
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < count; i++) v = (v << 1) | bit();
+    return v;
+  }
+
+  void alignToByte() {
+    if (bit_) {
+      bit_ = 0;
+      pos_++;
+    }
+  }
+
+  size_t bytePos() const { return pos_; }
+  void skipBytes(size_t n) { pos_ += n; }
+  bool error() const { return error_ || pos_ > len_; }
+
+private:
+  uint32_t bit() {
+    if (pos_ >= len_) {
+      error_ = true;
+      return 0;
+    }
+    uint32_t b = (p_[pos_] >> bit_) & 1;
+    if (++bit_ == 8) {
+      bit_ = 0;
+      pos_++;
+    }
+    return b;
+  }
+
+  const uint8_t* p_;
+  size_t len_;
+  size_t pos_;
+  uint8_t bit_;
+  bool error_;
+};
+
+// Fixed literal/length code (RFC 1951 3.2.6)
+int fixedSymbol(BitReader& in) {
+  uint32_t c = in.code(7);
+  if (c <= 0x17) return 256 + c;
+  c = (c << 1) | in.code(1);
+  if (c >= 0x30 && c <= 0xBF) return c - 0x30;
+  if (c >= 0xC0 && c <= 0xC7) return 280 + (c - 0xC0);
+  c = (c << 1) | in.code(1);
+  return 144 + (c - 0x190);
+}
+
+uint32_t adler32(const std::string& s, size_t from) {
+  uint32_t a = 1, b = 0;
+  for (size_t i = from; i < s.size(); i++) {
+    a = (a + (uint8_t)s[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+}  // namespace
+
+bool simInflate(const uint8_t* in, size_t len, const char* dict, size_t dictLen, std::string& out) {
+  if (len < 6 || (in[0] & 0x0F) != 8 || ((in[0] << 8) | in[1]) % 31 != 0) return false;
+  size_t start = 2;
+  std::string window;  // dictionary, then the output
+  if (in[1] & 0x20) {
+    if (!dict || len < 10) return false;
+    window.assign(dict, dictLen);
+    start = 6;
+  }
+  size_t dictSize = window.size();
+
+  BitReader bits(in + start, len - start);
+  bool last = false;
+  while (!last) {
+    last = bits.bits(1);
+    uint32_t type = bits.bits(2);
+    if (type == 0) {
+      bits.alignToByte();
+      size_t p = start + bits.bytePos();
+      if (p + 4 > len) return false;
+      uint16_t n = in[p] | (in[p + 1] << 8);
+      uint16_t nn = in[p + 2] | (in[p + 3] << 8);
+      if ((uint16_t)~n != nn || p + 4 + n > len) return false;
+      window.append((const char*)in + p + 4, n);
+      bits.skipBytes(4 + n);
+    } else if (type == 1) {
+      for (;;) {
+        int sym = fixedSymbol(bits);
+        if (bits.error() || sym > 285) return false;
+        if (sym < 256) {
+          window.push_back((char)sym);
+          continue;
+        }
+        if (sym == 256) break;
+        int li = sym - 257;
+        size_t length = lengthBase[li] + bits.bits(lengthExtra[li]);
+        uint32_t di = bits.code(5);
+        if (di >= 30) return false;
+        size_t dist = distBase[di] + bits.bits(distExtra[di]);
+        if (bits.error() || dist > window.size()) return false;
+        for (size_t i = 0; i < length; i++) window.push_back(window[window.size() - dist]);
+      }
+    } else {
+      return false;
+    }
+    if (bits.error()) return false;
+  }
+
+  bits.alignToByte();
+  size_t p = start + bits.bytePos();
+  if (p + 4 > len) return false;
+  uint32_t expected = ((uint32_t)in[p] << 24) | (in[p + 1] << 16) | (in[p + 2] << 8) | in[p + 3];
+  if (adler32(window, dictSize) != expected) return false;
+  out.assign(window, dictSize, std::string::npos);
+  return true;
+}
+
+SimIngest::SimIngest()
+  : failCount_(0), failStatus_(500), requests_(0), rejected_(0), readings_(0), duplicates_(0),
+    unnumbered_(0), bodyBytes_(0), plainBytes_(0), fenceVersion_(0), fenceRequests_(0),
+    fenceReadings_(0) {}
+
+size_t SimIngest::respond(uint16_t status, const char* body, char* out, size_t size) {
+  const char* reason = status == 200 ? "OK" : status == 400 ? "Bad Request" :
+                       status == 404 ? "Not Found" : "Error";
+  int n = snprintf(out, size,
+                   "HTTP/1.1 %u %s\r\nContent-Type: application/json\r\n"
+                   "Content-Length: %u\r\n\r\n%s",
+                   (unsigned)status, reason, (unsigned)strlen(body), body);
+  return n > 0 && (size_t)n < size ? (size_t)n : 0;
+}
+
+size_t SimIngest::respondFences(char* out, size_t size) {
+  if (fences_.empty()) return respond(404, "{\"error\":\"no fences\"}", out, size);
+  int n = snprintf(out, size,
+                   "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                   "Content-Length: %u\r\n\r\n", (unsigned)fences_.size());
+  if (n <= 0 || (size_t)n + fences_.size() > size) return 0;
+  memcpy(out + n, &fences_[0], fences_.size());
+  return (size_t)n + fences_.size();
+}
+
+// Header value of 'name' in the request head, or ""
+static std::string header(const std::string& head, const char* name) {
+  size_t nameLen = strlen(name);
+  for (size_t p = head.find("\r\n"); p != std::string::npos && p + 2 < head.size();
+       p = head.find("\r\n", p + 2)) {
+    const char* line = head.c_str() + p + 2;
+    if (strncasecmp(line, name, nameLen) != 0 || line[nameLen] != ':') continue;
+    size_t from = p + 2 + nameLen + 1;
+    while (from < head.size() && head[from] == ' ') from++;
+    size_t to = head.find("\r\n", from);
+    return head.substr(from, to == std::string::npos ? std::string::npos : to - from);
+  }
+  return "";
+}
+
+bool SimIngest::store(const std::string& contentType, const std::string& body, uint32_t& ack) {
+  ack = 0;
+  std::set<uint32_t> seen;
+  uint32_t unnumbered = 0;
+
+  if (contentType.compare(0, strlen(TBIN_CONTENT_TYPE), TBIN_CONTENT_TYPE) == 0) {
+    TelemetryDecoder decoder;
+    if (!decoder.begin((const uint8_t*)body.data(), body.size())) return false;
+    DecodedRecord r;
+    while (decoder.next(r)) {
+      if (r.flags & TBIN_FLAG_SEQ) seen.insert(r.seq);
+      else unnumbered++;
+      if (r.flags & TBIN_FLAG_FENCE) fenceReadings_++;
+    }
+    if (decoder.error() || decoder.remaining() > 0) return false;
+    DecodedStat stat;
+    while (decoder.nextStat(stat)) {}
+    if (decoder.error()) return false;
+  } else {
+    // Good enough for the tracker's own output: one "ts" per reading,
+    // "seq" on the numbered ones
+    if (body.empty() || body[0] != '{' || body[body.size() - 1] != '}' ||
+        body.find("\"readings\":[") == std::string::npos) {
+      return false;
+    }
+    for (size_t p = body.find("\"ts\":"); p != std::string::npos; p = body.find("\"ts\":", p + 1)) {
+      unnumbered++;
+    }
+    for (size_t p = body.find("\"seq\":"); p != std::string::npos; p = body.find("\"seq\":", p + 1)) {
+      seen.insert((uint32_t)strtoul(body.c_str() + p + 6, 0, 10));
+      unnumbered--;
+    }
+    for (size_t p = body.find("(fence)"); p != std::string::npos; p = body.find("(fence)", p + 1)) {
+      fenceReadings_++;
+    }
+  }
+
+  for (std::set<uint32_t>::const_iterator it = seen.begin(); it != seen.end(); ++it) {
+    if (seqs_.insert(*it).second) readings_++;
+    else duplicates_++;
+    ack = *it;
+  }
+  readings_ += unnumbered;
+  unnumbered_ += unnumbered;
+  return true;
+}
+
+size_t SimIngest::handle(const uint8_t* request, size_t len, char* response, size_t size, void* ctx) {
+  SimIngest* s = (SimIngest*)ctx;
+  s->requests_++;
+
+  std::string text((const char*)request, len);
+  size_t headerEnd = text.find("\r\n\r\n");
+  std::string head = text.substr(0, headerEnd);
+  std::string body = text.substr(headerEnd + 4);
+  s->bodyBytes_ += body.size();
+
+  if (s->failCount_ > 0) {
+    s->failCount_--;
+    return s->respond(s->failStatus_, "{\"error\":\"injected\"}", response, size);
+  }
+
+  if (head.compare(0, 12, "GET /fences ") == 0) {
+    s->fenceRequests_++;
+    return s->respondFences(response, size);
+  }
+
+  if (header(head, "Content-Encoding") == "deflate") {
+    std::string plain;
+    if (!simInflate((const uint8_t*)body.data(), body.size(), telemetryJsonDictionary,
+                    telemetryJsonDictionaryLength, plain)) {
+      s->rejected_++;
+      return s->respond(400, "{\"error\":\"deflate\"}", response, size);
+    }
+    body.swap(plain);
+  }
+  s->plainBytes_ += body.size();
+
+  uint32_t ack;
+  if (!s->store(header(head, "Content-Type"), body, ack)) {
+    s->rejected_++;
+    return s->respond(400, "{\"error\":\"decode\"}", response, size);
+  }
+  char doc[48];
+  if (s->fenceVersion_) {
+    snprintf(doc, sizeof(doc), "{\"ack\":%lu,\"fences\":%lu}", (unsigned long)ack,
+             (unsigned long)s->fenceVersion_);
+  } else {
+    snprintf(doc, sizeof(doc), "{\"ack\":%lu}", (unsigned long)ack);
+  }
+  return s->respond(200, doc, response, size);
+}
@@ -0,0 +1,72 @@
+#ifndef SIM_INGEST_H
+#define SIM_INGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <vector>
+
+// In-process counterpart of tools/ingest_server.py, as the server behind
+// a SimSim800 (pass SimIngest::handle with the instance as context).
+//
+// Accepts JSON and binary bodies, plain or "Content-Encoding: deflate"
+// (stored and fixed-Huffman blocks, as DeflateSink writes them, with the
+// JSON preset dictionary). Readings are stored once per seq and each
+// request is answered with 200 and {"ack":N}, N the highest seq in it;
+// bodies that do not decode get 400. With a fence image set, acks also
+// carry "fences":V and GET /fences returns the image.
+class SimIngest {
+public:
+  SimIngest();
+
+  static size_t handle(const uint8_t* request, size_t len, char* response, size_t size, void* ctx);
+
+  // Answers the next 'count' requests with this HTTP status instead
+  void failNext(uint32_t count, uint16_t status = 500) { failCount_ = count; failStatus_ = status; }
+
+  // Serves this geofence image (see buildFenceImage) as version 'version'
+  void setFences(const std::vector<uint8_t>& image, uint32_t version) {
+    fences_ = image;
+    fenceVersion_ = version;
+  }
+
+  uint32_t requests() const { return requests_; }
+  uint32_t rejected() const { return rejected_; }
+  uint32_t readings() const { return readings_; }      // stored, duplicates excluded
+  uint32_t duplicates() const { return duplicates_; }
+  uint32_t unnumbered() const { return unnumbered_; }  // readings without seq
+  uint32_t highestSeq() const { return seqs_.empty() ? 0 : *seqs_.rbegin(); }
+  bool has(uint32_t seq) const { return seqs_.count(seq) != 0; }
+  uint64_t bodyBytes() const { return bodyBytes_; }    // as received
+  uint64_t plainBytes() const { return plainBytes_; }  // after inflating
+  uint32_t fenceRequests() const { return fenceRequests_; }
+  uint32_t fenceReadings() const { return fenceReadings_; }  // flagged as fence crossings
+
+private:
+  size_t respond(uint16_t status, const char* body, char* out, size_t size);
+  size_t respondFences(char* out, size_t size);
+  bool store(const std::string& contentType, const std::string& body, uint32_t& ack);
+
+  std::set<uint32_t> seqs_;
+  uint32_t failCount_;
+  uint16_t failStatus_;
+  uint32_t requests_;
+  uint32_t rejected_;
+  uint32_t readings_;
+  uint32_t duplicates_;
+  uint32_t unnumbered_;
+  uint64_t bodyBytes_;
+  uint64_t plainBytes_;
+  std::vector<uint8_t> fences_;
+  uint32_t fenceVersion_;
+  uint32_t fenceRequests_;
+  uint32_t fenceReadings_;
+};
+
+// Inflates a zlib stream made of stored and fixed-Huffman blocks; false on
+// anything else or a bad checksum. 'dict' primes the window if the stream
+// asks for a preset dictionary.
+bool simInflate(const uint8_t* in, size_t len, const char* dict, size_t dictLen, std::string& out);
+
+#endif
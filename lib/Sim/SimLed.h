@@ -0,0 +1,33 @@
+#ifndef SIM_LED_H
+#define SIM_LED_H
+
+#include <Clock.h>
+#include <StatusLed.h>
+
+// Status LED of a native run: counts pattern changes and how long it was lit
+class SimLed : public StatusLed {
+public:
+  explicit SimLed(Clock& clock) : clock_(clock), lit_(false), litSince_(0), litMs_(0), changes_(0) {}
+
+  void set(uint8_t r, uint8_t g, uint8_t b) override {
+    bool lit = r || g || b;
+    uint32_t now = clock_.millis();
+    if (lit_) litMs_ += now - litSince_;
+    litSince_ = now;
+    lit_ = lit;
+    changes_++;
+  }
+
+  bool lit() const { return lit_; }
+  uint32_t changes() const { return changes_; }
+  uint64_t litMs() { return litMs_ + (lit_ ? clock_.millis() - litSince_ : 0); }
+
+private:
+  Clock& clock_;
+  bool lit_;
+  uint32_t litSince_;
+  uint64_t litMs_;
+  uint32_t changes_;
+};
+
+#endif
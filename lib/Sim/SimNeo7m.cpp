@@ -0,0 +1,254 @@
+#include "SimNeo7m.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <Ubx.h>
+
+// The first measurement after power-on, and how long after each
+// measurement its solution goes out
+#define NEO7M_FIRST_EPOCH_MS 180
+#define NEO7M_OUTPUT_DELAY_MS 25
+
+static void put2(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put4(uint8_t* p, uint32_t v) {
+  put2(p, v);
+  put2(p + 2, v >> 16);
+}
+
+static uint32_t get4(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Gregorian date of a day count since 1970-01-01
+static void civilFromDays(int32_t z, uint16_t& year, uint8_t& month, uint8_t& day) {
+  z += 719468;
+  int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  uint32_t doe = (uint32_t)(z - era * 146097);
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  day = (uint8_t)(doy - (153 * mp + 2) / 5 + 1);
+  month = (uint8_t)(mp < 10 ? mp + 3 : mp - 9);
+  year = (uint16_t)(yoe + era * 400 + (month <= 2 ? 1 : 0));
+}
+
+SimNeo7m::SimNeo7m(Clock& clock, SimTrackFn track, void* ctx, uint32_t baud)
+  : clock_(clock), uart_(clock, baud), track_(track), ctx_(ctx), measRateMs_(1000),
+    navPvtRate_(0), nmeaOut_(true), nextEpoch_(clock.millis() + NEO7M_FIRST_EPOCH_MS), epochs_(0),
+    messagesSent_(0), configMessages_(0) {
+  uart_.setWriteHandler(onWrite, this);
+}
+
+void SimNeo7m::onWrite(const uint8_t* data, size_t len, void* ctx) {
+  SimNeo7m* g = (SimNeo7m*)ctx;
+  for (size_t i = 0; i < len; i++) {
+    if (g->parser_.encode(data[i])) g->handleConfig();
+  }
+}
+
+void SimNeo7m::handleConfig() {
+  if (parser_.msgClass() != UBX_CLASS_CFG) return;
+  const uint8_t* p = parser_.payload();
+  uint16_t len = parser_.length();
+  configMessages_++;
+
+  if (parser_.msgId() == UBX_CFG_RATE && len >= 2) {
+    uint16_t rate = p[0] | (p[1] << 8);
+    if (rate >= 100) {
+      // Takes effect from the next measurement on; the first one is at a
+      // fixed time after power-on
+      if (epochs_ > 0) nextEpoch_ = nextEpoch_ - measRateMs_ + rate;
+      measRateMs_ = rate;
+    }
+  } else if (parser_.msgId() == UBX_CFG_MSG && len >= 3) {
+    if (p[0] == UBX_CLASS_NAV && p[1] == UBX_NAV_PVT) navPvtRate_ = p[2];
+  } else if (parser_.msgId() == UBX_CFG_PRT && len >= 12) {
+    uart_.setBaud(get4(p + 8));
+    if (len >= 16) nmeaOut_ = (p[14] & 0x02) != 0;  // outProtoMask
+  }
+}
+
+void SimNeo7m::poll() {
+  uint32_t now = clock_.millis();
+  while ((int32_t)(now - nextEpoch_) >= 0) {
+    uint32_t at = nextEpoch_;
+    nextEpoch_ += measRateMs_;
+    epochs_++;
+    bool pvt = navPvtRate_ != 0 && epochs_ % navPvtRate_ == 0;
+    if (!pvt && !nmeaOut_) continue;
+
+    SimFix fix;
+    memset(&fix, 0, sizeof(fix));
+    if (track_) track_(at, fix, ctx_);
+    if (nmeaOut_) sendNmea(at + NEO7M_OUTPUT_DELAY_MS, at, fix);
+    if (pvt) sendNavPvt(at + NEO7M_OUTPUT_DELAY_MS, at, fix);
+  }
+}
+
+uint32_t SimNeo7m::nextEvent() {
+  uint32_t at;
+  if (uart_.nextArrival(at) && (int32_t)(at - nextEpoch_) < 0) return at;
+  return nextEpoch_;
+}
+
+void SimNeo7m::sendNavPvt(uint32_t at, uint32_t ms, const SimFix& fix) {
+  uint8_t p[UBX_NAV_PVT_LEN];
+  memset(p, 0, sizeof(p));
+
+  put4(p + 0, (fix.utc % 604800) * 1000 + ms % 1000);  // iTOW, near enough
+  if (fix.utc) {
+    uint16_t year;
+    uint8_t month, day;
+    civilFromDays((int32_t)(fix.utc / 86400), year, month, day);
+    uint32_t secs = fix.utc % 86400;
+    put2(p + 4, year);
+    p[6] = month;
+    p[7] = day;
+    p[8] = (uint8_t)(secs / 3600);
+    p[9] = (uint8_t)(secs / 60 % 60);
+    p[10] = (uint8_t)(secs % 60);
+    p[11] = 0x03;  // validDate, validTime
+    put4(p + 16, ms % 1000 * 1000000);  // nano
+  }
+
+  if (fix.valid) {
+    double course = fix.courseDeg * M_PI / 180.0;
+    double speed = fix.speedKmh / 3.6 * 1000.0;  // mm/s
+    p[20] = 3;     // 3D fix
+    p[21] = 0x01;  // gnssFixOK
+    p[23] = fix.satellites;
+    put4(p + 24, (uint32_t)(int32_t)lround(fix.lng * 1e7));
+    put4(p + 28, (uint32_t)(int32_t)lround(fix.lat * 1e7));
+    put4(p + 32, (uint32_t)(int32_t)lround((fix.altitudeM + 90.0f) * 1000.0f));  // above ellipsoid
+    put4(p + 36, (uint32_t)(int32_t)lround(fix.altitudeM * 1000.0f));
+    put4(p + 40, 2500);  // hAcc
+    put4(p + 44, 4000);  // vAcc
+    put4(p + 48, (uint32_t)(int32_t)lround(speed * cos(course)));  // velN
+    put4(p + 52, (uint32_t)(int32_t)lround(speed * sin(course)));  // velE
+    put4(p + 60, (uint32_t)(int32_t)lround(speed));
+    put4(p + 64, (uint32_t)(int32_t)lround(fix.courseDeg * 1e5));
+    put2(p + 76, 150);   // pDOP 1.5
+  } else {
+    p[23] = fix.satellites;
+    put4(p + 40, 0xFFFFFFFF);
+    put2(p + 76, 9999);
+  }
+
+  // Frames it the same way the tracker frames its commands
+  struct Capture : public SerialPort {
+    uint8_t buf[UBX_NAV_PVT_LEN + UBX_FRAME_OVERHEAD];
+    size_t len;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(const uint8_t* data, size_t n) override {
+      memcpy(buf + len, data, n);
+      len += n;
+      return n;
+    }
+    using SerialPort::read;
+    using SerialPort::write;
+  } frame;
+  frame.len = 0;
+  ubxSend(frame, UBX_CLASS_NAV, UBX_NAV_PVT, p, sizeof(p));
+  uart_.schedule(at, frame.buf, frame.len);
+  messagesSent_++;
+}
+
+// Appends "$<body>*CS\r\n"
+static void addSentence(char* out, size_t size, size_t& len, const char* body) {
+  uint8_t cs = 0;
+  for (const char* p = body; *p; p++) cs ^= (uint8_t)*p;
+  int n = snprintf(out + len, size - len, "$%s*%02X\r\n", body, cs);
+  if (n > 0 && len + n < size) len += n;
+}
+
+// Degrees as "ddmm.mmmmm" (or "dddmm.mmmmm") and a hemisphere letter
+static void formatCoordinate(char* out, size_t size, double deg, int degDigits, char pos, char neg) {
+  long long m = llround(fabs(deg) * 60 * 100000);
+  snprintf(out, size, "%0*lld%02lld.%05lld,%c", degDigits, m / 6000000, m / 100000 % 60, m % 100000,
+           deg < 0 ? neg : pos);
+}
+
+void SimNeo7m::sendNmea(uint32_t at, uint32_t ms, const SimFix& fix) {
+  char time[16] = "";
+  char date[12] = "";
+  if (fix.utc) {
+    uint16_t year;
+    uint8_t month, day;
+    civilFromDays((int32_t)(fix.utc / 86400), year, month, day);
+    uint32_t secs = fix.utc % 86400;
+    snprintf(time, sizeof(time), "%02u%02u%02u.%02u", (unsigned)(secs / 3600),
+             (unsigned)(secs / 60 % 60), (unsigned)(secs % 60), (unsigned)(ms % 1000 / 10));
+    snprintf(date, sizeof(date), "%02u%02u%02u", day, month, (unsigned)(year % 100));
+  }
+  char lat[40] = ",";
+  char lng[40] = ",";
+  double knots = fix.speedKmh / 1.852;
+  uint8_t used = fix.valid ? fix.satellites : 0;
+  if (used > 12) used = 12;
+  if (fix.valid) {
+    formatCoordinate(lat, sizeof(lat), fix.lat, 2, 'N', 'S');
+    formatCoordinate(lng, sizeof(lng), fix.lng, 3, 'E', 'W');
+  }
+
+  char out[1024];
+  size_t len = 0;
+  char body[256];
+  if (fix.valid) {
+    snprintf(body, sizeof(body), "GPRMC,%s,A,%s,%s,%.3f,%.2f,%s,,,A", time, lat, lng, knots,
+             fix.courseDeg, date);
+  } else {
+    snprintf(body, sizeof(body), "GPRMC,%s,V,,,,,,,%s,,,N", time, date);
+  }
+  addSentence(out, sizeof(out), len, body);
+
+  if (fix.valid) {
+    snprintf(body, sizeof(body), "GPVTG,%.2f,T,,M,%.3f,N,%.3f,K,A", fix.courseDeg, knots,
+             fix.speedKmh);
+  } else {
+    snprintf(body, sizeof(body), "GPVTG,,,,,,,,,N");
+  }
+  addSentence(out, sizeof(out), len, body);
+
+  if (fix.valid) {
+    snprintf(body, sizeof(body), "GPGGA,%s,%s,%s,1,%02u,0.90,%.1f,M,90.0,M,,", time, lat, lng,
+             (unsigned)fix.satellites, fix.altitudeM);
+  } else {
+    snprintf(body, sizeof(body), "GPGGA,%s,,,,,0,00,99.99,,,,,,", time);
+  }
+  addSentence(out, sizeof(out), len, body);
+
+  // Satellites: the ones used, and a few more in view
+  uint8_t inView = (uint8_t)(fix.satellites + 3);
+  if (inView > 16) inView = 16;
+  size_t n = (size_t)snprintf(body, sizeof(body), "GPGSA,A,%c", fix.valid ? '3' : '1');
+  for (uint8_t i = 0; i < 12; i++) {
+    if (i < used) n += snprintf(body + n, sizeof(body) - n, ",%02u", 1 + i * 7 % 32);
+    else n += snprintf(body + n, sizeof(body) - n, ",");
+  }
+  snprintf(body + n, sizeof(body) - n, fix.valid ? ",1.50,0.90,1.20" : ",99.99,99.99,99.99");
+  addSentence(out, sizeof(out), len, body);
+
+  uint8_t messages = (uint8_t)((inView + 3) / 4);
+  for (uint8_t m = 0; m < messages; m++) {
+    n = (size_t)snprintf(body, sizeof(body), "GPGSV,%u,%u,%02u", messages, m + 1, inView);
+    for (uint8_t i = m * 4; i < inView && i < m * 4 + 4; i++) {
+      n += snprintf(body + n, sizeof(body) - n, ",%02u,%02u,%03u,", 1 + i * 7 % 32,
+                    10 + i * 23 % 75, (unsigned)((i * 67 + ms / 60000) % 360));
+      if (i < used) n += snprintf(body + n, sizeof(body) - n, "%02u", 20 + i * 13 % 30);
+    }
+    addSentence(out, sizeof(out), len, body);
+  }
+
+  if (fix.valid) snprintf(body, sizeof(body), "GPGLL,%s,%s,%s,A,A", lat, lng, time);
+  else snprintf(body, sizeof(body), "GPGLL,,,,,%s,V,N", time);
+  addSentence(out, sizeof(out), len, body);
+
+  uart_.schedule(at, (const uint8_t*)out, len);
+  messagesSent_++;
+}
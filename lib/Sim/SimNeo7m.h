@@ -0,0 +1,69 @@
+#ifndef SIM_NEO7M_H
+#define SIM_NEO7M_H
+
+#include <stdint.h>
+#include <UbxParser.h>
+#include "SimUart.h"
+
+// Where the simulated receiver is at a given moment
+struct SimFix {
+  bool valid;           // false: no fix (cold start, tunnel, ...)
+  double lat;           // degrees
+  double lng;
+  float speedKmh;
+  float courseDeg;
+  float altitudeM;
+  uint8_t satellites;
+  uint32_t utc;         // seconds since 1970, 0 if the receiver has no time yet
+};
+
+// Fills in the receiver's state at virtual time 'ms'
+typedef void (*SimTrackFn)(uint32_t ms, SimFix& out, void* ctx);
+
+// Simulated u-blox NEO-7M on a SimUart.
+//
+// Takes a measurement every measurement period (1 s until a CFG-RATE
+// changes it), asks the track function for the state at that moment and
+// sends the solution a few milliseconds later: the receiver's default
+// NMEA set (RMC, VTG, GGA, GSA, GSV, GLL) unless CFG-PRT turned NMEA
+// output off, and a NAV-PVT message if that is on (CFG-MSG). CFG-PRT also
+// changes the baud rate; $PUBX configuration is not modelled.
+class SimNeo7m {
+public:
+  SimNeo7m(Clock& clock, SimTrackFn track, void* ctx, uint32_t baud = 38400);
+
+  SerialPort& port() { return uart_; }
+  SimUart& uart() { return uart_; }
+
+  // Produces the measurements that are due; call before the tracker reads
+  void poll();
+
+  // The next measurement or byte arrival
+  uint32_t nextEvent();
+
+  uint16_t measRateMs() const { return measRateMs_; }
+  uint32_t epochs() const { return epochs_; }
+  uint32_t messagesSent() const { return messagesSent_; }
+  uint32_t configMessages() const { return configMessages_; }
+
+private:
+  static void onWrite(const uint8_t* data, size_t len, void* ctx);
+  void handleConfig();
+  void sendNavPvt(uint32_t at, uint32_t ms, const SimFix& fix);
+  void sendNmea(uint32_t at, uint32_t ms, const SimFix& fix);
+
+  Clock& clock_;
+  SimUart uart_;
+  SimTrackFn track_;
+  void* ctx_;
+  UbxParser parser_;  // for the configuration the tracker sends
+  uint16_t measRateMs_;
+  uint8_t navPvtRate_;
+  bool nmeaOut_;
+  uint32_t nextEpoch_;
+  uint32_t epochs_;
+  uint32_t messagesSent_;
+  uint32_t configMessages_;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#include "SimRoute.h"
+
+#include <math.h>
+
+#define MINUTE 60000u
+
+static bool inRange(uint32_t ms, uint32_t fromMinute, uint32_t toMinute) {
+  return ms >= fromMinute * MINUTE && ms < toMinute * MINUTE;
+}
+
+SimRoute::SimRoute(double lat, double lng, uint32_t startUtc)
+  : lat_(lat), lng_(lng), heading_(0), speed_(0), lastMs_(0), startUtc_(startUtc) {}
+
+void SimRoute::track(uint32_t ms, SimFix& out, void* ctx) {
+  SimRoute& r = *(SimRoute*)ctx;
+  float dt = (ms - r.lastMs_) / 1000.0f;
+  r.lastMs_ = ms;
+
+  uint32_t leg = ms / 90000;
+  float target = inRange(ms, 20, 25) ? 0.0f : 30.0f + (leg * 37 % 5) * 8.0f;
+  r.speed_ += (target - r.speed_) * (dt < 5 ? dt / 5 : 1);
+  r.heading_ = fmodf((float)(leg * 83 % 360) + 10.0f * sinf(ms / 20000.0f) + 360.0f, 360.0f);
+
+  double metres = r.speed_ / 3.6 * dt;
+  double course = r.heading_ * M_PI / 180.0;
+  r.lat_ += metres * cos(course) / 111320.0;
+  r.lng_ += metres * sin(course) / (111320.0 * cos(r.lat_ * M_PI / 180.0));
+
+  out.valid = ms >= 32000 && !inRange(ms, 40, 42);
+  out.lat = r.lat_;
+  out.lng = r.lng_;
+  out.speedKmh = r.speed_;
+  out.courseDeg = r.heading_;
+  out.altitudeM = 12.0f + 4.0f * sinf(ms / 300000.0f);
+  out.satellites = out.valid ? 7 + (ms / 45000) % 4 : 2;
+  out.utc = ms >= 20000 ? r.startUtc_ + ms / 1000 : 0;
+}
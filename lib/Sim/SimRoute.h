@@ -0,0 +1,31 @@
+#ifndef SIM_ROUTE_H
+#define SIM_ROUTE_H
+
+#include <stdint.h>
+#include "SimNeo7m.h"
+
+// A deterministic synthetic drive for SimNeo7m: city driving with a turn
+// every 90 s, position integrated from speed and heading.
+//
+//   0:00 - 0:32    no fix (cold start); UTC known from 0:20
+//   20:00 - 25:00  parked
+//   40:00 - 42:00  no sky view (tunnel)
+//
+// The same start gives the same track, so runs can be compared.
+class SimRoute {
+public:
+  SimRoute(double lat, double lng, uint32_t startUtc);
+
+  // SimTrackFn, with the route as context
+  static void track(uint32_t ms, SimFix& out, void* ctx);
+
+private:
+  double lat_;
+  double lng_;
+  float heading_;
+  float speed_;
+  uint32_t lastMs_;
+  uint32_t startUtc_;
+};
+
+#endif
@@ -0,0 +1,319 @@
+#include "SimSim800.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <vector>
+
+// CSCLK=2: asleep after this much UART silence; bytes arriving this soon
+// after the one that woke it are lost too
+#define SIM800_SLEEP_AFTER_MS 5000
+#define SIM800_WAKE_MS 20
+// Largest received-data frame the modem passes on at once
+#define SIM800_MAX_FRAME 1460
+// Large enough for a geofence image
+#define SIM800_RESPONSE_SIZE (256 * 1024)
+
+static bool after(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) > 0;
+}
+
+SimSim800::SimSim800(Clock& clock, SimServerFn server, void* ctx, uint32_t baud)
+  : clock_(clock), uart_(clock, baud), server_(server), ctx_(ctx),
+    bootMs_(3000), bearerMs_(1500), connectMs_(1200), sendRate_(4000), serverMs_(600),
+    closeIdleMs_(0), failConnects_(0),
+    poweredAt_(clock.millis()), lastTraffic_(clock.millis()), wokeAt_(0),
+    sleepEnabled_(false), wasAsleep_(false),
+    dataLeft_(0), skipLf_(false), dataLink_(0), dataLen_(0), mux_(false), ipHead_(false), bearer_(false),
+    commands_(0), requests_(0), connects_(0), wakeups_(0), bytesLost_(0) {
+  for (int i = 0; i < SIM800_LINKS; i++) {
+    links_[i].connected = false;
+    links_[i].lastActivity = 0;
+  }
+  uart_.setWriteHandler(onWrite, this);
+}
+
+bool SimSim800::asleep() {
+  return sleepEnabled_ && !after(lastTraffic_ + SIM800_SLEEP_AFTER_MS, clock_.millis());
+}
+
+void SimSim800::onWrite(const uint8_t* data, size_t len, void* ctx) {
+  SimSim800* m = (SimSim800*)ctx;
+  uint32_t now = m->clock_.millis();
+
+  // Not up yet: nothing is listening
+  if (after(m->poweredAt_ + m->bootMs_, now)) {
+    m->bytesLost_ += len;
+    return;
+  }
+  if (m->asleep()) {
+    m->wakeups_++;
+    m->wokeAt_ = now;
+    m->wasAsleep_ = true;
+  }
+  m->lastTraffic_ = now;
+  if (m->wasAsleep_ && after(m->wokeAt_ + SIM800_WAKE_MS, now)) {
+    m->bytesLost_ += len;
+    m->line_.clear();
+    return;
+  }
+  m->wasAsleep_ = false;
+
+  for (size_t i = 0; i < len; i++) m->handleByte(data[i]);
+}
+
+void SimSim800::handleByte(uint8_t b) {
+  bool lf = skipLf_ && b == '\n';
+  skipLf_ = false;
+  if (lf) return;
+  if (dataLeft_ > 0) {
+    links_[dataLink_].request.push_back((char)b);
+    if (--dataLeft_ == 0) handlePayload();
+    return;
+  }
+  if (b == '\n') return;
+  if (b != '\r') {
+    line_.push_back((char)b);
+    return;
+  }
+  std::string cmd;
+  cmd.swap(line_);
+  skipLf_ = true;
+  if (!cmd.empty()) handleCommand(cmd);
+}
+
+void SimSim800::out(uint32_t at, const std::string& bytes) {
+  uart_.schedule(at, (const uint8_t*)bytes.data(), bytes.size());
+  if (after(at, lastTraffic_)) lastTraffic_ = at;
+}
+
+// "\r\n<text>\r\n" after delayMs, prefixed "<link>, " in CIPMUX mode
+void SimSim800::reply(uint32_t delayMs, const char* text, int link) {
+  char prefix[16] = "";
+  if (link >= 0 && mux_) snprintf(prefix, sizeof(prefix), "%d, ", link);
+  out(clock_.millis() + delayMs, std::string("\r\n") + prefix + text + "\r\n");
+}
+
+// "[<link>,]<value>" as in AT+CIPSEND=0,120 or AT+CIPCLOSE=1
+bool SimSim800::parseArgs(const char* p, int& link, uint32_t& value) {
+  char* end;
+  link = 0;
+  value = 0;
+  if (mux_) {
+    link = (int)strtol(p, &end, 10);
+    if (end == p || link < 0 || link >= SIM800_LINKS) return false;
+    p = end;
+    if (*p == ',') p++;
+    else if (*p) return false;
+  }
+  if (!*p) return true;
+  value = (uint32_t)strtoul(p, &end, 10);
+  return end != p && *end == '\0';
+}
+
+void SimSim800::closeAll() {
+  for (int i = 0; i < SIM800_LINKS; i++) {
+    links_[i].connected = false;
+    links_[i].request.clear();
+  }
+}
+
+void SimSim800::handleCommand(const std::string& text) {
+  const char* cmd = text.c_str();
+  uint32_t now = clock_.millis();
+  commands_++;
+  out(now, text + "\r");  // echo
+
+  int link = 0;
+  uint32_t value = 0;
+
+  if (strcasecmp(cmd, "AT") == 0 || strcasecmp(cmd, "AT+CMEE=2") == 0 ||
+      strncasecmp(cmd, "AT+CSTT=", 8) == 0) {
+    reply(5, "OK");
+  } else if (strcasecmp(cmd, "AT+CPIN?") == 0) {
+    reply(10, "+CPIN: READY\r\n\r\nOK");
+  } else if (strncasecmp(cmd, "AT+CSCLK=", 9) == 0) {
+    sleepEnabled_ = cmd[9] == '2';
+    reply(5, "OK");
+  } else if (strcasecmp(cmd, "AT+CIPSHUT") == 0) {
+    closeAll();
+    bearer_ = false;
+    reply(300, "SHUT OK");
+  } else if (strncasecmp(cmd, "AT+CIPMUX=", 10) == 0) {
+    // Only allowed before the bearer comes up
+    if (bearer_) {
+      reply(5, "ERROR");
+    } else {
+      mux_ = cmd[10] == '1';
+      reply(5, "OK");
+    }
+  } else if (strncasecmp(cmd, "AT+CIPHEAD=", 11) == 0) {
+    ipHead_ = cmd[11] == '1';
+    reply(5, "OK");
+  } else if (strcasecmp(cmd, "AT+CIICR") == 0) {
+    bearer_ = true;
+    reply(bearerMs_, "OK");
+  } else if (strcasecmp(cmd, "AT+CIFSR") == 0) {
+    reply(10, bearer_ ? "10.64.12.7" : "ERROR");
+  } else if (strncasecmp(cmd, "AT+CIPSTART=", 12) == 0) {
+    const char* p = cmd + 12;
+    if (mux_) {
+      link = atoi(p);
+      if (link < 0 || link >= SIM800_LINKS) link = 0;
+    }
+    if (!bearer_) {
+      reply(5, "ERROR");
+    } else if (links_[link].connected) {
+      reply(5, "ALREADY CONNECT", link);
+    } else {
+      reply(5, "OK");
+      if (failConnects_ > 0) {
+        failConnects_--;
+        reply(connectMs_, "CONNECT FAIL", link);
+      } else {
+        links_[link].connected = true;
+        links_[link].lastActivity = now + connectMs_;
+        links_[link].request.clear();
+        connects_++;
+        reply(connectMs_, "CONNECT OK", link);
+      }
+    }
+  } else if (strcasecmp(cmd, "AT+CIPSTATUS") == 0 && !mux_) {
+    const char* state = links_[0].connected ? "STATE: CONNECT OK"
+                      : bearer_ ? "STATE: IP STATUS" : "STATE: IP INITIAL";
+    reply(5, "OK");
+    reply(6, state);
+  } else if (strncasecmp(cmd, "AT+CIPSTATUS=", 13) == 0 && mux_) {
+    link = atoi(cmd + 13);
+    if (link < 0 || link >= SIM800_LINKS) {
+      reply(5, "ERROR");
+    } else {
+      char line[80];
+      snprintf(line, sizeof(line), "+CIPSTATUS: %d,0,\"TCP\",\"10.0.0.1\",\"80\",\"%s\"",
+               link, links_[link].connected ? "CONNECTED" : "CLOSED");
+      reply(5, line);
+      reply(6, "OK");
+    }
+  } else if (strncasecmp(cmd, "AT+CIPSEND=", 11) == 0) {
+    if (!parseArgs(cmd + 11, link, value) || value == 0 || value > SIM800_MAX_FRAME ||
+        !links_[link].connected) {
+      reply(5, "ERROR");
+    } else {
+      dataLink_ = link;
+      dataLeft_ = value;
+      dataLen_ = value;
+      out(now + 5, "\r\n> ");
+    }
+  } else if (strncasecmp(cmd, "AT+CIPCLOSE", 11) == 0) {
+    const char* p = cmd + 11;
+    if (*p == '=') p++;
+    if (!parseArgs(p, link, value) || !links_[link].connected) {
+      reply(5, "ERROR");
+    } else {
+      links_[link].connected = false;
+      links_[link].request.clear();
+      reply(50, "CLOSE OK", link);
+    }
+  } else {
+    reply(5, "ERROR");
+  }
+}
+
+// A CIPSEND payload is complete: acknowledge it and pass every complete
+// HTTP request on the link to the server
+void SimSim800::handlePayload() {
+  Link& l = links_[dataLink_];
+  uint32_t sent = clock_.millis() + 10 + (sendRate_ ? dataLen_ * 1000 / sendRate_ : 0);
+  reply(sent - clock_.millis(), "SEND OK", dataLink_);
+  l.lastActivity = sent;
+
+  for (;;) {
+    size_t headerEnd = l.request.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) return;
+    size_t bodyLen = 0;
+    for (size_t p = 0; p < headerEnd; p = l.request.find("\r\n", p) + 2) {
+      if (strncasecmp(l.request.c_str() + p, "Content-Length:", 15) == 0) {
+        bodyLen = strtoul(l.request.c_str() + p + 15, 0, 10);
+      }
+    }
+    size_t total = headerEnd + 4 + bodyLen;
+    if (l.request.size() < total) return;
+
+    requests_++;
+    std::vector<char> response(SIM800_RESPONSE_SIZE);
+    size_t n = server_ ? server_((const uint8_t*)l.request.data(), total,
+                                 &response[0], response.size(), ctx_) : 0;
+    l.request.erase(0, total);
+    if (n > 0) {
+      uint32_t at = sent + serverMs_;
+      sendData(at, dataLink_, &response[0], n);
+      l.lastActivity = at;
+    }
+  }
+}
+
+void SimSim800::sendData(uint32_t at, int link, const char* data, size_t len) {
+  while (len > 0) {
+    size_t n = len < SIM800_MAX_FRAME ? len : SIM800_MAX_FRAME;
+    char header[32];
+    if (mux_) {
+      snprintf(header, sizeof(header), "\r\n+RECEIVE,%d,%u:\r\n", link, (unsigned)n);
+    } else if (ipHead_) {
+      snprintf(header, sizeof(header), "\r\n+IPD,%u:", (unsigned)n);
+    } else {
+      header[0] = '\0';
+    }
+    out(at, std::string(header) + std::string(data, n));
+    data += n;
+    len -= n;
+  }
+}
+
+void SimSim800::inject(uint32_t at, const char* line) {
+  injected_.insert(std::make_pair(at, std::string(line)));
+}
+
+void SimSim800::poll() {
+  uint32_t now = clock_.millis();
+
+  while (!injected_.empty() && !after(injected_.begin()->first, now)) {
+    const std::string& line = injected_.begin()->second;
+    if (line.compare(0, 11, "+PDP: DEACT") == 0) {
+      closeAll();
+      bearer_ = false;
+    } else if (line.find("CLOSED") != std::string::npos) {
+      int link = mux_ ? atoi(line.c_str()) : 0;
+      if (link >= 0 && link < SIM800_LINKS) links_[link].connected = false;
+    }
+    out(now, "\r\n" + line + "\r\n");
+    injected_.erase(injected_.begin());
+  }
+
+  if (closeIdleMs_ == 0) return;
+  for (int i = 0; i < SIM800_LINKS; i++) {
+    Link& l = links_[i];
+    if (!l.connected || after(l.lastActivity + closeIdleMs_, now)) continue;
+    l.connected = false;
+    l.request.clear();
+    reply(0, "CLOSED", i);
+  }
+}
+
+bool SimSim800::nextEvent(uint32_t& at) {
+  bool any = uart_.nextArrival(at);
+  if (!injected_.empty() && (!any || after(at, injected_.begin()->first))) {
+    at = injected_.begin()->first;
+    any = true;
+  }
+  if (closeIdleMs_ == 0) return any;
+  for (int i = 0; i < SIM800_LINKS; i++) {
+    if (!links_[i].connected) continue;
+    uint32_t close = links_[i].lastActivity + closeIdleMs_;
+    if (!any || after(at, close)) {
+      at = close;
+      any = true;
+    }
+  }
+  return any;
+}
@@ -0,0 +1,126 @@
+#ifndef SIM_SIM800_H
+#define SIM_SIM800_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include "SimUart.h"
+
+#define SIM800_LINKS 6
+
+// Answers one HTTP request received by the simulated modem. Writes the
+// response into 'response' and returns its length; 0 leaves the request
+// unanswered.
+typedef size_t (*SimServerFn)(const uint8_t* request, size_t len,
+                              char* response, size_t size, void* ctx);
+
+// Simulated SIM800 on a SimUart.
+//
+// Models the AT commands the tracker uses: start-up (AT, CMEE, CPIN,
+// CSCLK), the GPRS bearer (CIPSHUT, CIPMUX, CIPHEAD, CSTT, CIICR, CIFSR)
+// and TCP links (CIPSTART, CIPSTATUS, CIPSEND, CIPCLOSE), in single and
+// CIPMUX mode, with SIM800-like result texts and timings. Commands are
+// echoed; payload bytes are not. Anything else is answered with ERROR.
+//
+// Data sent on a link is reassembled into HTTP requests (by
+// Content-Length) and handed to the server function; its answer comes
+// back framed as "+IPD,<len>:" (AT+CIPHEAD=1) or "+RECEIVE,<n>,<len>:"
+// after the server delay. Idle connections are closed by the server
+// after closeIdleMs, as a keep-alive server would.
+//
+// With AT+CSCLK=2 the modem falls asleep after 5 s without UART traffic;
+// the bytes that wake it are lost.
+//
+// Unsolicited lines can be injected at any time; "+PDP: DEACT" and
+// "[<n>, ]CLOSED" also take the bearer or the link down.
+class SimSim800 {
+public:
+  SimSim800(Clock& clock, SimServerFn server, void* ctx, uint32_t baud = 115200);
+
+  SerialPort& port() { return uart_; }
+  SimUart& uart() { return uart_; }
+
+  // Delays, in ms
+  void setBootMs(uint32_t ms) { bootMs_ = ms; }        // power-on to first answer
+  void setBearerMs(uint32_t ms) { bearerMs_ = ms; }    // AT+CIICR
+  void setConnectMs(uint32_t ms) { connectMs_ = ms; }  // AT+CIPSTART to CONNECT OK
+  void setSendBytesPerSec(uint32_t rate) { sendRate_ = rate; }  // to SEND OK
+  void setServerMs(uint32_t ms) { serverMs_ = ms; }    // request to response
+  void setCloseIdleMs(uint32_t ms) { closeIdleMs_ = ms; }  // 0: never
+
+  // The next 'count' connection attempts fail with CONNECT FAIL
+  void failConnects(uint32_t count) { failConnects_ = count; }
+
+  // Sends an unsolicited line at 'at' (e.g. "+PDP: DEACT", "UNDER-VOLTAGE")
+  void inject(uint32_t at, const char* line);
+
+  // Time-driven events (injected lines, server-side closes); call before
+  // the tracker polls
+  void poll();
+
+  // The next time-driven event or byte arrival, if any
+  bool nextEvent(uint32_t& at);
+
+  uint32_t commands() const { return commands_; }
+  uint32_t requests() const { return requests_; }
+  uint32_t connects() const { return connects_; }
+  uint32_t wakeups() const { return wakeups_; }
+  uint32_t bytesLost() const { return bytesLost_; }
+  bool asleep();
+
+private:
+  struct Link {
+    bool connected;
+    uint32_t lastActivity;
+    std::string request;  // HTTP request being received
+  };
+
+  static void onWrite(const uint8_t* data, size_t len, void* ctx);
+  void handleByte(uint8_t b);
+  void handleCommand(const std::string& cmd);
+  void handlePayload();
+  void out(uint32_t at, const std::string& bytes);
+  void reply(uint32_t delayMs, const char* text, int link = -1);
+  void sendData(uint32_t at, int link, const char* data, size_t len);
+  void closeAll();
+  bool parseArgs(const char* p, int& link, uint32_t& value);
+
+  Clock& clock_;
+  SimUart uart_;
+  SimServerFn server_;
+  void* ctx_;
+
+  uint32_t bootMs_;
+  uint32_t bearerMs_;
+  uint32_t connectMs_;
+  uint32_t sendRate_;
+  uint32_t serverMs_;
+  uint32_t closeIdleMs_;
+  uint32_t failConnects_;
+
+  uint32_t poweredAt_;
+  uint32_t lastTraffic_;   // last byte either way, for CSCLK
+  uint32_t wokeAt_;
+  bool sleepEnabled_;
+  bool wasAsleep_;
+
+  std::string line_;
+  size_t dataLeft_;      // payload bytes still expected after '>'
+  bool skipLf_;          // the command's '\n' is not payload
+  int dataLink_;
+  uint32_t dataLen_;
+
+  bool mux_;
+  bool ipHead_;
+  bool bearer_;
+  Link links_[SIM800_LINKS];
+  std::multimap<uint32_t, std::string> injected_;
+
+  uint32_t commands_;
+  uint32_t requests_;
+  uint32_t connects_;
+  uint32_t wakeups_;
+  uint32_t bytesLost_;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "SimUart.h"
+
+#include <string.h>
+
+static bool after(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) > 0;
+}
+
+SimUart::SimUart(Clock& clock, uint32_t baud)
+  : clock_(clock), baud_(baud), handler_(0), ctx_(0), wireEnd_(0), bytesIn_(0), bytesOut_(0) {}
+
+void SimUart::schedule(uint32_t at, const uint8_t* data, size_t len) {
+  if (len == 0) return;
+  uint32_t now = clock_.millis();
+  if (after(now, at)) at = now;
+  pending_.insert(std::make_pair(at, std::string((const char*)data, len)));
+}
+
+void SimUart::schedule(uint32_t at, const char* s) {
+  schedule(at, (const uint8_t*)s, strlen(s));
+}
+
+void SimUart::clear() {
+  pending_.clear();
+  wire_.clear();
+}
+
+// Puts due chunks on the wire, each behind the one before it
+void SimUart::update() {
+  uint32_t now = clock_.millis();
+  while (!pending_.empty() && !after(pending_.begin()->first, now)) {
+    Chunk c;
+    c.start = pending_.begin()->first;
+    if (!wire_.empty() && after(wireEnd_, c.start)) c.start = wireEnd_;
+    c.usPerByte = baud_ ? 10000000 / baud_ : 0;
+    c.bytes.swap(pending_.begin()->second);
+    c.pos = 0;
+    pending_.erase(pending_.begin());
+    wireEnd_ = c.start + (uint32_t)((c.bytes.size() * c.usPerByte + 999) / 1000);
+    wire_.push_back(c);
+  }
+}
+
+// Bytes of c that have fully arrived by now
+size_t SimUart::arrived(const Chunk& c) const {
+  uint32_t now = clock_.millis();
+  if (after(c.start, now)) return 0;
+  if (c.usPerByte == 0) return c.bytes.size();
+  uint64_t n = (uint64_t)(now - c.start) * 1000 / c.usPerByte;
+  return n < c.bytes.size() ? (size_t)n : c.bytes.size();
+}
+
+bool SimUart::nextArrival(uint32_t& at) {
+  update();
+  if (!wire_.empty()) {
+    const Chunk& c = wire_.front();
+    at = c.start + (uint32_t)(((uint64_t)(c.pos + 1) * c.usPerByte + 999) / 1000);
+    return true;
+  }
+  if (!pending_.empty()) {
+    at = pending_.begin()->first;
+    return true;
+  }
+  return false;
+}
+
+int SimUart::available() {
+  update();
+  size_t n = 0;
+  for (size_t i = 0; i < wire_.size(); i++) {
+    size_t got = arrived(wire_[i]);
+    n += got - wire_[i].pos;
+    if (got < wire_[i].bytes.size()) break;
+  }
+  return (int)n;
+}
+
+int SimUart::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+size_t SimUart::read(uint8_t* buf, size_t len) {
+  update();
+  size_t n = 0;
+  while (n < len && !wire_.empty()) {
+    Chunk& c = wire_.front();
+    size_t got = arrived(c);
+    size_t take = got - c.pos;
+    if (take > len - n) take = len - n;
+    memcpy(buf + n, c.bytes.data() + c.pos, take);
+    c.pos += take;
+    n += take;
+    if (c.pos < c.bytes.size()) break;
+    wire_.pop_front();
+  }
+  bytesOut_ += n;
+  return n;
+}
+
+size_t SimUart::write(const uint8_t* data, size_t len) {
+  bytesIn_ += len;
+  if (handler_) handler_(data, len, ctx_);
+  return len;
+}
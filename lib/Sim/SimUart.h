@@ -0,0 +1,71 @@
+#ifndef SIM_UART_H
+#define SIM_UART_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <Clock.h>
+#include <SerialPort.h>
+
+// Receives what the tracker writes to a simulated peripheral
+typedef void (*SimWriteHandler)(const uint8_t* data, size_t len, void* ctx);
+
+// The tracker's end of a simulated UART.
+//
+// The peripheral model schedules what it sends for a point in virtual
+// time. From then on the bytes become readable one at a time at line rate
+// (10 bits per byte), after anything that was already on the wire, as
+// they would from a real UART. Everything the tracker writes is passed to
+// the model straight away.
+class SimUart : public SerialPort {
+public:
+  // baud 0 delivers every byte as soon as it is due
+  SimUart(Clock& clock, uint32_t baud);
+
+  void setBaud(uint32_t baud) { baud_ = baud; }
+  uint32_t baud() const { return baud_; }
+  void setWriteHandler(SimWriteHandler handler, void* ctx) { handler_ = handler; ctx_ = ctx; }
+
+  // Queues bytes to go out at 'at' (now, if that has passed)
+  void schedule(uint32_t at, const uint8_t* data, size_t len);
+  void schedule(uint32_t at, const char* s);
+
+  // When the next byte not yet read becomes readable; false if there is
+  // none. May be in the past if the tracker has not caught up.
+  bool nextArrival(uint32_t& at);
+
+  // Drops everything not yet read
+  void clear();
+
+  uint32_t bytesIn() const { return bytesIn_; }   // written by the tracker
+  uint32_t bytesOut() const { return bytesOut_; } // read by the tracker
+
+  int available() override;
+  int read() override;
+  size_t read(uint8_t* buf, size_t len) override;
+  size_t write(const uint8_t* data, size_t len) override;
+  using SerialPort::write;
+
+private:
+  struct Chunk {
+    uint32_t start;      // ms the first bit goes out
+    uint32_t usPerByte;
+    std::string bytes;
+    size_t pos;          // next byte to read
+  };
+
+  void update();
+  size_t arrived(const Chunk& c) const;
+
+  Clock& clock_;
+  uint32_t baud_;
+  SimWriteHandler handler_;
+  void* ctx_;
+  std::multimap<uint32_t, std::string> pending_;  // not on the wire yet, by time
+  std::deque<Chunk> wire_;
+  uint32_t wireEnd_;     // ms the last chunk on the wire is through
+  uint32_t bytesIn_;
+  uint32_t bytesOut_;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef STREAM_SIMPLIFIER_H
+#define STREAM_SIMPLIFIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <Geo.h>
+
+// Streaming line simplification with bounded memory.
+//
+// An opening-window variant of Douglas-Peucker: points collect behind the
+// last emitted point (the anchor) for as long as every one of them stays
+// within 'toleranceCm' of the straight line from the anchor to the newest
+// point. When a new point breaks that, the point before it is emitted and
+// becomes the new anchor. The emitted track therefore never strays more
+// than the tolerance from the raw one.
+//
+// The window is bounded at N points and at maxSpanMs of time after the
+// anchor; hitting either emits a point too, so a parked or dead-straight
+// track still produces one point per maxSpanMs. All geometry is integer
+// (see GeoFrame), there is no floating point on the per-fix path.
+//
+// T needs int32_t lat_e7, lng_e7 and a uint32_t ts in milliseconds.
+template <typename T, size_t N>
+class StreamSimplifier {
+  static_assert(N >= 3, "window must hold at least three points");
+
+public:
+  typedef void (*EmitFn)(const T& point, void* ctx);
+
+  StreamSimplifier(uint32_t toleranceCm, uint32_t maxSpanMs, EmitFn emit, void* ctx)
+    : toleranceCm_(toleranceCm), maxSpanMs_(maxSpanMs), emit_(emit), ctx_(ctx),
+      count_(0), emitted_(0) {}
+
+  void push(const T& p) {
+    if (count_ == 0) {
+      anchorAt(p);
+      return;
+    }
+
+    int32_t x, y;
+    geoFrameOffsetCm(frame_, p.lat_e7, p.lng_e7, x, y);
+    if (count_ == N || !fits(x, y)) {
+      // The previous point is the last one the current line describes
+      anchorAt(window_[count_ - 1]);
+      geoFrameOffsetCm(frame_, p.lat_e7, p.lng_e7, x, y);
+    }
+
+    if (p.ts - window_[0].ts >= maxSpanMs_) {
+      anchorAt(p);
+      return;
+    }
+    window_[count_] = p;
+    x_[count_] = x;
+    y_[count_] = y;
+    count_++;
+  }
+
+  // Emits the newest point if it is still held back, e.g. before an upload
+  void flush() {
+    if (count_ > 1) anchorAt(window_[count_ - 1]);
+  }
+
+  // Forgets everything; the next point is emitted as a fresh anchor
+  void reset() { count_ = 0; }
+
+  uint32_t emitted() const { return emitted_; }
+  size_t held() const { return count_ > 0 ? count_ - 1 : 0; }
+
+private:
+  // True if every held point is within tolerance of anchor -> (x, y)
+  bool fits(int32_t x, int32_t y) const {
+    for (size_t i = 1; i < count_; i++) {
+      if (geoSegmentDistanceCm(x_[i], y_[i], x, y) > toleranceCm_) return false;
+    }
+    return true;
+  }
+
+  void anchorAt(const T& p) {
+    T anchor = p;  // p may live in window_
+    emit_(anchor, ctx_);
+    emitted_++;
+    window_[0] = anchor;
+    x_[0] = 0;
+    y_[0] = 0;
+    count_ = 1;
+    geoFrameInit(frame_, anchor.lat_e7, anchor.lng_e7);
+  }
+
+  uint32_t toleranceCm_;
+  uint32_t maxSpanMs_;
+  EmitFn emit_;
+  void* ctx_;
+
+  GeoFrame frame_;
+  T window_[N];
+  int32_t x_[N];
+  int32_t y_[N];
+  size_t count_;
+  uint32_t emitted_;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+// Lock-free single-producer / single-consumer ring buffer.
+//
+// Exactly one task may push() and exactly one task may pop(). Only plain
+// atomic loads and stores are used (no read-modify-write), so this stays
+// lock-free on cores without atomic instructions such as the ESP32-C3,
+// and builds unchanged on a host with std::thread.
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+  SpscQueue() : head_(0), tail_(0) {}
+
+  // Producer side. Returns false (and drops v) when the queue is full.
+  bool push(const T& v) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == N) return false;
+    buf_[head & (N - 1)] = v;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when the queue is empty.
+  bool pop(T& out) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return false;
+    out = buf_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate when called concurrently with push()/pop()
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  static size_t capacity() { return N; }
+
+private:
+  T buf_[N];
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+};
+
+#endif
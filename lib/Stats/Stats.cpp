@@ -0,0 +1,69 @@
+#include "Stats.h"
+
+#if !(defined(ARDUINO) && defined(ESP32))
+#include <chrono>
+
+uint32_t statsCycles() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Index of the bucket for v: 0 for zero, else its bit length, capped
+static uint8_t bucketOf(uint32_t v) {
+  uint8_t i = 0;
+  while (v) {
+    i++;
+    v >>= 1;
+  }
+  return i < STATS_BUCKETS ? i : STATS_BUCKETS - 1;
+}
+
+Histogram::Histogram(const char* name, const char* unit) : name_(name), unit_(unit) {
+  reset();
+}
+
+void Histogram::record(uint32_t value) {
+  buckets_[bucketOf(value)]++;
+  if (count_ == 0 || value < min_) min_ = value;
+  if (value > max_) max_ = value;
+  count_++;
+  sum_ += value;
+}
+
+void Histogram::reset() {
+  for (uint8_t i = 0; i < STATS_BUCKETS; i++) buckets_[i] = 0;
+  count_ = 0;
+  min_ = 0;
+  max_ = 0;
+  sum_ = 0;
+}
+
+uint32_t Histogram::bucketFloor(uint8_t i) {
+  return i == 0 ? 0 : (uint32_t)1 << (i - 1);
+}
+
+uint32_t Histogram::percentile(uint8_t p) const {
+  if (count_ == 0) return 0;
+  // Rank of the sample wanted, rounded up, at least the first one
+  uint32_t rank = (uint32_t)(((uint64_t)count_ * p + 99) / 100);
+  if (rank == 0) rank = 1;
+
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < STATS_BUCKETS; i++) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      if (i == STATS_BUCKETS - 1) return max_;
+      uint32_t upper = i == 0 ? 0 : bucketFloor(i + 1) - 1;
+      return upper < max_ ? upper : max_;
+    }
+  }
+  return max_;
+}
+
+bool PhaseTimer::stop(uint32_t now) {
+  if (!running_) return false;
+  running_ = false;
+  h_.record(now - start_);
+  return true;
+}
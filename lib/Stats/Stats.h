@@ -0,0 +1,95 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Buckets per histogram: zero, then one per power of two; the last one
+// takes everything from 2^(STATS_BUCKETS - 2) up
+#ifndef STATS_BUCKETS
+#define STATS_BUCKETS 20
+#endif
+
+// CPU cycle counter for the scoped timers. It wraps every 2^32 cycles
+// (~27 s at 160 MHz), far longer than any timed scope.
+#if defined(ARDUINO) && defined(ESP32)
+#include <Arduino.h>
+inline uint32_t statsCycles() { return ESP.getCycleCount(); }
+inline uint32_t statsCyclesPerUs() { return ESP.getCpuFreqMHz(); }
+#else
+uint32_t statsCycles();
+inline uint32_t statsCyclesPerUs() { return 1000; }  // host: nanoseconds
+#endif
+
+// Fixed-size histogram with logarithmic buckets.
+//
+// Bucket 0 counts zeros and bucket i (i > 0) values in [2^(i-1), 2^i), so
+// microseconds to tens of seconds fit in 20 buckets of 4 bytes each.
+// Percentiles are resolved to a bucket, i.e. within a factor of two,
+// which is enough to tell where the time goes. record() is a handful of
+// instructions and never allocates.
+//
+// Not synchronized: a reader in another task may see a record half
+// applied, which skews a dump by at most one sample.
+class Histogram {
+public:
+  Histogram(const char* name, const char* unit);
+
+  void record(uint32_t value);
+  void reset();
+
+  const char* name() const { return name_; }
+  const char* unit() const { return unit_; }
+  uint32_t count() const { return count_; }
+  uint32_t min() const { return count_ ? min_ : 0; }
+  uint32_t max() const { return max_; }
+  uint32_t mean() const { return count_ ? (uint32_t)(sum_ / count_) : 0; }
+  uint32_t bucket(uint8_t i) const { return buckets_[i]; }
+
+  // Upper bound of the bucket holding the p-th percentile (0..100),
+  // capped at the largest value seen
+  uint32_t percentile(uint8_t p) const;
+
+  // Smallest value counted in bucket i
+  static uint32_t bucketFloor(uint8_t i);
+
+private:
+  const char* name_;
+  const char* unit_;
+  uint32_t buckets_[STATS_BUCKETS];
+  uint32_t count_;
+  uint32_t min_;
+  uint32_t max_;
+  uint64_t sum_;
+};
+
+// Records the CPU time spent in a scope, in microseconds
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Histogram& h) : h_(h), start_(statsCycles()) {}
+  ~ScopedTimer() { h_.record((statsCycles() - start_) / statsCyclesPerUs()); }
+
+private:
+  Histogram& h_;
+  uint32_t start_;
+};
+
+// Times an asynchronous phase (e.g. CIPSTART to CONNECT OK) on a
+// millisecond clock: start() when it begins, stop() when it ends
+class PhaseTimer {
+public:
+  explicit PhaseTimer(Histogram& h) : h_(h), start_(0), running_(false) {}
+
+  void start(uint32_t now) { start_ = now; running_ = true; }
+  // Records the phase if it was running; false otherwise
+  bool stop(uint32_t now);
+  void cancel() { running_ = false; }
+  bool running() const { return running_; }
+
+private:
+  Histogram& h_;
+  uint32_t start_;
+  bool running_;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "TcpSession.h"
+
+#include <stdio.h>
+#include <string.h>
+
+TcpSession::TcpSession(AtEngine& modem, Clock& clock, uint8_t links)
+  : modem_(modem), clock_(clock),
+    links_(links < 1 ? 1 : links > TCP_MAX_LINKS ? TCP_MAX_LINKS : links),
+    host_(""), port_(0), bearerUp_(false), reused_(false), opening_(false),
+    link_(0), openedAt_(0), cb_(0), ctx_(0),
+    connects_(0), reuses_(0), failures_(0), connectMs_(0), reuseMs_(0) {
+  cstt_[0] = '\0';
+  command_[0] = '\0';
+  for (uint8_t i = 0; i < TCP_MAX_LINKS; i++) socketUp_[i] = false;
+
+  // A remote close is a bare "CLOSED" in single mode, "<n>, CLOSED" with
+  // CIPMUX=1
+  modem_.addUrcHandler("CLOSED", onClosed, this);
+  modem_.addUrcHandler("#, CLOSED", onClosed, this);
+  modem_.addUrcHandler("+PDP: DEACT", onPdpDeact, this);
+}
+
+void TcpSession::setApn(const char* apn) {
+  snprintf(cstt_, sizeof(cstt_), "AT+CSTT=\"%s\"", apn);
+}
+
+void TcpSession::setServer(const char* host, int port) {
+  host_ = host;
+  port_ = port;
+}
+
+void TcpSession::formatSend(char* out, size_t size, uint8_t link, size_t len) const {
+  if (multiplexed()) {
+    snprintf(out, size, "AT+CIPSEND=%u,%u", (unsigned)link, (unsigned)len);
+  } else {
+    snprintf(out, size, "AT+CIPSEND=%u", (unsigned)len);
+  }
+}
+
+uint32_t TcpSession::savedMs() const {
+  if (connects_ == 0) return 0;
+  uint32_t perReuse = averageConnectMs();
+  uint32_t probe = averageReuseMs();
+  return perReuse > probe ? reuses_ * (perReuse - probe) : 0;
+}
+
+bool TcpSession::open(AtCallback cb, void* ctx, uint8_t link) {
+  if (opening_ || link >= links_) return false;
+  if (modem_.freeSlots() < 7) return false;
+
+  cb_ = cb;
+  ctx_ = ctx;
+  link_ = link;
+  opening_ = true;
+  openedAt_ = clock_.millis();
+
+  if (socketUp_[link]) {
+    // The socket may have died without a URC (e.g. the server timed out
+    // the idle connection while the modem was busy)
+    if (multiplexed()) {
+      snprintf(command_, sizeof(command_), "AT+CIPSTATUS=%u", (unsigned)link);
+      modem_.enqueue(command_, "+CIPSTATUS:", 2000, onProbe, this);
+    } else {
+      modem_.enqueue("AT+CIPSTATUS", "STATE:", 2000, onProbe, this);
+    }
+    return true;
+  }
+  return queueConnect();
+}
+
+bool TcpSession::queueConnect() {
+  bool ok = true;
+  if (!bearerUp_) {
+    // Start from a clean slate; CIPSHUT fails harmlessly if nothing is up
+    ok &= modem_.enqueue("AT+CIPSHUT", "SHUT OK", 65000, 0, 0, 0, AT_FLAG_OPTIONAL);
+    for (uint8_t i = 0; i < links_; i++) socketUp_[i] = false;
+    // CIPMUX can only be changed while no bearer is up
+    ok &= modem_.enqueue(multiplexed() ? "AT+CIPMUX=1" : "AT+CIPMUX=0", "OK", 2000);
+    // Frame received data as "+IPD,<len>:" (CIPMUX mode always frames it)
+    if (!multiplexed()) ok &= modem_.enqueue("AT+CIPHEAD=1", "OK", 2000);
+    ok &= modem_.enqueue(cstt_, "OK", 5000, 0, 0, 0, AT_FLAG_OPTIONAL);
+    ok &= modem_.enqueue("AT+CIICR", "OK", 85000);
+    // CIFSR answers with the bare IP address, so any dotted line will do
+    ok &= modem_.enqueue("AT+CIFSR", ".", 5000, onBearerUp, this);
+  }
+  if (multiplexed()) {
+    snprintf(command_, sizeof(command_), "AT+CIPSTART=%u,\"TCP\",\"%s\",\"%d\"",
+             (unsigned)link_, host_, port_);
+  } else {
+    snprintf(command_, sizeof(command_), "AT+CIPSTART=\"TCP\",\"%s\",\"%d\"", host_, port_);
+  }
+  ok &= modem_.enqueue(command_, "CONNECT OK|ALREADY CONNECT", 15000, onConnect, this);
+  return ok;
+}
+
+void TcpSession::close(uint8_t link) {
+  if (link >= links_) return;
+  if (socketUp_[link]) {
+    // Queued entries keep a copy of the command text
+    char cmd[24];
+    if (multiplexed()) {
+      snprintf(cmd, sizeof(cmd), "AT+CIPCLOSE=%u", (unsigned)link);
+    } else {
+      strcpy(cmd, "AT+CIPCLOSE");
+    }
+    modem_.enqueue(cmd, "CLOSE OK", 5000, 0, 0, 0, AT_FLAG_OPTIONAL);
+  }
+  socketUp_[link] = false;
+}
+
+void TcpSession::onClosed(const char* line, void* ctx) {
+  TcpSession* s = (TcpSession*)ctx;
+  uint8_t link = 0;
+  if (line[0] >= '0' && line[0] <= '9') link = (uint8_t)(line[0] - '0');
+  if (link < s->links_) s->socketUp_[link] = false;
+}
+
+void TcpSession::onPdpDeact(const char* line, void* ctx) {
+  TcpSession* s = (TcpSession*)ctx;
+  for (uint8_t i = 0; i < s->links_; i++) s->socketUp_[i] = false;
+  s->bearerUp_ = false;
+}
+
+void TcpSession::onProbe(AtResult result, const char* line, void* ctx) {
+  TcpSession* s = (TcpSession*)ctx;
+  // Single mode reports "STATE: CONNECT OK", CIPMUX mode a
+  // "+CIPSTATUS: <n>,...,"CONNECTED"" line per link
+  bool alive = strstr(line, "CONNECT OK") || strstr(line, "\"CONNECTED\"");
+  if (result == AT_RESULT_OK && alive) {
+    s->reuses_++;
+    s->reuseMs_ += s->clock_.millis() - s->openedAt_;
+    s->reused_ = true;
+    s->finish(AT_RESULT_OK, line);
+    return;
+  }
+  if (result == AT_RESULT_ABORTED) {
+    s->finish(result, line);
+    return;
+  }
+
+  // "IP STATUS", "TCP CLOSED" and "IP CLOSE" still have an address, as
+  // does any per-link status line; anything else means the bearer has to
+  // come up again
+  s->socketUp_[s->link_] = false;
+  if (!s->multiplexed() && !strstr(line, "IP STATUS") && !strstr(line, "CLOSE")) {
+    s->bearerUp_ = false;
+  }
+  if (!s->queueConnect()) s->finish(AT_RESULT_ERROR, "");
+}
+
+void TcpSession::onBearerUp(AtResult result, const char* line, void* ctx) {
+  TcpSession* s = (TcpSession*)ctx;
+  if (result == AT_RESULT_OK) s->bearerUp_ = true;
+}
+
+void TcpSession::onConnect(AtResult result, const char* line, void* ctx) {
+  TcpSession* s = (TcpSession*)ctx;
+  if (result == AT_RESULT_OK) {
+    s->socketUp_[s->link_] = true;
+    s->reused_ = false;
+    s->connects_++;
+    s->connectMs_ += s->clock_.millis() - s->openedAt_;
+  } else {
+    // A refused or timed out connect usually means the bearer is stale
+    s->bearerUp_ = false;
+  }
+  s->finish(result, line);
+}
+
+void TcpSession::finish(AtResult result, const char* line) {
+  opening_ = false;
+  if (result != AT_RESULT_OK) failures_++;
+  if (cb_) cb_(result, line, ctx_);
+}
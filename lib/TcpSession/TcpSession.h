@@ -0,0 +1,99 @@
+#ifndef TCP_SESSION_H
+#define TCP_SESSION_H
+
+#include <stdint.h>
+#include <AtEngine.h>
+#include <Clock.h>
+
+// Most links the SIM800 offers in AT+CIPMUX=1 mode is 6
+#ifndef TCP_MAX_LINKS
+#define TCP_MAX_LINKS 2
+#endif
+
+// Keeps the SIM800's GPRS bearer and its TCP connections open across
+// uploads, reconnecting only when a connection is known or found to be
+// gone.
+//
+// open() queues whatever the modem needs to end up with a usable socket
+// and reports the outcome through the callback:
+//   - connected before:  AT+CIPSTATUS, to confirm the socket survived
+//   - bearer up:         AT+CIPSTART
+//   - bearer down:       AT+CIPSHUT, CSTT, CIICR, CIFSR, then CIPSTART
+// Unsolicited "CLOSED" and "+PDP: DEACT" lines, which the session
+// subscribes to on the AT engine, mark the socket or the bearer as gone
+// without any polling. Received data is framed with a +IPD / +RECEIVE
+// header so the engine can keep it apart from command responses.
+//
+// With more than one link the modem is put in AT+CIPMUX=1 mode when the
+// bearer comes up, and every command and URC carries the link number.
+// Only one open() may be in progress at a time.
+//
+// Setup time is measured from open() to the callback so the time saved
+// by reusing a connection can be reported.
+class TcpSession {
+public:
+  TcpSession(AtEngine& modem, Clock& clock, uint8_t links = 1);
+
+  void setApn(const char* apn);
+  void setServer(const char* host, int port);
+
+  // Queues the commands that make the socket usable; false if the AT
+  // queue is too full. cb gets AT_RESULT_OK once data can be sent.
+  bool open(AtCallback cb, void* ctx, uint8_t link = 0);
+
+  // Drops the socket, e.g. after a failed send
+  void close(uint8_t link = 0);
+
+  // Writes the CIPSEND command for 'len' bytes on 'link' into out
+  void formatSend(char* out, size_t size, uint8_t link, size_t len) const;
+
+  uint8_t links() const { return links_; }
+  bool multiplexed() const { return links_ > 1; }
+  bool connected(uint8_t link = 0) const { return socketUp_[link]; }
+  // True if the last successful open() reused an existing socket
+  bool reused() const { return reused_; }
+
+  uint32_t connects() const { return connects_; }
+  uint32_t reuses() const { return reuses_; }
+  uint32_t failures() const { return failures_; }
+  uint32_t averageConnectMs() const { return connects_ ? connectMs_ / connects_ : 0; }
+  uint32_t averageReuseMs() const { return reuses_ ? reuseMs_ / reuses_ : 0; }
+  // Estimated setup time avoided by reusing connections instead of
+  // opening a new one for every upload
+  uint32_t savedMs() const;
+
+private:
+  static void onClosed(const char* line, void* ctx);
+  static void onPdpDeact(const char* line, void* ctx);
+  static void onProbe(AtResult result, const char* line, void* ctx);
+  static void onBearerUp(AtResult result, const char* line, void* ctx);
+  static void onConnect(AtResult result, const char* line, void* ctx);
+
+  bool queueConnect();
+  void finish(AtResult result, const char* line);
+
+  AtEngine& modem_;
+  Clock& clock_;
+  uint8_t links_;
+  char cstt_[64];
+  const char* host_;
+  int port_;
+  char command_[AT_MAX_COMMAND_LEN];
+
+  bool bearerUp_;
+  bool socketUp_[TCP_MAX_LINKS];
+  bool reused_;
+  bool opening_;
+  uint8_t link_;
+  uint32_t openedAt_;
+  AtCallback cb_;
+  void* ctx_;
+
+  uint32_t connects_;
+  uint32_t reuses_;
+  uint32_t failures_;
+  uint32_t connectMs_;
+  uint32_t reuseMs_;
+};
+
+#endif
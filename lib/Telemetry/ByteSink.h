@@ -0,0 +1,98 @@
+#ifndef BYTE_SINK_H
+#define BYTE_SINK_H
+
+#include <stddef.h>
+#include <string.h>
+
+// Destination for serialized output. Serializers write through this so the
+// same code can size a document, fill a fixed buffer or stream to a port.
+class ByteSink {
+public:
+  virtual ~ByteSink() {}
+  virtual void write(const char* data, size_t len) = 0;
+
+  // True once the sink will discard anything further; long serializers
+  // may check it to stop early.
+  virtual bool full() const { return false; }
+
+  void write(const char* s) { write(s, strlen(s)); }
+};
+
+// Counts bytes without storing them (the Content-Length sizing pass).
+class CountingSink : public ByteSink {
+public:
+  CountingSink() : count_(0) {}
+  void write(const char* data, size_t len) override { count_ += len; }
+  using ByteSink::write;
+
+  size_t count() const { return count_; }
+
+private:
+  size_t count_;
+};
+
+// Writes into a caller-provided buffer. Output past the end is dropped and
+// flagged; the buffer is always NUL terminated.
+class BufferSink : public ByteSink {
+public:
+  BufferSink(char* buf, size_t capacity) : buf_(buf), cap_(capacity), len_(0), overflow_(false) {
+    if (cap_ > 0) buf_[0] = '\0';
+  }
+
+  void write(const char* data, size_t len) override {
+    if (cap_ == 0) { overflow_ = overflow_ || len > 0; return; }
+    size_t room = cap_ - 1 - len_;
+    if (len > room) {
+      len = room;
+      overflow_ = true;
+    }
+    memcpy(buf_ + len_, data, len);
+    len_ += len;
+    buf_[len_] = '\0';
+  }
+  using ByteSink::write;
+
+  const char* data() const { return buf_; }
+  size_t length() const { return len_; }
+  bool overflow() const { return overflow_; }
+  bool full() const override { return overflow_; }
+
+private:
+  char* buf_;
+  size_t cap_;
+  size_t len_;
+  bool overflow_;
+};
+
+// Forwards only bytes [offset, offset + length) of whatever is written to
+// it. Re-running a serializer through a window yields any slice of the
+// document without holding the whole thing in memory.
+class WindowSink : public ByteSink {
+public:
+  WindowSink(ByteSink& inner, size_t offset, size_t length)
+    : inner_(inner), skip_(offset), left_(length) {}
+
+  void write(const char* data, size_t len) override {
+    if (skip_ >= len) {
+      skip_ -= len;
+      return;
+    }
+    data += skip_;
+    len -= skip_;
+    skip_ = 0;
+    if (len > left_) len = left_;
+    if (len == 0) return;
+    inner_.write(data, len);
+    left_ -= len;
+  }
+  using ByteSink::write;
+
+  bool full() const override { return left_ == 0; }
+
+private:
+  ByteSink& inner_;
+  size_t skip_;
+  size_t left_;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#include "Deflate.h"
+
+#include <string.h>
+
+// RFC 1951 length and distance code bases and extra bits
+static const uint16_t lengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+#define ADLER_MOD 65521
+// Largest run of bytes before the Adler-32 sums can overflow 32 bits
+#define ADLER_NMAX 5552
+
+static uint32_t adler32(const uint8_t* p, size_t len) {
+  uint32_t a = 1, b = 0;
+  while (len > 0) {
+    size_t n = len < ADLER_NMAX ? len : ADLER_NMAX;
+    len -= n;
+    while (n--) {
+      a += *p++;
+      b += a;
+    }
+    a %= ADLER_MOD;
+    b %= ADLER_MOD;
+  }
+  return (b << 16) | a;
+}
+
+DeflateSink::DeflateSink()
+  : out_(0), pos_(0), end_(0), adlerA_(1), adlerB_(0), bitBuf_(0), bitCount_(0),
+    outLen_(0), bytesIn_(0), bytesOut_(0) {}
+
+void DeflateSink::begin(ByteSink& out, const char* dictionary, size_t dictLen) {
+  out_ = &out;
+  pos_ = 0;
+  end_ = 0;
+  adlerA_ = 1;
+  adlerB_ = 0;
+  bitBuf_ = 0;
+  bitCount_ = 0;
+  outLen_ = 0;
+  bytesIn_ = 0;
+  bytesOut_ = 0;
+  for (uint16_t i = 0; i < HASH_SIZE; i++) head_[i] = NIL;
+
+  // zlib header: deflate with our window size, optional dictionary id
+  uint8_t cmf = (uint8_t)(((DEFLATE_WINDOW_BITS - 8) << 4) | 8);
+  uint8_t flg = dictLen > 0 ? 0x20 : 0;
+  flg += 31 - ((cmf << 8) | flg) % 31;
+  putByte(cmf);
+  putByte(flg);
+
+  if (dictLen > 0) {
+    // The id covers the whole dictionary, as zlib's does
+    uint32_t id = adler32((const uint8_t*)dictionary, dictLen);
+    putByte((uint8_t)(id >> 24));
+    putByte((uint8_t)(id >> 16));
+    putByte((uint8_t)(id >> 8));
+    putByte((uint8_t)id);
+
+    if (dictLen > WINDOW) {
+      dictionary += dictLen - WINDOW;
+      dictLen = WINDOW;
+    }
+    memcpy(window_, dictionary, dictLen);
+    end_ = (uint16_t)dictLen;
+    for (uint16_t p = 0; p + MIN_MATCH <= end_; p++) insert(p);
+    pos_ = end_;
+  }
+
+  // BFINAL = 1, BTYPE = 01 (fixed Huffman codes)
+  putBits(1, 1);
+  putBits(1, 2);
+}
+
+void DeflateSink::write(const char* data, size_t len) {
+  if (!out_) return;
+  bytesIn_ += len;
+
+  while (len > 0) {
+    if (end_ == 2 * WINDOW) slide();
+    size_t n = 2 * WINDOW - end_;
+    if (n > len) n = len;
+
+    // Adler-32 of the uncompressed data, n is far below ADLER_NMAX
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < n; i++) {
+      adlerA_ += p[i];
+      adlerB_ += adlerA_;
+    }
+    adlerA_ %= ADLER_MOD;
+    adlerB_ %= ADLER_MOD;
+
+    memcpy(window_ + end_, data, n);
+    end_ += (uint16_t)n;
+    data += n;
+    len -= n;
+    compress(false);
+  }
+}
+
+void DeflateSink::finish() {
+  if (!out_) return;
+  compress(true);
+
+  putCode(0, 7);  // end of block (symbol 256)
+  if (bitCount_ > 0) putBits(0, 8 - bitCount_);
+
+  uint32_t adler = (adlerB_ << 16) | adlerA_;
+  putByte((uint8_t)(adler >> 24));
+  putByte((uint8_t)(adler >> 16));
+  putByte((uint8_t)(adler >> 8));
+  putByte((uint8_t)adler);
+  flushOut();
+  out_ = 0;
+}
+
+// Encodes everything but the lookahead, or all of it at the end
+void DeflateSink::compress(bool all) {
+  while (pos_ < end_ && (all || end_ - pos_ >= LOOKAHEAD)) {
+    uint16_t avail = end_ - pos_;
+    uint16_t bestLen = 0;
+    uint16_t bestDist = 0;
+
+    if (avail >= MIN_MATCH) {
+      uint16_t maxLen = avail < MAX_MATCH ? avail : (uint16_t)MAX_MATCH;
+      uint16_t cand = head_[hash(pos_)];
+      insert(pos_);
+
+      for (uint8_t chain = DEFLATE_MAX_CHAIN; cand != NIL && chain > 0; chain--) {
+        // Older slots of prev_ get reused, so stop at the window edge
+        if (pos_ - cand >= WINDOW) break;
+        const uint8_t* a = window_ + cand;
+        const uint8_t* b = window_ + pos_;
+        if (a[bestLen] == b[bestLen]) {
+          uint16_t n = 0;
+          while (n < maxLen && a[n] == b[n]) n++;
+          if (n > bestLen) {
+            bestLen = n;
+            bestDist = pos_ - cand;
+            if (n == maxLen) break;
+          }
+        }
+        uint16_t next = prev_[cand & (WINDOW - 1)];
+        if (next == NIL || next >= cand) break;
+        cand = next;
+      }
+    }
+
+    if (bestLen >= MIN_MATCH) {
+      match(bestLen, bestDist);
+      for (uint16_t i = 1; i < bestLen; i++) {
+        if (pos_ + i + MIN_MATCH <= end_) insert(pos_ + i);
+      }
+      pos_ += bestLen;
+    } else {
+      literal(window_[pos_]);
+      pos_++;
+    }
+  }
+}
+
+// Drops the oldest half of the window
+void DeflateSink::slide() {
+  memmove(window_, window_ + WINDOW, WINDOW);
+  pos_ -= WINDOW;
+  end_ -= WINDOW;
+  for (uint16_t i = 0; i < HASH_SIZE; i++) {
+    head_[i] = head_[i] != NIL && head_[i] >= WINDOW ? head_[i] - WINDOW : NIL;
+  }
+  for (uint16_t i = 0; i < WINDOW; i++) {
+    prev_[i] = prev_[i] != NIL && prev_[i] >= WINDOW ? prev_[i] - WINDOW : NIL;
+  }
+}
+
+void DeflateSink::insert(uint16_t pos) {
+  uint16_t h = hash(pos);
+  prev_[pos & (WINDOW - 1)] = head_[h];
+  head_[h] = pos;
+}
+
+uint16_t DeflateSink::hash(uint16_t pos) const {
+  uint32_t v = ((uint32_t)window_[pos] << 16) | ((uint32_t)window_[pos + 1] << 8) | window_[pos + 2];
+  return (uint16_t)((v * 2654435761u) >> (32 - DEFLATE_HASH_BITS));
+}
+
+// Fixed Huffman literal/length codes (RFC 1951 3.2.6)
+void DeflateSink::literal(uint8_t c) {
+  if (c < 144) putCode(0x30 + c, 8);
+  else putCode(0x190 + (c - 144), 9);
+}
+
+void DeflateSink::match(uint16_t len, uint16_t dist) {
+  uint8_t code = 28;
+  while (lengthBase[code] > len) code--;
+  uint16_t symbol = 257 + code;
+  if (symbol < 280) putCode(symbol - 256, 7);
+  else putCode(0xC0 + (symbol - 280), 8);
+  putBits(len - lengthBase[code], lengthExtra[code]);
+
+  uint8_t d = 29;
+  while (distBase[d] > dist) d--;
+  putCode(d, 5);
+  putBits(dist - distBase[d], distExtra[d]);
+}
+
+// Appends 'count' bits, least significant first
+void DeflateSink::putBits(uint32_t value, uint8_t count) {
+  bitBuf_ |= value << bitCount_;
+  bitCount_ += count;
+  while (bitCount_ >= 8) {
+    putByte((uint8_t)bitBuf_);
+    bitBuf_ >>= 8;
+    bitCount_ -= 8;
+  }
+}
+
+// Huffman codes are packed most significant bit first
+void DeflateSink::putCode(uint32_t code, uint8_t count) {
+  uint32_t reversed = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  putBits(reversed, count);
+}
+
+void DeflateSink::putByte(uint8_t b) {
+  outBuf_[outLen_++] = (char)b;
+  bytesOut_++;
+  if (outLen_ == sizeof(outBuf_)) flushOut();
+}
+
+void DeflateSink::flushOut() {
+  if (outLen_ > 0) out_->write(outBuf_, outLen_);
+  outLen_ = 0;
+}
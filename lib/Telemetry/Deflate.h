@@ -0,0 +1,92 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ByteSink.h"
+
+// Sliding window, log2 bytes. RAM use is about 5 x (1 << bits) bytes:
+// the window and its lookahead, plus the match chains.
+#ifndef DEFLATE_WINDOW_BITS
+#define DEFLATE_WINDOW_BITS 10
+#endif
+// Match candidates tried per position; more is slower and smaller
+#ifndef DEFLATE_MAX_CHAIN
+#define DEFLATE_MAX_CHAIN 16
+#endif
+#define DEFLATE_HASH_BITS 9
+
+// Streaming zlib (RFC 1950) compressor, usable as the body of an HTTP
+// request with "Content-Encoding: deflate".
+//
+// Output is a single block with the fixed Huffman codes of RFC 1951, so
+// there are no code tables to build or buffer: every byte written goes
+// through an LZ77 matcher over a small window and straight out to the
+// inner sink. The result is deterministic, which lets the caller size it
+// in a first pass and re-run it for each CIPSEND chunk.
+//
+// A preset dictionary (sample text shaped like the payload) primes the
+// window so even a one-record batch finds matches. The receiver needs the
+// same dictionary; its Adler-32 is sent in the zlib header.
+class DeflateSink : public ByteSink {
+  static_assert(DEFLATE_WINDOW_BITS >= 9 && DEFLATE_WINDOW_BITS <= 14,
+                "window must hold the lookahead and fit 16 bit positions");
+
+public:
+  DeflateSink();
+
+  // Starts a new stream into 'out'; only the last window of the
+  // dictionary is used
+  void begin(ByteSink& out, const char* dictionary = 0, size_t dictLen = 0);
+
+  void write(const char* data, size_t len) override;
+  using ByteSink::write;
+
+  // Compresses what is still buffered and ends the stream
+  void finish();
+
+  bool full() const override { return out_ && out_->full(); }
+
+  size_t bytesIn() const { return bytesIn_; }
+  size_t bytesOut() const { return bytesOut_; }
+
+private:
+  enum {
+    WINDOW = 1 << DEFLATE_WINDOW_BITS,
+    HASH_SIZE = 1 << DEFLATE_HASH_BITS,
+    MIN_MATCH = 3,
+    MAX_MATCH = 258,
+    // Bytes kept ahead of the encoder so the longest match always fits
+    LOOKAHEAD = MAX_MATCH + MIN_MATCH + 1,
+    NIL = 0xFFFF
+  };
+
+  void compress(bool all);
+  void slide();
+  void insert(uint16_t pos);
+  uint16_t hash(uint16_t pos) const;
+  void literal(uint8_t c);
+  void match(uint16_t len, uint16_t dist);
+  void putBits(uint32_t value, uint8_t count);
+  void putCode(uint32_t code, uint8_t count);
+  void putByte(uint8_t b);
+  void flushOut();
+
+  ByteSink* out_;
+  uint8_t window_[2 * WINDOW];
+  uint16_t head_[HASH_SIZE];
+  uint16_t prev_[WINDOW];
+  uint16_t pos_;     // next byte to encode
+  uint16_t end_;     // bytes held in window_
+
+  uint32_t adlerA_;
+  uint32_t adlerB_;
+  uint32_t bitBuf_;
+  uint8_t bitCount_;
+  char outBuf_[32];
+  uint8_t outLen_;
+  size_t bytesIn_;
+  size_t bytesOut_;
+};
+
+#endif
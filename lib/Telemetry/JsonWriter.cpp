@@ -0,0 +1,94 @@
+#include "JsonWriter.h"
+
+static const int32_t kPow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+// Writes the decimal digits of v into the end of buf; returns the start
+static char* formatUint(uint32_t v, char* end) {
+  char* p = end;
+  do {
+    *--p = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  return p;
+}
+
+void JsonWriter::key(const char* name) {
+  sink_.write("\"", 1);
+  sink_.write(name);
+  sink_.write("\":", 2);
+}
+
+void JsonWriter::string(const char* s) {
+  sink_.write("\"", 1);
+  const char* run = s;
+  for (; *s; s++) {
+    char c = *s;
+    if (c != '"' && c != '\\' && (unsigned char)c >= 0x20) continue;
+    sink_.write(run, s - run);
+    // Control characters have no business in our fields and are dropped
+    if (c == '"' || c == '\\') {
+      char esc[2] = { '\\', c };
+      sink_.write(esc, 2);
+    }
+    run = s + 1;
+  }
+  sink_.write(run, s - run);
+  sink_.write("\"", 1);
+}
+
+void JsonWriter::uint(uint32_t v) {
+  char buf[10];
+  char* p = formatUint(v, buf + sizeof(buf));
+  sink_.write(p, buf + sizeof(buf) - p);
+}
+
+void JsonWriter::integer(int32_t v) {
+  if (v < 0) {
+    sink_.write("-", 1);
+    uint((uint32_t)0 - (uint32_t)v);
+  } else {
+    uint((uint32_t)v);
+  }
+}
+
+void JsonWriter::fixed(int32_t scaled, uint8_t decimals) {
+  if (decimals == 0) {
+    integer(scaled);
+    return;
+  }
+  if (decimals > 7) decimals = 7;
+
+  uint32_t mag = scaled < 0 ? (uint32_t)0 - (uint32_t)scaled : (uint32_t)scaled;
+  uint32_t whole = mag / (uint32_t)kPow10[decimals];
+  uint32_t frac = mag % (uint32_t)kPow10[decimals];
+
+  char buf[20];
+  char* end = buf + sizeof(buf);
+  char* p = end;
+  for (uint8_t i = 0; i < decimals; i++) {
+    *--p = (char)('0' + frac % 10);
+    frac /= 10;
+  }
+  *--p = '.';
+  p = formatUint(whole, p);
+  if (scaled < 0) *--p = '-';
+  sink_.write(p, end - p);
+}
+
+void JsonWriter::fixedFromFloat(float v, uint8_t decimals) {
+  if (decimals > 7) decimals = 7;
+  fixed(scaleToFixed(v, decimals), decimals);
+}
+
+int32_t scaleToFixed(float v, uint8_t decimals) {
+  if (decimals > 7) decimals = 7;
+  // Double keeps 1e-6 degree resolution for +/-180 degree values
+  double scaled = (double)v * kPow10[decimals];
+  return (int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
+
+int32_t dropDecimals(int32_t scaled, uint8_t digits) {
+  if (digits > 7) digits = 7;
+  int64_t v = scaled, d = kPow10[digits];
+  return (int32_t)(v >= 0 ? (v + d / 2) / d : -((-v + d / 2) / d));
+}
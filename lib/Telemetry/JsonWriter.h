@@ -0,0 +1,38 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include "ByteSink.h"
+
+// Minimal allocation-free JSON emitter. Numbers are formatted with integer
+// arithmetic only; fractional values are passed pre-scaled (fixed point).
+class JsonWriter {
+public:
+  explicit JsonWriter(ByteSink& sink) : sink_(sink) {}
+
+  void raw(const char* s) { sink_.write(s); }
+  void raw(const char* s, size_t len) { sink_.write(s, len); }
+
+  void key(const char* name);            // "name":
+  void string(const char* s);            // "escaped"
+  void uint(uint32_t v);
+  void integer(int32_t v);
+
+  // Writes scaled / 10^decimals, e.g. fixed(-3712345, 6) -> -3.712345
+  void fixed(int32_t scaled, uint8_t decimals);
+
+  // Rounds a float to 'decimals' places and writes it via fixed()
+  void fixedFromFloat(float v, uint8_t decimals);
+
+private:
+  ByteSink& sink_;
+};
+
+// Converts v to an integer scaled by 10^decimals, rounding half away from zero
+int32_t scaleToFixed(float v, uint8_t decimals);
+
+// Drops 'digits' decimals from a fixed-point value, rounding half away
+// from zero, e.g. dropDecimals(-69270795, 1) -> -6927080
+int32_t dropDecimals(int32_t scaled, uint8_t digits);
+
+#endif
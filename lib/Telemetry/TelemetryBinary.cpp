@@ -0,0 +1,213 @@
+#include "TelemetryBinary.h"
+#include "JsonWriter.h"
+
+#include <string.h>
+
+static uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static void writeVarint(ByteSink& sink, uint32_t v) {
+  char buf[5];
+  size_t n = 0;
+  while (v >= 0x80) {
+    buf[n++] = (char)(v | 0x80);
+    v >>= 7;
+  }
+  buf[n++] = (char)v;
+  sink.write(buf, n);
+}
+
+static void writeDelta(ByteSink& sink, uint32_t value, uint32_t prev) {
+  writeVarint(sink, zigzag((int32_t)(value - prev)));
+}
+
+void writeTelemetryBinary(ByteSink& sink, const TelemetryBatch& batch) {
+  size_t idLen = strlen(batch.deviceId);
+  if (idLen > 32) idLen = 32;
+
+  char header[4] = { 'G', 'T', (char)TBIN_VERSION, (char)idLen };
+  sink.write(header, 4);
+  sink.write(batch.deviceId, idLen);
+  writeVarint(sink, (uint32_t)batch.count);
+
+  uint32_t prevSeq = 0, prevTs = 0, prevUtc = 0;
+  int32_t prevLat = 0, prevLng = 0, prevAlt = 0;
+  TelemetryRecord r;
+  for (size_t i = 0; i < batch.slots; i++) {
+    if (sink.full()) return;
+    if (!batch.source(i, r, batch.ctx)) continue;
+
+    uint8_t flags = r.flags & (TBIN_FLAG_UTC | TBIN_FLAG_CACHED | TBIN_FLAG_ESTIMATED | TBIN_FLAG_FENCE);
+    if (r.seq) flags |= TBIN_FLAG_SEQ;
+
+    int32_t lat = dropDecimals(r.lat_e7, 1);
+    int32_t lng = dropDecimals(r.lng_e7, 1);
+    int32_t alt = r.alt_dm;
+
+    char f = (char)flags;
+    sink.write(&f, 1);
+    if (flags & TBIN_FLAG_SEQ) {
+      writeDelta(sink, r.seq, prevSeq);
+      prevSeq = r.seq;
+    }
+    writeDelta(sink, r.ts, prevTs);
+    if (flags & TBIN_FLAG_UTC) {
+      writeDelta(sink, r.utc, prevUtc);
+      prevUtc = r.utc;
+    }
+    writeDelta(sink, (uint32_t)lat, (uint32_t)prevLat);
+    writeDelta(sink, (uint32_t)lng, (uint32_t)prevLng);
+    writeVarint(sink, r.speed_e2);
+    writeDelta(sink, (uint32_t)alt, (uint32_t)prevAlt);
+    writeVarint(sink, r.satellites > 0 ? (uint32_t)r.satellites : 0);
+
+    prevTs = r.ts;
+    prevLat = lat;
+    prevLng = lng;
+    prevAlt = alt;
+  }
+
+  // Counted up front so the decoder knows where the block ends
+  TelemetryStat stat;
+  uint32_t stats = 0;
+  while (batch.stats && batch.stats(stats, stat, batch.statsCtx)) stats++;
+  writeVarint(sink, stats);
+  for (uint32_t i = 0; i < stats; i++) {
+    batch.stats(i, stat, batch.statsCtx);
+    size_t keyLen = strlen(stat.key);
+    if (keyLen > 32) keyLen = 32;
+    char len = (char)keyLen;
+    sink.write(&len, 1);
+    sink.write(stat.key, keyLen);
+    writeVarint(sink, stat.value);
+  }
+}
+
+size_t telemetryBinaryLength(const TelemetryBatch& batch) {
+  CountingSink counter;
+  writeTelemetryBinary(counter, batch);
+  return counter.count();
+}
+
+TelemetryDecoder::TelemetryDecoder()
+  : p_(0), end_(0), version_(0), count_(0), decoded_(0), statsLeft_(0),
+    statsStarted_(false), error_(false) {
+  deviceId_[0] = '\0';
+  memset(&prev_, 0, sizeof(prev_));
+}
+
+bool TelemetryDecoder::readVarint(uint32_t& v) {
+  v = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (p_ >= end_) return false;
+    uint8_t b = *p_++;
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+bool TelemetryDecoder::readSigned(int32_t& v) {
+  uint32_t raw;
+  if (!readVarint(raw)) return false;
+  v = unzigzag(raw);
+  return true;
+}
+
+bool TelemetryDecoder::begin(const uint8_t* data, size_t len) {
+  p_ = data;
+  end_ = data + len;
+  decoded_ = 0;
+  statsLeft_ = 0;
+  statsStarted_ = false;
+  error_ = true;
+  memset(&prev_, 0, sizeof(prev_));
+
+  if (len < 4 || data[0] != 'G' || data[1] != 'T') return false;
+  if (data[2] < 1 || data[2] > TBIN_VERSION) return false;
+  version_ = data[2];
+  uint8_t idLen = data[3];
+  if (idLen > 32 || len < 4u + idLen) return false;
+  memcpy(deviceId_, data + 4, idLen);
+  deviceId_[idLen] = '\0';
+  p_ = data + 4 + idLen;
+
+  if (!readVarint(count_)) return false;
+  error_ = false;
+  return true;
+}
+
+bool TelemetryDecoder::next(DecodedRecord& out) {
+  if (error_ || decoded_ >= count_) return false;
+  error_ = true;  // cleared again once the record is complete
+
+  if (p_ >= end_) return false;
+  out.flags = *p_++;
+
+  int32_t d;
+  uint32_t u;
+  out.seq = 0;
+  if (out.flags & TBIN_FLAG_SEQ) {
+    if (!readSigned(d)) return false;
+    out.seq = prev_.seq + (uint32_t)d;
+  }
+
+  if (!readSigned(d)) return false;
+  out.ts = prev_.ts + (uint32_t)d;
+
+  out.utc = 0;
+  if (out.flags & TBIN_FLAG_UTC) {
+    if (!readSigned(d)) return false;
+    out.utc = prev_.utc + (uint32_t)d;
+  }
+
+  if (!readSigned(d)) return false;
+  out.lat_e6 = (int32_t)((uint32_t)prev_.lat_e6 + (uint32_t)d);
+  if (!readSigned(d)) return false;
+  out.lng_e6 = (int32_t)((uint32_t)prev_.lng_e6 + (uint32_t)d);
+  if (!readVarint(out.speed_e2)) return false;
+  if (!readSigned(d)) return false;
+  out.alt_e1 = (int32_t)((uint32_t)prev_.alt_e1 + (uint32_t)d);
+  if (!readVarint(u)) return false;
+  out.satellites = (uint8_t)u;
+
+  // UTC and seq deltas chain only through records that carry them
+  uint32_t lastUtc = prev_.utc;
+  uint32_t lastSeq = prev_.seq;
+  prev_ = out;
+  if (!(out.flags & TBIN_FLAG_UTC)) prev_.utc = lastUtc;
+  if (!(out.flags & TBIN_FLAG_SEQ)) prev_.seq = lastSeq;
+
+  decoded_++;
+  error_ = false;
+  return true;
+}
+
+bool TelemetryDecoder::nextStat(DecodedStat& out) {
+  if (error_ || decoded_ < count_ || version_ < 3) return false;
+  if (!statsStarted_) {
+    statsStarted_ = true;
+    error_ = true;
+    if (!readVarint(statsLeft_)) return false;
+    error_ = false;
+  }
+  if (statsLeft_ == 0) return false;
+  error_ = true;  // cleared again once the entry is complete
+
+  if (p_ >= end_) return false;
+  uint8_t keyLen = *p_++;
+  if (keyLen > 32 || (size_t)(end_ - p_) < keyLen) return false;
+  memcpy(out.key, p_, keyLen);
+  out.key[keyLen] = '\0';
+  p_ += keyLen;
+  if (!readVarint(out.value)) return false;
+
+  statsLeft_--;
+  error_ = false;
+  return true;
+}
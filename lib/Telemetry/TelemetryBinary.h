@@ -0,0 +1,108 @@
+#ifndef TELEMETRY_BINARY_H
+#define TELEMETRY_BINARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ByteSink.h"
+#include "TelemetryJson.h"
+
+// Compact binary alternative to the JSON upload document.
+//
+// Layout (all integers are LEB128 varints; deltas are zigzag encoded):
+//
+//   header:  'G' 'T' version(1 byte)
+//            device_id length (1 byte, max 32) + device_id bytes
+//            record count
+//   record:  flags (1 byte, TBIN_FLAG_*)
+//            seq       only with TBIN_FLAG_SEQ; store sequence number,
+//                      delta to the previous record that carried one
+//            ts        millis, delta to the previous record
+//            utc       only with TBIN_FLAG_UTC; epoch seconds, delta to the
+//                      previous record that carried one
+//            lat, lng  1e-6 degrees, delta to the previous record
+//            speed     1e-2 km/h, absolute
+//            alt       1e-1 m, delta to the previous record
+//            sats      absolute
+//   stats:   (version 3) entry count, then per entry: key length (1 byte,
+//            max 32) + key bytes, value
+//
+// Deltas of the first record are taken against zero, i.e. they are the
+// absolute values. Delta arithmetic wraps modulo 2^32 on both sides.
+//
+// A typical moving-vehicle record takes 12-16 bytes instead of ~110.
+
+// Version 2 added TBIN_FLAG_SEQ, version 3 the stats block; older
+// documents are still decoded
+#define TBIN_VERSION 3
+#define TBIN_CONTENT_TYPE "application/x-gps-telemetry"
+
+// The reading's own flags go out unchanged (see TELEMETRY_FLAG_*)
+#define TBIN_FLAG_UTC     TELEMETRY_FLAG_UTC        // record carries a GPS UTC time
+#define TBIN_FLAG_CACHED  TELEMETRY_FLAG_CACHED     // position repeated from the last known fix
+#define TBIN_FLAG_SEQ     0x04                      // record carries a sequence number
+#define TBIN_FLAG_ESTIMATED TELEMETRY_FLAG_ESTIMATED  // position dead-reckoned, not measured
+#define TBIN_FLAG_FENCE   TELEMETRY_FLAG_FENCE      // reading taken at a geofence crossing
+
+// Writes the batch in binary form straight to the sink
+void writeTelemetryBinary(ByteSink& sink, const TelemetryBatch& batch);
+
+// Sizing pass for writeTelemetryBinary()
+size_t telemetryBinaryLength(const TelemetryBatch& batch);
+
+// One record as recovered by the decoder
+struct DecodedRecord {
+  uint8_t flags;
+  uint32_t seq;          // valid if flags & TBIN_FLAG_SEQ
+  uint32_t ts;
+  uint32_t utc;          // valid if flags & TBIN_FLAG_UTC
+  int32_t lat_e6;
+  int32_t lng_e6;
+  uint32_t speed_e2;
+  int32_t alt_e1;
+  uint8_t satellites;
+};
+
+// One stats entry as recovered by the decoder
+struct DecodedStat {
+  char key[33];
+  uint32_t value;
+};
+
+// Reference decoder. Runs anywhere (device or host); keeps only the
+// previous record as state.
+class TelemetryDecoder {
+public:
+  TelemetryDecoder();
+
+  // Parses the header; false if the buffer is not a valid document
+  bool begin(const uint8_t* data, size_t len);
+
+  // Decodes the next record; false at the end or on malformed input
+  bool next(DecodedRecord& out);
+
+  // Once every record is decoded: the next stats entry; false at the end
+  // (always for documents older than version 3) or on malformed input
+  bool nextStat(DecodedStat& out);
+
+  const char* deviceId() const { return deviceId_; }
+  uint32_t count() const { return count_; }
+  uint32_t remaining() const { return count_ - decoded_; }
+  bool error() const { return error_; }
+
+private:
+  bool readVarint(uint32_t& v);
+  bool readSigned(int32_t& v);
+
+  const uint8_t* p_;
+  const uint8_t* end_;
+  char deviceId_[33];
+  uint8_t version_;
+  uint32_t count_;
+  uint32_t decoded_;
+  uint32_t statsLeft_;
+  bool statsStarted_;
+  bool error_;
+  DecodedRecord prev_;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "TelemetryJson.h"
+#include "JsonWriter.h"
+
+#include <string.h>
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  uint32_t yoe = (uint32_t)(y - era * 400);
+  uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+uint32_t makeEpoch(uint16_t year, uint8_t month, uint8_t day,
+                   uint8_t hour, uint8_t minute, uint8_t second) {
+  return (uint32_t)daysFromCivil(year, month, day) * 86400u +
+         hour * 3600u + minute * 60u + second;
+}
+
+void formatDatetime(uint32_t epoch, char* out) {
+  // Inverse of daysFromCivil()
+  int32_t z = (int32_t)(epoch / 86400u) + 719468;
+  uint32_t secs = epoch % 86400u;
+  int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  uint32_t doe = (uint32_t)(z - era * 146097);
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int32_t y = (int32_t)yoe + era * 400;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  uint32_t d = doy - (153 * mp + 2) / 5 + 1;
+  uint32_t m = mp < 10 ? mp + 3 : mp - 9;
+  y += m <= 2;
+
+  uint32_t f[6] = { (uint32_t)y, m, d, secs / 3600, secs / 60 % 60, secs % 60 };
+  static const uint8_t widths[6] = { 4, 2, 2, 2, 2, 2 };
+  static const char seps[6] = { '-', '-', ' ', ':', ':', '\0' };
+  char* p = out;
+  for (uint8_t i = 0; i < 6; i++) {
+    for (int8_t k = widths[i] - 1; k >= 0; k--) {
+      p[k] = (char)('0' + f[i] % 10);
+      f[i] /= 10;
+    }
+    p += widths[i];
+    *p++ = seps[i];
+  }
+}
+
+// The "datetime" text for a reading
+static void writeDatetime(JsonWriter& json, const TelemetryRecord& r) {
+  if (!(r.flags & TELEMETRY_FLAG_UTC)) {
+    json.string("N/A");
+    return;
+  }
+  char datetime[32];
+  formatDatetime(r.utc, datetime);
+  if (r.flags & TELEMETRY_FLAG_CACHED) strcat(datetime, " (cached)");
+  else if (r.flags & TELEMETRY_FLAG_ESTIMATED) strcat(datetime, " (estimated)");
+  else if (r.flags & TELEMETRY_FLAG_FENCE) strcat(datetime, " (fence)");
+  json.string(datetime);
+}
+
+void writeTelemetryJson(ByteSink& sink, const TelemetryBatch& batch) {
+  JsonWriter json(sink);
+
+  json.raw("{");
+  json.key("device_id");
+  json.string(batch.deviceId);
+  json.raw(",");
+  json.key("count");
+  json.uint((uint32_t)batch.count);
+  json.raw(",");
+  json.key("readings");
+  json.raw("[");
+
+  bool first = true;
+  TelemetryRecord r;
+  for (size_t i = 0; i < batch.slots; i++) {
+    if (sink.full()) return;
+    if (!batch.source(i, r, batch.ctx)) continue;
+    if (!first) json.raw(",");
+
+    json.raw("{");
+    if (r.seq) {
+      json.key("seq");
+      json.uint(r.seq);
+      json.raw(",");
+    }
+    json.key("datetime");
+    writeDatetime(json, r);
+    json.raw(",");
+    json.key("ts");
+    json.uint(r.ts);
+    json.raw(",");
+    json.key("lat");
+    json.fixed(dropDecimals(r.lat_e7, 1), 6);
+    json.raw(",");
+    json.key("lng");
+    json.fixed(dropDecimals(r.lng_e7, 1), 6);
+    json.raw(",");
+    json.key("spd");
+    json.fixed((int32_t)r.speed_e2, 2);
+    json.raw(",");
+    json.key("alt");
+    json.fixed(r.alt_dm, 1);
+    json.raw(",");
+    json.key("sat");
+    json.integer(r.satellites);
+    json.raw("}");
+
+    first = false;
+  }
+  json.raw("]");
+
+  TelemetryStat stat;
+  size_t stats = 0;
+  while (batch.stats && batch.stats(stats, stat, batch.statsCtx)) {
+    json.raw(stats == 0 ? ",\"stats\":{" : ",");
+    json.key(stat.key);
+    json.uint(stat.value);
+    stats++;
+  }
+  json.raw(stats > 0 ? "}}" : "}");
+}
+
+size_t telemetryJsonLength(const TelemetryBatch& batch) {
+  CountingSink counter;
+  writeTelemetryJson(counter, batch);
+  return counter.count();
+}
+
+// The server has to decompress with exactly these bytes; change them only
+// together with tools/ingest_server.py
+const char telemetryJsonDictionary[] =
+  "{\"device_id\":\"ESP_GPS_001\",\"count\":60,\"readings\":["
+  "{\"seq\":1000,\"datetime\":\"N/A\",\"ts\":0,\"lat\":0.000000,\"lng\":0.000000,"
+  "\"spd\":0.00,\"alt\":0.0,\"sat\":0},"
+  "{\"seq\":1001,\"datetime\":\"2026-01-01 00:00:00 (cached)\",\"ts\":10000,"
+  "\"lat\":-6.900000,\"lng\":79.800000,\"spd\":0.00,\"alt\":10.0,\"sat\":0},"
+  "{\"seq\":1002,\"datetime\":\"2026-01-01 00:00:10\",\"ts\":20000,"
+  "\"lat\":-6.927079,\"lng\":79.861244,\"spd\":12.34,\"alt\":7.5,\"sat\":8},";
+const size_t telemetryJsonDictionaryLength = sizeof(telemetryJsonDictionary) - 1;
+
+void writeHttpPostHeader(ByteSink& sink, const char* host, const char* path,
+                         const char* contentType, size_t contentLength,
+                         const char* contentEncoding) {
+  JsonWriter out(sink);  // only used for its integer formatting
+  sink.write("POST ");
+  sink.write(path);
+  sink.write(" HTTP/1.1\r\nHost: ");
+  sink.write(host);
+  sink.write("\r\nConnection: keep-alive\r\nContent-Type: ");
+  sink.write(contentType);
+  if (contentEncoding) {
+    sink.write("\r\nContent-Encoding: ");
+    sink.write(contentEncoding);
+  }
+  sink.write("\r\nContent-Length: ");
+  out.uint((uint32_t)contentLength);
+  sink.write("\r\n\r\n");
+}
+
+void writeHttpGetHeader(ByteSink& sink, const char* host, const char* path) {
+  sink.write("GET ");
+  sink.write(path);
+  sink.write(" HTTP/1.1\r\nHost: ");
+  sink.write(host);
+  sink.write("\r\nConnection: keep-alive\r\n\r\n");
+}
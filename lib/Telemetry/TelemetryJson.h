@@ -0,0 +1,85 @@
+#ifndef TELEMETRY_JSON_H
+#define TELEMETRY_JSON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ByteSink.h"
+
+// What is known about a reading besides its position. The binary format
+// sends these bits as they are; the JSON one turns them into the
+// "datetime" text.
+#define TELEMETRY_FLAG_UTC        0x01  // 'utc' holds the GPS time of the reading
+#define TELEMETRY_FLAG_CACHED     0x02  // position repeated from the last known fix
+#define TELEMETRY_FLAG_ESTIMATED  0x08  // position dead-reckoned, not measured
+#define TELEMETRY_FLAG_FENCE      0x10  // taken at a geofence crossing
+
+// One reading as it appears in the upload document
+struct TelemetryRecord {
+  uint32_t seq;           // store sequence number, 0 if the reading has none
+  uint32_t ts;
+  uint32_t utc;           // seconds since 1970, if TELEMETRY_FLAG_UTC
+  uint8_t flags;          // TELEMETRY_FLAG_*
+  int32_t lat_e7;         // degrees * 1e7
+  int32_t lng_e7;
+  uint32_t speed_e2;      // km/h * 100
+  int32_t alt_dm;         // metres above mean sea level * 10
+  int satellites;
+};
+
+// Fills 'out' with the reading in slot 'index'; returns false to skip it.
+typedef bool (*TelemetrySource)(size_t index, TelemetryRecord& out, void* ctx);
+
+// A device counter or timing figure sent along with a batch
+struct TelemetryStat {
+  const char* key;        // at most 32 characters
+  uint32_t value;
+};
+
+// Fills 'out' with stat 'index'; returns false past the last one. Must
+// yield the same values on every call for the same batch.
+typedef bool (*TelemetryStatsSource)(size_t index, TelemetryStat& out, void* ctx);
+
+struct TelemetryBatch {
+  const char* deviceId;
+  size_t slots;           // number of slots the source is asked for
+  size_t count;           // number of slots it will accept (the "count" field)
+  TelemetrySource source;
+  void* ctx;
+  TelemetryStatsSource stats;  // optional
+  void* statsCtx;
+};
+
+// Writes {"device_id":..,"count":..,"readings":[..]} straight to the sink.
+// Readings with a sequence number carry it as "seq", so the server can
+// drop retransmitted ones and acknowledge the highest it has stored.
+// "datetime" is "YYYY-MM-DD HH:MM:SS", followed by " (cached)",
+// " (estimated)" or " (fence)" if the flags say so, or "N/A" without a
+// GPS time. Positions go out with 6 decimals, speed with 2 and altitude
+// with 1. Batches with a stats source add "stats":{"key":value,..}.
+void writeTelemetryJson(ByteSink& sink, const TelemetryBatch& batch);
+
+// Sizing pass: the exact number of bytes writeTelemetryJson() will emit
+size_t telemetryJsonLength(const TelemetryBatch& batch);
+
+// UTC calendar date and time to seconds since 1970
+uint32_t makeEpoch(uint16_t year, uint8_t month, uint8_t day,
+                   uint8_t hour, uint8_t minute, uint8_t second);
+
+// Seconds since 1970 to "YYYY-MM-DD HH:MM:SS"; 'out' must hold 20 bytes
+void formatDatetime(uint32_t epoch, char* out);
+
+// Preset dictionary for compressing the document (see DeflateSink): a
+// short sample with the keys and typical values in the order they appear
+extern const char telemetryJsonDictionary[];
+extern const size_t telemetryJsonDictionaryLength;
+
+// Writes the POST request line and headers, up to and including the blank
+// line. A Content-Encoding header is only added if 'contentEncoding' is set.
+void writeHttpPostHeader(ByteSink& sink, const char* host, const char* path,
+                         const char* contentType, size_t contentLength,
+                         const char* contentEncoding = 0);
+
+// Writes a GET request line and headers, up to and including the blank line
+void writeHttpGetHeader(ByteSink& sink, const char* host, const char* path);
+
+#endif
@@ -0,0 +1,205 @@
+#include "TrackFilter.h"
+
+#include <math.h>
+#include <Geo.h>
+
+// Accuracy assumed when the receiver reports none
+#define DEFAULT_ACCURACY_M 5.0f
+// Below this speed the course is noise; the filter's heading is kept
+#define COURSE_MIN_SPEED_MPS 0.5f
+// The origin follows the vehicle so float positions stay precise
+#define REANCHOR_M 5000.0f
+
+#define DEG_TO_RAD 0.017453293f
+#define RAD_TO_DEG 57.29578f
+
+static float accuracyOf(const FilterFix& in) {
+  return in.accuracy_mm > 0 ? in.accuracy_mm / 1000.0f : DEFAULT_ACCURACY_M;
+}
+
+// East and north velocity from speed and course, m/s
+static void velocityOf(const FilterFix& in, float& ve, float& vn) {
+  float speed = in.speed_e1 / 36.0f;
+  float course = in.course_e1 * (DEG_TO_RAD / 10);
+  ve = speed * sinf(course);
+  vn = speed * cosf(course);
+}
+
+TrackFilter::TrackFilter(const TrackFilterConfig& config)
+  : config_(config), started_(false), lat0_e7_(0), lng0_e7_(0), mPerE7Lng_(GEO_M_PER_E7),
+    lastMs_(0), accepted_(0), rejected_(0), restarts_(0) {}
+
+TrackFilterConfig TrackFilter::defaults() {
+  TrackFilterConfig c;
+  c.accelNoise = 3.0f;       // brisk city driving
+  c.speedNoise = 0.6f;
+  c.maxSpeedMps = 70.0f;     // 250 km/h
+  c.maxAccuracyM = 60.0f;
+  c.gate = 25.0f;            // 5 sigma
+  c.minSatellites = 4;
+  c.restartMs = 5000;
+  c.maxPredictMs = 30000;
+  return c;
+}
+
+void TrackFilter::toLocal(int32_t lat_e7, int32_t lng_e7, float& east, float& north) const {
+  north = (float)(lat_e7 - lat0_e7_) * GEO_M_PER_E7;
+  east = (float)(lng_e7 - lng0_e7_) * mPerE7Lng_;
+}
+
+void TrackFilter::toFix(float east, float north, float ve, float vn, uint32_t ms,
+                        FilterFix& out) const {
+  out.ms = ms;
+  out.lat_e7 = lat0_e7_ + (int32_t)lroundf(north / GEO_M_PER_E7);
+  out.lng_e7 = lng0_e7_ + (int32_t)lroundf(east / mPerE7Lng_);
+  float speed = sqrtf(ve * ve + vn * vn);
+  float speed_e1 = speed * 36.0f + 0.5f;
+  out.speed_e1 = speed_e1 < 65535 ? (uint16_t)speed_e1 : 65535;
+  if (speed >= COURSE_MIN_SPEED_MPS) {
+    int32_t course = (int32_t)lroundf(atan2f(ve, vn) * (RAD_TO_DEG * 10));
+    out.course_e1 = (uint16_t)((course + 3600) % 3600);
+  } else {
+    out.course_e1 = last_.course_e1;
+  }
+}
+
+void TrackFilter::start(const FilterFix& in, FilterFix& out) {
+  lat0_e7_ = in.lat_e7;
+  lng0_e7_ = in.lng_e7;
+  mPerE7Lng_ = GEO_M_PER_E7 * cosf(in.lat_e7 * 1e-7f * DEG_TO_RAD);
+
+  float accuracy = accuracyOf(in);
+  float rv = config_.speedNoise * config_.speedNoise;
+  east_.p = 0;
+  north_.p = 0;
+  velocityOf(in, east_.v, north_.v);
+  east_.pp = north_.pp = accuracy * accuracy;
+  east_.pv = north_.pv = 0;
+  east_.vv = north_.vv = rv;
+
+  started_ = true;
+  lastMs_ = in.ms;
+  out = in;
+  last_ = out;
+}
+
+void TrackFilter::predictAxis(Axis& a, float dt) const {
+  // Discrete white-noise acceleration
+  float q = config_.accelNoise * config_.accelNoise;
+  float dt2 = dt * dt;
+  a.p += a.v * dt;
+  a.pp += dt * (2 * a.pv + dt * a.vv) + q * dt2 * dt2 * 0.25f;
+  a.pv += dt * a.vv + q * dt2 * dt * 0.5f;
+  a.vv += q * dt2;
+}
+
+void TrackFilter::updatePosition(Axis& a, float z, float r) {
+  float s = a.pp + r;
+  float k0 = a.pp / s;
+  float k1 = a.pv / s;
+  float y = z - a.p;
+  a.p += k0 * y;
+  a.v += k1 * y;
+  a.vv -= k1 * a.pv;
+  a.pv -= k0 * a.pv;
+  a.pp -= k0 * a.pp;
+}
+
+void TrackFilter::updateVelocity(Axis& a, float z, float r) {
+  float s = a.vv + r;
+  float k0 = a.pv / s;
+  float k1 = a.vv / s;
+  float y = z - a.v;
+  a.p += k0 * y;
+  a.v += k1 * y;
+  a.pp -= k0 * a.pv;
+  a.pv -= k1 * a.pv;
+  a.vv -= k1 * a.vv;
+}
+
+FilterResult TrackFilter::update(const FilterFix& in, FilterFix& out) {
+  if (in.accuracy_mm > config_.maxAccuracyM * 1000) {
+    rejected_++;
+    return FILTER_REJECTED;
+  }
+  if (!started_ || in.ms - lastMs_ > config_.maxPredictMs) {
+    if (started_) restarts_++;
+    start(in, out);
+    accepted_++;
+    return FILTER_STARTED;
+  }
+
+  float dt = (in.ms - lastMs_) / 1000.0f;
+  float accuracy = accuracyOf(in);
+  float r = accuracy * accuracy;
+  float rv = config_.speedNoise * config_.speedNoise;
+  if (in.satellites < config_.minSatellites) {
+    r *= 4;
+    rv *= 4;
+  }
+
+  float ze, zn;
+  toLocal(in.lat_e7, in.lng_e7, ze, zn);
+  Axis e = east_;
+  Axis n = north_;
+  predictAxis(e, dt);
+  predictAxis(n, dt);
+
+  // Further from the last position than any vehicle could have gone, or
+  // further from the prediction than the uncertainty allows
+  float de = ze - east_.p;
+  float dn = zn - north_.p;
+  float reach = config_.maxSpeedMps * dt + 3 * accuracy;
+  float ye = ze - e.p;
+  float yn = zn - n.p;
+  float d2 = ye * ye / (e.pp + r) + yn * yn / (n.pp + r);
+  if (de * de + dn * dn > reach * reach || d2 > config_.gate) {
+    rejected_++;
+    if (in.ms - lastMs_ < config_.restartMs) return FILTER_REJECTED;
+    // Everything has been off for a while: the filter is the one that is wrong
+    restarts_++;
+    start(in, out);
+    return FILTER_STARTED;
+  }
+
+  float ve, vn;
+  velocityOf(in, ve, vn);
+  updatePosition(e, ze, r);
+  updatePosition(n, zn, r);
+  updateVelocity(e, ve, rv);
+  updateVelocity(n, vn, rv);
+  east_ = e;
+  north_ = n;
+  lastMs_ = in.ms;
+  accepted_++;
+
+  toFix(east_.p, north_.p, east_.v, north_.v, in.ms, out);
+  out.accuracy_mm = (uint32_t)(sqrtf(east_.pp > north_.pp ? east_.pp : north_.pp) * 1000 + 0.5f);
+  out.satellites = in.satellites;
+  last_ = out;
+
+  if (fabsf(east_.p) > REANCHOR_M || fabsf(north_.p) > REANCHOR_M) {
+    lat0_e7_ = out.lat_e7;
+    lng0_e7_ = out.lng_e7;
+    mPerE7Lng_ = GEO_M_PER_E7 * cosf(out.lat_e7 * 1e-7f * DEG_TO_RAD);
+    east_.p = 0;
+    north_.p = 0;
+  }
+  return FILTER_ACCEPTED;
+}
+
+bool TrackFilter::predict(uint32_t ms, FilterFix& out) const {
+  if (!started_) return false;
+  int32_t elapsed = (int32_t)(ms - lastMs_);
+  if (elapsed < 0 || (uint32_t)elapsed > config_.maxPredictMs) return false;
+
+  float dt = elapsed / 1000.0f;
+  Axis e = east_;
+  Axis n = north_;
+  predictAxis(e, dt);
+  predictAxis(n, dt);
+  toFix(e.p, n.p, e.v, n.v, ms, out);
+  out.accuracy_mm = (uint32_t)(sqrtf(e.pp > n.pp ? e.pp : n.pp) * 1000 + 0.5f);
+  out.satellites = 0;
+  return true;
+}
@@ -0,0 +1,99 @@
+#ifndef TRACK_FILTER_H
+#define TRACK_FILTER_H
+
+#include <stdint.h>
+
+// A fix as the filter takes it in and hands it back
+struct FilterFix {
+  uint32_t ms;          // millis() when the fix was parsed
+  int32_t lat_e7;       // degrees * 1e7
+  int32_t lng_e7;
+  uint16_t speed_e1;    // km/h * 10
+  uint16_t course_e1;   // degrees * 10, [0, 3600): heading of motion
+  uint32_t accuracy_mm; // horizontal 1-sigma estimate (hAcc, or HDOP x UERE)
+  uint8_t satellites;
+};
+
+enum FilterResult {
+  FILTER_ACCEPTED,      // 'out' is the smoothed fix
+  FILTER_STARTED,       // first fix, or a restart: 'out' is the fix itself
+  FILTER_REJECTED       // an outlier or too poor to use; 'out' untouched
+};
+
+struct TrackFilterConfig {
+  float accelNoise;       // m/s^2, how hard the vehicle may manoeuvre
+  float speedNoise;       // m/s, 1-sigma of the receiver's speed
+  float maxSpeedMps;      // anything implying more is a jump
+  float maxAccuracyM;     // fixes claiming worse than this are dropped
+  float gate;             // innovation limit, squared sigmas
+  uint8_t minSatellites;  // fewer count as four times less accurate
+  uint32_t restartMs;     // rejecting everything this long means the filter is lost
+  uint32_t maxPredictMs;  // dead reckoning limit; also the gap that forces a restart
+};
+
+// Constant-velocity Kalman filter for GPS fixes.
+//
+// Works in metres east/north of a local origin; the two axes are
+// independent two-state (position, velocity) filters, so an update is a
+// few dozen float operations with no matrix library. Fixes go in and come
+// out in fixed point; floats stay inside the filter. Each fix updates
+// position (with its reported accuracy) and velocity (from speed and
+// course).
+//
+// Fixes are rejected when they imply a speed no vehicle reaches, fall
+// outside the innovation gate, or report a poor accuracy. If nothing has
+// been accepted for restartMs the filter starts over from the next fix,
+// so a real jump (after a cold start, say) is only held back briefly.
+//
+// Between fixes predict() dead-reckons along the last velocity, for up to
+// maxPredictMs.
+class TrackFilter {
+public:
+  explicit TrackFilter(const TrackFilterConfig& config);
+
+  static TrackFilterConfig defaults();
+
+  FilterResult update(const FilterFix& in, FilterFix& out);
+
+  // Estimated fix at 'ms' (not before the last accepted one); false
+  // without a state or past maxPredictMs. Leaves the state alone.
+  bool predict(uint32_t ms, FilterFix& out) const;
+
+  const TrackFilterConfig& config() const { return config_; }
+  void reset() { started_ = false; }
+  bool started() const { return started_; }
+  uint32_t lastAcceptedMs() const { return lastMs_; }
+
+  uint32_t accepted() const { return accepted_; }
+  uint32_t rejected() const { return rejected_; }
+  uint32_t restarts() const { return restarts_; }
+
+private:
+  // Position and velocity along one axis, with their covariance
+  struct Axis {
+    float p, v;
+    float pp, pv, vv;
+  };
+
+  void start(const FilterFix& in, FilterFix& out);
+  void toLocal(int32_t lat_e7, int32_t lng_e7, float& east, float& north) const;
+  void toFix(float east, float north, float ve, float vn, uint32_t ms, FilterFix& out) const;
+  void predictAxis(Axis& a, float dt) const;
+  static void updatePosition(Axis& a, float z, float r);
+  static void updateVelocity(Axis& a, float z, float r);
+
+  TrackFilterConfig config_;
+  bool started_;
+  int32_t lat0_e7_;       // local origin
+  int32_t lng0_e7_;
+  float mPerE7Lng_;       // metres per 1e-7 degree of longitude at the origin
+  Axis east_;
+  Axis north_;
+  uint32_t lastMs_;       // last accepted fix
+  FilterFix last_;        // ... as handed out
+  uint32_t accepted_;
+  uint32_t rejected_;
+  uint32_t restarts_;
+};
+
+#endif
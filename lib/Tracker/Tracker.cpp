@@ -0,0 +1,1384 @@
+#include "Tracker.h"
+
+#include <string.h>
+#include <TelemetryBinary.h>
+#include <Ubx.h>
+
+// RGB Color definitions
+#define COLOR_OFF 0, 0, 0
+#define COLOR_GREEN 0, 255, 0
+#define COLOR_BLUE 0, 0, 255
+#define COLOR_RED 255, 0, 0
+#define COLOR_YELLOW 255, 255, 0
+
+// Upload body format: JSON by default, build with -D TELEMETRY_FORMAT_BINARY
+// for the compact binary encoding (see TelemetryBinary.h)
+#ifdef TELEMETRY_FORMAT_BINARY
+#define writeTelemetryBody writeTelemetryBinary
+#define TELEMETRY_CONTENT_TYPE TBIN_CONTENT_TYPE
+#define TELEMETRY_DICTIONARY 0
+#define TELEMETRY_DICTIONARY_LENGTH 0
+#else
+#define writeTelemetryBody writeTelemetryJson
+#define TELEMETRY_CONTENT_TYPE "application/json"
+#define TELEMETRY_DICTIONARY telemetryJsonDictionary
+#define TELEMETRY_DICTIONARY_LENGTH telemetryJsonDictionaryLength
+#endif
+
+// Build with -D TELEMETRY_DEFLATE to send the body zlib compressed
+// ("Content-Encoding: deflate", JSON primed with a preset dictionary the
+// server must share; see tools/ingest_server.py)
+#ifdef TELEMETRY_DEFLATE
+#define TELEMETRY_CONTENT_ENCODING "deflate"
+#else
+#define TELEMETRY_CONTENT_ENCODING 0
+#endif
+
+// Build with -D POWER_SAVE for battery use: between deadlines the caller
+// puts the CPU in light sleep (see sleepFor()) and the SIM800 sleeps
+// whenever its UART is idle (AT+CSCLK=2)
+#define POWER_MIN_SLEEP_MS 10
+#define POWER_MAX_SLEEP_MS 5000
+#define GPS_WAKE_LEAD_MS 30         // awake this long around an expected burst
+#define SIM800_SLEEP_AFTER_MS 4000  // it sleeps after 5 s of UART silence
+#define SIM800_WAKE_GUARD_MS 100
+
+// NMEA only reports HDOP; the accuracy handed to the filter is HDOP times
+// a typical user range error
+#define GPS_UERE_MM 5000
+
+// Timing
+const uint32_t heartbeatInterval = 60000; // keep a reading at least this often
+#ifdef SAMPLING_FIXED_INTERVAL
+const uint32_t sampleInterval = 10000;
+#endif
+const uint32_t sendInterval = 60000; // 60 seconds
+const uint32_t statusInterval = 5000;
+
+// A geofence crossing is uploaded at once, but uploads start at most this
+// often
+#define FENCE_UPLOAD_MIN_INTERVAL_MS 5000
+// Where the fence image comes from, how long its download may take, and
+// how long a version that failed to arrive is left alone
+#define FENCE_PATH "/fences"
+#define FENCE_FETCH_TIMEOUT_MS 60000
+#define FENCE_RETRY_MS 600000
+
+// A reading is only stored when the track can no longer be drawn as a
+// straight line within trackToleranceCm of every sampled fix
+const uint32_t trackToleranceCm = 1000;  // 10 m
+
+// The request is never held in RAM: it is serialized again for each
+// CIPSEND chunk and only the bytes of that chunk reach the modem. A
+// compressed body is recompressed from the start each time; the output
+// is deterministic, so every pass yields the same bytes.
+// SIM800 accepts at most 1460 bytes per CIPSEND in single-link mode.
+#define CIPSEND_CHUNK_SIZE 1024
+
+#ifndef SAMPLING_FIXED_INTERVAL
+static AdaptiveSamplingConfig samplingConfig() {
+  AdaptiveSamplingConfig c = AdaptivePolicy::defaults();
+  c.maxIntervalMs = heartbeatInterval;
+  return c;
+}
+#endif
+
+// Feeds serializer output to a serial port
+class PortSink : public ByteSink {
+public:
+  explicit PortSink(SerialPort& port) : port_(port) {}
+  void write(const char* data, size_t len) override { port_.write((const uint8_t*)data, len); }
+  using ByteSink::write;
+private:
+  SerialPort& port_;
+};
+
+Tracker::Tracker(const TrackerConfig& config, Clock& clock, SerialPort& console,
+                 SerialPort& modemPort, SerialPort& gpsPort, StatusLed& led, FlashDevice& flash,
+                 FlashDevice& fenceFlash)
+  : config_(config), clock_(clock), console_(console), gpsPort_(gpsPort), led_(led), leds_(led),
+    hasLastPosition_(false),
+    fixesDropped_(0), rxOverflows_(0), gpsLastRx_(0), gpsBurstStart_(0),
+    modem_(modemPort), session_(modem_, clock, UPLOAD_LINKS),
+    power_(POWER_MIN_SLEEP_MS, POWER_MAX_SLEEP_MS),
+    lastReadingTime_(0), lastSendTime_(0), lastStatusTime_(0), lastFixTime_(0), prevFixMs_(0),
+    utc_(clock),
+#ifdef SAMPLING_FIXED_INTERVAL
+    samplingPolicy_(sampleInterval),
+#else
+    samplingPolicy_(samplingConfig()),
+#endif
+    fixesSeen_(0), fixesKept_(0), fixesRejected_(0), fixesEstimated_(0),
+#ifndef GPS_RAW_FIXES
+    filter_(TrackFilter::defaults()), lastFix_(), lastEstimateMs_(0),
+#endif
+    simplifier_(trackToleranceCm, heartbeatInterval, onTrackPoint, this),
+    gpsParseTime_("gps_parse", "us"),    // per GPS port read
+    fixGap_("fix_gap", "ms"),            // between fixes reaching loop()
+    sampleTime_("sample", "us"),         // sampleFix()
+    flashAppendTime_("flash_append", "us"),
+    serializeTime_("serialize", "us"),   // per CIPSEND chunk
+    connectTime_("connect", "ms"),       // session.open() to connected
+    cipsendTime_("cipsend", "ms"),       // CIPSEND prompt to SEND OK
+    ackTime_("ack_wait", "ms"),          // last SEND OK to the server's answer
+    uploadTime_("upload", "ms"),         // whole upload, every batch
+    connectPhase_(connectTime_), cipsendPhase_(cipsendTime_), uploadPhase_(uploadTime_),
+    gpsBytes_(0), firstFixMs_(0), modemBytesIn_(0), modemBytesOut_(0),
+    uploadsOk_(0), uploadsFailed_(0),
+    uploadInProgress_(false), batchSending_(false), uploadFailed_(false),
+    batchLink_(0), uploadSlots_(0), acks_(10000, onBatchSettled, this),
+    fixStore_(flash), storeReady_(false), uploadFirstSeq_(0), uploadCount_(0), nextUploadSeq_(0),
+    storeMisses_(0), sizedMisses_(0), batchBroken_(false),
+    bodyLength_(0), requestLength_(0), chunkOffset_(0), chunkLength_(0),
+    fenceStore_(fenceFlash), fences_(fenceStore_, onFenceEvent, this), fenceDownload_(fenceStore_),
+    fenceWanted_(0), fenceRequest_(false), fenceLink_(0), fenceRx_(false), fenceUploadDue_(false),
+    fenceFailed_(false), fenceFailedAt_(0), fenceEvents_(0), fenceUpdates_(0),
+    uploadStatCount_(0), batchHasStats_(false) {
+  Histogram* all[] = {
+    &gpsParseTime_, &fixGap_, &sampleTime_, &flashAppendTime_, &serializeTime_,
+    &connectTime_, &cipsendTime_, &ackTime_, &uploadTime_
+  };
+  for (size_t i = 0; i < histogramCount(); i++) histograms_[i] = all[i];
+  for (uint8_t i = 0; i < TCP_MAX_LINKS; i++) batchSentAt_[i] = 0;
+
+  for (int i = 0; i < STEP_COUNT; i++) {
+    uploadSteps_[i].tracker = this;
+    uploadSteps_[i].step = i;
+    uploadSteps_[i].command = 0;
+  }
+  static const char* const initCommands[] = { "AT", "AT+CMEE=2", "AT+CPIN?", "AT+CSCLK=2" };
+  for (int i = 0; i < 4; i++) {
+    initSteps_[i].tracker = this;
+    initSteps_[i].step = i;
+    initSteps_[i].command = initCommands[i];
+  }
+}
+
+// LED Functions
+// Played by leds_ from loop(); where two overlap, the higher priority one
+// is shown while it is lit
+
+// Solid red for 1 second (error/failure)
+static const LedPattern LED_ERROR = { COLOR_RED, 1000, 0, 1, 4 };
+// Fast blink green (success) - 2 quick flashes
+static const LedPattern LED_SUCCESS = { COLOR_GREEN, 50, 50, 2, 3 };
+// Blue flash every second while an upload runs
+static const LedPattern LED_UPLOADING = { COLOR_BLUE, 50, 950, 0, 2 };
+// Yellow blink (reading kept)
+static const LedPattern LED_COLLECTING = { COLOR_YELLOW, 50, 0, 1, 1 };
+
+void Tracker::ledSuccessBlink() {
+  leds_.start(LED_SUCCESS, clock_.millis());
+}
+
+void Tracker::ledUploading(bool on) {
+  if (on) leds_.start(LED_UPLOADING, clock_.millis());
+  else leds_.stop(LED_UPLOADING);
+}
+
+void Tracker::ledError() {
+  leds_.start(LED_ERROR, clock_.millis());
+}
+
+void Tracker::ledGPSCollecting() {
+  leds_.start(LED_COLLECTING, clock_.millis());
+}
+
+// Echo everything the modem says to the debug console
+void Tracker::onModemLine(const char* line, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  t->console_.println(line);
+}
+
+// Server responses: echoed, and matched to the uploaded batches. A fence
+// image goes straight to flash instead; so does whatever is left of a
+// failed one until the link carries another request.
+void Tracker::onModemData(uint8_t link, const uint8_t* data, size_t len, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  t->modemBytesIn_ += len;
+  if (t->fenceRx_ && link == t->fenceLink_) {
+    t->fenceDownload_.onData(data, len);
+    t->checkFenceDownload(t->clock_.millis());
+    return;
+  }
+  t->console_.write(data, len);
+  t->acks_.onData(link, data, len);
+}
+
+// Supply and power URCs, reported whenever they turn up
+void Tracker::onPowerUrc(const char* line, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  t->console_.print("Modem power warning: ");
+  t->console_.println(line);
+  t->ledError();
+}
+
+void Tracker::onInitStep(AtResult result, const char* line, void* ctx) {
+  const StepContext* s = (const StepContext*)ctx;
+  Tracker* t = s->tracker;
+  const char* what = s->command;
+  if (result == AT_RESULT_OK) {
+    if (strcmp(what, "AT+CPIN?") == 0) {
+      t->console_.println("SIM800 initialized");
+    } else if (strcmp(what, "AT+CSCLK=2") == 0) {
+      // From now on the modem may be asleep whenever a command starts
+      t->modem_.setWakeup(SIM800_SLEEP_AFTER_MS, SIM800_WAKE_GUARD_MS);
+    }
+    return;
+  }
+  if (result == AT_RESULT_ABORTED) return;
+
+  if (strcmp(what, "AT") == 0) {
+    t->console_.println("SIM800 not responding");
+  } else if (strcmp(what, "AT+CPIN?") == 0) {
+    t->console_.println("SIM card not ready");
+  } else {
+    t->console_.print(what);
+    t->console_.println(" failed");
+  }
+  t->console_.println("Will continue collecting GPS data...");
+  t->ledError();  // Red LED on failure
+}
+
+// Queues the SIM800 bring-up script. The AT engine runs it in the
+// background; failures are reported from onInitStep(). The GPRS bearer is
+// brought up by the session on the first upload.
+bool Tracker::initSIM800() {
+  console_.println("Initializing SIM800...");
+  session_.setApn(config_.apn);
+  session_.setServer(config_.server, config_.port);
+  modem_.setLineCallback(onModemLine, this);
+  modem_.setDataHandler(onModemData, this);
+  modem_.addUrcHandler("UNDER-VOLTAGE", onPowerUrc, this);
+  modem_.addUrcHandler("OVER-VOLTAGE", onPowerUrc, this);
+  modem_.addUrcHandler("NORMAL POWER DOWN", onPowerUrc, this);
+  modem_.addUrcHandler("RING", 0, 0);  // no calls expected, just swallow them
+
+  // Settle times replace the fixed delays the modem needs between steps
+  bool ok = true;
+  // Give the modem time to boot and lock onto our baud rate first
+  ok &= modem_.enqueue("AT", "OK", 5000, onInitStep, &initSteps_[0], 8000);
+  ok &= modem_.enqueue("AT+CMEE=2", "OK", 2000, onInitStep, &initSteps_[1], 0, AT_FLAG_OPTIONAL);
+  ok &= modem_.enqueue("AT+CPIN?", "READY", 5000, onInitStep, &initSteps_[2]);
+#ifdef POWER_SAVE
+  // Slow clock whenever the UART is idle; the engine wakes it up again
+  ok &= modem_.enqueue("AT+CSCLK=2", "OK", 2000, onInitStep, &initSteps_[3], 0, AT_FLAG_OPTIONAL);
+#endif
+  return ok;
+}
+
+static int16_t clampInt16(int32_t v) {
+  if (v > 32767) return 32767;
+  if (v < -32768) return -32768;
+  return (int16_t)v;
+}
+
+// v / d rounded half away from zero, d > 0
+static int32_t divRound(int32_t v, int32_t d) {
+  return v >= 0 ? (v + d / 2) / d : -((-v + d / 2) / d);
+}
+
+// Ground speed in mm/s to km/h * 10
+static uint16_t speedFromMms(int32_t mms) {
+  if (mms <= 0) return 0;
+  uint64_t e1 = ((uint64_t)mms * 36 + 500) / 1000;
+  return e1 > 65535 ? 65535 : (uint16_t)e1;
+}
+
+// Converts a fix from the GPS side into its compact form
+FixRecord Tracker::makeRecord(const GpsFix& fix) {
+  FixRecord r;
+  r.ts = fix.ms;
+  r.lat_e7 = fix.lat_e7;
+  r.lng_e7 = fix.lng_e7;
+  r.speed_e1 = clampInt16(fix.speed_e1);
+  r.alt_m = clampInt16(divRound(fix.alt_dm, 10));
+  r.satellites = fix.satellites;
+  r.flags = 0;
+  r.utc = 0;
+  if (utc_.valid()) {
+    r.utc = utc_.seconds(fix.ms);
+    r.flags |= FIXSTORE_FLAG_UTC;
+  }
+  return r;
+}
+
+// "YYYY-MM-DD HH:MM:SS", "... (cached)", "... (estimated)", "... (fence)"
+// or "N/A" for the console
+static const char* recordDatetime(uint32_t utc, uint8_t flags) {
+  static char datetime[32];
+  if (!(flags & FIXSTORE_FLAG_UTC)) return "N/A";
+  formatDatetime(utc, datetime);
+  if (flags & FIXSTORE_FLAG_CACHED) strcat(datetime, " (cached)");
+  else if (flags & FIXSTORE_FLAG_ESTIMATED) strcat(datetime, " (estimated)");
+  else if (flags & FIXSTORE_FLAG_FENCE) strcat(datetime, " (fence)");
+  return datetime;
+}
+
+// The store's reading flags as the upload formats know them
+static uint8_t telemetryFlags(uint8_t flags) {
+  uint8_t out = 0;
+  if (flags & FIXSTORE_FLAG_UTC) out |= TELEMETRY_FLAG_UTC;
+  if (flags & FIXSTORE_FLAG_CACHED) out |= TELEMETRY_FLAG_CACHED;
+  if (flags & FIXSTORE_FLAG_ESTIMATED) out |= TELEMETRY_FLAG_ESTIMATED;
+  if (flags & FIXSTORE_FLAG_FENCE) out |= TELEMETRY_FLAG_FENCE;
+  return out;
+}
+
+// Appends a reading to the flash store
+void Tracker::persistReading(const FixRecord& r) {
+  if (!storeReady_) return;
+  ScopedTimer timer(flashAppendTime_);
+
+  StoredFix fix;
+  memset(&fix, 0, sizeof(fix));
+  fix.ts = r.ts;
+  fix.utc = r.utc;
+  fix.lat_e7 = r.lat_e7;
+  fix.lng_e7 = r.lng_e7;
+  fix.alt_dm = r.alt_m * 10;
+  fix.speed_e2 = r.speed_e1 > 6553 ? 65535 : (uint16_t)(r.speed_e1 * 10);
+  fix.satellites = r.satellites;
+  fix.flags = FIXSTORE_FLAG_VALID | r.flags;
+
+  if (!fixStore_.append(fix)) {
+    console_.println("Flash store write failed");
+  }
+}
+
+#ifdef GPS_PROTOCOL_UBX
+// Queues a NAV-PVT solution for loop() if it is a valid fix
+void Tracker::publishNavPvt(const UbxNavPvt& pvt) {
+  if (!pvt.fixOk || pvt.fixType < 2) return;
+
+  GpsFix fix;
+  fix.ms = clock_.millis();
+  fix.lat_e7 = pvt.lat_e7;
+  fix.lng_e7 = pvt.lon_e7;
+  fix.alt_dm = divRound(pvt.hMSL_mm, 100);
+  fix.speed_e1 = speedFromMms(pvt.gSpeed_mms);
+  fix.course_e1 = (uint16_t)((divRound(pvt.headMot_e5, 10000) % 3600 + 3600) % 3600);
+  fix.accuracy_mm = pvt.hAcc_mm;
+  fix.satellites = pvt.numSV;
+  fix.hasDateTime = pvt.dateValid && pvt.timeValid;
+  fix.year = pvt.year;
+  fix.month = pvt.month;
+  fix.day = pvt.day;
+  fix.hour = pvt.hour;
+  fix.minute = pvt.minute;
+  fix.second = pvt.second;
+  fix.millisecond = (int16_t)(pvt.nano / 1000000);
+
+  if (!fixQueue_.push(fix)) fixesDropped_ = fixesDropped_ + 1;
+}
+
+void Tracker::handleGpsByte(uint8_t b) {
+  if (!ubx_.encode(b)) return;
+  if (ubx_.msgClass() != UBX_CLASS_NAV || ubx_.msgId() != UBX_NAV_PVT) return;
+
+  UbxNavPvt pvt;
+  if (ubxDecodeNavPvt(ubx_.payload(), ubx_.length(), pvt)) publishNavPvt(pvt);
+}
+
+uint32_t Tracker::gpsParseErrors() const {
+  return ubx_.checksumErrors() + ubx_.oversized();
+}
+#else
+// Queues the epoch's solution (GGA, with its RMC) for loop() if it is a
+// valid fix
+void Tracker::publishFix() {
+  const NmeaFix& f = nmea_.fix();
+  if (!f.valid) return;
+
+  GpsFix fix;
+  fix.ms = clock_.millis();
+  fix.lat_e7 = f.lat_e7;
+  fix.lng_e7 = f.lng_e7;
+  fix.alt_dm = f.alt_dm;
+  fix.speed_e1 = speedFromMms((int32_t)f.speed_mms);
+  fix.course_e1 = (uint16_t)((f.course_e2 + 5) / 10 % 3600);
+  fix.accuracy_mm = (uint32_t)f.hdop_e2 * GPS_UERE_MM / 100;
+  fix.satellites = f.satellites;
+  fix.hasDateTime = f.hasDate && f.hasTime;
+  fix.year = f.year;
+  fix.month = f.month;
+  fix.day = f.day;
+  fix.hour = f.hour;
+  fix.minute = f.minute;
+  fix.second = f.second;
+  fix.millisecond = (int16_t)(f.centisecond * 10);
+
+  if (!fixQueue_.push(fix)) fixesDropped_ = fixesDropped_ + 1;
+}
+
+void Tracker::handleGpsByte(uint8_t b) {
+  if (nmea_.encode(b)) publishFix();
+}
+
+uint32_t Tracker::gpsParseErrors() const {
+  return nmea_.checksumErrors() + nmea_.malformed();
+}
+#endif
+
+// Drains the receiver into the parser and publishes every completed fix.
+// Also notes when each burst starts, so sleeps can be planned around them.
+void Tracker::pollGps() {
+  uint8_t buf[128];
+  size_t n;
+  while ((n = gpsPort_.read(buf, sizeof(buf))) > 0) {
+    uint32_t now = clock_.millis();
+    if (now - gpsLastRx_ > GPS_BURST_GAP_MS) gpsBurstStart_ = now;
+    gpsLastRx_ = now;
+
+    ScopedTimer timer(gpsParseTime_);
+    gpsBytes_ = gpsBytes_ + n;
+    for (size_t i = 0; i < n; i++) {
+      handleGpsByte(buf[i]);
+    }
+  }
+}
+
+// Persists a reading, or buffers it in RAM when there is no flash store.
+// The store is released on acknowledgement, the RAM buffer per batch.
+void Tracker::keepReading(const FixRecord& r) {
+  lastReadingTime_ = clock_.millis();
+  if (storeReady_) persistReading(r);
+  else if (!readings_.push(r)) console_.println("Reading buffer full, reading not kept");
+
+  ledGPSCollecting();  // Quick yellow flash for every kept reading
+}
+
+// Simplifier output: the readings that describe the track
+void Tracker::onTrackPoint(const FixRecord& r, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  Console& out = t->console_;
+  out.print("\n[Reading #");
+  out.print((unsigned long)(t->storeReady_ ? t->fixStore_.pending() : t->readings_.size()) + 1);
+  out.print("] Time: ");
+  out.print(recordDatetime(r.utc, r.flags));
+  out.print(", Lat: ");
+  out.print(r.lat_e7 / 1e7, 6);
+  out.print(", Lng: ");
+  out.print(r.lng_e7 / 1e7, 6);
+  out.print(", Sats: ");
+  out.println(r.satellites);
+
+  t->keepReading(r);
+}
+
+// Offers a fix to the sampling policy; true if it is to be kept
+bool Tracker::samplePoint(const GpsFix& fix) {
+  TrackPoint p;
+  p.ms = fix.ms;
+  p.lat_e7 = fix.lat_e7;
+  p.lng_e7 = fix.lng_e7;
+  p.speed_e1 = fix.speed_e1;
+  p.course_e1 = fix.course_e1;
+  if (!samplingPolicy_.accept(p)) return false;
+  fixesKept_++;
+  return true;
+}
+
+// Filters a fix, offers it to the sampling policy and simplifies the ones
+// it keeps
+void Tracker::sampleFix(const GpsFix& raw) {
+  ScopedTimer timer(sampleTime_);
+  if (fixesSeen_ > 0) fixGap_.record(raw.ms - prevFixMs_);
+  prevFixMs_ = raw.ms;
+  if (firstFixMs_ == 0) firstFixMs_ = raw.ms ? raw.ms : 1;
+  fixesSeen_++;
+
+  // Every fix with a time counts, whatever the filter makes of its position
+  if (raw.hasDateTime) {
+    uint64_t utcMs = (uint64_t)makeEpoch(raw.year, raw.month, raw.day, raw.hour, raw.minute,
+                                         raw.second) * 1000 + raw.millisecond;
+    utc_.discipline(raw.ms, utcMs);
+  }
+
+#ifdef GPS_RAW_FIXES
+  const GpsFix& fix = raw;
+#else
+  FilterFix in;
+  in.ms = raw.ms;
+  in.lat_e7 = raw.lat_e7;
+  in.lng_e7 = raw.lng_e7;
+  in.speed_e1 = raw.speed_e1;
+  in.course_e1 = raw.course_e1;
+  in.accuracy_mm = raw.accuracy_mm;
+  in.satellites = raw.satellites;
+  FilterFix out;
+  if (filter_.update(in, out) == FILTER_REJECTED) {
+    fixesRejected_++;
+    return;
+  }
+  GpsFix fix = raw;
+  fix.lat_e7 = out.lat_e7;
+  fix.lng_e7 = out.lng_e7;
+  fix.speed_e1 = out.speed_e1;
+  fix.course_e1 = out.course_e1;
+  fix.accuracy_mm = out.accuracy_mm;
+  lastFix_ = fix;
+#endif
+  lastFixTime_ = clock_.millis();
+
+  // A fix that crosses a fence is kept whatever the sampler says, and
+  // not held back by the simplifier
+  bool crossed = fences_.update(fix.ms, fix.lat_e7, fix.lng_e7) > 0;
+  if (!samplePoint(fix) && !crossed) return;
+  FixRecord r = makeRecord(fix);
+  lastKnownPosition_ = r;
+  hasLastPosition_ = true;
+  if (crossed) r.flags |= FIXSTORE_FLAG_FENCE;
+  simplifier_.push(r);
+  if (crossed) simplifier_.flush();
+}
+
+// While fixes are missing (or all rejected), dead-reckons from the last
+// accepted one and offers the estimates like fixes, flagged as such.
+// Past the filter's prediction limit the heartbeat takes over.
+void Tracker::fillOutage() {
+#ifndef GPS_RAW_FIXES
+  uint32_t now = clock_.millis();
+  if (!filter_.started() || now - lastFixTime_ < GAP_FILL_AFTER_MS) return;
+  if (now - lastEstimateMs_ < GAP_FILL_INTERVAL_MS) return;
+
+  FilterFix est;
+  if (!filter_.predict(now, est)) return;
+  lastEstimateMs_ = now;
+  fixesEstimated_++;
+
+  GpsFix fix = lastFix_;
+  fix.ms = now;
+  fix.lat_e7 = est.lat_e7;
+  fix.lng_e7 = est.lng_e7;
+  fix.speed_e1 = est.speed_e1;
+  fix.course_e1 = est.course_e1;
+  fix.accuracy_mm = est.accuracy_mm;
+  fix.satellites = 0;
+  if (!samplePoint(fix)) return;
+
+  FixRecord r = makeRecord(fix);
+  r.flags |= FIXSTORE_FLAG_ESTIMATED;
+  simplifier_.push(r);
+#endif
+}
+
+// Fence engine callback. The fix is kept and uploaded by sampleFix() and
+// loop().
+void Tracker::onFenceEvent(const FenceEvent& event, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  t->fenceEvents_++;
+  t->fenceUploadDue_ = true;
+  t->console_.print(event.enter ? "\n[Fence] Entered " : "\n[Fence] Left ");
+  t->console_.print((unsigned long)event.fenceId);
+  t->console_.print(" at ");
+  t->console_.print(event.lat_e7 / 1e7, 6);
+  t->console_.print(", ");
+  t->console_.println(event.lng_e7 / 1e7, 6);
+}
+
+// Hands every fix from the GPS side to the sampler
+void Tracker::drainFixQueue() {
+  GpsFix fix;
+  while (fixQueue_.pop(fix)) {
+    sampleFix(fix);
+  }
+}
+
+// Without any fix for heartbeatInterval, keeps the last known position
+// (flagged as cached) so the server still hears from the tracker
+void Tracker::checkHeartbeat() {
+  uint32_t now = clock_.millis();
+  if (now - lastFixTime_ < heartbeatInterval) return;
+  if (now - lastReadingTime_ < heartbeatInterval) return;
+  lastReadingTime_ = now;
+
+  console_.print("\n[Heartbeat] No GPS fix,");
+  if (!hasLastPosition_) {
+    console_.println(" no cached position");
+    return;
+  }
+
+  FixRecord r = lastKnownPosition_;
+  r.ts = now;
+  r.speed_e1 = 0;
+  r.satellites = 0;
+  r.flags |= FIXSTORE_FLAG_CACHED;
+  // The position is old, the time is not
+  r.utc = utc_.seconds(now);
+  if (!utc_.valid()) r.flags &= ~FIXSTORE_FLAG_UTC;
+
+  console_.print(" using cached position (");
+  console_.print(r.lat_e7 / 1e7, 6);
+  console_.print(", ");
+  console_.print(r.lng_e7 / 1e7, 6);
+  console_.println(")");
+
+  keepReading(r);
+}
+
+// Hands the serializer one buffered reading at a time
+bool Tracker::readingSource(size_t index, TelemetryRecord& out, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  const FixRecord& r = t->readings_[index];
+  out.seq = 0;  // RAM readings do not survive a reboot, so they are not numbered
+  out.ts = r.ts;
+  out.utc = r.utc;
+  out.flags = telemetryFlags(r.flags);
+  out.lat_e7 = r.lat_e7;
+  out.lng_e7 = r.lng_e7;
+  out.speed_e2 = r.speed_e1 > 0 ? (uint32_t)r.speed_e1 * 10 : 0;
+  out.alt_dm = r.alt_m * 10;
+  out.satellites = r.satellites;
+  return true;
+}
+
+// Same, reading from the flash store
+bool Tracker::storedSource(size_t index, TelemetryRecord& out, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  StoredFix fix;
+  if (!t->fixStore_.read(t->uploadFirstSeq_ + index, fix)) {
+    t->storeMisses_++;
+    return false;
+  }
+  if (!(fix.flags & FIXSTORE_FLAG_VALID)) return false;
+
+  out.seq = fix.seq;
+  out.ts = fix.ts;
+  out.utc = fix.utc;
+  out.flags = telemetryFlags(fix.flags);
+  out.lat_e7 = fix.lat_e7;
+  out.lng_e7 = fix.lng_e7;
+  out.speed_e2 = fix.speed_e2;
+  out.alt_dm = fix.alt_dm;
+  out.satellites = fix.satellites;
+  return true;
+}
+
+void Tracker::addStat(const char* key, uint32_t value) {
+  if (uploadStatCount_ >= MAX_UPLOAD_STATS) return;
+  uploadStats_[uploadStatCount_].key = key;
+  uploadStats_[uploadStatCount_].value = value;
+  uploadStatCount_++;
+}
+
+// Freezes the summary when an upload starts, so every serialization pass
+// of the batch carrying it sees the same values
+void Tracker::snapshotStats() {
+  uploadStatCount_ = 0;
+  addStat("up_s", clock_.millis() / 1000);
+  addStat("ttff_ms", firstFixMs_);
+  addStat("gps_b", gpsBytes_);
+  addStat("gps_err", gpsParseErrors());
+  addStat("gps_ovr", rxOverflows_);
+  addStat("fix_drop", fixesDropped_);
+  addStat("fixes", fixesSeen_);
+  addStat("fix_rej", fixesRejected_);
+  addStat("fix_est", fixesEstimated_);
+  addStat("utc_s", utc_.seconds(clock_.millis()));
+  addStat("utc_syncs", utc_.syncs());
+  addStat("fix_gap_p90", fixGap_.percentile(90));
+  addStat("sample_p90_us", sampleTime_.percentile(90));
+  addStat("flash_p90_us", flashAppendTime_.percentile(90));
+  addStat("ser_p90_us", serializeTime_.percentile(90));
+  addStat("connect_p50", connectTime_.percentile(50));
+  addStat("cipsend_p50", cipsendTime_.percentile(50));
+  addStat("ack_p50", ackTime_.percentile(50));
+  addStat("upload_p50", uploadTime_.percentile(50));
+  addStat("tx_b", modemBytesOut_);
+  addStat("rx_b", modemBytesIn_);
+  addStat("up_ok", uploadsOk_);
+  addStat("up_fail", uploadsFailed_);
+  addStat("fence_v", fenceStore_.version());
+  addStat("fence_ev", fenceEvents_);
+}
+
+bool Tracker::statsSource(size_t index, TelemetryStat& out, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  if (index >= t->uploadStatCount_) return false;
+  out = t->uploadStats_[index];
+  return true;
+}
+
+TelemetryBatch Tracker::uploadBatch() {
+  TelemetryStatsSource stats = batchHasStats_ ? statsSource : 0;
+  if (storeReady_) {
+    // Every stored record is valid, so the count is known up front
+    TelemetryBatch batch = { config_.deviceId, uploadCount_, uploadCount_, storedSource, this,
+                             stats, this };
+    return batch;
+  }
+
+  TelemetryBatch batch = { config_.deviceId, uploadSlots_, uploadSlots_, readingSource, this,
+                           stats, this };
+  return batch;
+}
+
+// Serializes the body, compressed if enabled, into any sink
+void Tracker::writeBody(ByteSink& sink) {
+#ifdef TELEMETRY_DEFLATE
+  deflater_.begin(sink, TELEMETRY_DICTIONARY, TELEMETRY_DICTIONARY_LENGTH);
+  writeTelemetryBody(deflater_, uploadBatch());
+  deflater_.finish();
+#else
+  writeTelemetryBody(sink, uploadBatch());
+#endif
+}
+
+void Tracker::writeRequestHeader(ByteSink& sink) {
+  if (fenceRequest_) {
+    writeHttpGetHeader(sink, config_.server, FENCE_PATH);
+    return;
+  }
+  writeHttpPostHeader(sink, config_.server, config_.endpoint, TELEMETRY_CONTENT_TYPE, bodyLength_,
+                      TELEMETRY_CONTENT_ENCODING);
+}
+
+// Serializes the full request (header + body) into any sink
+void Tracker::writeRequest(ByteSink& sink) {
+  writeRequestHeader(sink);
+  if (!fenceRequest_) writeBody(sink);
+}
+
+// AT engine payload writer: streams the current chunk to the modem
+void Tracker::writeRequestChunk(SerialPort& port, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  ScopedTimer timer(t->serializeTime_);
+  PortSink portSink(port);
+  WindowSink window(portSink, t->chunkOffset_, t->chunkLength_);
+  t->storeMisses_ = 0;
+  t->writeRequest(window);
+  // A reading skipped now but not when sizing (or the reverse) shifts
+  // everything after it; the batch is abandoned once this chunk is out
+  if (!t->fenceRequest_ && t->storeMisses_ != t->sizedMisses_) t->batchBroken_ = true;
+}
+
+void Tracker::finishUpload(bool success) {
+  uploadInProgress_ = false;
+  ledUploading(false);
+  uploadPhase_.stop(clock_.millis());
+  if (success) uploadsOk_++;
+  else uploadsFailed_++;
+
+  console_.print("Session: ");
+  console_.print((unsigned long)session_.connects());
+  console_.print(" connects (avg ");
+  console_.print((unsigned long)session_.averageConnectMs());
+  console_.print(" ms), ");
+  console_.print((unsigned long)session_.reuses());
+  console_.print(" reuses (avg ");
+  console_.print((unsigned long)session_.averageReuseMs());
+  console_.print(" ms), ~");
+  console_.print((unsigned long)(session_.savedMs() / 1000));
+  console_.println(" s setup saved");
+
+  if (success) {
+    console_.println("\n=== Data sent successfully! ===\n");
+    ledSuccessBlink();  // Green fast blink on success!
+    console_.println("Transmission successful!");
+  } else {
+    ledError();  // Red LED on failure
+    console_.println("Transmission failed. Will retry in 1 minute.");
+  }
+}
+
+// Returns a link with no batch waiting for a response, or -1
+int Tracker::freeLink() {
+  for (uint8_t link = 0; link < session_.links(); link++) {
+    if (!acks_.waiting(link)) return link;
+  }
+  return -1;
+}
+
+// Sizes the next batch and opens its connection. Returns false if there
+// is nothing (more) to send or the modem is too busy; true if a batch was
+// started or has to wait for a link to become free.
+bool Tracker::startNextBatch(bool first) {
+  int link = freeLink();
+  if (link < 0) return true;
+
+  if (storeReady_) {
+    uploadFirstSeq_ = nextUploadSeq_;
+    uploadCount_ = fixStore_.nextSeq() - nextUploadSeq_;
+    if (uploadCount_ > MAX_UPLOAD_BATCH) uploadCount_ = MAX_UPLOAD_BATCH;
+    if (uploadCount_ == 0 && !first) return false;
+    // Every CIPSEND chunk reads the batch again, so its sectors must not
+    // be recycled until the last one is out
+    fixStore_.pin(uploadFirstSeq_);
+  } else {
+    // The RAM buffer is released per batch, so batches go one at a time
+    if (!acks_.idle()) return true;
+    uploadSlots_ = readings_.size();
+    if (uploadSlots_ == 0 && !first) return false;
+  }
+  batchHasStats_ = first;
+  TelemetryBatch batch = uploadBatch();
+
+  // Sizing passes: Content-Length first, then the header that carries it
+  CountingSink bodyCounter;
+  storeMisses_ = 0;
+  writeBody(bodyCounter);
+  sizedMisses_ = storeMisses_;
+  batchBroken_ = false;
+  bodyLength_ = bodyCounter.count();
+  CountingSink headerCounter;
+  writeRequestHeader(headerCounter);
+  requestLength_ = headerCounter.count() + bodyLength_;
+  chunkOffset_ = 0;
+
+  console_.print("Batch of ");
+  console_.print((unsigned)batch.count);
+  console_.print(" readings on link ");
+  console_.print(link);
+  console_.print(", request size: ");
+  console_.print((unsigned long)requestLength_);
+  console_.println(" bytes");
+
+  // Reuses the open connection if it is still alive. The CIPSEND chunks
+  // are queued as each step completes.
+  batchLink_ = (uint8_t)link;
+  if (batchLink_ == fenceLink_) fenceRx_ = false;
+  batchSending_ = true;
+  connectPhase_.start(clock_.millis());
+  if (!session_.open(onUploadStep, &uploadSteps_[STEP_CONNECT], batchLink_)) {
+    connectPhase_.cancel();
+    console_.println("Modem busy");
+    batchSending_ = false;
+    fixStore_.unpin();
+    uploadSlots_ = 0;
+    return false;
+  }
+  return true;
+}
+
+// Sends the fence image request, through the same connect and CIPSEND
+// steps as a batch. False if it could not be started.
+bool Tracker::startFenceFetch() {
+  int link = freeLink();
+  if (link < 0) return false;
+
+  fenceRequest_ = true;
+  bodyLength_ = 0;
+  CountingSink counter;
+  writeRequestHeader(counter);
+  requestLength_ = counter.count();
+  chunkOffset_ = 0;
+
+  console_.print("Fetching geofences, version ");
+  console_.println((unsigned long)fenceWanted_);
+
+  batchLink_ = (uint8_t)link;
+  fenceRx_ = false;
+  batchSending_ = true;
+  connectPhase_.start(clock_.millis());
+  if (!session_.open(onUploadStep, &uploadSteps_[STEP_CONNECT], batchLink_)) {
+    connectPhase_.cancel();
+    batchSending_ = false;
+    fenceRequest_ = false;
+    return false;
+  }
+  return true;
+}
+
+// Once the fence request is out: mounts the image when it has arrived,
+// or gives up on it after an error or FENCE_FETCH_TIMEOUT_MS
+void Tracker::checkFenceDownload(uint32_t now) {
+  if (!fenceRequest_ || batchSending_) return;
+  if (fenceDownload_.active()) {
+    if (now - fenceDownload_.startedAt() < FENCE_FETCH_TIMEOUT_MS) return;
+    fenceDownload_.cancel();
+  }
+  fenceRequest_ = false;
+  fenceWanted_ = 0;
+
+  if (fenceDownload_.state() == FenceDownload::DONE) {
+    fences_.begin();
+    fenceUpdates_++;
+    fenceFailed_ = false;
+    console_.print("Geofences updated: ");
+    console_.print((unsigned)fences_.fenceCount());
+    console_.print(" fences, version ");
+    console_.println((unsigned long)fenceStore_.version());
+  } else {
+    // Whatever is left of the response would only confuse the next one
+    session_.close(fenceLink_);
+    fenceFailed_ = true;
+    fenceFailedAt_ = now;
+    console_.print("Geofence download failed, HTTP ");
+    console_.print((unsigned)fenceDownload_.status());
+    console_.print(", ");
+    console_.print((unsigned long)fenceDownload_.received());
+    console_.println(" bytes");
+  }
+  continueUpload();
+}
+
+// Starts the next batch if there is one, then fetches a newer fence image
+// if the server has one, and ends the upload once every sent batch has
+// been answered
+void Tracker::continueUpload() {
+  if (!uploadInProgress_ || batchSending_ || fenceRequest_) return;
+  if (!uploadFailed_ && startNextBatch(false)) return;
+  if (!uploadFailed_ && fenceWanted_ && acks_.idle() && startFenceFetch()) return;
+  if (acks_.idle()) finishUpload(!uploadFailed_);
+}
+
+// Ack tracker callback, in the order the batches were sent. Readings
+// are only released once the server has confirmed storing them: stored
+// ones up to the sequence number it acknowledged, RAM ones on a 2xx.
+// After a failure, later batches are not released either; the next
+// upload sends them again and the server drops the duplicates.
+void Tracker::onBatchSettled(const AckedBatch& batch, void* ctx) {
+  Tracker* t = (Tracker*)ctx;
+  uint32_t now = t->clock_.millis();
+  if (batch.status != 0) t->ackTime_.record(now - t->batchSentAt_[batch.link]);
+  // The server has other fences than the ones in flash
+  if (batch.ok && batch.fenceVersion != 0 && batch.fenceVersion != t->fenceStore_.version() &&
+      t->fenceStore_.capacity() > 0 && !(t->fenceFailed_ && now - t->fenceFailedAt_ < FENCE_RETRY_MS)) {
+    t->fenceWanted_ = batch.fenceVersion;
+  }
+  if (!batch.ok) {
+    if (batch.status == 0) {
+      t->console_.print("No response for batch on link ");
+      t->console_.println(batch.link);
+      // The connection is in an unknown state
+      t->session_.close(batch.link);
+    } else {
+      t->console_.print("Batch not accepted, HTTP ");
+      t->console_.println(batch.status);
+    }
+    t->uploadFailed_ = true;
+  } else if (t->uploadFailed_) {
+    // Already resending from an earlier batch
+  } else if (t->storeReady_ && batch.count > 0) {
+    uint32_t last = batch.firstSeq + batch.count - 1;
+    uint32_t upTo = batch.ackSeq < last ? batch.ackSeq : last;
+    if (!t->fixStore_.acknowledge(upTo)) {
+      t->console_.println("Failed to persist upload cursor");
+    }
+    if (upTo < last) {
+      t->console_.print("Server stored readings up to #");
+      t->console_.println((unsigned long)upTo);
+      t->uploadFailed_ = true;
+    }
+  } else if (!t->storeReady_) {
+    // Anything collected meanwhile becomes the front of the buffer
+    t->readings_.dropFront(batch.count);
+  }
+  t->continueUpload();
+}
+
+// Queues the CIPSEND for the chunk at chunkOffset_
+void Tracker::queueNextChunk() {
+  chunkLength_ = requestLength_ - chunkOffset_;
+  if (chunkLength_ > CIPSEND_CHUNK_SIZE) chunkLength_ = CIPSEND_CHUNK_SIZE;
+
+  char cipsend[24];
+  session_.formatSend(cipsend, sizeof(cipsend), batchLink_, chunkLength_);
+  // The modem wants a moment after CONNECT OK before the first send
+  uint32_t settle = chunkOffset_ == 0 && !session_.reused() ? 2000 : 0;
+  modem_.enqueue(cipsend, ">", 10000, onUploadStep, &uploadSteps_[STEP_SEND_CMD], settle);
+  modem_.enqueueStream(writeRequestChunk, this, "SEND OK", 20000, onUploadStep,
+                       &uploadSteps_[STEP_PAYLOAD]);
+}
+
+void Tracker::onUploadStep(AtResult result, const char* line, void* ctx) {
+  const StepContext* s = (const StepContext*)ctx;
+  Tracker* t = s->tracker;
+  if (!t->batchSending_) return;
+  UploadStep step = (UploadStep)s->step;
+  uint32_t now = t->clock_.millis();
+  if (step == STEP_PAYLOAD && t->batchBroken_) result = AT_RESULT_ERROR;
+
+  if (result == AT_RESULT_OK) {
+    if (step == STEP_CONNECT) {
+      t->connectPhase_.stop(now);
+      t->queueNextChunk();
+    } else if (step == STEP_SEND_CMD) {
+      t->cipsendPhase_.start(now);
+    } else if (step == STEP_PAYLOAD) {
+      t->cipsendPhase_.stop(now);
+      t->chunkOffset_ += t->chunkLength_;
+      if (t->chunkOffset_ < t->requestLength_) {
+        t->queueNextChunk();
+        return;
+      }
+      // The response is echoed by onModemLine() and matched to this
+      // batch by the ack tracker; meanwhile the next batch can go out
+      t->batchSending_ = false;
+      t->fixStore_.unpin();
+      t->modemBytesOut_ += t->requestLength_;
+      if (t->fenceRequest_) {
+        // The image arrives through onModemData()
+        t->fenceLink_ = t->batchLink_;
+        t->fenceRx_ = true;
+        t->fenceDownload_.begin(now);
+        return;
+      }
+      t->batchSentAt_[t->batchLink_] = now;
+      if (t->storeReady_) {
+        t->acks_.add(t->batchLink_, t->uploadFirstSeq_, t->uploadCount_, now);
+        t->nextUploadSeq_ += t->uploadCount_;
+      } else {
+        t->acks_.add(t->batchLink_, 0, t->uploadSlots_, now);
+      }
+      t->console_.println("\nWaiting for server response...");
+      t->continueUpload();
+    }
+    return;
+  }
+
+  switch (step) {
+    case STEP_CONNECT:
+      t->console_.println(result == AT_RESULT_TIMEOUT ? "Connection timeout" : "Connection error");
+      break;
+    case STEP_SEND_CMD:
+      t->console_.println("\nFailed to get send prompt");
+      break;
+    case STEP_PAYLOAD:
+      if (t->batchBroken_) t->console_.println("Stored readings changed while sending");
+      else t->console_.println("Send failed - no SEND OK");
+      break;
+    default:
+      t->console_.println("Upload aborted");
+      break;
+  }
+
+  // Closing the link also drops a request the server has only part of
+  t->session_.close(t->batchLink_);
+  t->batchSending_ = false;
+  t->fixStore_.unpin();
+  if (t->fenceRequest_) {
+    // The readings are through; only the fences wait for another upload
+    t->fenceRequest_ = false;
+    t->fenceWanted_ = 0;
+    t->fenceFailed_ = true;
+    t->fenceFailedAt_ = now;
+  } else {
+    t->uploadFailed_ = true;
+  }
+  t->continueUpload();
+}
+
+// Starts an upload of everything collected so far. Batches are streamed
+// to the modem chunk by chunk, so RAM use does not depend on the batch
+// size. Returns false if the upload could not be started; the outcome of
+// a started upload is reported by finishUpload().
+bool Tracker::sendDataToServer() {
+  if (uploadInProgress_) {
+    console_.println("Previous upload still in progress");
+    return false;
+  }
+
+  // Readings that arrive while the upload runs are queued behind it
+  simplifier_.flush();  // the newest position should make it into this upload
+  if (storeReady_) {
+    fixStore_.flush();
+    nextUploadSeq_ = fixStore_.firstPending();
+  }
+
+  console_.println("\n=== Sending data to server ===");
+  if (storeReady_) {
+    console_.print("Stored backlog: ");
+    console_.println((unsigned long)fixStore_.pending());
+  } else {
+    console_.print("Buffered readings: ");
+    console_.print((unsigned)readings_.size());
+    console_.print("/");
+    console_.println(MAX_READINGS);
+  }
+
+  if (modem_.freeSlots() < 7) {
+    console_.println("Modem busy, skipping this upload");
+    return false;
+  }
+
+  uploadInProgress_ = true;
+  uploadFailed_ = false;
+  fenceUploadDue_ = false;
+  ledUploading(true);
+  snapshotStats();
+  uploadPhase_.start(clock_.millis());
+  if (!startNextBatch(true)) {
+    uploadInProgress_ = false;
+    ledUploading(false);
+    uploadPhase_.cancel();
+    return false;
+  }
+  return true;
+}
+
+void Tracker::dumpStats() {
+  console_.println("\n=== Stats ===");
+  console_.print("Uptime ");
+  console_.print((unsigned long)(clock_.millis() / 1000));
+  console_.print(" s, first fix after ");
+  console_.print((unsigned long)firstFixMs_);
+  console_.println(" ms");
+  console_.print("GPS: ");
+  console_.print((unsigned long)gpsBytes_);
+  console_.print(" bytes, ");
+  console_.print((unsigned long)gpsParseErrors());
+  console_.print(" parse errors, ");
+  console_.print((unsigned long)rxOverflows_);
+  console_.print(" overruns, ");
+  console_.print((unsigned long)fixesDropped_);
+  console_.println(" fixes dropped");
+  console_.print("Fixes: ");
+  console_.print((unsigned long)fixesSeen_);
+  console_.print(" seen, ");
+  console_.print((unsigned long)fixesRejected_);
+  console_.print(" rejected, ");
+  console_.print((unsigned long)fixesEstimated_);
+  console_.println(" estimated");
+  console_.print("UTC: ");
+  if (utc_.valid()) {
+    console_.print((unsigned long)utc_.syncs());
+    console_.print(" syncs, ");
+    console_.print((unsigned long)utc_.steps());
+    console_.print(" steps, last error ");
+    console_.print((long)utc_.lastErrorMs());
+    console_.print(" ms, drift ");
+    console_.print((long)utc_.driftPpb());
+    console_.println(" ppb");
+  } else {
+    console_.println("not set");
+  }
+  console_.print("Geofences: ");
+  if (fences_.fenceCount() > 0) {
+    console_.print((unsigned)fences_.fenceCount());
+    console_.print(" (version ");
+    console_.print((unsigned long)fenceStore_.version());
+    console_.print("), ");
+    console_.print((unsigned long)fenceEvents_);
+    console_.print(" events, ");
+    console_.print((unsigned long)fenceUpdates_);
+    console_.print(" updates, ");
+    console_.print((unsigned long)fences_.tests());
+    console_.print(" tests in ");
+    console_.print((unsigned long)fences_.fixes());
+    console_.print(" fixes, ");
+    console_.print((unsigned long)fences_.cellLoads());
+    console_.println(" cell loads");
+  } else {
+    console_.println("none");
+  }
+  console_.print("Modem: ");
+  console_.print((unsigned long)modemBytesOut_);
+  console_.print(" bytes out, ");
+  console_.print((unsigned long)modemBytesIn_);
+  console_.print(" bytes in; uploads ");
+  console_.print((unsigned long)uploadsOk_);
+  console_.print(" ok, ");
+  console_.print((unsigned long)uploadsFailed_);
+  console_.println(" failed");
+
+  for (size_t i = 0; i < histogramCount(); i++) {
+    const Histogram& h = *histograms_[i];
+    console_.print(h.name());
+    console_.print(" (");
+    console_.print(h.unit());
+    console_.print("): n=");
+    console_.print((unsigned long)h.count());
+    if (h.count() > 0) {
+      console_.print(" min=");
+      console_.print((unsigned long)h.min());
+      console_.print(" mean=");
+      console_.print((unsigned long)h.mean());
+      console_.print(" p50<=");
+      console_.print((unsigned long)h.percentile(50));
+      console_.print(" p90<=");
+      console_.print((unsigned long)h.percentile(90));
+      console_.print(" max=");
+      console_.print((unsigned long)h.max());
+      // Non-empty buckets as floor:count
+      console_.print(" |");
+      for (uint8_t b = 0; b < STATS_BUCKETS; b++) {
+        if (h.bucket(b) == 0) continue;
+        console_.print(" ");
+        console_.print((unsigned long)Histogram::bucketFloor(b));
+        console_.print(":");
+        console_.print((unsigned long)h.bucket(b));
+      }
+    }
+    console_.println();
+  }
+}
+
+// Single-character commands from the debug console
+void Tracker::checkConsole() {
+  SerialPort& in = console_.port();
+  while (in.available() > 0) {
+    int c = in.read();
+    if (c == 's') dumpStats();
+  }
+}
+
+// Returns whichever of two millis() values is later
+static uint32_t laterOf(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) > 0 ? a : b;
+}
+
+// The next thing loop() has to do: the next upload, status line or
+// heartbeat, or the next GPS burst. Stays awake while a burst is arriving
+// or the modem, an upload or the fix queue has work.
+uint32_t Tracker::sleepFor() {
+  uint32_t now = clock_.millis();
+  power_.begin(now);
+  power_.deadline(lastSendTime_ + sendInterval);
+  power_.deadline(lastStatusTime_ + statusInterval);
+  power_.deadline(laterOf(lastFixTime_, lastReadingTime_) + heartbeatInterval);
+#ifndef GPS_RAW_FIXES
+  // The next outage estimate, while the filter can still make one
+  if (filter_.started() && now - filter_.lastAcceptedMs() < filter_.config().maxPredictMs) {
+    power_.deadline(laterOf(lastFixTime_ + GAP_FILL_AFTER_MS, lastEstimateMs_ + GAP_FILL_INTERVAL_MS));
+  }
+#endif
+  power_.deadlineEvery(gpsBurstStart_, 1000 / GPS_RATE_HZ, GPS_WAKE_LEAD_MS);
+  if (fenceUploadDue_) power_.deadline(lastSendTime_ + FENCE_UPLOAD_MIN_INTERVAL_MS);
+  uint32_t ledChange;
+  if (leds_.nextChange(now, ledChange)) power_.deadline(ledChange);
+
+  if (now - gpsLastRx_ < GPS_BURST_GAP_MS) power_.hold();
+  if (fixQueue_.size() > 0 || modem_.busy() || uploadInProgress_ || !acks_.idle()) power_.hold();
+  return power_.sleepFor();
+}
+
+void Tracker::begin(bool haveStorage, bool haveFences) {
+  led_.off();
+  console_.println("\n=== GPS Tracker ===");
+#ifdef SAMPLING_FIXED_INTERVAL
+  console_.print("Samples a fix every ");
+  console_.print((unsigned long)(sampleInterval / 1000));
+  console_.println(" s");
+#else
+  console_.print("Samples fixes on turns and speed changes, at least every ");
+  console_.print((unsigned long)(heartbeatInterval / 1000));
+  console_.println(" s");
+#endif
+  console_.print("Keeps readings within ");
+  console_.print((unsigned long)(trackToleranceCm / 100));
+  console_.print(" m of the track, sends every ");
+  console_.print((unsigned long)(sendInterval / 1000));
+  console_.println(" s");
+
+  if (!initSIM800()) {
+    console_.println("Failed to initialize SIM800");
+    console_.println("Will continue collecting GPS data...");
+  }
+
+  readings_.clear();
+
+  storeReady_ = haveStorage && fixStore_.begin();
+  if (storeReady_) {
+    console_.print("Flash store mounted, ");
+    console_.print((unsigned long)fixStore_.pending());
+    console_.println(" readings waiting to be sent");
+  } else {
+    console_.println("No flash store, readings are kept in RAM only");
+  }
+
+  // Without the region no image is ever requested
+  if (haveFences && fenceStore_.begin()) {
+    fences_.begin();
+    console_.print("Geofences loaded: ");
+    console_.print((unsigned)fences_.fenceCount());
+    console_.print(" fences, version ");
+    console_.println((unsigned long)fenceStore_.version());
+  } else if (haveFences) {
+    console_.println("No geofences yet");
+  }
+
+  console_.println("System ready!\n");
+  lastReadingTime_ = clock_.millis();
+  lastSendTime_ = clock_.millis();
+
+  // Queued behind the init script; runs once the modem is up
+  if (!sendDataToServer()) {
+    console_.println("Transmission failed. Will retry in 1 minute.");
+  }
+}
+
+// Show countdown every 5 seconds
+void Tracker::printStatus(uint32_t now) {
+  uint32_t nextSend = sendInterval - (now - lastSendTime_);
+
+  if (storeReady_) {
+    console_.print("[Status] Stored: ");
+    console_.print((unsigned long)fixStore_.pending());
+  } else {
+    console_.print("[Status] Buffered: ");
+    console_.print((unsigned)readings_.size());
+    console_.print("/");
+    console_.print(MAX_READINGS);
+  }
+
+  console_.print(" | Kept: ");
+  console_.print((unsigned long)simplifier_.emitted());
+  console_.print("/");
+  console_.print((unsigned long)fixesKept_);
+  console_.print("/");
+  console_.print((unsigned long)fixesSeen_);
+  console_.print(" fixes");
+
+  console_.print(" | Next send in: ");
+  console_.print((unsigned long)(nextSend / 1000));
+  console_.print("s");
+
+  if (fixesDropped_ || rxOverflows_) {
+    console_.print(" | GPS drops: ");
+    console_.print((unsigned long)fixesDropped_);
+    console_.print(" fixes, ");
+    console_.print((unsigned long)rxOverflows_);
+    console_.print(" overruns");
+  }
+#ifdef POWER_SAVE
+  console_.print(" | Asleep: ");
+  console_.print((unsigned long)(power_.sleptMs() * 100 / (now ? now : 1)));
+  console_.print("%");
+#endif
+  console_.println();
+}
+
+void Tracker::loop() {
+  uint32_t currentTime = clock_.millis();
+
+  // loop() is the consumer/uplink side: it takes fixes from the GPS side
+  // and keeps the modem moving on every pass
+  drainFixQueue();
+  fillOutage();
+  modem_.poll(currentTime);
+  acks_.poll(currentTime);
+  checkHeartbeat();
+  checkConsole();
+  checkFenceDownload(currentTime);
+
+  // A fence crossing goes out without waiting for the next upload
+  if (fenceUploadDue_ && !uploadInProgress_ &&
+      currentTime - lastSendTime_ >= FENCE_UPLOAD_MIN_INTERVAL_MS) {
+    console_.println("\n=== Fence Crossed - Sending Data ===");
+    if (!sendDataToServer()) {
+      console_.println("Transmission failed. Will retry shortly.");
+    }
+    lastSendTime_ = currentTime;
+  }
+
+  // Send data every 60 seconds
+  if (currentTime - lastSendTime_ >= sendInterval) {
+    console_.println("\n=== 1 Minute Elapsed - Sending Data ===");
+
+    // The uploaded readings are released when the upload finishes
+    if (!sendDataToServer()) {
+      console_.println("Transmission failed. Will retry in 1 minute.");
+    }
+
+    lastSendTime_ = currentTime;
+  }
+
+  if (currentTime - lastStatusTime_ >= statusInterval) {
+    printStatus(currentTime);
+    lastStatusTime_ = currentTime;
+  }
+
+  leds_.tick(clock_.millis());
+}
@@ -0,0 +1,389 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <Clock.h>
+#include <StatusLed.h>
+#include <LedEngine.h>
+#include <SerialPort.h>
+#include <Console.h>
+#include <AtEngine.h>
+#include <TcpSession.h>
+#include <AckTracker.h>
+#include <JsonWriter.h>
+#include <TelemetryJson.h>
+#include <Deflate.h>
+#include <FixStore.h>
+#include <SpscQueue.h>
+#include <RingBuffer.h>
+#include <SamplingPolicy.h>
+#include <StreamSimplifier.h>
+#include <UbxParser.h>
+#include <NmeaParser.h>
+#include <PowerScheduler.h>
+#include <TrackFilter.h>
+#include <UtcClock.h>
+#include <FenceStore.h>
+#include <FenceEngine.h>
+#include <FenceDownload.h>
+#include <Stats.h>
+
+// Readings waiting for upload, oldest first. Must be a power of two.
+#ifndef MAX_READINGS
+#define MAX_READINGS 128
+#endif
+
+// Every reading is also appended to a ring buffer in flash. Uploads drain
+// it from the acknowledged cursor in requests of at most this many, so
+// readings survive failed uploads and reboots. Without the storage region
+// the tracker falls back to uploading the RAM buffer directly.
+#ifndef MAX_UPLOAD_BATCH
+#define MAX_UPLOAD_BATCH 60
+#endif
+
+// Fix rate the receiver is configured for
+#ifdef POWER_SAVE
+#define GPS_RATE_HZ 1       // the sampling policy keeps at most 1 fix/s anyway
+#else
+#define GPS_RATE_HZ 5
+#endif
+
+// Fixes go through a Kalman filter (see TrackFilter.h) that smooths the
+// track, drops outliers and dead-reckons through short outages. Build with
+// -D GPS_RAW_FIXES to take the receiver's fixes as they are.
+#ifndef GPS_RAW_FIXES
+// Outage fill: estimated positions start once no fix has been accepted for
+// this long, and are offered at most this often
+#define GAP_FILL_AFTER_MS 2000
+#define GAP_FILL_INTERVAL_MS 1000
+#endif
+
+// Receive events from the GPS UART; a burst is one epoch's worth of
+// sentences (or one NAV-PVT), arriving once per 1000 / GPS_RATE_HZ ms
+#define GPS_BURST_GAP_MS 50
+
+// The GPRS bearer and the TCP connection to the server stay up between
+// uploads; requests use HTTP/1.1 keep-alive. Build with -D MODEM_CIPMUX
+// to use two links (AT+CIPMUX=1), so the next batch of a backlog is sent
+// while the server is still answering the previous one.
+#ifdef MODEM_CIPMUX
+#define UPLOAD_LINKS 2
+#else
+#define UPLOAD_LINKS 1
+#endif
+
+// Where the uploads go
+struct TrackerConfig {
+  const char* server;
+  int port;
+  const char* endpoint;
+  const char* apn;
+  const char* deviceId;
+};
+
+// One reading as kept in RAM until it is uploaded. 24 bytes and no heap
+// allocation; the datetime string is only produced while serializing.
+struct FixRecord {
+  uint32_t ts;          // millis() when taken
+  uint32_t utc;         // GPS UTC, seconds since 1970 (if FIXSTORE_FLAG_UTC)
+  int32_t lat_e7;       // degrees * 1e7
+  int32_t lng_e7;
+  int16_t speed_e1;     // km/h * 10
+  int16_t alt_m;        // metres above mean sea level
+  uint8_t satellites;
+  uint8_t flags;        // FIXSTORE_FLAG_UTC / _CACHED / _ESTIMATED / _FENCE
+};
+
+// A validated fix as handed from the GPS side to loop(), in the fixed
+// point the receiver reports it in
+struct GpsFix {
+  uint32_t ms;          // millis() when the fix was parsed
+  int32_t lat_e7;       // degrees * 1e7
+  int32_t lng_e7;
+  int32_t alt_dm;       // metres above mean sea level * 10
+  uint16_t speed_e1;    // km/h * 10
+  uint16_t course_e1;   // degrees * 10, [0, 3600): heading of motion
+  uint32_t accuracy_mm; // horizontal 1-sigma
+  uint8_t satellites;
+  bool hasDateTime;
+  uint16_t year;
+  uint8_t month, day, hour, minute, second;
+  int16_t millisecond;  // -999..999 (UBX rounds the second, then corrects)
+};
+
+// Stats entries sent with the first batch of an upload
+#define MAX_UPLOAD_STATS 28
+
+// Sampled fixes go through streaming line simplification over this many
+// points before a reading is kept
+#define SIMPLIFY_WINDOW 32
+
+// The tracker application: collects GPS fixes, keeps the ones that
+// describe the track, stores them in flash and uploads them through the
+// SIM800. Every fix is also checked against the geofences in a second
+// flash region; a crossing is kept as a flagged reading and uploaded at
+// once.
+//
+// All hardware is reached through the HAL (Clock, SerialPort, StatusLed,
+// FlashDevice), so the same code runs on the ESP32-C3 and, against
+// simulated peripherals, on a host (see src/native).
+//
+// Two contexts drive it. pollGps() drains the GPS port into the parser and
+// publishes fixes through a lock-free queue; on the device it runs in its
+// own task. Everything else runs from loop(). Set-up of the ports (pins,
+// baud rates, receiver configuration) is left to the caller.
+class Tracker {
+public:
+  Tracker(const TrackerConfig& config, Clock& clock, SerialPort& console,
+          SerialPort& modemPort, SerialPort& gpsPort, StatusLed& led, FlashDevice& flash,
+          FlashDevice& fenceFlash);
+
+  // Queues the modem bring-up, mounts the flash store if the storage
+  // region is there, loads the geofences if their region is, and starts
+  // the first upload
+  void begin(bool haveStorage, bool haveFences = false);
+
+  // GPS side: parses whatever the receiver has sent
+  void pollGps();
+
+  // One pass of the main loop; never blocks
+  void loop();
+
+  // How long the caller may sleep before the next thing loop() has to do,
+  // or 0 to keep running. Record the sleep with slept().
+  uint32_t sleepFor();
+  void slept(uint32_t ms) { power_.slept(ms); }
+
+  // A GPS receive buffer overrun seen by the driver
+  void noteRxOverflow() { rxOverflows_ = rxOverflows_ + 1; }
+
+  // Prints every counter and histogram (also on 's' from the console)
+  void dumpStats();
+
+  uint32_t fixesSeen() const { return fixesSeen_; }
+  uint32_t fixesKept() const { return fixesKept_; }
+  uint32_t fixesRejected() const { return fixesRejected_; }
+  uint32_t fixesEstimated() const { return fixesEstimated_; }
+  uint32_t readingsKept() const { return simplifier_.emitted(); }
+  uint32_t uploadsOk() const { return uploadsOk_; }
+  uint32_t uploadsFailed() const { return uploadsFailed_; }
+  uint32_t modemBytesOut() const { return modemBytesOut_; }
+  uint32_t modemBytesIn() const { return modemBytesIn_; }
+  size_t buffered() const { return readings_.size(); }
+  bool storeReady() const { return storeReady_; }
+  const FixStore& store() const { return fixStore_; }
+  const TcpSession& session() const { return session_; }
+  const PowerScheduler& power() const { return power_; }
+  const UtcClock& utc() const { return utc_; }
+  const FenceEngine& fences() const { return fences_; }
+  uint32_t fenceVersion() const { return fenceStore_.version(); }
+  const Histogram* const* histograms() const { return histograms_; }
+  size_t histogramCount() const { return sizeof(histograms_) / sizeof(histograms_[0]); }
+
+private:
+  enum UploadStep {
+    STEP_CONNECT,
+    STEP_SEND_CMD,
+    STEP_PAYLOAD,
+    STEP_COUNT
+  };
+
+  // Callback context for AT engine steps: the tracker, and which step
+  struct StepContext {
+    Tracker* tracker;
+    int step;
+    const char* command;
+  };
+
+  // LED patterns
+  void ledSuccessBlink();
+  void ledUploading(bool on);
+  void ledError();
+  void ledGPSCollecting();
+
+  bool initSIM800();
+  static void onModemLine(const char* line, void* ctx);
+  static void onModemData(uint8_t link, const uint8_t* data, size_t len, void* ctx);
+  static void onPowerUrc(const char* line, void* ctx);
+  static void onInitStep(AtResult result, const char* line, void* ctx);
+
+  // GPS ingestion
+  void handleGpsByte(uint8_t b);
+  void publishFix();
+  void publishNavPvt(const UbxNavPvt& pvt);
+  uint32_t gpsParseErrors() const;
+
+  // Collection
+  FixRecord makeRecord(const GpsFix& fix);
+  void persistReading(const FixRecord& r);
+  void keepReading(const FixRecord& r);
+  static void onTrackPoint(const FixRecord& r, void* ctx);
+  bool samplePoint(const GpsFix& fix);
+  void sampleFix(const GpsFix& fix);
+  void fillOutage();
+  void drainFixQueue();
+  void checkHeartbeat();
+  void checkConsole();
+  static void onFenceEvent(const FenceEvent& event, void* ctx);
+  void printStatus(uint32_t now);
+
+  // Upload
+  static bool readingSource(size_t index, TelemetryRecord& out, void* ctx);
+  static bool storedSource(size_t index, TelemetryRecord& out, void* ctx);
+  static bool statsSource(size_t index, TelemetryStat& out, void* ctx);
+  void addStat(const char* key, uint32_t value);
+  void snapshotStats();
+  TelemetryBatch uploadBatch();
+  void writeBody(ByteSink& sink);
+  void writeRequestHeader(ByteSink& sink);
+  bool startFenceFetch();
+  void checkFenceDownload(uint32_t now);
+  void writeRequest(ByteSink& sink);
+  static void writeRequestChunk(SerialPort& port, void* ctx);
+  void finishUpload(bool success);
+  int freeLink();
+  bool startNextBatch(bool first);
+  void continueUpload();
+  static void onBatchSettled(const AckedBatch& batch, void* ctx);
+  void queueNextChunk();
+  static void onUploadStep(AtResult result, const char* line, void* ctx);
+  bool sendDataToServer();
+
+  TrackerConfig config_;
+  Clock& clock_;
+  Console console_;
+  SerialPort& gpsPort_;
+  StatusLed& led_;
+  LedEngine leds_;
+
+  // Last known good position, repeated by the heartbeat while there is no fix
+  FixRecord lastKnownPosition_;
+  bool hasLastPosition_;
+  RingBuffer<FixRecord, MAX_READINGS> readings_;
+
+  // GPS side: the parser is owned by pollGps(); fixes reach loop()
+  // through the queue
+#ifdef GPS_PROTOCOL_UBX
+  UbxParser ubx_;
+#else
+  NmeaParser nmea_;
+#endif
+  SpscQueue<GpsFix, 32> fixQueue_;
+  volatile uint32_t fixesDropped_;   // queue full (written by pollGps() only)
+  volatile uint32_t rxOverflows_;    // UART FIFO / ring buffer overruns
+  volatile uint32_t gpsLastRx_;      // millis() of the latest GPS bytes
+  volatile uint32_t gpsBurstStart_;  // ... of the first ones in the latest burst
+
+  // Non-blocking modem command engine and the connections it keeps open
+  AtEngine modem_;
+  TcpSession session_;
+  PowerScheduler power_;
+
+  // Timing
+  uint32_t lastReadingTime_;
+  uint32_t lastSendTime_;
+  uint32_t lastStatusTime_;
+  uint32_t lastFixTime_;
+  uint32_t prevFixMs_;
+
+  // Every reading is stamped from millis() through this, disciplined by
+  // the GPS time of each fix
+  UtcClock utc_;
+
+  // Every fix is offered to the sampling policy, which keeps only the ones
+  // that change the shape of the track
+#ifdef SAMPLING_FIXED_INTERVAL
+  FixedIntervalPolicy samplingPolicy_;
+#else
+  AdaptivePolicy samplingPolicy_;
+#endif
+  uint32_t fixesSeen_;
+  uint32_t fixesKept_;
+  uint32_t fixesRejected_;    // by the filter
+  uint32_t fixesEstimated_;   // dead-reckoned and offered to the sampler
+#ifndef GPS_RAW_FIXES
+  TrackFilter filter_;
+  GpsFix lastFix_;            // last one the filter accepted, as smoothed
+  uint32_t lastEstimateMs_;
+#endif
+  StreamSimplifier<FixRecord, SIMPLIFY_WINDOW> simplifier_;
+
+  // Instrumentation: where the time goes
+  Histogram gpsParseTime_;
+  Histogram fixGap_;
+  Histogram sampleTime_;
+  Histogram flashAppendTime_;
+  Histogram serializeTime_;
+  Histogram connectTime_;
+  Histogram cipsendTime_;
+  Histogram ackTime_;
+  Histogram uploadTime_;
+  Histogram* histograms_[9];
+  PhaseTimer connectPhase_;
+  PhaseTimer cipsendPhase_;
+  PhaseTimer uploadPhase_;
+  uint32_t batchSentAt_[TCP_MAX_LINKS];
+  volatile uint32_t gpsBytes_;       // written by pollGps() only
+  uint32_t firstFixMs_;              // millis() of the first fix, 0 until then
+  uint32_t modemBytesIn_;            // server responses
+  uint32_t modemBytesOut_;           // upload requests
+  uint32_t uploadsOk_;
+  uint32_t uploadsFailed_;
+
+  // Upload state. An upload sends batches until the backlog is drained;
+  // one batch is being sent at a time, and up to UPLOAD_LINKS may be
+  // waiting for the server's response.
+  bool uploadInProgress_;
+  bool batchSending_;
+  bool uploadFailed_;
+  uint8_t batchLink_;
+  size_t uploadSlots_;  // readings [0, uploadSlots_) belong to the batch being sent
+  AckTracker acks_;
+  StepContext uploadSteps_[STEP_COUNT];
+  StepContext initSteps_[4];
+
+  // Every reading is also appended to the flash store; uploads drain it
+  // from the acknowledged cursor
+  FixStore fixStore_;
+  bool storeReady_;
+  uint32_t uploadFirstSeq_;  // store range of the batch being sent
+  uint32_t uploadCount_;
+  uint32_t nextUploadSeq_;   // first reading not yet sent in this upload
+  uint32_t storeMisses_;     // stored readings that failed to read, this pass
+  uint32_t sizedMisses_;     // the same in the sizing pass
+  bool batchBroken_;         // a later pass did not match the sizing pass
+
+  // The request is serialized again for each CIPSEND chunk
+  size_t bodyLength_;
+  size_t requestLength_;
+  size_t chunkOffset_;
+  size_t chunkLength_;
+#ifdef TELEMETRY_DEFLATE
+  DeflateSink deflater_;
+#endif
+
+  // Geofences: the image received from the server, evaluated on every
+  // fix. An ack naming another version than the mounted one has the
+  // upload fetch it once the readings are through (fenceRequest_ marks
+  // that request as the one being sent).
+  FenceStore fenceStore_;
+  FenceEngine fences_;
+  FenceDownload fenceDownload_;
+  uint32_t fenceWanted_;     // version to fetch, 0 if none
+  bool fenceRequest_;
+  uint8_t fenceLink_;
+  bool fenceRx_;             // data on fenceLink_ is the fence response's
+  bool fenceUploadDue_;      // a crossing waits to be uploaded
+  bool fenceFailed_;         // the last download failed, at fenceFailedAt_
+  uint32_t fenceFailedAt_;
+  uint32_t fenceEvents_;
+  uint32_t fenceUpdates_;
+
+  // Instrumentation summary for the upload, frozen when it starts
+  TelemetryStat uploadStats_[MAX_UPLOAD_STATS];
+  size_t uploadStatCount_;
+  bool batchHasStats_;
+};
+
+#endif
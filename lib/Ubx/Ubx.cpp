@@ -0,0 +1,62 @@
+#include "Ubx.h"
+
+#include <stdio.h>
+
+void ubxSend(SerialPort& port, uint8_t cls, uint8_t id, const uint8_t* payload, uint16_t len) {
+  uint8_t head[6] = { UBX_SYNC1, UBX_SYNC2, cls, id, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+
+  // 8-bit Fletcher checksum over class, id, length and payload
+  uint8_t a = 0, b = 0;
+  for (uint8_t i = 2; i < 6; i++) {
+    a += head[i];
+    b += a;
+  }
+  for (uint16_t i = 0; i < len; i++) {
+    a += payload[i];
+    b += a;
+  }
+
+  uint8_t tail[2] = { a, b };
+  port.write(head, sizeof(head));
+  if (len) port.write(payload, len);
+  port.write(tail, sizeof(tail));
+}
+
+void ubxSetRate(SerialPort& port, uint16_t measRateMs) {
+  uint8_t payload[6] = {
+    (uint8_t)(measRateMs & 0xFF), (uint8_t)(measRateMs >> 8),
+    1, 0,   // navRate: one solution per measurement
+    1, 0    // timeRef: GPS time
+  };
+  ubxSend(port, UBX_CLASS_CFG, UBX_CFG_RATE, payload, sizeof(payload));
+}
+
+void ubxSetPortUbxOnly(SerialPort& port, uint32_t baud) {
+  uint8_t payload[20] = {
+    1, 0,                      // portID UART1, reserved
+    0, 0,                      // txReady off
+    0xD0, 0x08, 0, 0,          // mode: 8 bits, no parity, 1 stop bit
+    (uint8_t)baud, (uint8_t)(baud >> 8), (uint8_t)(baud >> 16), (uint8_t)(baud >> 24),
+    0x03, 0,                   // inProtoMask: UBX + NMEA
+    0x01, 0,                   // outProtoMask: UBX
+    0, 0, 0, 0                 // flags, reserved
+  };
+  ubxSend(port, UBX_CLASS_CFG, UBX_CFG_PRT, payload, sizeof(payload));
+}
+
+void ubxSetMessageRate(SerialPort& port, uint8_t cls, uint8_t id, uint8_t rate) {
+  uint8_t payload[3] = { cls, id, rate };
+  ubxSend(port, UBX_CLASS_CFG, UBX_CFG_MSG, payload, sizeof(payload));
+}
+
+void ubxSetBaudNmea(SerialPort& port, uint32_t baud) {
+  char body[48];
+  snprintf(body, sizeof(body), "PUBX,41,1,0007,0003,%lu,0", (unsigned long)baud);
+
+  uint8_t cs = 0;
+  for (const char* p = body; *p; p++) cs ^= (uint8_t)*p;
+
+  char sentence[64];
+  snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, cs);
+  port.print(sentence);
+}
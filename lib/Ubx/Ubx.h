@@ -0,0 +1,34 @@
+#ifndef UBX_H
+#define UBX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <SerialPort.h>
+
+// u-blox UBX framing: B5 62 class id len(le16) payload ck_a ck_b
+#define UBX_SYNC1 0xB5
+#define UBX_SYNC2 0x62
+#define UBX_FRAME_OVERHEAD 8
+
+#define UBX_CLASS_CFG 0x06
+#define UBX_CFG_PRT 0x00
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+
+// Sends one UBX message
+void ubxSend(SerialPort& port, uint8_t cls, uint8_t id, const uint8_t* payload, uint16_t len);
+
+// CFG-RATE: navigation solution every measRateMs milliseconds
+void ubxSetRate(SerialPort& port, uint16_t measRateMs);
+
+// CFG-PRT for UART1: 8N1 at 'baud', accepts UBX+NMEA, outputs UBX only
+void ubxSetPortUbxOnly(SerialPort& port, uint32_t baud);
+
+// CFG-MSG: output message cls/id once every 'rate' solutions (0 = off)
+void ubxSetMessageRate(SerialPort& port, uint8_t cls, uint8_t id, uint8_t rate);
+
+// Sends "$PUBX,41,1,0007,0003,<baud>,0*CS": UART1 accepts UBX+NMEA,
+// outputs UBX+NMEA at the new baud rate. Takes effect after the sentence.
+void ubxSetBaudNmea(SerialPort& port, uint32_t baud);
+
+#endif
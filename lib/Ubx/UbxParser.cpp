@@ -0,0 +1,99 @@
+#include "UbxParser.h"
+#include "Ubx.h"
+
+UbxParser::UbxParser()
+  : state_(SYNC1), cls_(0), id_(0), len_(0), pos_(0), ckA_(0), ckB_(0),
+    framesOk_(0), checksumErrors_(0), oversized_(0) {
+}
+
+bool UbxParser::encode(uint8_t b) {
+  switch (state_) {
+    case SYNC1:
+      if (b == UBX_SYNC1) state_ = SYNC2;
+      break;
+    case SYNC2:
+      state_ = b == UBX_SYNC2 ? CLASS : (b == UBX_SYNC1 ? SYNC2 : SYNC1);
+      break;
+    case CLASS:
+      ckA_ = ckB_ = 0;
+      add(b);
+      cls_ = b;
+      state_ = ID;
+      break;
+    case ID:
+      add(b);
+      id_ = b;
+      state_ = LEN1;
+      break;
+    case LEN1:
+      add(b);
+      len_ = b;
+      state_ = LEN2;
+      break;
+    case LEN2:
+      add(b);
+      len_ |= (uint16_t)b << 8;
+      pos_ = 0;
+      if (len_ > UBX_MAX_PAYLOAD) {
+        oversized_++;
+        state_ = SYNC1;
+      } else {
+        state_ = len_ ? PAYLOAD : CK_A;
+      }
+      break;
+    case PAYLOAD:
+      add(b);
+      buf_[pos_++] = b;
+      if (pos_ >= len_) state_ = CK_A;
+      break;
+    case CK_A:
+      if (b == ckA_) {
+        state_ = CK_B;
+      } else {
+        checksumErrors_++;
+        state_ = b == UBX_SYNC1 ? SYNC2 : SYNC1;
+      }
+      break;
+    case CK_B:
+      state_ = SYNC1;
+      if (b == ckB_) {
+        framesOk_++;
+        return true;
+      }
+      checksumErrors_++;
+      if (b == UBX_SYNC1) state_ = SYNC2;
+      break;
+  }
+  return false;
+}
+
+static uint16_t u2(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t u4(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static int32_t i4(const uint8_t* p) { return (int32_t)u4(p); }
+
+bool ubxDecodeNavPvt(const uint8_t* p, uint16_t len, UbxNavPvt& out) {
+  if (len < UBX_NAV_PVT_LEN) return false;
+
+  out.year = u2(p + 4);
+  out.month = p[6];
+  out.day = p[7];
+  out.hour = p[8];
+  out.minute = p[9];
+  out.second = p[10];
+  out.dateValid = p[11] & 0x01;
+  out.timeValid = p[11] & 0x02;
+  out.nano = i4(p + 16);
+  out.fixType = p[20];
+  out.fixOk = p[21] & 0x01;
+  out.numSV = p[23];
+  out.lon_e7 = i4(p + 24);
+  out.lat_e7 = i4(p + 28);
+  out.hMSL_mm = i4(p + 36);
+  out.hAcc_mm = u4(p + 40);
+  out.gSpeed_mms = i4(p + 60);
+  out.headMot_e5 = i4(p + 64);
+  out.pDOP_e2 = u2(p + 76);
+  return true;
+}
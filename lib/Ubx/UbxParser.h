@@ -0,0 +1,74 @@
+#ifndef UBX_PARSER_H
+#define UBX_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UBX_CLASS_NAV 0x01
+#define UBX_NAV_PVT 0x07
+// NAV-PVT as u-blox 7 (protocol 14) sends it. u-blox 8 and later append
+// headVeh, magDec and magAcc for 92 bytes; nothing past 84 is read.
+#define UBX_NAV_PVT_LEN 84
+
+// Largest payload kept; longer frames are skipped (and counted)
+#ifndef UBX_MAX_PAYLOAD
+#define UBX_MAX_PAYLOAD 100
+#endif
+
+// Byte-at-a-time UBX frame parser. Resynchronises on the next B5 62 after
+// any error; frames with a bad checksum are dropped.
+class UbxParser {
+public:
+  UbxParser();
+
+  // Returns true when b completes a valid frame; the frame stays
+  // available through msgClass()/msgId()/payload() until the next byte
+  bool encode(uint8_t b);
+
+  uint8_t msgClass() const { return cls_; }
+  uint8_t msgId() const { return id_; }
+  uint16_t length() const { return len_; }
+  const uint8_t* payload() const { return buf_; }
+
+  uint32_t framesOk() const { return framesOk_; }
+  uint32_t checksumErrors() const { return checksumErrors_; }
+  uint32_t oversized() const { return oversized_; }
+
+private:
+  enum State { SYNC1, SYNC2, CLASS, ID, LEN1, LEN2, PAYLOAD, CK_A, CK_B };
+
+  void add(uint8_t b) { ckA_ += b; ckB_ += ckA_; }
+
+  State state_;
+  uint8_t cls_, id_;
+  uint16_t len_, pos_;
+  uint8_t ckA_, ckB_;
+  uint8_t buf_[UBX_MAX_PAYLOAD];
+  uint32_t framesOk_;
+  uint32_t checksumErrors_;
+  uint32_t oversized_;
+};
+
+// The NAV-PVT fields the tracker uses
+struct UbxNavPvt {
+  uint16_t year;
+  uint8_t month, day, hour, minute, second;
+  int32_t nano;         // -1e9..1e9 added to the above (which is rounded)
+  bool dateValid;
+  bool timeValid;
+  uint8_t fixType;      // 0 none, 2 2D, 3 3D
+  bool fixOk;           // gnssFixOK flag
+  uint8_t numSV;
+  int32_t lon_e7;       // degrees * 1e7
+  int32_t lat_e7;
+  int32_t hMSL_mm;
+  int32_t gSpeed_mms;   // ground speed, mm/s
+  int32_t headMot_e5;   // heading of motion, degrees * 1e5
+  uint32_t hAcc_mm;
+  uint16_t pDOP_e2;
+};
+
+// Decodes a NAV-PVT payload; false if it is shorter than UBX_NAV_PVT_LEN
+bool ubxDecodeNavPvt(const uint8_t* payload, uint16_t len, UbxNavPvt& out);
+
+#endif
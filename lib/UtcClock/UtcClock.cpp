@@ -0,0 +1,80 @@
+#include "UtcClock.h"
+
+UtcClock::UtcClock(Clock& clock)
+  : clock_(clock), valid_(false), anchorMs_(0), anchorUtc_(0), driftPpb_(0), lastErrorMs_(0),
+    haveRef_(false), refMs_(0), refUtc_(0), haveNextRef_(false), nextRefMs_(0), nextRefUtc_(0),
+    windowOpen_(false), windowStart_(0), bestMs_(0),
+    bestUtc_(0), bestError_(0), syncs_(0), steps_(0) {}
+
+uint64_t UtcClock::at(uint32_t ms) const {
+  if (!valid_) return 0;
+  int64_t elapsed = (int32_t)(ms - anchorMs_);
+  return anchorUtc_ + elapsed + elapsed * driftPpb_ / 1000000000;
+}
+
+void UtcClock::anchor(uint32_t ms, uint64_t utcMs) {
+  anchorMs_ = ms;
+  anchorUtc_ = utcMs;
+  valid_ = true;
+  syncs_++;
+}
+
+void UtcClock::discipline(uint32_t ms, uint64_t utcMs) {
+  if (!valid_) {
+    // Good enough to stamp readings with straight away
+    anchor(ms, utcMs);
+    return;
+  }
+  if (windowOpen_ && ms - windowStart_ >= UTC_WINDOW_MS) commit();
+
+  int64_t error = (int64_t)(utcMs - at(ms));
+  if (!windowOpen_) {
+    windowOpen_ = true;
+    windowStart_ = ms;
+  } else if (error <= bestError_) {
+    return;
+  }
+  bestMs_ = ms;
+  bestUtc_ = utcMs;
+  bestError_ = error;
+}
+
+// Closes a window: steps the clock, or nudges it and updates the drift
+void UtcClock::commit() {
+  windowOpen_ = false;
+  lastErrorMs_ = (int32_t)(bestError_ > INT32_MAX ? INT32_MAX :
+                           bestError_ < INT32_MIN ? INT32_MIN : bestError_);
+  if (bestError_ > UTC_STEP_MS || bestError_ < -UTC_STEP_MS) {
+    // The baseline is no good across a step; the drift estimate is kept
+    anchor(bestMs_, bestUtc_);
+    steps_++;
+    haveRef_ = false;
+    return;
+  }
+  anchor(bestMs_, bestError_ >= 0 ? bestUtc_ : bestUtc_ - bestError_ + bestError_ / 4);
+
+  if (!haveRef_) {
+    haveRef_ = true;
+    haveNextRef_ = false;
+    refMs_ = bestMs_;
+    refUtc_ = bestUtc_;
+    return;
+  }
+
+  uint32_t span = bestMs_ - refMs_;
+  if (!haveNextRef_ && span >= UTC_DRIFT_MAX_SPAN_MS / 2) {
+    haveNextRef_ = true;
+    nextRefMs_ = bestMs_;
+    nextRefUtc_ = bestUtc_;
+  }
+  if (span < UTC_DRIFT_MIN_SPAN_MS) return;
+  int64_t drift = ((int64_t)(bestUtc_ - refUtc_) - span) * 1000000000 / span;
+  if (drift > UTC_MAX_DRIFT_PPB) drift = UTC_MAX_DRIFT_PPB;
+  if (drift < -UTC_MAX_DRIFT_PPB) drift = -UTC_MAX_DRIFT_PPB;
+  driftPpb_ = (int32_t)drift;
+  if (span >= UTC_DRIFT_MAX_SPAN_MS) {
+    refMs_ = nextRefMs_;
+    refUtc_ = nextRefUtc_;
+    haveNextRef_ = false;
+  }
+}
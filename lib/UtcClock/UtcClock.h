@@ -0,0 +1,93 @@
+#ifndef UTC_CLOCK_H
+#define UTC_CLOCK_H
+
+#include <stdint.h>
+#include <Clock.h>
+
+// GPS times are collected over windows of this length; the least delayed
+// one disciplines the clock when the window closes
+#ifndef UTC_WINDOW_MS
+#define UTC_WINDOW_MS 10000
+#endif
+
+// A larger error is a step (the first sync after an outage, or a bad
+// time), not drift
+#define UTC_STEP_MS 500
+
+// Drift is measured over at least this long a baseline. Once the baseline
+// is this old it is shortened to half, so temperature changes are followed
+#define UTC_DRIFT_MIN_SPAN_MS 600000
+#define UTC_DRIFT_MAX_SPAN_MS 3600000
+
+// Crystals are good to well within this
+#define UTC_MAX_DRIFT_PPB 500000
+
+// millis() anchored to GPS UTC.
+//
+// Every fix with a valid date and time is handed to discipline() with
+// the millis() at which it was parsed. A fix always reaches the tracker
+// a little after its time of validity (output delay, UART transfer,
+// queueing), so of each window the sample that predicts the latest UTC is
+// the least delayed one. If it is ahead of the clock the clock moves up
+// to it; if it is behind, the whole window was probably delayed, and the
+// clock only moves a quarter of the way back. Comparing window samples
+// at least ten minutes apart gives the oscillator's drift, which is
+// applied between syncs, so times stay good through GPS outages.
+//
+// Everything is integer arithmetic; at() is a few multiplications, cheap
+// enough for any event. Needs a sync at least every 24 days (the reach of
+// a signed millis() difference).
+class UtcClock {
+public:
+  explicit UtcClock(Clock& clock);
+
+  // A GPS time: UTC in milliseconds since 1970 as valid at millis() 'ms'
+  void discipline(uint32_t ms, uint64_t utcMs);
+
+  bool valid() const { return valid_; }
+
+  // UTC in milliseconds since 1970 at millis() 'ms'; 0 before the first sync
+  uint64_t at(uint32_t ms) const;
+  uint64_t nowMs() { return at(clock_.millis()); }
+
+  // Same in seconds, as the flash store keeps it
+  uint32_t seconds(uint32_t ms) const { return (uint32_t)(at(ms) / 1000); }
+
+  int32_t driftPpb() const { return driftPpb_; }  // positive: millis() runs slow
+  int32_t lastErrorMs() const { return lastErrorMs_; }
+  uint32_t lastSyncMs() const { return anchorMs_; }
+  uint32_t syncs() const { return syncs_; }
+  uint32_t steps() const { return steps_; }
+
+private:
+  void commit();
+  void anchor(uint32_t ms, uint64_t utcMs);
+
+  Clock& clock_;
+  bool valid_;
+  uint32_t anchorMs_;
+  uint64_t anchorUtc_;
+  int32_t driftPpb_;
+  int32_t lastErrorMs_;
+
+  // Start of the drift baseline (a window's best sample), and the one
+  // that takes over when the baseline gets too long
+  bool haveRef_;
+  uint32_t refMs_;
+  uint64_t refUtc_;
+  bool haveNextRef_;
+  uint32_t nextRefMs_;
+  uint64_t nextRefUtc_;
+
+  // The window being collected, and its best sample so far
+  bool windowOpen_;
+  uint32_t windowStart_;
+  uint32_t bestMs_;
+  uint64_t bestUtc_;
+  int64_t bestError_;
+
+  uint32_t syncs_;
+  uint32_t steps_;
+};
+
+#endif
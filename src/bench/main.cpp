@@ -0,0 +1,1164 @@
+// Native benchmark: the tracker's data path from receiver bytes to the
+// bytes it hands the modem.
+//
+//   pio run -e bench && .pio/build/bench/program [-m minutes] [-f capture] [-r runs]
+//
+// Pipeline: a receiver log (recorded from the simulated drive in
+// SimRoute.h, or a raw capture given with -f) is replayed burst by
+// burst into a Tracker in virtual time, with a simulated SIM800 and ingest
+// server behind it. Reports fixes/s over the whole replay (the modem
+// model's share is small and constant), wire bytes per fix, and the heap
+// allocations the tracker itself makes.
+//
+// Encoding: the readings the pipeline kept are serialized the way an
+// upload does it (sizing pass, then one pass per CIPSEND chunk) for every
+// body format and a range of batch sizes: time per batch and per pass,
+// wire and body bytes, and the body's size against plain JSON. JSON is
+// deflated with the preset dictionary, as the tracker sends it, and
+// without it (nodict) to show what the dictionary is worth.
+//
+// GPS front end: the NMEA and UBX logs of the simulated drive through the
+// tracker's parsers, in bytes/s and time per epoch. The bench_tinygps
+// environment (-D BENCH_TINYGPS) adds stock TinyGPSPlus, what the tracker
+// used before, on the same NMEA bytes.
+//
+// Filter accuracy: the synthetic drive with receiver errors added
+// (noise, multipath jumps, 3-satellite stretches, short outages) is run
+// through the TrackFilter and compared with the route itself, including
+// the positions dead-reckoned through the outages.
+//
+// Geofences: the same noisy drive through the FenceEngine for growing
+// sets of random circles and polygons over the area it covers, images
+// built as the server builds them; per-fix cost against testing every
+// fence, and the inside state checked against that brute-force answer
+// (the odd disagreement is a fix within a centimetre of an edge).
+//
+// The pipeline uses the body format and MAX_UPLOAD_BATCH the build was
+// configured with; build with the usual -D flags to compare.
+//
+//   -m minutes  length of the recorded drive (default 60)
+//   -f file     replay a raw capture instead, in the build's protocol
+//               (epochs at GPS_RATE_HZ, started by each NAV-PVT or RMC)
+//   -r runs     repeat each measurement, report the fastest (default 3)
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+#include <RamFlash.h>
+#include <Ubx.h>
+#include <Tracker.h>
+#include <TelemetryJson.h>
+#include <TelemetryBinary.h>
+#include <Deflate.h>
+#include <TrackFilter.h>
+#include <NmeaParser.h>
+#include <UbxParser.h>
+#ifdef BENCH_TINYGPS
+#include <TinyGPS++.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_TSC 1
+#endif
+#include <SimClock.h>
+#include <SimNeo7m.h>
+#include <SimRoute.h>
+#include <SimSim800.h>
+#include <SimIngest.h>
+#include <SimFences.h>
+#include <SimLed.h>
+#include <HostConsole.h>
+
+#define TRACK_FLASH_SIZE 0xB0000  // the "track" partition
+#define FENCE_FLASH_SIZE 0x40000  // the "fence" partition
+#define MINUTE 60000u
+// CIPSEND_CHUNK_SIZE in Tracker.cpp
+#define BENCH_CHUNK_SIZE 1024
+// Readings serialized per cell of the encoding table
+#define ENCODE_RECORDS 20000
+
+// Receiver errors for the filter accuracy run
+#define NOISE_SIGMA_M 3.0f          // horizontal, per axis
+#define NOISE_SPEED_SIGMA_MPS 0.3f
+#define NOISE_COURSE_SIGMA_DEG 5.0f
+#define JUMP_PERCENT 2              // multipath: 50-300 m off, accuracy still claimed good
+#define DEGRADED_PERIOD_MS 300000   // every 5 min, 30 s with 3 satellites and 4x the noise
+#define DEGRADED_MS 30000
+// Every 3 min, 10 s without a fix; mid-leg, as the route turns instantly
+// between legs (SimRoute.cpp) and nothing could dead-reckon through that
+#define OUTAGE_PERIOD_MS 180000
+#define OUTAGE_START_MS 45000
+#define OUTAGE_MS 10000
+#define METRES_PER_DEGREE 111319.5
+// Where FenceEngine and the double-precision reference may disagree: the
+// engine measures in whole centimetres in a frame scaled by a Q15 cosine
+// (Geo.h), which moves an edge by millimetres, not more
+#define FENCE_EDGE_TOLERANCE_M 0.05
+
+typedef std::chrono::steady_clock BenchClock;
+
+static uint64_t nanosSince(BenchClock::time_point start) {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           BenchClock::now() - start).count();
+}
+
+static bool before(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+// Heap accounting. Every allocation carries a small header with its size
+// and whether it was made while counting, so frees are matched correctly.
+struct HeapStats {
+  bool counting;
+  uint64_t allocations;
+  uint64_t bytes;
+  int64_t live;
+  int64_t peak;
+};
+static HeapStats heap;
+
+struct AllocHeader {
+  size_t size;
+  size_t counted;
+};
+static_assert(sizeof(AllocHeader) % alignof(max_align_t) == 0, "header keeps alignment");
+
+void* operator new(size_t size) {
+  AllocHeader* h = (AllocHeader*)malloc(sizeof(AllocHeader) + size);
+  if (!h) throw std::bad_alloc();
+  h->size = size;
+  h->counted = heap.counting;
+  if (heap.counting) {
+    heap.allocations++;
+    heap.bytes += size;
+    heap.live += size;
+    if (heap.live > heap.peak) heap.peak = heap.live;
+  }
+  return h + 1;
+}
+
+void operator delete(void* p) noexcept {
+  if (!p) return;
+  AllocHeader* h = (AllocHeader*)p - 1;
+  if (h->counted) heap.live -= h->size;
+  free(h);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+// Attributes allocations to the tracker while in scope
+class Counted {
+public:
+  Counted() : wasCounting_(heap.counting) { heap.counting = true; }
+  ~Counted() { heap.counting = wasCounting_; }
+
+private:
+  bool wasCounting_;
+};
+
+class Paused {
+public:
+  Paused() : wasCounting_(heap.counting) { heap.counting = false; }
+  ~Paused() { heap.counting = wasCounting_; }
+
+private:
+  bool wasCounting_;
+};
+
+// The tracker's end of the modem model: what the model allocates is not
+// the tracker's
+class ModelPort : public SerialPort {
+public:
+  explicit ModelPort(SerialPort& inner) : inner_(inner), bytesOut_(0) {}
+
+  int available() override { Paused p; return inner_.available(); }
+  int read() override { Paused p; return inner_.read(); }
+  size_t read(uint8_t* buf, size_t len) override { Paused p; return inner_.read(buf, len); }
+  size_t write(const uint8_t* data, size_t len) override {
+    Paused p;
+    bytesOut_ += len;
+    return inner_.write(data, len);
+  }
+  using SerialPort::write;
+
+  uint64_t bytesOut() const { return bytesOut_; }
+
+private:
+  SerialPort& inner_;
+  uint64_t bytesOut_;
+};
+
+// A receiver log: what arrived from the GPS, and when
+struct LogChunk {
+  uint32_t ms;
+  std::string bytes;
+};
+typedef std::vector<LogChunk> ReceiverLog;
+
+// Records the simulated drive as the tracker would receive it, in NMEA
+// (the receiver's default) or UBX
+static void recordDrive(uint32_t minutes, bool ubx, ReceiverLog& log) {
+  SimClock clock;
+  SimRoute route(-6.927079, 79.861244, makeEpoch(2026, 3, 14, 8, 30, 0));
+  SimNeo7m gps(clock, SimRoute::track, &route);
+  if (ubx) {
+    ubxSetPortUbxOnly(gps.port(), gps.uart().baud());
+    ubxSetMessageRate(gps.port(), UBX_CLASS_NAV, UBX_NAV_PVT, 1);
+  }
+  ubxSetRate(gps.port(), 1000 / GPS_RATE_HZ);
+  gps.uart().setBaud(0);  // whole messages at once
+
+  uint32_t end = minutes * MINUTE;
+  while (before(clock.millis(), end)) {
+    gps.poll();
+    LogChunk chunk;
+    chunk.ms = clock.millis();
+    uint8_t buf[256];
+    size_t n;
+    while ((n = gps.port().read(buf, sizeof(buf))) > 0) chunk.bytes.append((const char*)buf, n);
+    if (!chunk.bytes.empty()) log.push_back(chunk);
+    clock.set(gps.nextEvent());
+  }
+}
+
+#ifndef GPS_PROTOCOL_UBX
+// Splits a raw NMEA capture into sentences; each RMC starts a new epoch
+static void splitNmea(const std::string& data, ReceiverLog& log) {
+  uint32_t epoch = 0;
+  size_t p = data.find('$');
+  while (p != std::string::npos) {
+    size_t end = data.find('$', p + 1);
+    size_t len = (end == std::string::npos ? data.size() : end) - p;
+    bool rmc = len > 6 && data.compare(p + 3, 3, "RMC") == 0;
+    if (rmc || log.empty()) {
+      LogChunk chunk;
+      chunk.ms = ++epoch * (1000 / GPS_RATE_HZ);
+      log.push_back(chunk);
+    }
+    log.back().bytes.append(data, p, len);
+    p = end;
+  }
+}
+
+#else
+// Splits a raw UBX capture into messages; each NAV-PVT starts a new epoch
+static void splitUbx(const std::string& data, ReceiverLog& log) {
+  uint32_t epoch = 0;
+  size_t p = 0;
+  while (p + UBX_FRAME_OVERHEAD <= data.size()) {
+    if ((uint8_t)data[p] != UBX_SYNC1 || (uint8_t)data[p + 1] != UBX_SYNC2) {
+      p++;
+      continue;
+    }
+    size_t len = (uint8_t)data[p + 4] | ((uint8_t)data[p + 5] << 8);
+    size_t total = len + UBX_FRAME_OVERHEAD;
+    if (p + total > data.size()) break;
+    bool pvt = (uint8_t)data[p + 2] == UBX_CLASS_NAV && (uint8_t)data[p + 3] == UBX_NAV_PVT;
+    if (pvt || log.empty()) {
+      LogChunk chunk;
+      chunk.ms = ++epoch * (1000 / GPS_RATE_HZ);
+      log.push_back(chunk);
+    }
+    log.back().bytes.append(data, p, total);
+    p += total;
+  }
+}
+#endif
+
+static bool loadCapture(const char* path, ReceiverLog& log) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  std::string data;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+  fclose(f);
+
+#ifdef GPS_PROTOCOL_UBX
+  splitUbx(data, log);
+#else
+  splitNmea(data, log);
+#endif
+  return !log.empty();
+}
+
+// Replays a receiver log. Each chunk becomes readable all at once when it
+// is due, as the UART driver hands a burst over on its RX timeout.
+class ReplayPort : public SerialPort {
+public:
+  ReplayPort(Clock& clock, const ReceiverLog& log) : clock_(clock), log_(log), chunk_(0), offset_(0) {}
+
+  int available() override {
+    if (chunk_ >= log_.size() || before(clock_.millis(), log_[chunk_].ms)) return 0;
+    return (int)(log_[chunk_].bytes.size() - offset_);
+  }
+
+  int read() override {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+  }
+
+  size_t read(uint8_t* buf, size_t len) override {
+    size_t n = (size_t)available();
+    if (n > len) n = len;
+    if (n == 0) return 0;
+    memcpy(buf, log_[chunk_].bytes.data() + offset_, n);
+    offset_ += n;
+    if (offset_ == log_[chunk_].bytes.size()) {
+      chunk_++;
+      offset_ = 0;
+    }
+    return n;
+  }
+
+  size_t write(const uint8_t* data, size_t len) override { return len; }
+  using SerialPort::write;
+
+  // When the next chunk is due; false at the end of the log
+  bool nextArrival(uint32_t& at) const {
+    if (chunk_ >= log_.size()) return false;
+    at = log_[chunk_].ms;
+    return true;
+  }
+
+private:
+  Clock& clock_;
+  const ReceiverLog& log_;
+  size_t chunk_;
+  size_t offset_;
+};
+
+struct PipelineResult {
+  uint64_t nanos;           // the whole replay, modem model included
+  uint64_t gpsNanos;        // in pollGps() with bytes to parse
+  uint64_t passes;
+  uint64_t allocations;
+  uint64_t allocatedBytes;
+  int64_t peakHeap;
+  uint32_t logBytes;
+  uint32_t fixes;
+  uint32_t stored;          // readings appended to the flash store
+  uint32_t uploadsOk;
+  uint32_t uploadsFailed;
+  uint64_t wireBytes;       // everything written to the modem
+  uint32_t serverReadings;
+};
+
+// Replays the log into a tracker; 'flash' keeps the readings it stored
+static void runPipeline(const ReceiverLog& log, RamFlash& flash, PipelineResult& r) {
+  memset(&r, 0, sizeof(r));
+  for (size_t i = 0; i < log.size(); i++) r.logBytes += log[i].bytes.size();
+
+  SimClock clock;
+  ReplayPort gpsPort(clock, log);
+  SimIngest ingest;
+  SimSim800 modem(clock, SimIngest::handle, &ingest);
+  ModelPort modemPort(modem.port());
+  HostConsole console(false);
+  SimLed led(clock);
+
+  TrackerConfig config = { "ingest.example.com", 80, "/api/readings", "internet", "ESP_GPS_001" };
+  // No fence region: the geofence cost is measured on its own below
+  RamFlash fenceFlash(FENCE_FLASH_SIZE);
+  Tracker tracker(config, clock, console, modemPort, gpsPort, led, flash, fenceFlash);
+
+  heap.allocations = 0;
+  heap.bytes = 0;
+  heap.live = 0;
+  heap.peak = 0;
+  BenchClock::time_point start = BenchClock::now();
+  {
+    Counted c;
+    tracker.begin(true);
+  }
+
+  // Long enough after the last fix for the final upload
+  uint32_t end = log.back().ms + 2 * MINUTE;
+  while (before(clock.millis(), end)) {
+    modem.poll();
+    {
+      Counted c;
+      if (gpsPort.available() > 0) {
+        BenchClock::time_point parse = BenchClock::now();
+        tracker.pollGps();
+        r.gpsNanos += nanosSince(parse);
+      }
+      tracker.loop();
+    }
+    r.passes++;
+
+    uint32_t ms = clock.millis();
+    uint32_t idle = tracker.sleepFor();
+    uint32_t next = ms + (idle ? idle : 1);
+    uint32_t at;
+    if (gpsPort.nextArrival(at) && before(at, next)) next = at;
+    if (modem.nextEvent(at) && before(at, next)) next = at;
+    if (!before(ms, next)) next = ms + 1;
+    clock.set(next);
+  }
+  r.nanos = nanosSince(start);
+
+  r.allocations = heap.allocations;
+  r.allocatedBytes = heap.bytes;
+  r.peakHeap = heap.peak;
+  r.fixes = tracker.fixesSeen();
+  r.stored = tracker.store().nextSeq() - 1;
+  r.uploadsOk = tracker.uploadsOk();
+  r.uploadsFailed = tracker.uploadsFailed();
+  r.wireBytes = modemPort.bytesOut();
+  r.serverReadings = ingest.readings();
+}
+
+// Readings as an upload sees them
+struct BenchReading {
+  StoredFix fix;
+};
+
+struct EncodeSource {
+  const std::vector<BenchReading>* readings;
+  size_t first;
+};
+
+static bool encodeSource(size_t index, TelemetryRecord& out, void* ctx) {
+  const EncodeSource& s = *(const EncodeSource*)ctx;
+  const BenchReading& r = (*s.readings)[(s.first + index) % s.readings->size()];
+  out.seq = r.fix.seq;
+  out.ts = r.fix.ts;
+  out.utc = r.fix.utc;
+  out.flags = 0;
+  if (r.fix.flags & FIXSTORE_FLAG_UTC) out.flags |= TELEMETRY_FLAG_UTC;
+  if (r.fix.flags & FIXSTORE_FLAG_CACHED) out.flags |= TELEMETRY_FLAG_CACHED;
+  if (r.fix.flags & FIXSTORE_FLAG_ESTIMATED) out.flags |= TELEMETRY_FLAG_ESTIMATED;
+  if (r.fix.flags & FIXSTORE_FLAG_FENCE) out.flags |= TELEMETRY_FLAG_FENCE;
+  out.lat_e7 = r.fix.lat_e7;
+  out.lng_e7 = r.fix.lng_e7;
+  out.speed_e2 = r.fix.speed_e2;
+  out.alt_dm = r.fix.alt_dm;
+  out.satellites = r.fix.satellites;
+  return true;
+}
+
+static void loadReadings(RamFlash& flash, std::vector<BenchReading>& out) {
+  FixStore store(flash);
+  if (!store.begin()) return;
+  for (uint32_t seq = 1; seq < store.nextSeq(); seq++) {
+    BenchReading r;
+    if (!store.read(seq, r.fix) || !(r.fix.flags & FIXSTORE_FLAG_VALID)) continue;
+    out.push_back(r);
+  }
+}
+
+enum BodyFormat {
+  FORMAT_JSON, FORMAT_JSON_DEFLATE, FORMAT_JSON_DEFLATE_NODICT, FORMAT_BINARY, FORMAT_BINARY_DEFLATE
+};
+static const char* const formatNames[] = { "json", "json+deflate", "json+dfl nodict", "tbin",
+                                           "tbin+deflate" };
+
+// One upload request, serialized the way Tracker::writeRequest() does it
+class RequestWriter {
+public:
+  explicit RequestWriter(BodyFormat format) : format_(format), bodyLength_(0) {}
+
+  // Takes the next batch and sizes its body
+  void begin(const TelemetryBatch& batch) {
+    batch_ = batch;
+    CountingSink counter;
+    writeBody(counter);
+    bodyLength_ = counter.count();
+  }
+
+  size_t bodyLength() const { return bodyLength_; }
+
+  void writeHeader(ByteSink& sink) {
+    bool binary = format_ == FORMAT_BINARY || format_ == FORMAT_BINARY_DEFLATE;
+    writeHttpPostHeader(sink, "ingest.example.com", "/api/readings",
+                        binary ? TBIN_CONTENT_TYPE : "application/json", bodyLength_,
+                        deflated() ? "deflate" : 0);
+  }
+
+  void writeBody(ByteSink& sink) {
+    switch (format_) {
+      case FORMAT_JSON:
+        writeTelemetryJson(sink, batch_);
+        break;
+      case FORMAT_BINARY:
+        writeTelemetryBinary(sink, batch_);
+        break;
+      case FORMAT_JSON_DEFLATE:
+        deflater_.begin(sink, telemetryJsonDictionary, telemetryJsonDictionaryLength);
+        writeTelemetryJson(deflater_, batch_);
+        deflater_.finish();
+        break;
+      case FORMAT_JSON_DEFLATE_NODICT:
+        deflater_.begin(sink);
+        writeTelemetryJson(deflater_, batch_);
+        deflater_.finish();
+        break;
+      case FORMAT_BINARY_DEFLATE:
+        deflater_.begin(sink);
+        writeTelemetryBinary(deflater_, batch_);
+        deflater_.finish();
+        break;
+    }
+  }
+
+private:
+  bool deflated() const { return format_ != FORMAT_JSON && format_ != FORMAT_BINARY; }
+
+  BodyFormat format_;
+  TelemetryBatch batch_;
+  size_t bodyLength_;
+  DeflateSink deflater_;
+};
+
+struct EncodeResult {
+  uint64_t nanos;
+  uint64_t requestBytes;
+  uint64_t bodyBytes;
+  uint64_t passes;
+  uint64_t allocations;
+};
+
+// Serializes ENCODE_RECORDS readings in batches of 'batchSize'
+static void runEncode(const std::vector<BenchReading>& readings, BodyFormat format,
+                      size_t batchSize, EncodeResult& r) {
+  memset(&r, 0, sizeof(r));
+  heap.allocations = 0;
+  EncodeSource source = { &readings, 0 };
+  TelemetryBatch batch = { "ESP_GPS_001", batchSize, batchSize, encodeSource, &source, 0, 0 };
+
+  RequestWriter request(format);
+  Counted c;
+  BenchClock::time_point start = BenchClock::now();
+  for (size_t done = 0; done < ENCODE_RECORDS; done += batchSize) {
+    source.first = done;
+    request.begin(batch);
+    CountingSink headerCounter;
+    request.writeHeader(headerCounter);
+    size_t length = headerCounter.count() + request.bodyLength();
+
+    CountingSink wire;
+    for (size_t offset = 0; offset < length; offset += BENCH_CHUNK_SIZE) {
+      WindowSink window(wire, offset, BENCH_CHUNK_SIZE);
+      request.writeHeader(window);
+      request.writeBody(window);
+      r.passes++;
+    }
+    r.requestBytes += wire.count();
+    r.bodyBytes += request.bodyLength();
+  }
+  r.nanos = nanosSince(start);
+  r.allocations = heap.allocations;
+}
+
+// GPS front end. Each parser runs over a whole log; the fields the
+// tracker reads from every fix are read here too.
+static volatile float parseSink;
+
+static std::string concat(const ReceiverLog& log) {
+  std::string bytes;
+  for (size_t i = 0; i < log.size(); i++) bytes += log[i].bytes;
+  return bytes;
+}
+
+static uint32_t parseNmea(const std::string& bytes) {
+  NmeaParser parser;
+  uint32_t fixes = 0;
+  const uint8_t* p = (const uint8_t*)bytes.data();
+  for (size_t i = 0; i < bytes.size(); i++) {
+    if (!parser.encode(p[i])) continue;
+    const NmeaFix& f = parser.fix();
+    if (!f.valid) continue;
+    parseSink = f.lat_e7 / 1e7f + f.lng_e7 / 1e7f + f.speed_mms * 0.0036f + f.alt_dm / 10.0f +
+                f.course_e2 / 100.0f + f.hdop_e2 + f.satellites + f.year + f.second;
+    fixes++;
+  }
+  return fixes;
+}
+
+static uint32_t parseUbx(const std::string& bytes) {
+  UbxParser parser;
+  uint32_t fixes = 0;
+  const uint8_t* p = (const uint8_t*)bytes.data();
+  for (size_t i = 0; i < bytes.size(); i++) {
+    if (!parser.encode(p[i])) continue;
+    if (parser.msgClass() != UBX_CLASS_NAV || parser.msgId() != UBX_NAV_PVT) continue;
+    UbxNavPvt pvt;
+    if (!ubxDecodeNavPvt(parser.payload(), parser.length(), pvt) || !pvt.fixOk) continue;
+    parseSink = pvt.lat_e7 / 1e7f + pvt.lon_e7 / 1e7f + pvt.gSpeed_mms * 0.0036f +
+                pvt.hMSL_mm / 1000.0f + pvt.headMot_e5 / 1e5f + pvt.hAcc_mm + pvt.numSV +
+                pvt.year + pvt.second;
+    fixes++;
+  }
+  return fixes;
+}
+
+#ifdef BENCH_TINYGPS
+// As Tracker::publishFix() used it: every sentence through encode(), the
+// fields read whenever the location was updated (by RMC and by GGA)
+static uint32_t parseTinyGps(const std::string& bytes) {
+  TinyGPSPlus gps;
+  uint32_t fixes = 0;
+  for (size_t i = 0; i < bytes.size(); i++) {
+    if (!gps.encode(bytes[i])) continue;
+    if (!gps.location.isValid() || !gps.location.isUpdated()) continue;
+    parseSink = gps.location.lat() + gps.location.lng() + gps.speed.kmph() +
+                gps.altitude.meters() + gps.course.deg() + gps.hdop.hdop() +
+                gps.satellites.value() + gps.date.year() + gps.time.second();
+    fixes++;
+  }
+  return fixes;
+}
+#endif
+
+struct ParseResult {
+  uint64_t nanos;
+  uint64_t ticks;   // TSC, where there is one
+  uint32_t fixes;
+};
+
+static void timeParser(uint32_t (*parse)(const std::string&), const std::string& bytes, int runs,
+                       ParseResult& r) {
+  memset(&r, 0, sizeof(r));
+  for (int run = 0; run < runs; run++) {
+#ifdef BENCH_TSC
+    uint64_t tsc = __rdtsc();
+#endif
+    BenchClock::time_point start = BenchClock::now();
+    uint32_t fixes = parse(bytes);
+    uint64_t nanos = nanosSince(start);
+#ifdef BENCH_TSC
+    uint64_t ticks = __rdtsc() - tsc;
+#else
+    uint64_t ticks = 0;
+#endif
+    if (run == 0 || nanos < r.nanos) {
+      r.nanos = nanos;
+      r.ticks = ticks;
+    }
+    r.fixes = fixes;
+  }
+}
+
+static void printParser(const char* name, const ParseResult& r, size_t bytes, size_t epochs) {
+  printf("  %-14s %10.1f %9.2f %11.0f %10.0f %7u\n", name, bytes / (r.nanos / 1e3),
+         (double)r.nanos / bytes, (double)r.nanos / epochs, (double)r.ticks / epochs,
+         (unsigned)r.fixes);
+}
+
+// Deterministic noise source (64-bit LCG)
+class Noise {
+public:
+  explicit Noise(uint64_t seed) : state_(seed) {}
+  double uniform() {
+    state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+    return ((state_ >> 11) + 0.5) / 9007199254740992.0;
+  }
+  double gauss() {
+    return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+  }
+private:
+  uint64_t state_;
+};
+
+struct ErrorStats {
+  double sum2;
+  double max;
+  uint32_t n;
+  void add(double e) {
+    sum2 += e * e;
+    if (e > max) max = e;
+    n++;
+  }
+  double rms() const { return n ? sqrt(sum2 / n) : 0; }
+};
+
+// A fix as the receiver reported it, and where the vehicle really was
+struct NoisyFix {
+  bool valid;
+  bool jump;
+  FilterFix fix;
+  double lat;
+  double lng;
+};
+
+static double errorM(int32_t lat_e7, int32_t lng_e7, double lat, double lng) {
+  double north = (lat_e7 / 1e7 - lat) * METRES_PER_DEGREE;
+  double east = (lng_e7 / 1e7 - lng) * METRES_PER_DEGREE * cos(lat * M_PI / 180);
+  return sqrt(north * north + east * east);
+}
+
+// The synthetic drive at GPS_RATE_HZ with receiver errors added
+static void recordNoisyDrive(uint32_t minutes, std::vector<NoisyFix>& out) {
+  SimRoute route(-6.927079, 79.861244, makeEpoch(2026, 3, 14, 8, 30, 0));
+  Noise noise(12345);
+  out.clear();
+  for (uint32_t ms = 0; ms < minutes * MINUTE; ms += 1000 / GPS_RATE_HZ) {
+    SimFix truth;
+    SimRoute::track(ms, truth, &route);
+    NoisyFix f;
+    memset(&f, 0, sizeof(f));
+    f.lat = truth.lat;
+    f.lng = truth.lng;
+    f.fix.ms = ms;
+    uint32_t cycle = ms % OUTAGE_PERIOD_MS;
+    f.valid = truth.valid && (cycle < OUTAGE_START_MS || cycle >= OUTAGE_START_MS + OUTAGE_MS);
+    if (f.valid) {
+      bool degraded = ms % DEGRADED_PERIOD_MS < DEGRADED_MS;
+      double sigma = degraded ? 4 * NOISE_SIGMA_M : NOISE_SIGMA_M;
+      double north = noise.gauss() * sigma;
+      double east = noise.gauss() * sigma;
+      if (noise.uniform() * 100 < JUMP_PERCENT) {
+        double d = 50 + 250 * noise.uniform();
+        double a = 2 * M_PI * noise.uniform();
+        north += d * cos(a);
+        east += d * sin(a);
+        f.jump = true;
+      }
+      double lat = truth.lat + north / METRES_PER_DEGREE;
+      double lng = truth.lng + east / (METRES_PER_DEGREE * cos(truth.lat * M_PI / 180));
+      f.fix.lat_e7 = (int32_t)lround(lat * 1e7);
+      f.fix.lng_e7 = (int32_t)lround(lng * 1e7);
+      double speed = truth.speedKmh / 3.6 + noise.gauss() * NOISE_SPEED_SIGMA_MPS;
+      f.fix.speed_e1 = (uint16_t)lround(speed > 0 ? speed * 36 : 0);
+      double course = fmod(truth.courseDeg + noise.gauss() * NOISE_COURSE_SIGMA_DEG + 360, 360);
+      f.fix.course_e1 = (uint16_t)(lround(course * 10) % 3600);
+      f.fix.accuracy_mm = (uint32_t)lround(sigma * 1000);
+      f.fix.satellites = degraded ? 3 : truth.satellites;
+    }
+    out.push_back(f);
+  }
+}
+
+struct AccuracyResult {
+  uint32_t fixes;
+  uint32_t jumps;
+  uint32_t jumpsRejected;
+  uint32_t rejected;
+  uint32_t restarts;
+  ErrorStats raw;
+  ErrorStats rawNoJumps;
+  ErrorStats filtered;
+  ErrorStats estimated[3];  // up to 5, 10 and 30 s into an outage
+  ErrorStats repeated[3];   // ... the last position repeated instead
+  uint64_t nanos;           // filter updates only
+};
+
+static void runAccuracy(const std::vector<NoisyFix>& drive, int runs, AccuracyResult& r) {
+  memset(&r, 0, sizeof(r));
+  TrackFilter filter(TrackFilter::defaults());
+  FilterFix last;
+  memset(&last, 0, sizeof(last));
+  for (size_t i = 0; i < drive.size(); i++) {
+    const NoisyFix& f = drive[i];
+    if (!f.valid) {
+      if (!filter.started()) continue;
+      uint32_t elapsed = f.fix.ms - filter.lastAcceptedMs();
+      if (elapsed % 1000 != 0) continue;
+      int bucket = elapsed <= 5000 ? 0 : elapsed <= 10000 ? 1 : 2;
+      FilterFix est;
+      if (!filter.predict(f.fix.ms, est)) continue;
+      r.estimated[bucket].add(errorM(est.lat_e7, est.lng_e7, f.lat, f.lng));
+      r.repeated[bucket].add(errorM(last.lat_e7, last.lng_e7, f.lat, f.lng));
+      continue;
+    }
+    r.fixes++;
+    double rawError = errorM(f.fix.lat_e7, f.fix.lng_e7, f.lat, f.lng);
+    r.raw.add(rawError);
+    if (f.jump) r.jumps++;
+    else r.rawNoJumps.add(rawError);
+
+    FilterFix out;
+    if (filter.update(f.fix, out) == FILTER_REJECTED) {
+      if (f.jump) r.jumpsRejected++;
+      continue;
+    }
+    r.filtered.add(errorM(out.lat_e7, out.lng_e7, f.lat, f.lng));
+    last = out;
+  }
+  r.rejected = filter.rejected();
+  r.restarts = filter.restarts();
+
+  // Cost: the same updates again, timed as a whole
+  for (int run = 0; run < runs; run++) {
+    TrackFilter timed(TrackFilter::defaults());
+    FilterFix out;
+    BenchClock::time_point start = BenchClock::now();
+    for (size_t i = 0; i < drive.size(); i++) {
+      if (drive[i].valid) timed.update(drive[i].fix, out);
+    }
+    uint64_t nanos = nanosSince(start);
+    if (run == 0 || nanos < r.nanos) r.nanos = nanos;
+  }
+}
+
+// Random fences over the box the drive covers (plus a margin): half
+// circles of 50-500 m, half polygons of 3-12 vertices and 100-600 m
+static void randomFences(const std::vector<NoisyFix>& drive, size_t count, std::vector<SimFence>& out) {
+  double minLat = 90, maxLat = -90, minLng = 180, maxLng = -180;
+  for (size_t i = 0; i < drive.size(); i++) {
+    minLat = fmin(minLat, drive[i].lat);
+    maxLat = fmax(maxLat, drive[i].lat);
+    minLng = fmin(minLng, drive[i].lng);
+    maxLng = fmax(maxLng, drive[i].lng);
+  }
+  double margin = 1000 / METRES_PER_DEGREE;
+  minLat -= margin;
+  maxLat += margin;
+  minLng -= margin;
+  maxLng += margin;
+  double lngScale = cos((minLat + maxLat) / 2 * M_PI / 180);
+
+  Noise noise(count);
+  out.clear();
+  for (size_t i = 0; i < count; i++) {
+    SimFence f;
+    f.id = (uint32_t)(i + 1);
+    f.lat = minLat + (maxLat - minLat) * noise.uniform();
+    f.lng = minLng + (maxLng - minLng) * noise.uniform();
+    f.radiusM = 0;
+    if (i % 2 == 0) {
+      f.type = FENCE_CIRCLE;
+      f.radiusM = 50 + 450 * noise.uniform();
+    } else {
+      f.type = FENCE_POLYGON;
+      int vertices = 3 + (int)(10 * noise.uniform());
+      double size = 100 + 500 * noise.uniform();
+      for (int v = 0; v < vertices; v++) {
+        double a = 2 * M_PI * v / vertices;
+        double r = size * (0.4 + 0.6 * noise.uniform()) / METRES_PER_DEGREE;
+        f.vertices.push_back(f.lat + r * sin(a));
+        f.vertices.push_back(f.lng + r * cos(a) / lngScale);
+      }
+    }
+    out.push_back(f);
+  }
+}
+
+// Whether a point is in a fence, in doubles, with no index
+static bool insideFence(const SimFence& f, double lat, double lng) {
+  if (f.type == FENCE_CIRCLE) {
+    double north = (lat - f.lat) * METRES_PER_DEGREE;
+    double east = (lng - f.lng) * METRES_PER_DEGREE * cos(f.lat * M_PI / 180);
+    return north * north + east * east <= f.radiusM * f.radiusM;
+  }
+  bool in = false;
+  size_t n = f.vertices.size() / 2;
+  for (size_t i = 0, j = n - 1; i < n; j = i++) {
+    double latI = f.vertices[2 * i], lngI = f.vertices[2 * i + 1];
+    double latJ = f.vertices[2 * j], lngJ = f.vertices[2 * j + 1];
+    if ((latI > lat) != (latJ > lat) && lng < (lngJ - lngI) * (lat - latI) / (latJ - latI) + lngI) {
+      in = !in;
+    }
+  }
+  return in;
+}
+
+// Distance from a point to a fence's edge, in doubles
+static double edgeDistanceM(const SimFence& f, double lat, double lng) {
+  if (f.type == FENCE_CIRCLE) {
+    double north = (lat - f.lat) * METRES_PER_DEGREE;
+    double east = (lng - f.lng) * METRES_PER_DEGREE * cos(f.lat * M_PI / 180);
+    return fabs(sqrt(north * north + east * east) - f.radiusM);
+  }
+  double best = HUGE_VAL;
+  double lngScale = METRES_PER_DEGREE * cos(lat * M_PI / 180);
+  size_t n = f.vertices.size() / 2;
+  for (size_t i = 0, j = n - 1; i < n; j = i++) {
+    double ax = (f.vertices[2 * i + 1] - lng) * lngScale, ay = (f.vertices[2 * i] - lat) * METRES_PER_DEGREE;
+    double bx = (f.vertices[2 * j + 1] - lng) * lngScale, by = (f.vertices[2 * j] - lat) * METRES_PER_DEGREE;
+    double dx = bx - ax, dy = by - ay;
+    double t = dx || dy ? -(ax * dx + ay * dy) / (dx * dx + dy * dy) : 0;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    best = fmin(best, hypot(ax + t * dx, ay + t * dy));
+  }
+  return best;
+}
+
+// A fix and fence where the engine and the reference disagree
+struct FenceMismatch {
+  uint32_t fences;      // in the run
+  uint32_t fenceId;
+  uint8_t type;
+  int32_t lat_e7;
+  int32_t lng_e7;
+  bool engineInside;
+  double edgeM;
+};
+
+struct FenceResult {
+  size_t imageBytes;
+  uint16_t cols;
+  uint16_t rows;
+  uint32_t fixes;
+  uint32_t events;
+  uint32_t tests;
+  uint32_t cellLoads;
+  uint32_t mismatches;      // fix and fence where the engine and brute force differ
+  uint64_t nanos;           // engine updates only
+  uint64_t bruteNanos;      // every fence tested on every fix
+};
+
+// False if the image does not fit the fence slot
+static bool runFences(const std::vector<NoisyFix>& drive, size_t count, int runs, FenceResult& r,
+                      std::vector<FenceMismatch>& mismatches) {
+  memset(&r, 0, sizeof(r));
+  std::vector<SimFence> fences;
+  randomFences(drive, count, fences);
+  std::vector<uint8_t> image = buildFenceImage(fences, 1);
+  r.imageBytes = image.size();
+
+  RamFlash flash(FENCE_FLASH_SIZE);
+  FenceStore store(flash);
+  store.begin();
+  if (!store.beginWrite() || !store.write(&image[0], image.size()) || !store.commit()) {
+    printf("FAIL: %u fences: image %u B exceeds slot capacity (%u B)\n", (unsigned)count,
+           (unsigned)image.size(), (unsigned)store.capacity());
+    return false;
+  }
+  r.cols = store.header().cols;
+  r.rows = store.header().rows;
+
+  // Correctness, fix by fix
+  FenceEngine engine(store, 0, 0);
+  engine.begin();
+  for (size_t i = 0; i < drive.size(); i++) {
+    if (!drive[i].valid) continue;
+    const FilterFix& f = drive[i].fix;
+    engine.update(f.ms, f.lat_e7, f.lng_e7);
+    for (size_t k = 0; k < fences.size(); k++) {
+      double lat = f.lat_e7 / 1e7, lng = f.lng_e7 / 1e7;
+      bool inside = engine.inside((uint16_t)k);
+      if (inside != insideFence(fences[k], lat, lng)) {
+        r.mismatches++;
+        FenceMismatch m = { (uint32_t)count, fences[k].id, fences[k].type, f.lat_e7, f.lng_e7, inside,
+                            edgeDistanceM(fences[k], lat, lng) };
+        mismatches.push_back(m);
+      }
+    }
+  }
+  r.fixes = engine.fixes();
+  r.events = engine.events();
+  r.tests = engine.tests();
+  r.cellLoads = engine.cellLoads();
+
+  volatile uint32_t sink = 0;
+  for (int run = 0; run < runs; run++) {
+    FenceEngine timed(store, 0, 0);
+    timed.begin();
+    BenchClock::time_point start = BenchClock::now();
+    for (size_t i = 0; i < drive.size(); i++) {
+      if (drive[i].valid) timed.update(drive[i].fix.ms, drive[i].fix.lat_e7, drive[i].fix.lng_e7);
+    }
+    uint64_t nanos = nanosSince(start);
+    if (run == 0 || nanos < r.nanos) r.nanos = nanos;
+
+    start = BenchClock::now();
+    for (size_t i = 0; i < drive.size(); i++) {
+      if (!drive[i].valid) continue;
+      double lat = drive[i].fix.lat_e7 / 1e7, lng = drive[i].fix.lng_e7 / 1e7;
+      for (size_t k = 0; k < fences.size(); k++) sink = sink + insideFence(fences[k], lat, lng);
+    }
+    nanos = nanosSince(start);
+    if (run == 0 || nanos < r.bruteNanos) r.bruteNanos = nanos;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint32_t minutes = 60;
+  const char* capture = 0;
+  int runs = 3;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) minutes = (uint32_t)atoi(argv[++i]);
+    else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) capture = argv[++i];
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) runs = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [-m minutes] [-f log.ubx] [-r runs]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (runs < 1) runs = 1;
+
+  ReceiverLog log;
+  if (capture) {
+    if (!loadCapture(capture, log)) {
+      fprintf(stderr, "%s: no receiver messages\n", capture);
+      return 1;
+    }
+  } else {
+#ifdef GPS_PROTOCOL_UBX
+    recordDrive(minutes, true, log);
+#else
+    recordDrive(minutes, false, log);
+#endif
+  }
+
+  // Pipeline. Runs are deterministic apart from the timings, so the
+  // readings of the first one serve for the encoding table.
+  PipelineResult best;
+  std::vector<BenchReading> readings;
+  for (int run = 0; run < runs; run++) {
+    RamFlash flash(TRACK_FLASH_SIZE);
+    PipelineResult r;
+    runPipeline(log, flash, r);
+    if (run == 0) loadReadings(flash, readings);
+    if (run == 0 || r.nanos < best.nanos) best = r;
+  }
+  const PipelineResult& p = best;
+  uint32_t fixes = p.fixes ? p.fixes : 1;
+
+#ifdef TELEMETRY_FORMAT_BINARY
+  const char* format = "tbin";
+#else
+  const char* format = "json";
+#endif
+#ifdef TELEMETRY_DEFLATE
+  const char* encoding = "+deflate";
+#else
+  const char* encoding = "";
+#endif
+
+  printf("Pipeline: %.1f min of receiver log, %u bytes, %s%s bodies, batches of up to %u\n",
+         log.back().ms / (double)MINUTE, (unsigned)p.logBytes, format, encoding,
+         (unsigned)MAX_UPLOAD_BATCH);
+  printf("  fixes        %u seen, %u readings stored, %u on the server\n",
+         (unsigned)p.fixes, (unsigned)p.stored, (unsigned)p.serverReadings);
+  printf("  uploads      %u ok, %u failed\n", (unsigned)p.uploadsOk, (unsigned)p.uploadsFailed);
+  printf("  time         %.1f ms over %llu loop passes, GPS parsing %.1f ms (%.1f ns/byte)\n",
+         p.nanos / 1e6, (unsigned long long)p.passes, p.gpsNanos / 1e6,
+         (double)p.gpsNanos / p.logBytes);
+  printf("  throughput   %.0f fixes/s, %.2f us/fix\n", p.fixes / (p.nanos / 1e9),
+         p.nanos / 1000.0 / fixes);
+  printf("  wire         %llu bytes to the modem, %.2f per fix, %.1f per reading\n",
+         (unsigned long long)p.wireBytes, (double)p.wireBytes / fixes,
+         (double)p.wireBytes / (p.stored ? p.stored : 1));
+  printf("  heap         %llu allocations (%.3f per fix, %llu bytes), peak %lld bytes\n",
+         (unsigned long long)p.allocations, (double)p.allocations / fixes,
+         (unsigned long long)p.allocatedBytes, (long long)p.peakHeap);
+  printf("  static       Tracker %u bytes\n", (unsigned)sizeof(Tracker));
+
+  // Encoding
+  if (readings.empty()) {
+    printf("\nNo readings kept, nothing to encode\n");
+    return 0;
+  }
+  static const size_t batchSizes[] = { 1, 10, 30, 60, 120 };
+  const size_t batchCount = sizeof(batchSizes) / sizeof(batchSizes[0]);
+  uint64_t jsonBodyBytes[batchCount];
+  printf("\nEncoding: %u readings per cell, %u byte CIPSEND chunks, deflate window %u B, chain %u\n",
+         (unsigned)ENCODE_RECORDS, (unsigned)BENCH_CHUNK_SIZE, 1u << DEFLATE_WINDOW_BITS,
+         (unsigned)DEFLATE_MAX_CHAIN);
+  printf("  %-15s %5s %12s %10s %8s %12s %11s %8s %7s %7s\n", "format", "batch", "readings/s",
+         "us/batch", "us/pass", "wire B/rdg", "body B/rdg", "vs json", "passes", "allocs");
+  for (int f = FORMAT_JSON; f <= FORMAT_BINARY_DEFLATE; f++) {
+    for (size_t b = 0; b < batchCount; b++) {
+      size_t size = batchSizes[b];
+      EncodeResult e = EncodeResult();
+      for (int run = 0; run < runs; run++) {
+        EncodeResult r;
+        runEncode(readings, (BodyFormat)f, size, r);
+        if (run == 0 || r.nanos < e.nanos) e = r;
+      }
+      if (f == FORMAT_JSON) jsonBodyBytes[b] = e.bodyBytes;
+      uint64_t batches = (ENCODE_RECORDS + size - 1) / size;
+      uint64_t records = batches * size;
+      // us/pass counts the sizing pass as well as the chunk passes
+      printf("  %-15s %5u %12.0f %10.1f %8.1f %12.1f %11.1f %7.1f%% %7.2f %7llu\n", formatNames[f],
+             (unsigned)size, records / (e.nanos / 1e9), e.nanos / 1000.0 / batches,
+             e.nanos / 1000.0 / (e.passes + batches), (double)e.requestBytes / records,
+             (double)e.bodyBytes / records, 100.0 * e.bodyBytes / jsonBodyBytes[b],
+             (double)e.passes / batches, (unsigned long long)e.allocations);
+    }
+  }
+
+  // GPS front end, on the synthetic drive in both protocols
+  ReceiverLog nmeaLog;
+  ReceiverLog ubxLog;
+  recordDrive(minutes, false, nmeaLog);
+  recordDrive(minutes, true, ubxLog);
+  std::string nmeaBytes = concat(nmeaLog);
+  std::string ubxBytes = concat(ubxLog);
+  printf("\nGPS front end: %u min synthetic drive, %u epochs; NMEA %.0f bytes/epoch, UBX %.0f\n",
+         (unsigned)minutes, (unsigned)nmeaLog.size(), (double)nmeaBytes.size() / nmeaLog.size(),
+         (double)ubxBytes.size() / ubxLog.size());
+  printf("  %-14s %10s %9s %11s %10s %7s\n", "parser", "MB/s", "ns/byte", "ns/epoch",
+         "TSC/epoch", "fixes");
+  ParseResult pr;
+  timeParser(parseNmea, nmeaBytes, runs, pr);
+  printParser("nmea", pr, nmeaBytes.size(), nmeaLog.size());
+#ifdef BENCH_TINYGPS
+  timeParser(parseTinyGps, nmeaBytes, runs, pr);
+  printParser("tinygps++", pr, nmeaBytes.size(), nmeaLog.size());
+#endif
+  timeParser(parseUbx, ubxBytes, runs, pr);
+  printParser("ubx nav-pvt", pr, ubxBytes.size(), ubxLog.size());
+
+  // Filter accuracy, always on the synthetic drive: a capture has no
+  // ground truth
+  std::vector<NoisyFix> drive;
+  recordNoisyDrive(minutes, drive);
+  AccuracyResult a;
+  runAccuracy(drive, runs, a);
+  printf("\nFilter accuracy: %u min synthetic drive at %u Hz, %.0f m noise, %u%% multipath jumps,\n"
+         "  30 s with 3 satellites every 5 min, 10 s without a fix every 3 min\n",
+         (unsigned)minutes, (unsigned)GPS_RATE_HZ, NOISE_SIGMA_M, (unsigned)JUMP_PERCENT);
+  printf("  fixes        %u, %u jumps; %u rejected (%u jumps), %u restarts\n", (unsigned)a.fixes,
+         (unsigned)a.jumps, (unsigned)a.rejected, (unsigned)a.jumpsRejected, (unsigned)a.restarts);
+  printf("  error (m)    %-22s %8s %8s\n", "", "rms", "max");
+  printf("               %-22s %8.2f %8.1f\n", "raw", a.raw.rms(), a.raw.max);
+  printf("               %-22s %8.2f %8.1f\n", "raw without jumps", a.rawNoJumps.rms(),
+         a.rawNoJumps.max);
+  printf("               %-22s %8.2f %8.1f\n", "filtered", a.filtered.rms(), a.filtered.max);
+  static const char* const buckets[] = { "<= 5 s", "<= 10 s", "<= 30 s" };
+  printf("  outage (m)   %-22s %8s %8s %10s\n", "", "n", "rms", "repeated");
+  for (int b = 0; b < 3; b++) {
+    printf("               %-22s %8u %8.2f %10.2f\n", buckets[b], (unsigned)a.estimated[b].n,
+           a.estimated[b].rms(), a.repeated[b].rms());
+  }
+  printf("  cost         %.0f ns/fix, TrackFilter %u bytes\n",
+         (double)a.nanos / (a.fixes ? a.fixes : 1), (unsigned)sizeof(TrackFilter));
+
+  // Geofences, on the same drive
+  static const size_t fenceCounts[] = { 10, 100, 300, 1000 };
+  printf("\nGeofences: the drive above against random circles and polygons, FenceEngine %u bytes\n",
+         (unsigned)sizeof(FenceEngine));
+  printf("  %6s %8s %7s %8s %10s %9s %8s %10s %10s\n", "fences", "image B", "grid", "events",
+         "tests/fix", "loads", "ns/fix", "brute ns", "mismatch");
+  std::vector<FenceMismatch> mismatches;
+  for (size_t c = 0; c < sizeof(fenceCounts) / sizeof(fenceCounts[0]); c++) {
+    FenceResult fr;
+    if (!runFences(drive, fenceCounts[c], runs, fr, mismatches)) return 1;
+    uint32_t n = fr.fixes ? fr.fixes : 1;
+    char grid[16];
+    snprintf(grid, sizeof(grid), "%ux%u", (unsigned)fr.cols, (unsigned)fr.rows);
+    printf("  %6u %8u %7s %8u %10.2f %9u %8.0f %10.0f %10u\n", (unsigned)fenceCounts[c],
+           (unsigned)fr.imageBytes, grid, (unsigned)fr.events, (double)fr.tests / n,
+           (unsigned)fr.cellLoads, (double)fr.nanos / n, (double)fr.bruteNanos / n,
+           (unsigned)fr.mismatches);
+  }
+  // Every disagreement has to be right on an edge
+  double worst = 0;
+  for (size_t i = 0; i < mismatches.size(); i++) {
+    const FenceMismatch& m = mismatches[i];
+    printf("  mismatch     fence %u of %u (%s) at %.7f,%.7f: engine says %s, %.1f mm from the edge\n",
+           (unsigned)m.fenceId, (unsigned)m.fences, m.type == FENCE_CIRCLE ? "circle" : "polygon", m.lat_e7 / 1e7,
+           m.lng_e7 / 1e7, m.engineInside ? "inside" : "outside", m.edgeM * 1000);
+    worst = fmax(worst, m.edgeM);
+  }
+  if (worst >= FENCE_EDGE_TOLERANCE_M) {
+    printf("FAIL: fence mismatch %.1f mm from the edge (limit %.0f mm)\n", worst * 1000,
+           FENCE_EDGE_TOLERANCE_M * 1000);
+    return 1;
+  }
+  return 0;
+}
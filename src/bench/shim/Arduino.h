@@ -0,0 +1,33 @@
+// Just enough of Arduino.h for TinyGPSPlus to build on the host, for the
+// bench's -D BENCH_TINYGPS comparison
+#ifndef BENCH_ARDUINO_SHIM_H
+#define BENCH_ARDUINO_SHIM_H
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define sq(x) ((x) * (x))
+
+inline unsigned long millis() {
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
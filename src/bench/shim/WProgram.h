@@ -0,0 +1,2 @@
+// Pre-1.0 name of Arduino.h
+#include "Arduino.h"
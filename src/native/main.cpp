@@ -0,0 +1,219 @@
+// Native (host) build: runs the tracker against simulated peripherals in
+// virtual time.
+//
+//   pio run -e native && .pio/build/native/program [-m minutes] [-v] [-s]
+//
+// A NEO-7M follows a synthetic route (see SimRoute.h) and a SIM800 hands
+// every upload to an in-process ingest server. Between loop passes the
+// clock jumps straight to the tracker's next deadline or the next byte
+// from a peripheral, so an hour of operation takes well under a second.
+// The server also hands out a set of geofences along the route, which
+// the tracker fetches after its first upload. Exits non-zero if a reading
+// went missing, the RAM reading buffer filled up or the fences never
+// arrived.
+//
+//   -m minutes  virtual time to run (default 60)
+//   -v          echo the tracker's console
+//   -s          dump the tracker's stats at the end
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <RamFlash.h>
+#include <Ubx.h>
+#include <Tracker.h>
+#include <TelemetryBinary.h>
+#include <SimClock.h>
+#include <SimNeo7m.h>
+#include <SimRoute.h>
+#include <SimSim800.h>
+#include <SimIngest.h>
+#include <SimFences.h>
+#include <SimLed.h>
+#include <HostConsole.h>
+
+// Sizes of the "track" and "fence" partitions (see partitions.csv)
+#define TRACK_FLASH_SIZE 0xB0000
+#define FENCE_FLASH_SIZE 0x40000
+#define FENCE_VERSION 3
+
+#define MINUTE 60000u
+
+static bool before(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+// Fences the drive crosses: circles around where the route is at a few
+// points in time (the one at minute 22 around the parking spot) and
+// squares around others, among a scatter of fences it mostly misses
+static std::vector<SimFence> routeFences(double lat, double lng, uint32_t startUtc) {
+  SimRoute probe(lat, lng, startUtc);
+  std::vector<SimFence> fences;
+  static const uint32_t circleAt[] = { 4, 9, 22, 31, 47 };
+  static const uint32_t squareAt[] = { 14, 37, 53 };
+  size_t c = 0, s = 0;
+  SimFix at;
+  for (uint32_t ms = 0; ms <= 60 * MINUTE; ms += 1000) {
+    SimRoute::track(ms, at, &probe);
+    if (c < sizeof(circleAt) / sizeof(circleAt[0]) && ms == circleAt[c] * MINUTE) {
+      SimFence f = { (uint32_t)(100 + c), FENCE_CIRCLE, at.lat, at.lng, 150.0, std::vector<double>() };
+      fences.push_back(f);
+      c++;
+    }
+    if (s < sizeof(squareAt) / sizeof(squareAt[0]) && ms == squareAt[s] * MINUTE) {
+      double d = 200.0 / 111320.0;
+      double e = d / cos(at.lat * M_PI / 180.0);
+      double corners[] = { at.lat - d, at.lng - e, at.lat - d, at.lng + e,
+                           at.lat + d, at.lng + e, at.lat + d, at.lng - e };
+      SimFence f = { (uint32_t)(200 + s), FENCE_POLYGON, 0, 0, 0,
+                     std::vector<double>(corners, corners + 8) };
+      fences.push_back(f);
+      s++;
+    }
+  }
+
+  uint32_t seed = 12345;
+  for (uint32_t i = 0; i < 200; i++) {
+    seed = seed * 1103515245 + 12345;
+    double dLat = ((seed >> 8) % 2000 - 1000) / 1000.0 * 0.15;
+    seed = seed * 1103515245 + 12345;
+    double dLng = ((seed >> 8) % 2000 - 1000) / 1000.0 * 0.15;
+    SimFence f = { 1000 + i, FENCE_CIRCLE, lat + dLat, lng + dLng, 50.0 + i % 7 * 25.0,
+                   std::vector<double>() };
+    fences.push_back(f);
+  }
+  return fences;
+}
+
+int main(int argc, char** argv) {
+  uint32_t minutes = 60;
+  bool verbose = false;
+  bool dump = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) minutes = (uint32_t)atoi(argv[++i]);
+    else if (strcmp(argv[i], "-v") == 0) verbose = true;
+    else if (strcmp(argv[i], "-s") == 0) dump = true;
+    else {
+      fprintf(stderr, "usage: %s [-m minutes] [-v] [-s]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  SimClock clock;
+  uint32_t startUtc = makeEpoch(2026, 3, 14, 8, 30, 0);
+  SimRoute route(-6.927079, 79.861244, startUtc);
+  SimNeo7m gps(clock, SimRoute::track, &route);
+  SimIngest ingest;
+  std::vector<SimFence> fences = routeFences(-6.927079, 79.861244, startUtc);
+  std::vector<uint8_t> fenceImage = buildFenceImage(fences, FENCE_VERSION);
+  ingest.setFences(fenceImage, FENCE_VERSION);
+  SimSim800 modem(clock, SimIngest::handle, &ingest);
+  modem.setCloseIdleMs(75000);  // a typical keep-alive timeout
+  RamFlash flash(TRACK_FLASH_SIZE);
+  RamFlash fenceFlash(FENCE_FLASH_SIZE);
+  HostConsole console(verbose);
+  SimLed led(clock);
+
+  TrackerConfig config = { "ingest.example.com", 80, "/api/readings", "internet", "ESP_GPS_001" };
+  Tracker tracker(config, clock, console, modem.port(), gps.port(), led, flash, fenceFlash);
+
+  // The receiver set-up src/test2.cpp does, at the simulated receiver's
+  // baud rate
+#ifdef GPS_PROTOCOL_UBX
+  ubxSetPortUbxOnly(gps.port(), gps.uart().baud());
+#endif
+  ubxSetRate(gps.port(), 1000 / GPS_RATE_HZ);
+#ifdef GPS_PROTOCOL_UBX
+  ubxSetMessageRate(gps.port(), UBX_CLASS_NAV, UBX_NAV_PVT, 1);
+#endif
+
+  std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+  tracker.begin(true, true);
+
+  uint32_t end = minutes * MINUTE;
+  uint64_t passes = 0;
+  size_t peakBuffered = 0;
+  while (before(clock.millis(), end)) {
+    gps.poll();
+    modem.poll();
+    tracker.pollGps();
+    tracker.loop();
+    passes++;
+    if (tracker.buffered() > peakBuffered) peakBuffered = tracker.buffered();
+
+    // Sleep to the next deadline; output from either peripheral cuts it
+    // short, as the GPIO wake sources do on the device
+    uint32_t now = clock.millis();
+    uint32_t idle = tracker.sleepFor();
+    uint32_t next = now + (idle ? idle : 1);
+    uint32_t at = gps.nextEvent();
+    if (before(at, next)) next = at;
+    if (modem.nextEvent(at) && before(at, next)) next = at;
+    if (!before(now, next)) next = now + 1;
+#ifdef POWER_SAVE
+    if (idle) tracker.slept(next - now);
+#endif
+    clock.set(next);
+  }
+  double wallMs = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - wallStart).count();
+
+  if (dump) {
+    console.setEcho(true);
+    tracker.dumpStats();
+  }
+
+  const FixStore& store = tracker.store();
+  uint32_t appended = store.nextSeq() - 1;
+  printf("\nSimulated %u min in %.0f ms (%.0fx), %llu loop passes\n", (unsigned)minutes, wallMs,
+         end / (wallMs > 0 ? wallMs : 1), (unsigned long long)passes);
+  printf("GPS:    %u epochs, %u fixes seen, %u sampled, %u readings kept\n",
+         (unsigned)gps.epochs(), (unsigned)tracker.fixesSeen(), (unsigned)tracker.fixesKept(),
+         (unsigned)tracker.readingsKept());
+  printf("Store:  %u appended, %u pending, %u dropped; RAM buffer peaked at %u/%u\n",
+         (unsigned)appended, (unsigned)store.pending(), (unsigned)store.dropped(),
+         (unsigned)peakBuffered, (unsigned)MAX_READINGS);
+  printf("Upload: %u ok, %u failed, %u bytes out, %u in; %u connects, %u reuses\n",
+         (unsigned)tracker.uploadsOk(), (unsigned)tracker.uploadsFailed(),
+         (unsigned)tracker.modemBytesOut(), (unsigned)tracker.modemBytesIn(),
+         (unsigned)tracker.session().connects(), (unsigned)tracker.session().reuses());
+  printf("Server: %u requests, %u rejected, %u readings stored, %u duplicates\n",
+         (unsigned)ingest.requests(), (unsigned)ingest.rejected(), (unsigned)ingest.readings(),
+         (unsigned)ingest.duplicates());
+  printf("Modem:  %u commands, %u wake-ups, %u bytes lost; LED lit %.1f s\n",
+         (unsigned)modem.commands(), (unsigned)modem.wakeups(), (unsigned)modem.bytesLost(),
+         led.litMs() / 1000.0);
+  printf("Fences: %u in a %u byte image, version %u loaded after %u requests; %u events, "
+         "%u fence readings on the server\n",
+         (unsigned)fences.size(), (unsigned)fenceImage.size(), (unsigned)tracker.fenceVersion(),
+         (unsigned)ingest.fenceRequests(), (unsigned)tracker.fences().events(),
+         (unsigned)ingest.fenceReadings());
+#ifdef POWER_SAVE
+  printf("Power:  asleep %.1f%% in %u sleeps\n",
+         100.0 * tracker.power().sleptMs() / end, (unsigned)tracker.power().sleeps());
+#endif
+
+  // Every acknowledged reading is on the server, unless the store had to
+  // drop it before it was sent
+  uint32_t missing = 0;
+  for (uint32_t seq = 1; seq < store.firstPending(); seq++) {
+    if (!ingest.has(seq)) missing++;
+  }
+  if (missing > store.dropped()) {
+    printf("FAIL: %u acknowledged readings not on the server\n", (unsigned)(missing - store.dropped()));
+    return 1;
+  }
+  // Readings are released from RAM as they are sent, so the buffer only
+  // fills when uploads stall
+  if (peakBuffered >= MAX_READINGS) {
+    printf("FAIL: RAM reading buffer filled up\n");
+    return 1;
+  }
+  if (minutes >= 5 && tracker.fenceVersion() != FENCE_VERSION) {
+    printf("FAIL: geofences not loaded\n");
+    return 1;
+  }
+  return 0;
+}
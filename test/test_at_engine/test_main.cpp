@@ -0,0 +1,283 @@
+// AtEngine against scripted modem transcripts.
+//
+// A transcript is the conversation as it would appear on the wire: lines
+// starting with "> " are what the engine must send, lines starting with
+// "< " are what the modem answers. The player feeds the modem side only
+// once the engine has sent everything before it, and polls with a clock
+// that moves 10 ms per pass, so nothing in here can block.
+//
+//   pio test -e test_native -f test_at_engine
+
+#include <string>
+#include <vector>
+#include <unity.h>
+#include <AtEngine.h>
+#include <MockSerialPort.h>
+
+struct Completion {
+  AtResult result;
+  std::string line;
+};
+
+struct Recorder {
+  std::vector<Completion> done;
+};
+
+static void record(AtResult result, const char* line, void* ctx) {
+  Completion c = { result, line };
+  ((Recorder*)ctx)->done.push_back(c);
+}
+
+// Plays 'script' against the engine, then polls a little longer so the
+// last modem lines are taken in. Returns the number of polls it took, or
+// fails the test if the engine sent something else or went quiet.
+static uint32_t play(AtEngine& engine, MockSerialPort& port, uint32_t& now,
+                     const char* const* script, size_t steps, uint32_t maxPolls = 10000) {
+  size_t step = 0;
+  std::string expected;
+  uint32_t polls = 0;
+  while (step < steps || !expected.empty()) {
+    TEST_ASSERT_LESS_THAN_MESSAGE(maxPolls, polls, "engine never sent the expected line");
+    // Modem lines are released only once the engine sent what precedes them
+    while (step < steps && script[step][0] == '<' && expected.empty()) {
+      port.feed(script[step] + 2);
+      port.feed("\r\n");
+      step++;
+    }
+    engine.poll(now);
+    port.nextPoll();
+    polls++;
+    now += 10;
+
+    while (expected.empty() && step < steps && script[step][0] == '>') {
+      expected.append(script[step] + 2);
+      expected.append("\r\n");
+      step++;
+    }
+    if (!expected.empty() && port.sent().size() >= expected.size()) {
+      TEST_ASSERT_EQUAL_STRING(expected.c_str(), port.sent().substr(0, expected.size()).c_str());
+      port.clearSent();
+      expected.clear();
+    }
+  }
+  while (port.pendingRx() > 0 && polls < maxPolls) {
+    engine.poll(now);
+    port.nextPoll();
+    polls++;
+    now += 10;
+  }
+  engine.poll(now);
+  return polls;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_init_sequence_runs_in_order(void) {
+  MockSerialPort port;
+  AtEngine engine(port);
+  Recorder rec;
+  uint32_t now = 0;
+  engine.enqueue("AT", "OK", 2000, record, &rec);
+  engine.enqueue("AT+CPIN?", "READY", 5000, record, &rec);
+  engine.enqueue("AT+CREG?", "+CREG: 0,1|+CREG: 0,5", 2000, record, &rec);
+  engine.enqueue("AT+CGATT=1", "OK", 10000, record, &rec);
+
+  static const char* const script[] = {
+    "> AT",          "< AT", "< OK",   // echo on
+    "> AT+CPIN?",    "< +CPIN: READY", "< OK",
+    "> AT+CREG?",    "< +CREG: 0,5", "< OK",
+    "> AT+CGATT=1",  "< OK",
+  };
+  play(engine, port, now, script, sizeof(script) / sizeof(script[0]));
+
+  TEST_ASSERT_EQUAL_size_t(4, rec.done.size());
+  for (size_t i = 0; i < rec.done.size(); i++) TEST_ASSERT_EQUAL(AT_RESULT_OK, rec.done[i].result);
+  TEST_ASSERT_EQUAL_STRING("+CPIN: READY", rec.done[1].line.c_str());
+  TEST_ASSERT_EQUAL_STRING("+CREG: 0,5", rec.done[2].line.c_str());
+  TEST_ASSERT_FALSE(engine.busy());
+}
+
+static void test_error_aborts_the_rest_of_the_queue(void) {
+  MockSerialPort port;
+  AtEngine engine(port);
+  Recorder rec;
+  uint32_t now = 0;
+  engine.enqueue("AT+CSTT=\"internet\"", "OK", 5000, record, &rec);
+  engine.enqueue("AT+CIICR", "OK", 85000, record, &rec);
+  engine.enqueue("AT+CIFSR", ".", 5000, record, &rec);
+
+  static const char* const script[] = {
+    "> AT+CSTT=\"internet\"", "< +CME ERROR: operation not allowed",
+  };
+  play(engine, port, now, script, sizeof(script) / sizeof(script[0]));
+
+  TEST_ASSERT_EQUAL_size_t(3, rec.done.size());
+  TEST_ASSERT_EQUAL(AT_RESULT_ERROR, rec.done[0].result);
+  TEST_ASSERT_EQUAL(AT_RESULT_ABORTED, rec.done[1].result);
+  TEST_ASSERT_EQUAL(AT_RESULT_ABORTED, rec.done[2].result);
+  TEST_ASSERT_EQUAL_STRING("", port.sent().c_str());
+}
+
+static void test_optional_failure_keeps_going(void) {
+  MockSerialPort port;
+  AtEngine engine(port);
+  Recorder rec;
+  uint32_t now = 0;
+  engine.enqueue("AT+CIPSHUT", "SHUT OK", 65000, record, &rec, 0, AT_FLAG_OPTIONAL);
+  engine.enqueue("AT+CIPMUX=0", "OK", 2000, record, &rec);
+
+  static const char* const script[] = {
+    "> AT+CIPSHUT",  "< ERROR",
+    "> AT+CIPMUX=0", "< OK",
+  };
+  play(engine, port, now, script, sizeof(script) / sizeof(script[0]));
+
+  TEST_ASSERT_EQUAL_size_t(2, rec.done.size());
+  TEST_ASSERT_EQUAL(AT_RESULT_ERROR, rec.done[0].result);
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, rec.done[1].result);
+}
+
+static void test_silent_modem_times_out_on_schedule(void) {
+  MockSerialPort port;
+  AtEngine engine(port);
+  Recorder rec;
+  engine.enqueue("AT", "OK", 2000, record, &rec);
+  engine.enqueue("AT+CSQ", "OK", 2000, record, &rec);
+
+  engine.poll(0);
+  TEST_ASSERT_EQUAL_STRING("AT\r\n", port.sent().c_str());
+  engine.poll(1999);
+  TEST_ASSERT_TRUE(rec.done.empty());
+  engine.poll(2000);
+  TEST_ASSERT_EQUAL_size_t(2, rec.done.size());
+  TEST_ASSERT_EQUAL(AT_RESULT_TIMEOUT, rec.done[0].result);
+  TEST_ASSERT_EQUAL(AT_RESULT_ABORTED, rec.done[1].result);
+  TEST_ASSERT_FALSE(engine.busy());
+}
+
+static void test_connect_and_send_with_prompt(void) {
+  MockSerialPort port;
+  AtEngine engine(port);
+  Recorder rec;
+  uint32_t now = 0;
+  static const uint8_t body[] = "GET / HTTP/1.1\r\n\r\n";
+  engine.enqueue("AT+CIPSTART=\"TCP\",\"example.com\",80", "CONNECT OK|ALREADY CONNECT", 15000,
+                 record, &rec);
+  engine.enqueue("AT+CIPSEND=18", ">", 5000, record, &rec);
+  engine.enqueuePayload(body, sizeof(body) - 1, "SEND OK", 10000, record, &rec);
+
+  static const char* const script[] = {
+    "> AT+CIPSTART=\"TCP\",\"example.com\",80", "< OK", "< ALREADY CONNECT",
+    "> AT+CIPSEND=18",
+  };
+  play(engine, port, now, script, 4);
+  // The prompt has no line terminator
+  port.feed("> ");
+  for (int i = 0; i < 3; i++, now += 10) engine.poll(now);
+  TEST_ASSERT_EQUAL_STRING((const char*)body, port.sent().c_str());
+  port.feed("\r\nSEND OK\r\n");
+  for (int i = 0; i < 3; i++, now += 10) engine.poll(now);
+
+  TEST_ASSERT_EQUAL_size_t(3, rec.done.size());
+  TEST_ASSERT_EQUAL_STRING("ALREADY CONNECT", rec.done[0].line.c_str());
+  TEST_ASSERT_EQUAL_STRING(">", rec.done[1].line.c_str());
+  TEST_ASSERT_EQUAL_STRING("SEND OK", rec.done[2].line.c_str());
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, rec.done[2].result);
+}
+
+static void test_wait_ends_early_on_its_token(void) {
+  MockSerialPort port;
+  AtEngine engine(port);
+  Recorder rec;
+  engine.enqueueWait(3000, record, &rec, "HTTP/1.1");
+  engine.enqueueWait(500, record, &rec);
+
+  engine.poll(0);
+  port.feed("HTTP/1.1 200 OK\r\n");
+  engine.poll(100);
+  TEST_ASSERT_EQUAL_size_t(1, rec.done.size());
+  TEST_ASSERT_EQUAL_STRING("HTTP/1.1 200 OK", rec.done[0].line.c_str());
+  // The next wait starts at once and, without a token, just runs out
+  engine.poll(150);
+  engine.poll(599);
+  TEST_ASSERT_EQUAL_size_t(1, rec.done.size());
+  engine.poll(600);
+  TEST_ASSERT_EQUAL_size_t(2, rec.done.size());
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, rec.done[1].result);
+}
+
+static void test_byte_at_a_time_matches_whole_lines(void) {
+  MockSerialPort port;
+  port.setMaxBytesPerPoll(1);
+  AtEngine engine(port);
+  Recorder rec;
+  uint32_t now = 0;
+  engine.enqueue("AT+CSQ", "OK", 2000, record, &rec);
+  engine.enqueue("AT+COPS?", "OK", 2000, record, &rec);
+
+  static const char* const script[] = {
+    "> AT+CSQ",   "< +CSQ: 17,0", "< ", "< OK",
+    "> AT+COPS?", "< +COPS: 0,0,\"Dialog\"", "< OK",
+  };
+  uint32_t polls = play(engine, port, now, script, sizeof(script) / sizeof(script[0]));
+
+  TEST_ASSERT_EQUAL_size_t(2, rec.done.size());
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, rec.done[0].result);
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, rec.done[1].result);
+  // One poll per byte plus the ones that send
+  TEST_ASSERT_GREATER_OR_EQUAL(40, polls);
+}
+
+static void test_settle_delays_the_next_command(void) {
+  MockSerialPort port;
+  AtEngine engine(port);
+  engine.enqueue("AT+CIPSEND=10", ">", 5000, 0, 0, 2000);
+
+  engine.poll(0);
+  engine.poll(1999);
+  TEST_ASSERT_EQUAL_STRING("", port.sent().c_str());
+  engine.poll(2000);
+  TEST_ASSERT_EQUAL_STRING("AT+CIPSEND=10\r\n", port.sent().c_str());
+}
+
+static void test_idle_modem_is_woken_first(void) {
+  MockSerialPort port;
+  AtEngine engine(port);
+  engine.setWakeup(5000, 100);
+  engine.enqueue("AT+CIPSTATUS", "STATE:", 2000);
+
+  engine.poll(6000);
+  TEST_ASSERT_EQUAL_STRING("AT\r\n", port.sent().c_str());
+  port.clearSent();
+  engine.poll(6050);
+  TEST_ASSERT_EQUAL_STRING("", port.sent().c_str());
+  engine.poll(6100);
+  TEST_ASSERT_EQUAL_STRING("AT+CIPSTATUS\r\n", port.sent().c_str());
+}
+
+static void test_full_queue_refuses_commands(void) {
+  MockSerialPort port;
+  AtEngine engine(port);
+  for (int i = 0; i < AT_QUEUE_SIZE; i++) TEST_ASSERT_TRUE(engine.enqueue("AT", "OK", 1000));
+  TEST_ASSERT_FALSE(engine.enqueue("AT", "OK", 1000));
+  TEST_ASSERT_EQUAL_UINT8(0, engine.freeSlots());
+  engine.abort();
+  TEST_ASSERT_FALSE(engine.busy());
+  TEST_ASSERT_TRUE(engine.enqueue("AT", "OK", 1000));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_init_sequence_runs_in_order);
+  RUN_TEST(test_error_aborts_the_rest_of_the_queue);
+  RUN_TEST(test_optional_failure_keeps_going);
+  RUN_TEST(test_silent_modem_times_out_on_schedule);
+  RUN_TEST(test_connect_and_send_with_prompt);
+  RUN_TEST(test_wait_ends_early_on_its_token);
+  RUN_TEST(test_byte_at_a_time_matches_whole_lines);
+  RUN_TEST(test_settle_delays_the_next_command);
+  RUN_TEST(test_idle_modem_is_woken_first);
+  RUN_TEST(test_full_queue_refuses_commands);
+  return UNITY_END();
+}
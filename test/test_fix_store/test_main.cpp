@@ -0,0 +1,236 @@
+// FixStore across power cuts, on a file-backed flash that loses power
+// after a given number of programmed bytes.
+//
+// Every test cuts power at each byte offset of one write in turn, mounts
+// the store again from what made it to the file and checks what it
+// recovered: whole records and cursor entries survive, a torn one is as
+// if it had never been written, and the store carries on from there.
+//
+// The last test fills the ring while an upload is reading its batch: the
+// batch must read back the same on every pass until it is unpinned.
+//
+//   pio test -e test_native -f test_fix_store
+
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <FileFlash.h>
+#include <FixStore.h>
+
+#define FLASH_FILE "test_fix_store.flash"
+#define FLASH_SIZE (8 * 4096)  // cursor + 6 data sectors
+#define RECORD_BYTES 32
+#define CURSOR_ENTRY_BYTES 8
+
+static StoredFix makeFix(uint32_t i) {
+  StoredFix f;
+  memset(&f, 0, sizeof(f));
+  f.ts = i * 1000;
+  f.utc = 1773477000 + i;
+  f.lat_e7 = -69270790 + (int32_t)i * 100;
+  f.lng_e7 = 798612440 - (int32_t)i * 100;
+  f.alt_dm = 70;
+  f.speed_e2 = (uint16_t)(i * 10);
+  f.satellites = 9;
+  f.flags = FIXSTORE_FLAG_VALID;
+  return f;
+}
+
+static void appendFixes(FixStore& store, uint32_t first, uint32_t count) {
+  for (uint32_t i = first; i < first + count; i++) store.append(makeFix(i));
+}
+
+// Every fix up to 'last' reads back as it was appended
+static void assertFixes(FixStore& store, uint32_t last) {
+  for (uint32_t seq = 1; seq <= last; seq++) {
+    StoredFix f;
+    TEST_ASSERT_TRUE_MESSAGE(store.read(seq, f), "recovered fix unreadable");
+    StoredFix want = makeFix(seq);
+    want.seq = seq;
+    TEST_ASSERT_EQUAL_MEMORY(&want, &f, sizeof(f));
+  }
+}
+
+void setUp() {
+  remove(FLASH_FILE);
+}
+
+void tearDown() {
+  remove(FLASH_FILE);
+}
+
+static void test_file_flash_keeps_nor_rules() {
+  {
+    FileFlash flash(FLASH_FILE, FLASH_SIZE);
+    TEST_ASSERT_TRUE(flash.ok());
+    uint8_t b = 0xF0;
+    TEST_ASSERT_TRUE(flash.write(100, &b, 1));
+    b = 0x3C;
+    TEST_ASSERT_TRUE(flash.write(100, &b, 1));  // can only clear bits
+  }
+  FileFlash flash(FLASH_FILE, FLASH_SIZE);
+  uint8_t b = 0;
+  TEST_ASSERT_TRUE(flash.read(100, &b, 1));
+  TEST_ASSERT_EQUAL_HEX8(0x30, b);
+  TEST_ASSERT_TRUE(flash.eraseSector(0));
+  TEST_ASSERT_TRUE(flash.read(100, &b, 1));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, b);
+
+  uint8_t data[16] = { 0 };
+  flash.cutPowerAfter(5);
+  TEST_ASSERT_FALSE(flash.write(200, data, sizeof(data)));
+  TEST_ASSERT_FALSE(flash.powered());
+  FileFlash after(FLASH_FILE, FLASH_SIZE);
+  uint8_t back[16];
+  TEST_ASSERT_TRUE(after.read(200, back, sizeof(back)));
+  TEST_ASSERT_EQUAL_HEX8(0x00, back[4]);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, back[5]);
+}
+
+// A staged batch of FIXSTORE_STAGE_RECORDS going to flash in one write
+static void test_power_cut_in_batch_write() {
+  const uint32_t batchBytes = FIXSTORE_STAGE_RECORDS * RECORD_BYTES;
+  for (uint32_t cut = 0; cut < batchBytes; cut++) {
+    remove(FLASH_FILE);
+    {
+      FileFlash flash(FLASH_FILE, FLASH_SIZE);
+      FixStore store(flash);
+      TEST_ASSERT_TRUE(store.begin());
+      appendFixes(store, 1, FIXSTORE_STAGE_RECORDS);  // written on the last append
+      TEST_ASSERT_TRUE(store.acknowledge(5));
+
+      flash.cutPowerAfter(cut);
+      appendFixes(store, FIXSTORE_STAGE_RECORDS + 1, FIXSTORE_STAGE_RECORDS);
+      TEST_ASSERT_FALSE(flash.powered());
+    }
+
+    // Records that are whole; none of these ends in a 0xFF byte, so one
+    // cut short is always torn
+    uint32_t survived = FIXSTORE_STAGE_RECORDS + cut / RECORD_BYTES;
+    {
+      FileFlash flash(FLASH_FILE, FLASH_SIZE);
+      FixStore store(flash);
+      TEST_ASSERT_TRUE(store.begin());
+      TEST_ASSERT_EQUAL(survived + 1, store.nextSeq());
+      TEST_ASSERT_EQUAL(5, store.acked());
+      TEST_ASSERT_EQUAL(6, store.firstPending());
+      TEST_ASSERT_EQUAL(survived - 5, store.pending());
+      assertFixes(store, survived);
+
+      // Carries on after the torn record, which is never read back
+      appendFixes(store, survived + 1, FIXSTORE_STAGE_RECORDS);
+      TEST_ASSERT_TRUE(store.flush());
+    }
+
+    FileFlash flash(FLASH_FILE, FLASH_SIZE);
+    FixStore store(flash);
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_EQUAL(survived + FIXSTORE_STAGE_RECORDS + 1, store.nextSeq());
+    assertFixes(store, survived + FIXSTORE_STAGE_RECORDS);
+  }
+}
+
+// The cursor entry written by acknowledge(), in the middle of a sector
+// and as the first entry after the cursor moves to its other sector
+static void powerCutInAck(uint32_t acksBefore) {
+  for (uint32_t cut = 0; cut <= CURSOR_ENTRY_BYTES; cut++) {
+    remove(FLASH_FILE);
+    {
+      FileFlash flash(FLASH_FILE, FLASH_SIZE);
+      FixStore store(flash);
+      TEST_ASSERT_TRUE(store.begin());
+      appendFixes(store, 1, acksBefore + 8);
+      TEST_ASSERT_TRUE(store.flush());
+      for (uint32_t seq = 1; seq <= acksBefore; seq++) TEST_ASSERT_TRUE(store.acknowledge(seq));
+
+      flash.cutPowerAfter(cut);
+      store.acknowledge(acksBefore + 1);
+      TEST_ASSERT_FALSE(flash.powered());
+    }
+
+    // Only a whole entry counts; a torn one leaves the previous value. An
+    // entry is whole once its last byte that is not 0xFF is programmed.
+    uint32_t entry[2] = { acksBefore + 1, ~(acksBefore + 1) };
+    uint32_t needed = CURSOR_ENTRY_BYTES;
+    while (needed > 0 && ((const uint8_t*)entry)[needed - 1] == 0xFF) needed--;
+    uint32_t acked = cut >= needed ? acksBefore + 1 : acksBefore;
+    {
+      FileFlash flash(FLASH_FILE, FLASH_SIZE);
+      FixStore store(flash);
+      TEST_ASSERT_TRUE(store.begin());
+      TEST_ASSERT_EQUAL(acked, store.acked());
+      TEST_ASSERT_EQUAL(acked + 1, store.firstPending());
+      TEST_ASSERT_EQUAL(acksBefore + 9, store.nextSeq());
+      assertFixes(store, acksBefore + 8);
+
+      // The next acknowledgement lands after the torn slot
+      TEST_ASSERT_TRUE(store.acknowledge(acksBefore + 2));
+    }
+
+    FileFlash flash(FLASH_FILE, FLASH_SIZE);
+    FixStore store(flash);
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_EQUAL(acksBefore + 2, store.acked());
+  }
+}
+
+static void test_power_cut_in_cursor_write() {
+  powerCutInAck(3);
+}
+
+static void test_power_cut_in_cursor_write_after_switch() {
+  powerCutInAck(4096 / CURSOR_ENTRY_BYTES);  // sector 0 full, 1 just erased
+}
+
+// After an outage the ring is full and the batch being uploaded sits in
+// the sector recycled next; the tracker reads it again for every chunk
+static void test_ring_fills_during_upload() {
+  const uint32_t perSector = (4096 - 32) / RECORD_BYTES;
+  const uint32_t ring = (FLASH_SIZE / 4096 - 2) * perSector;
+  const uint32_t batch = 60;
+  FileFlash flash(FLASH_FILE, FLASH_SIZE);
+  FixStore store(flash);
+  TEST_ASSERT_TRUE(store.begin());
+  appendFixes(store, 1, ring);
+  TEST_ASSERT_TRUE(store.flush());
+  TEST_ASSERT_EQUAL(1, store.firstPending());
+  TEST_ASSERT_EQUAL(0, store.dropped());
+
+  // Sized, then more than a sector's worth of fixes before the last chunk
+  store.pin(1);
+  assertFixes(store, batch);
+  appendFixes(store, ring + 1, perSector + 10);
+  TEST_ASSERT_FALSE(store.flush());
+  assertFixes(store, batch);
+  // The newest wait in RAM, the rest are lost instead of the batch
+  TEST_ASSERT_EQUAL(ring + FIXSTORE_STAGE_RECORDS + 1, store.nextSeq());
+  TEST_ASSERT_EQUAL(perSector + 10 - FIXSTORE_STAGE_RECORDS, store.dropped());
+  StoredFix f;
+  TEST_ASSERT_TRUE(store.read(ring + FIXSTORE_STAGE_RECORDS, f));
+
+  // Sent and acknowledged: the oldest sector goes with the rest of its
+  // undelivered fixes, and the waiting ones land
+  TEST_ASSERT_TRUE(store.acknowledge(batch));
+  store.unpin();
+  TEST_ASSERT_TRUE(store.flush());
+  TEST_ASSERT_EQUAL(perSector + 10 - FIXSTORE_STAGE_RECORDS + perSector - batch, store.dropped());
+  TEST_ASSERT_EQUAL(perSector + 1, store.firstPending());
+  TEST_ASSERT_FALSE(store.read(batch, f));
+  TEST_ASSERT_TRUE(store.read(ring + FIXSTORE_STAGE_RECORDS, f));
+  TEST_ASSERT_EQUAL_UINT32(ring + FIXSTORE_STAGE_RECORDS, f.seq);
+
+  // Unpinned, the next batch would lose its sector to the next appends
+  appendFixes(store, 1, perSector);
+  TEST_ASSERT_TRUE(store.flush());
+  TEST_ASSERT_FALSE(store.read(perSector + 1, f));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_file_flash_keeps_nor_rules);
+  RUN_TEST(test_power_cut_in_batch_write);
+  RUN_TEST(test_power_cut_in_cursor_write);
+  RUN_TEST(test_power_cut_in_cursor_write_after_switch);
+  RUN_TEST(test_ring_fills_during_upload);
+  return UNITY_END();
+}
@@ -0,0 +1,256 @@
+// NmeaParser against reference and hand-made sentences.
+//
+// The coordinates are checked to the last digit of lat_e7/lng_e7 against
+// the integer conversion (minutes * 1e5 / 60, rounded), for both
+// hemispheres and the 2- and 3-digit degree fields. Sentences with a bad
+// checksum or an overlong field must leave the last fix alone, GSV/GSA/VTG
+// are skipped unparsed, and an RMC only lends its date and motion to the
+// GGA of the same epoch.
+//
+//   pio test -e test_native -f test_nmea
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include <NmeaParser.h>
+
+// The textbook pair, checksums as published
+static const char* const refRmc =
+  "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n";
+static const char* const refGga =
+  "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+
+// "$<body>*<checksum>\r\n"
+static std::string sentence(const char* body) {
+  uint8_t sum = 0;
+  for (const char* p = body; *p; p++) sum ^= (uint8_t)*p;
+  char tail[8];
+  snprintf(tail, sizeof(tail), "*%02X\r\n", sum);
+  return std::string("$") + body + tail;
+}
+
+// Feeds 's' and returns how many fixes it completed
+static int feed(NmeaParser& parser, const std::string& s) {
+  int fixes = 0;
+  for (size_t i = 0; i < s.size(); i++) fixes += parser.encode((uint8_t)s[i]);
+  return fixes;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_reference_sentences() {
+  NmeaParser parser;
+  TEST_ASSERT_EQUAL(0, feed(parser, refRmc));
+  TEST_ASSERT_EQUAL(1, feed(parser, refGga));
+  TEST_ASSERT_EQUAL(2, parser.sentences());
+  TEST_ASSERT_EQUAL(0, parser.checksumErrors());
+
+  const NmeaFix& f = parser.fix();
+  TEST_ASSERT_TRUE(f.valid);
+  // 48 deg 07.038' = 48.1173 deg; 11 deg 31.000' = 11.516666.. deg
+  TEST_ASSERT_EQUAL_INT32(481173000, f.lat_e7);
+  TEST_ASSERT_EQUAL_INT32(115166667, f.lng_e7);
+  TEST_ASSERT_EQUAL_INT32(5454, f.alt_dm);
+  TEST_ASSERT_EQUAL(1, f.quality);
+  TEST_ASSERT_EQUAL(8, f.satellites);
+  TEST_ASSERT_EQUAL(90, f.hdop_e2);
+  TEST_ASSERT_TRUE(f.hasTime);
+  TEST_ASSERT_EQUAL(12, f.hour);
+  TEST_ASSERT_EQUAL(35, f.minute);
+  TEST_ASSERT_EQUAL(19, f.second);
+  TEST_ASSERT_EQUAL(0, f.centisecond);
+  // From the RMC: 22.4 kn = 11523.6 mm/s, truncated
+  TEST_ASSERT_TRUE(f.hasMotion);
+  TEST_ASSERT_EQUAL_UINT32(11523, f.speed_mms);
+  TEST_ASSERT_EQUAL_UINT32(8440, f.course_e2);
+  TEST_ASSERT_TRUE(f.hasDate);
+  TEST_ASSERT_EQUAL(23, f.day);
+  TEST_ASSERT_EQUAL(3, f.month);
+}
+
+static void test_neo7m_sentences() {
+  NmeaParser parser;
+  feed(parser, sentence("GPRMC,083015.40,A,0655.62474,S,07951.67464,E,17.275,123.45,140326,,,A"));
+  TEST_ASSERT_EQUAL(1, feed(parser, sentence("GPGGA,083015.40,0655.62474,S,07951.67464,E,1,07,1.23,-12.3,M,-95.2,M,,")));
+  const NmeaFix& f = parser.fix();
+  TEST_ASSERT_TRUE(f.valid);
+  // 6 deg 55.62474' S = -(6 + 5562474 / 6e6) deg
+  TEST_ASSERT_EQUAL_INT32(-69270790, f.lat_e7);
+  TEST_ASSERT_EQUAL_INT32(798612440, f.lng_e7);
+  TEST_ASSERT_EQUAL_INT32(-123, f.alt_dm);
+  TEST_ASSERT_EQUAL(123, f.hdop_e2);
+  TEST_ASSERT_EQUAL(40, f.centisecond);
+  TEST_ASSERT_EQUAL_UINT32(17275u * 1852 / 3600, f.speed_mms);
+  TEST_ASSERT_EQUAL_UINT32(12345, f.course_e2);
+  TEST_ASSERT_EQUAL(2026, f.year);
+  TEST_ASSERT_EQUAL(3, f.month);
+  TEST_ASSERT_EQUAL(14, f.day);
+}
+
+static void test_hemispheres_and_degree_digits() {
+  struct Case {
+    const char* lat;
+    const char* ns;
+    const char* lng;
+    const char* ew;
+    int32_t lat_e7;
+    int32_t lng_e7;
+  };
+  static const Case cases[] = {
+    { "0000.00000", "N", "00000.00000", "E", 0, 0 },
+    { "0000.00001", "S", "00000.00001", "W", -2, -2 },
+    { "8959.99999", "N", "17959.99999", "W", 899999998, -1799999998 },
+    { "9000.00000", "S", "18000.00000", "E", -900000000, 1800000000 },
+    { "4530.5", "N", "1000.25", "E", 455083333, 100041667 },   // short fraction, 2-digit lng
+    { "0130.000000", "S", "10015.000009", "W", -15000000, -1002500000 },  // extra decimals dropped
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const Case& c = cases[i];
+    char body[120];
+    snprintf(body, sizeof(body), "GNGGA,101010.00,%s,%s,%s,%s,1,09,0.80,10.0,M,0.0,M,,", c.lat, c.ns, c.lng, c.ew);
+    NmeaParser parser;
+    TEST_ASSERT_EQUAL_MESSAGE(1, feed(parser, sentence(body)), body);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(c.lat_e7, parser.fix().lat_e7, body);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(c.lng_e7, parser.fix().lng_e7, body);
+  }
+
+  // Minutes of 60 or more, and too many degree digits, are not coordinates
+  NmeaParser parser;
+  feed(parser, sentence("GPGGA,101010.00,4560.00000,N,181000.00000,E,1,09,0.80,10.0,M,0.0,M,,"));
+  TEST_ASSERT_EQUAL_INT32(0, parser.fix().lat_e7);
+  TEST_ASSERT_EQUAL_INT32(0, parser.fix().lng_e7);
+}
+
+static void test_no_fix_fields_are_empty() {
+  NmeaParser parser;
+  feed(parser, refRmc);
+  feed(parser, refGga);
+
+  // What a NEO-7M sends before its first fix
+  TEST_ASSERT_EQUAL(0, feed(parser, sentence("GPRMC,,V,,,,,,,,,,N")));
+  TEST_ASSERT_EQUAL(1, feed(parser, sentence("GPGGA,,,,,,0,00,99.99,,,,,,")));
+  const NmeaFix& f = parser.fix();
+  TEST_ASSERT_FALSE(f.valid);
+  TEST_ASSERT_EQUAL(0, f.quality);
+  TEST_ASSERT_FALSE(f.hasTime);
+  TEST_ASSERT_FALSE(f.hasDate);
+  TEST_ASSERT_FALSE(f.hasMotion);
+  TEST_ASSERT_EQUAL_INT32(0, f.lat_e7);
+  TEST_ASSERT_EQUAL_INT32(0, f.lng_e7);
+  TEST_ASSERT_EQUAL(9999, f.hdop_e2);
+
+  // Time but no position yet: RMC status V makes the fix invalid too
+  feed(parser, sentence("GPRMC,101011.00,V,,,,,,,140326,,,N"));
+  TEST_ASSERT_EQUAL(1, feed(parser, sentence("GPGGA,101011.00,0655.62474,S,07951.67464,E,1,03,4.10,,,,,,")));
+  TEST_ASSERT_FALSE(parser.fix().valid);
+  TEST_ASSERT_TRUE(parser.fix().hasDate);
+  TEST_ASSERT_EQUAL_INT32(0, parser.fix().alt_dm);
+}
+
+static void test_bad_checksums_are_dropped() {
+  NmeaParser parser;
+  feed(parser, refRmc);
+  feed(parser, refGga);
+
+  std::string bad = sentence("GPGGA,123520,4807.039,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+  bad[bad.size() - 3] = bad[bad.size() - 3] == '0' ? '1' : '0';
+  TEST_ASSERT_EQUAL(0, feed(parser, bad));
+  // One character changed in transit
+  std::string flipped = sentence("GPGGA,123521,4807.039,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+  flipped[20] = '8';
+  TEST_ASSERT_EQUAL(0, feed(parser, flipped));
+  // No checksum digits at all, and a sentence cut short by the next '$'
+  TEST_ASSERT_EQUAL(0, feed(parser, "$GPGGA,123522,4807.039,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*\r\n"));
+  TEST_ASSERT_EQUAL(0, feed(parser, "$GPGGA,123523,4807.039,N,0113"));
+
+  TEST_ASSERT_EQUAL(2, parser.checksumErrors());
+  TEST_ASSERT_EQUAL(2, parser.sentences());
+  TEST_ASSERT_EQUAL_INT32(481173000, parser.fix().lat_e7);
+  TEST_ASSERT_EQUAL(19, parser.fix().second);
+
+  // And the next good sentence goes through
+  TEST_ASSERT_EQUAL(1, feed(parser, refGga));
+}
+
+static void test_overlong_field_is_malformed() {
+  NmeaParser parser;
+  feed(parser, refRmc);
+  feed(parser, refGga);
+
+  std::string longField(NMEA_MAX_FIELD + 1, '1');
+  std::string body = "GPGGA,123520," + longField + ",N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,";
+  TEST_ASSERT_EQUAL(0, feed(parser, sentence(body.c_str())));
+  TEST_ASSERT_EQUAL(1, parser.malformed());
+  TEST_ASSERT_EQUAL(0, parser.checksumErrors());
+  TEST_ASSERT_EQUAL(19, parser.fix().second);
+
+  // A field exactly NMEA_MAX_FIELD long is still read
+  body = "GPGGA,123521,4807.0380000000,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,";
+  TEST_ASSERT_EQUAL(NMEA_MAX_FIELD, strlen("4807.0380000000"));
+  TEST_ASSERT_EQUAL(1, feed(parser, sentence(body.c_str())));
+  TEST_ASSERT_EQUAL(1, parser.malformed());
+  TEST_ASSERT_EQUAL_INT32(481173000, parser.fix().lat_e7);
+
+  // Numbers too large for their field are dropped, not wrapped
+  feed(parser, sentence("GPGGA,123522,4807.038,N,01131.000,E,1,08,0.9,99999999999.9,M,46.9,M,,"));
+  TEST_ASSERT_EQUAL_INT32(0, parser.fix().alt_dm);
+}
+
+static void test_other_sentences_are_skipped() {
+  NmeaParser parser;
+  std::string epoch = refRmc;
+  epoch += sentence("GPVTG,084.4,T,,M,022.4,N,041.5,K,A");
+  epoch += sentence("GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1");
+  epoch += sentence("GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45");
+  // Not checksummed, so a corrupt one costs nothing
+  epoch += "$GPGSV,2,2,08,15,12,040,,*00\r\n";
+  epoch += sentence("GPGLL,4807.038,N,01131.000,E,123519,A,A");
+  epoch += refGga;
+  TEST_ASSERT_EQUAL(1, feed(parser, epoch));
+  TEST_ASSERT_EQUAL(5, parser.skipped());
+  TEST_ASSERT_EQUAL(2, parser.sentences());
+  TEST_ASSERT_EQUAL(0, parser.checksumErrors());
+  // The RMC still pairs with its GGA across them
+  TEST_ASSERT_TRUE(parser.fix().hasMotion);
+  TEST_ASSERT_EQUAL_UINT32(8440, parser.fix().course_e2);
+}
+
+static void test_rmc_of_another_epoch_lends_nothing() {
+  NmeaParser parser;
+  feed(parser, sentence("GPRMC,101010.00,A,0655.62474,S,07951.67464,E,17.275,123.45,140326,,,A"));
+  TEST_ASSERT_EQUAL(1, feed(parser, sentence("GPGGA,101010.20,0655.62474,S,07951.67464,E,1,07,1.23,12.3,M,-95.2,M,,")));
+  const NmeaFix& f = parser.fix();
+  TEST_ASSERT_TRUE(f.valid);
+  TEST_ASSERT_TRUE(f.hasTime);
+  TEST_ASSERT_FALSE(f.hasDate);
+  TEST_ASSERT_FALSE(f.hasMotion);
+  TEST_ASSERT_EQUAL_UINT32(0, f.speed_mms);
+  TEST_ASSERT_EQUAL_UINT32(0, f.course_e2);
+
+  // An RMC is used once: a second GGA of the same epoch gets nothing
+  feed(parser, sentence("GPRMC,101011.00,A,0655.62474,S,07951.67464,E,17.275,123.45,140326,,,A"));
+  TEST_ASSERT_EQUAL(1, feed(parser, sentence("GPGGA,101011.00,0655.62474,S,07951.67464,E,1,07,1.23,12.3,M,-95.2,M,,")));
+  TEST_ASSERT_TRUE(parser.fix().hasDate);
+  TEST_ASSERT_EQUAL(1, feed(parser, sentence("GPGGA,101011.00,0655.62474,S,07951.67464,E,1,07,1.23,12.3,M,-95.2,M,,")));
+  TEST_ASSERT_FALSE(parser.fix().hasDate);
+
+  // An RMC without a time pairs with nothing
+  feed(parser, sentence("GPRMC,,A,0655.62474,S,07951.67464,E,17.275,123.45,140326,,,A"));
+  TEST_ASSERT_EQUAL(1, feed(parser, sentence("GPGGA,,0655.62474,S,07951.67464,E,1,07,1.23,12.3,M,-95.2,M,,")));
+  TEST_ASSERT_FALSE(parser.fix().hasMotion);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_reference_sentences);
+  RUN_TEST(test_neo7m_sentences);
+  RUN_TEST(test_hemispheres_and_degree_digits);
+  RUN_TEST(test_no_fix_fields_are_empty);
+  RUN_TEST(test_bad_checksums_are_dropped);
+  RUN_TEST(test_overlong_field_is_malformed);
+  RUN_TEST(test_other_sentences_are_skipped);
+  RUN_TEST(test_rmc_of_another_epoch_lends_nothing);
+  return UNITY_END();
+}
@@ -0,0 +1,219 @@
+// The GPS ingestion pipeline on std::thread: a producer parses a NEO-7M
+// NMEA feed and pushes fixes into an SpscQueue, as pollGps() does on the
+// device, and a consumer takes them off in upload batches, as loop() does.
+//
+// The feed is half an hour of the simulated receiver at 5 Hz, generated
+// up front. The producer hands out one epoch per EPOCH_US of wall time
+// (2000x real time) and, like the tracker, drops a fix when the queue is
+// full. Every fix the consumer gets must be the one a single-threaded
+// parse produced at that position. Throughput and drop rates depend on
+// how the host schedules the two threads, so they are printed, not
+// checked.
+//
+//   pio test -e test_native -f test_pipeline
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <unity.h>
+#include <NmeaParser.h>
+#include <SpscQueue.h>
+#include <Ubx.h>
+#include <SimClock.h>
+#include <SimNeo7m.h>
+#include <SimRoute.h>
+#include <TelemetryJson.h>
+
+#define FEED_MINUTES 30
+#define GPS_RATE_MS 200
+#define EPOCH_US 100
+#define QUEUE_DEPTH 32           // as Tracker's fixQueue_
+#define UPLOAD_BATCH 60
+
+typedef std::chrono::steady_clock WallClock;
+
+// A fix and its position in the feed
+struct Item {
+  uint32_t n;
+  NmeaFix fix;
+};
+
+struct Feed {
+  std::vector<uint8_t> bytes;
+  std::vector<size_t> epochEnds;   // where each epoch's output ends
+  std::vector<NmeaFix> fixes;      // single-threaded parse, in order
+};
+
+static Feed feed;
+
+static void makeFeed() {
+  SimClock clock;
+  SimRoute route(-6.927079, 79.861244, makeEpoch(2026, 3, 14, 8, 30, 0));
+  SimNeo7m gps(clock, SimRoute::track, &route, 0);
+  ubxSetRate(gps.port(), GPS_RATE_MS);
+  for (uint32_t t = 10; t <= FEED_MINUTES * 60000u; t += 10) {
+    clock.set(t);
+    gps.poll();
+    uint8_t buf[256];
+    size_t n;
+    while ((n = gps.port().read(buf, sizeof(buf))) > 0) feed.bytes.insert(feed.bytes.end(), buf, buf + n);
+    if (t % GPS_RATE_MS == 0) feed.epochEnds.push_back(feed.bytes.size());
+  }
+
+  NmeaParser parser;
+  for (size_t i = 0; i < feed.bytes.size(); i++) {
+    if (parser.encode(feed.bytes[i])) feed.fixes.push_back(parser.fix());
+  }
+}
+
+struct Result {
+  uint32_t delivered;
+  uint32_t dropped;
+  uint32_t batches;
+  uint32_t outOfOrder;
+  uint32_t corrupt;
+  double seconds;
+};
+
+// Runs producer and consumer; the consumer stalls for 'uploadUs' after
+// every full batch, standing in for the modem
+static void run(uint32_t epochUs, uint32_t uploadUs, Result& r) {
+  SpscQueue<Item, QUEUE_DEPTH>* queue = new SpscQueue<Item, QUEUE_DEPTH>();
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> dropped(0);
+  memset(&r, 0, sizeof(r));
+
+  WallClock::time_point start = WallClock::now();
+  std::thread producer([&]() {
+    NmeaParser parser;
+    uint32_t n = 0;
+    size_t at = 0;
+    for (size_t e = 0; e < feed.epochEnds.size(); e++) {
+      if (epochUs) {
+        WallClock::time_point due = start + std::chrono::microseconds((uint64_t)e * epochUs);
+        while (WallClock::now() < due) std::this_thread::yield();
+      }
+      for (; at < feed.epochEnds[e]; at++) {
+        if (!parser.encode(feed.bytes[at])) continue;
+        Item item = { n++, parser.fix() };
+        if (!queue->push(item)) dropped.store(dropped.load() + 1);
+      }
+    }
+    done.store(true);
+  });
+
+  std::thread consumer([&]() {
+    Item item;
+    uint32_t inBatch = 0;
+    int64_t last = -1;
+    for (;;) {
+      if (!queue->pop(item)) {
+        if (done.load() && queue->size() == 0) break;
+        std::this_thread::yield();
+        continue;
+      }
+      r.delivered++;
+      if ((int64_t)item.n <= last) r.outOfOrder++;
+      last = item.n;
+      const NmeaFix& want = feed.fixes[item.n];
+      if (item.fix.lat_e7 != want.lat_e7 || item.fix.lng_e7 != want.lng_e7 ||
+          item.fix.second != want.second || item.fix.speed_mms != want.speed_mms) {
+        r.corrupt++;
+      }
+      if (++inBatch == UPLOAD_BATCH) {
+        inBatch = 0;
+        r.batches++;
+        if (uploadUs) std::this_thread::sleep_for(std::chrono::microseconds(uploadUs));
+      }
+    }
+  });
+
+  producer.join();
+  consumer.join();
+  r.seconds = std::chrono::duration<double>(WallClock::now() - start).count();
+  r.dropped = dropped.load();
+  delete queue;
+}
+
+static void report(const char* name, const Result& r) {
+  char line[200];
+  snprintf(line, sizeof(line), "%s: %u fixes parsed in %.3f s (%.0f fixes/s, %.1f MB/s of NMEA), "
+           "%u delivered in %u batches, %u dropped (%.2f%%)", name, (unsigned)feed.fixes.size(),
+           r.seconds, feed.fixes.size() / r.seconds, feed.bytes.size() / r.seconds / 1e6,
+           (unsigned)r.delivered, (unsigned)r.batches, (unsigned)r.dropped,
+           100.0 * r.dropped / feed.fixes.size());
+  TEST_MESSAGE(line);
+}
+
+static void assertIntact(const Result& r) {
+  TEST_ASSERT_EQUAL(feed.fixes.size(), r.delivered + r.dropped);
+  TEST_ASSERT_EQUAL(0, r.outOfOrder);
+  TEST_ASSERT_EQUAL(0, r.corrupt);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_queue_hands_over_every_item_once() {
+  const uint32_t items = 1000000;
+  SpscQueue<uint32_t, 64> queue;
+  uint64_t sum = 0;
+  uint32_t expected = 0, misordered = 0;
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < items; i++) {
+      while (!queue.push(i)) std::this_thread::yield();
+    }
+  });
+  while (expected < items) {
+    uint32_t v;
+    if (!queue.pop(v)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (v != expected) misordered++;
+    sum += v;
+    expected++;
+  }
+  producer.join();
+  TEST_ASSERT_EQUAL(0, misordered);
+  TEST_ASSERT_TRUE(sum == (uint64_t)items * (items - 1) / 2);
+  TEST_ASSERT_EQUAL(0, queue.size());
+}
+
+static void test_consumer_keeps_up() {
+  TEST_ASSERT_GREATER_THAN(8000, feed.fixes.size());
+  Result r;
+  run(EPOCH_US, 0, r);
+  report("paced, free consumer", r);
+  // A consumer that is never held up only loses fixes to the scheduler,
+  // so how many depends on the host; the rate is reported, not asserted
+  assertIntact(r);
+}
+
+static void test_stalled_uplink_drops_but_never_corrupts() {
+  Result r;
+  run(EPOCH_US, 3 * QUEUE_DEPTH * EPOCH_US, r);  // 3x what the queue can absorb
+  report("paced, stalling consumer", r);
+  assertIntact(r);
+  TEST_ASSERT_GREATER_THAN(0, r.dropped);
+}
+
+static void test_unpaced_throughput() {
+  Result r;
+  run(0, 0, r);
+  report("unpaced", r);
+  assertIntact(r);
+}
+
+int main(int argc, char** argv) {
+  makeFeed();
+  UNITY_BEGIN();
+  RUN_TEST(test_queue_hands_over_every_item_once);
+  RUN_TEST(test_consumer_keeps_up);
+  RUN_TEST(test_stalled_uplink_drops_but_never_corrupts);
+  RUN_TEST(test_unpaced_throughput);
+  return UNITY_END();
+}
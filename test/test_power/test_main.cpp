@@ -0,0 +1,258 @@
+// The POWER_SAVE wake timeline, replayed on a host.
+//
+// PowerScheduler is driven as Tracker::sleepFor() drives it: upload and
+// status deadlines plus the receiver's 1 Hz fix bursts, which arrive up to
+// 25 ms late. Every sleep must end at or before the next deadline, never
+// span a burst (a burst that wakes the CPU loses its first bytes) and be
+// between the minimum and maximum sleep; the share of time asleep is
+// printed.
+//
+// The SIM800 side is AT+CSCLK=2 on the simulated modem: once the UART has
+// been quiet long enough the engine sends a throw-away "AT" before the
+// next command, and no command is lost however long the modem slept.
+//
+//   pio test -e test_native -f test_power
+
+#include <stdio.h>
+#include <vector>
+#include <unity.h>
+#include <PowerScheduler.h>
+#include <AtEngine.h>
+#include <SimClock.h>
+#include <SimSim800.h>
+
+// As Tracker.cpp builds with POWER_SAVE
+#define POWER_MIN_SLEEP_MS 10
+#define POWER_MAX_SLEEP_MS 5000
+#define GPS_PERIOD_MS 1000
+#define GPS_WAKE_LEAD_MS 30
+#define GPS_BURST_MS 40
+#define GPS_BURST_GAP_MS 50
+#define SIM800_SLEEP_AFTER_MS 4000
+#define SIM800_WAKE_GUARD_MS 100
+
+#define UPLOAD_MS 60000
+#define STATUS_MS 15000
+#define TIMELINE_MS (30 * 60000u)
+
+static bool before(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+// Start of the n-th fix burst: on the second, up to 25 ms late
+static uint32_t burstAt(uint32_t start, uint32_t n) {
+  return start + n * GPS_PERIOD_MS + (n * 7) % 26;
+}
+
+struct Timeline {
+  uint32_t sleeps;
+  uint32_t wokenByGps;
+  uint32_t lateForDeadline;
+  uint32_t uploads;
+  uint32_t minSleep;
+  uint32_t maxSleep;
+  uint64_t asleepMs;
+};
+
+// Replays TIMELINE_MS from 'start'; a sleep ends at its length or when a
+// burst starts, whichever is first
+static void replay(uint32_t start, Timeline& t) {
+  PowerScheduler power(POWER_MIN_SLEEP_MS, POWER_MAX_SLEEP_MS);
+  t = Timeline();
+  t.minSleep = 0xFFFFFFFFu;
+
+  uint32_t now = start;
+  // Out of step with the bursts, so sleeps are cut short for them
+  uint32_t lastUpload = start + 437 - UPLOAD_MS, lastStatus = start + 611 - STATUS_MS;
+  uint32_t burst = 0, lastBurstStart = start, lastRx = start - 1000;
+  while (before(now, start + TIMELINE_MS)) {
+    // Receive: the burst's bytes trickle in for GPS_BURST_MS
+    uint32_t at = burstAt(start, burst);
+    if (!before(now, at)) {
+      lastRx = now;
+      lastBurstStart = at;
+      if (!before(now, at + GPS_BURST_MS)) burst++;
+    }
+    if (!before(now, lastUpload + UPLOAD_MS)) {
+      TEST_ASSERT_EQUAL_UINT32(lastUpload + UPLOAD_MS, now);
+      lastUpload = now;
+      t.uploads++;
+    }
+    if (!before(now, lastStatus + STATUS_MS)) lastStatus = now;
+
+    power.begin(now);
+    power.deadline(lastUpload + UPLOAD_MS);
+    power.deadline(lastStatus + STATUS_MS);
+    power.deadlineEvery(lastBurstStart, GPS_PERIOD_MS, GPS_WAKE_LEAD_MS);
+    if (now - lastRx < GPS_BURST_GAP_MS) power.hold();
+    uint32_t sleep = power.sleepFor();
+    if (!sleep) {
+      now++;
+      continue;
+    }
+
+    t.sleeps++;
+    if (sleep < t.minSleep) t.minSleep = sleep;
+    if (sleep > t.maxSleep) t.maxSleep = sleep;
+    if (before(lastUpload + UPLOAD_MS, now + sleep) || before(lastStatus + STATUS_MS, now + sleep)) {
+      t.lateForDeadline++;
+    }
+    uint32_t wake = now + sleep;
+    at = burstAt(start, burst);
+    if (before(at, wake)) {
+      t.wokenByGps++;
+      wake = at;
+    }
+    power.slept(wake - now);
+    t.asleepMs += wake - now;
+    now = wake;
+  }
+  TEST_ASSERT_EQUAL_UINT32(t.sleeps, power.sleeps());
+  TEST_ASSERT_TRUE(power.sleptMs() == t.asleepMs);
+}
+
+static void report(const char* name, const Timeline& t) {
+  char line[160];
+  snprintf(line, sizeof(line), "%s: asleep %.1f%% in %u sleeps of %u..%u ms, %u woken by GPS, %u uploads",
+           name, 100.0 * t.asleepMs / TIMELINE_MS, (unsigned)t.sleeps, (unsigned)t.minSleep,
+           (unsigned)t.maxSleep, (unsigned)t.wokenByGps, (unsigned)t.uploads);
+  TEST_MESSAGE(line);
+}
+
+static void assertTimeline(const Timeline& t) {
+  TEST_ASSERT_EQUAL(TIMELINE_MS / UPLOAD_MS, t.uploads);
+  TEST_ASSERT_EQUAL(0, t.lateForDeadline);
+  TEST_ASSERT_EQUAL(0, t.wokenByGps);
+  TEST_ASSERT_GREATER_OR_EQUAL(POWER_MIN_SLEEP_MS, t.minSleep);
+  TEST_ASSERT_LESS_OR_EQUAL(POWER_MAX_SLEEP_MS, t.maxSleep);
+  // Awake for the lead, the burst and the gap after it, once a second
+  TEST_ASSERT_GREATER_THAN(80, (int)(100 * t.asleepMs / TIMELINE_MS));
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_deadlines_and_edge_cases() {
+  PowerScheduler power(POWER_MIN_SLEEP_MS, POWER_MAX_SLEEP_MS);
+  power.begin(1000);
+  TEST_ASSERT_EQUAL_UINT32(POWER_MAX_SLEEP_MS, power.sleepFor());
+  power.deadline(3000);
+  power.deadline(4000);
+  TEST_ASSERT_EQUAL_UINT32(2000, power.sleepFor());
+  power.hold();
+  TEST_ASSERT_EQUAL_UINT32(0, power.sleepFor());
+
+  // A deadline already passed, or too close to be worth a sleep
+  power.begin(1000);
+  power.deadline(900);
+  TEST_ASSERT_EQUAL_UINT32(0, power.sleepFor());
+  power.begin(1000);
+  power.deadline(1000 + POWER_MIN_SLEEP_MS - 1);
+  TEST_ASSERT_EQUAL_UINT32(0, power.sleepFor());
+
+  // millis() wrapping between now and the deadline
+  power.begin(0xFFFFFF00u);
+  power.deadline(0x100);
+  TEST_ASSERT_EQUAL_UINT32(0x200, power.sleepFor());
+
+  // A periodic event: awake from the lead before it to the lead after
+  power.begin(10000);
+  power.deadlineEvery(9000, GPS_PERIOD_MS, GPS_WAKE_LEAD_MS);
+  TEST_ASSERT_EQUAL_UINT32(0, power.sleepFor());
+  power.begin(10000 + GPS_WAKE_LEAD_MS);
+  power.deadlineEvery(9000, GPS_PERIOD_MS, GPS_WAKE_LEAD_MS);
+  TEST_ASSERT_EQUAL_UINT32(GPS_PERIOD_MS - 2 * GPS_WAKE_LEAD_MS, power.sleepFor());
+  power.begin(10000 - GPS_WAKE_LEAD_MS);
+  power.deadlineEvery(9000, GPS_PERIOD_MS, GPS_WAKE_LEAD_MS);
+  TEST_ASSERT_EQUAL_UINT32(0, power.sleepFor());
+  power.begin(0x10);
+  power.deadlineEvery(0xFFFFFFF0u, GPS_PERIOD_MS, GPS_WAKE_LEAD_MS);
+  TEST_ASSERT_EQUAL_UINT32(GPS_PERIOD_MS - GPS_WAKE_LEAD_MS - 0x20, power.sleepFor());
+  power.begin(0);
+  power.deadlineEvery(0, 0, GPS_WAKE_LEAD_MS);  // no period: no deadline
+  TEST_ASSERT_EQUAL_UINT32(POWER_MAX_SLEEP_MS, power.sleepFor());
+}
+
+static void test_wake_timeline() {
+  Timeline t;
+  replay(0, t);
+  report("from boot", t);
+  assertTimeline(t);
+}
+
+static void test_wake_timeline_across_millis_wrap() {
+  Timeline t;
+  replay(0xFFFFFFFFu - TIMELINE_MS / 2, t);
+  report("across the millis() wrap", t);
+  assertTimeline(t);
+}
+
+struct Modem {
+  SimClock clock;
+  SimSim800 modem;
+  AtEngine engine;
+  std::vector<AtResult> results;
+
+  Modem() : modem(clock, 0, 0), engine(modem.port()) { idle(5000); }
+
+  static void onDone(AtResult result, const char* line, void* ctx) {
+    ((Modem*)ctx)->results.push_back(result);
+  }
+
+  void idle(uint32_t ms) {
+    for (uint32_t end = clock.millis() + ms; before(clock.millis(), end); clock.advance(10)) {
+      modem.poll();
+      engine.poll(clock.millis());
+    }
+  }
+
+  // One command, then quiet for 'gapMs'; the result it completed with
+  AtResult command(const char* text, const char* expect, uint32_t gapMs) {
+    size_t done = results.size();
+    engine.enqueue(text, expect, 2000, onDone, this);
+    idle(gapMs);
+    TEST_ASSERT_EQUAL(done + 1, results.size());
+    return results.back();
+  }
+};
+
+static void test_sleeping_modem_is_woken_first() {
+  Modem* m = new Modem();
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, m->command("AT+CSCLK=2", "OK", 20000));
+  TEST_ASSERT_TRUE(m->modem.asleep());
+
+  // Without the wake-up the command's first bytes are lost with the sleep
+  uint32_t lost = m->modem.bytesLost();
+  TEST_ASSERT_EQUAL(AT_RESULT_TIMEOUT, m->command("AT+CPIN?", "+CPIN:", 20000));
+  TEST_ASSERT_GREATER_THAN(lost, m->modem.bytesLost());
+
+  m->engine.setWakeup(SIM800_SLEEP_AFTER_MS, SIM800_WAKE_GUARD_MS);
+  for (int i = 0; i < 20; i++) {
+    TEST_ASSERT_TRUE(m->modem.asleep());
+    uint32_t commands = m->modem.commands(), wakeups = m->modem.wakeups();
+    lost = m->modem.bytesLost();
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, m->command("AT+CPIN?", "+CPIN:", 20000));
+    // The "AT" that woke it was lost, the command was not
+    TEST_ASSERT_EQUAL_UINT32(commands + 1, m->modem.commands());
+    TEST_ASSERT_EQUAL_UINT32(wakeups + 1, m->modem.wakeups());
+    TEST_ASSERT_EQUAL_UINT32(lost + 4, m->modem.bytesLost());
+  }
+
+  // Close together no wake-up is sent; past the engine's idle limit but
+  // before the modem sleeps, the "AT" is answered and does no harm
+  uint32_t commands = m->modem.commands();
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, m->command("AT+CPIN?", "+CPIN:", 2000));
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, m->command("AT+CPIN?", "+CPIN:", SIM800_SLEEP_AFTER_MS + 500));
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, m->command("AT+CPIN?", "+CPIN:", 20000));
+  TEST_ASSERT_EQUAL_UINT32(commands + 4, m->modem.commands());
+  delete m;
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_deadlines_and_edge_cases);
+  RUN_TEST(test_wake_timeline);
+  RUN_TEST(test_wake_timeline_across_millis_wrap);
+  RUN_TEST(test_sleeping_modem_is_woken_first);
+  return UNITY_END();
+}
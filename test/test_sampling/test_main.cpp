@@ -0,0 +1,241 @@
+// AdaptivePolicy against the fixed 10 s window it replaced.
+//
+// The drive is the simulated route src/native runs, at 5 Hz: a turn every
+// 90 s, parked from 20:00 to 25:00 and a tunnel at 40:00. Every turn,
+// stop and start on it must produce a kept point soon after it happens,
+// with fewer points kept overall than the fixed window. Short synthetic
+// tracks cover a parked vehicle with receiver jitter, a speed step on a
+// straight road and the 1 s floor. Kept counts are printed.
+//
+//   pio test -e test_native -f test_sampling
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include <unity.h>
+#include <Geo.h>
+#include <SamplingPolicy.h>
+#include <SimRoute.h>
+#include <TelemetryJson.h>
+
+#define DRIVE_MINUTES 60
+#define GPS_RATE_MS 200
+#define HEARTBEAT_MS 60000       // Tracker's heartbeatInterval
+#define FIXED_INTERVAL_MS 10000  // SAMPLING_FIXED_INTERVAL
+#define LEG_MS 90000             // SimRoute turns this often
+#define MINUTE 60000u
+#define METRES_PER_DEGREE 111319.5
+
+struct Kept {
+  TrackPoint p;
+  SampleReason reason;
+};
+
+static AdaptiveSamplingConfig config() {
+  AdaptiveSamplingConfig c = AdaptivePolicy::defaults();
+  c.maxIntervalMs = HEARTBEAT_MS;
+  return c;
+}
+
+static void drive(std::vector<TrackPoint>& out) {
+  SimRoute route(-6.927079, 79.861244, makeEpoch(2026, 3, 14, 8, 30, 0));
+  for (uint32_t ms = 0; ms < DRIVE_MINUTES * MINUTE; ms += GPS_RATE_MS) {
+    SimFix f;
+    SimRoute::track(ms, f, &route);
+    if (!f.valid) continue;
+    TrackPoint p = { ms, (int32_t)lround(f.lat * 1e7), (int32_t)lround(f.lng * 1e7),
+                     (uint16_t)lround(f.speedKmh * 10), (uint16_t)(lround(f.courseDeg * 10) % 3600) };
+    out.push_back(p);
+  }
+}
+
+static void run(SamplingPolicy& policy, const std::vector<TrackPoint>& points, std::vector<Kept>& kept) {
+  for (size_t i = 0; i < points.size(); i++) {
+    if (!policy.accept(points[i])) continue;
+    Kept k = { points[i], policy.reason() };
+    kept.push_back(k);
+  }
+}
+
+// The first kept point at or after 'ms', or 0
+static const Kept* keptFrom(const std::vector<Kept>& kept, uint32_t ms) {
+  for (size_t i = 0; i < kept.size(); i++) {
+    if (kept[i].p.ms >= ms) return &kept[i];
+  }
+  return 0;
+}
+
+static void assertFloor(const std::vector<Kept>& kept) {
+  for (size_t i = 1; i < kept.size(); i++) {
+    TEST_ASSERT_GREATER_OR_EQUAL(1000, kept[i].p.ms - kept[i - 1].p.ms);
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_drive_against_fixed_window() {
+  std::vector<TrackPoint> points;
+  drive(points);
+  AdaptivePolicy adaptive(config());
+  FixedIntervalPolicy fixed(FIXED_INTERVAL_MS);
+  std::vector<Kept> a, f;
+  run(adaptive, points, a);
+  run(fixed, points, f);
+
+  size_t reasons[SAMPLE_SPEED + 1] = { 0 };
+  for (size_t i = 0; i < a.size(); i++) reasons[a[i].reason]++;
+  char line[200];
+  snprintf(line, sizeof(line), "%u fixes: fixed 10 s window keeps %u, adaptive %u "
+           "(%u heartbeat, %u distance, %u heading, %u speed)",
+           (unsigned)points.size(), (unsigned)f.size(), (unsigned)a.size(),
+           (unsigned)reasons[SAMPLE_HEARTBEAT], (unsigned)reasons[SAMPLE_DISTANCE],
+           (unsigned)reasons[SAMPLE_HEADING], (unsigned)reasons[SAMPLE_SPEED]);
+  TEST_MESSAGE(line);
+
+  // The window keeps one fix per 10 s of fix time, the tunnel aside
+  TEST_ASSERT_GREATER_OR_EQUAL(DRIVE_MINUTES * 6 - 20, f.size());
+  TEST_ASSERT_LESS_OR_EQUAL(DRIVE_MINUTES * 6, f.size());
+  TEST_ASSERT_LESS_THAN(f.size(), a.size());
+  TEST_ASSERT_EQUAL(SAMPLE_FIRST, a[0].reason);
+  assertFloor(a);
+  // Never longer than the heartbeat between points while there is a fix
+  for (size_t i = 1; i < a.size(); i++) {
+    bool tunnel = a[i - 1].p.ms < 40 * MINUTE && a[i].p.ms >= 42 * MINUTE;
+    if (!tunnel) TEST_ASSERT_LESS_OR_EQUAL(HEARTBEAT_MS + GPS_RATE_MS, a[i].p.ms - a[i - 1].p.ms);
+  }
+}
+
+static void test_every_turn_is_kept() {
+  std::vector<TrackPoint> points;
+  drive(points);
+  AdaptivePolicy adaptive(config());
+  std::vector<Kept> kept;
+  run(adaptive, points, kept);
+
+  uint32_t turns = 0;
+  for (uint32_t at = LEG_MS; at < DRIVE_MINUTES * MINUTE; at += LEG_MS) {
+    // Parked, or no fix around the corner
+    if (at >= 20 * MINUTE && at < 25 * MINUTE + 10000) continue;
+    if (at >= 40 * MINUTE && at < 42 * MINUTE + 1000) continue;
+    const Kept* k = keptFrom(kept, at);
+    TEST_ASSERT_NOT_NULL(k);
+    TEST_ASSERT_LESS_OR_EQUAL_MESSAGE(at + 1000, k->p.ms, "turn not kept within 1 s");
+    TEST_ASSERT_TRUE(k->reason == SAMPLE_HEADING || k->reason == SAMPLE_SPEED);
+    turns++;
+  }
+  TEST_ASSERT_GREATER_THAN(30, turns);
+}
+
+static void test_stop_and_start_are_kept() {
+  std::vector<TrackPoint> points;
+  drive(points);
+  AdaptivePolicy adaptive(config());
+  std::vector<Kept> kept;
+  run(adaptive, points, kept);
+
+  // Where the speed crosses the moving threshold on the way in and out
+  uint16_t moving = config().movingSpeed_e1;
+  uint32_t stopped = 0, started = 0;
+  for (size_t i = 1; i < points.size(); i++) {
+    if (!stopped && points[i - 1].speed_e1 >= moving && points[i].speed_e1 < moving) stopped = points[i].ms;
+    if (stopped && !started && points[i - 1].speed_e1 < moving && points[i].speed_e1 >= moving) {
+      started = points[i].ms;
+    }
+  }
+  TEST_ASSERT_TRUE(stopped >= 20 * MINUTE && stopped < 21 * MINUTE);
+  TEST_ASSERT_TRUE(started >= 25 * MINUTE && started < 26 * MINUTE);
+
+  const Kept* k = keptFrom(kept, stopped);
+  TEST_ASSERT_NOT_NULL(k);
+  TEST_ASSERT_EQUAL_UINT32(stopped, k->p.ms);
+  TEST_ASSERT_EQUAL(SAMPLE_SPEED, k->reason);
+  k = keptFrom(kept, started);
+  TEST_ASSERT_NOT_NULL(k);
+  TEST_ASSERT_EQUAL_UINT32(started, k->p.ms);
+  TEST_ASSERT_EQUAL(SAMPLE_SPEED, k->reason);
+
+  // In between only the heartbeat
+  for (size_t i = 0; i < kept.size(); i++) {
+    if (kept[i].p.ms > stopped && kept[i].p.ms < started) {
+      TEST_ASSERT_EQUAL(SAMPLE_HEARTBEAT, kept[i].reason);
+    }
+  }
+}
+
+static void test_parked_keeps_only_the_heartbeat() {
+  AdaptivePolicy adaptive(config());
+  std::vector<TrackPoint> points;
+  uint32_t seed = 7;
+  for (uint32_t ms = 0; ms <= 30 * MINUTE; ms += GPS_RATE_MS) {
+    // A few metres of wander, 0-3 km/h and a random course
+    seed = seed * 1103515245 + 12345;
+    int32_t jitter = (int32_t)(seed >> 16) % 60 - 30;
+    TrackPoint p = { ms, -69270790 + jitter * 10, 798612440 - jitter * 7,
+                     (uint16_t)((seed >> 8) % 30), (uint16_t)((seed >> 4) % 3600) };
+    points.push_back(p);
+  }
+  std::vector<Kept> kept;
+  run(adaptive, points, kept);
+
+  TEST_ASSERT_EQUAL(31, kept.size());
+  for (size_t i = 1; i < kept.size(); i++) {
+    TEST_ASSERT_EQUAL(SAMPLE_HEARTBEAT, kept[i].reason);
+    TEST_ASSERT_EQUAL_UINT32(HEARTBEAT_MS, kept[i].p.ms - kept[i - 1].p.ms);
+  }
+}
+
+static void test_speed_step_and_straight_road() {
+  AdaptivePolicy adaptive(config());
+  std::vector<TrackPoint> points;
+  // Due north at 40 km/h, 70 km/h from 2:00
+  double lat = -6.927079;
+  for (uint32_t ms = 0; ms <= 4 * MINUTE; ms += GPS_RATE_MS) {
+    uint16_t speed = ms < 2 * MINUTE ? 400 : 700;
+    lat += speed / 36.0 * GPS_RATE_MS / 1000 / METRES_PER_DEGREE;
+    TrackPoint p = { ms, (int32_t)lround(lat * 1e7), 798612440, speed, 0 };
+    points.push_back(p);
+  }
+  std::vector<Kept> kept;
+  run(adaptive, points, kept);
+
+  const Kept* k = keptFrom(kept, 2 * MINUTE);
+  TEST_ASSERT_NOT_NULL(k);
+  TEST_ASSERT_EQUAL_UINT32(2 * MINUTE, k->p.ms);
+  TEST_ASSERT_EQUAL(SAMPLE_SPEED, k->reason);
+  // Otherwise a point per maxDistanceM: 250 m is 22.5 s at 40 km/h
+  for (size_t i = 1; i < kept.size(); i++) {
+    if (kept[i].reason == SAMPLE_SPEED) continue;
+    TEST_ASSERT_EQUAL(SAMPLE_DISTANCE, kept[i].reason);
+    float d = geoDistanceM(kept[i - 1].p.lat_e7, kept[i - 1].p.lng_e7, kept[i].p.lat_e7, kept[i].p.lng_e7);
+    TEST_ASSERT_TRUE(d >= 250 && d < 255);
+  }
+}
+
+static void test_one_second_floor() {
+  // Zig-zagging 90 degrees and jumping 30 km/h at every 5 Hz fix
+  AdaptivePolicy adaptive(config());
+  std::vector<TrackPoint> points;
+  for (uint32_t ms = 0; ms <= MINUTE; ms += GPS_RATE_MS) {
+    bool odd = (ms / GPS_RATE_MS) % 2;
+    TrackPoint p = { ms, -69270790 + (int32_t)ms, 798612440, (uint16_t)(odd ? 300 : 600),
+                     (uint16_t)(odd ? 900 : 0) };
+    points.push_back(p);
+  }
+  std::vector<Kept> kept;
+  run(adaptive, points, kept);
+
+  assertFloor(kept);
+  TEST_ASSERT_EQUAL(MINUTE / 1000 + 1, kept.size());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_drive_against_fixed_window);
+  RUN_TEST(test_every_turn_is_kept);
+  RUN_TEST(test_stop_and_start_are_kept);
+  RUN_TEST(test_parked_keeps_only_the_heartbeat);
+  RUN_TEST(test_speed_step_and_straight_road);
+  RUN_TEST(test_one_second_floor);
+  return UNITY_END();
+}
@@ -0,0 +1,170 @@
+// StreamSimplifier on recorded-style drives: compression and the largest
+// distance of any raw fix from the simplified track, measured in doubles
+// against the segment that covers its time, for a range of tolerances.
+//
+// The drive is the simulated route src/native runs, at 5 Hz, once clean
+// and once with 2 m of receiver noise. Figures are printed per tolerance.
+//
+//   pio test -e test_native -f test_simplify
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include <unity.h>
+#include <StreamSimplifier.h>
+#include <SimRoute.h>
+#include <TelemetryJson.h>
+
+#define DRIVE_MINUTES 60
+#define GPS_RATE_MS 200
+#define MAX_SPAN_MS 60000
+#define WINDOW 64
+#define METRES_PER_DEGREE 111319.5
+
+struct Point {
+  int32_t lat_e7;
+  int32_t lng_e7;
+  uint32_t ts;
+};
+
+typedef StreamSimplifier<Point, WINDOW> Simplifier;
+
+static void collect(const Point& p, void* ctx) {
+  ((std::vector<Point>*)ctx)->push_back(p);
+}
+
+// Deterministic Gaussian noise
+static double gauss(uint32_t& seed) {
+  double u[2];
+  for (int i = 0; i < 2; i++) {
+    seed = seed * 1103515245 + 12345;
+    u[i] = ((seed >> 8) + 1.0) / 16777217.0;
+  }
+  return sqrt(-2 * log(u[0])) * cos(2 * M_PI * u[1]);
+}
+
+static void drive(double noiseM, std::vector<Point>& out) {
+  SimRoute route(-6.927079, 79.861244, makeEpoch(2026, 3, 14, 8, 30, 0));
+  uint32_t seed = 99;
+  out.clear();
+  for (uint32_t ms = 0; ms < DRIVE_MINUTES * 60000u; ms += GPS_RATE_MS) {
+    SimFix f;
+    SimRoute::track(ms, f, &route);
+    if (!f.valid) continue;
+    double lat = f.lat + noiseM * gauss(seed) / METRES_PER_DEGREE;
+    double lng = f.lng + noiseM * gauss(seed) / (METRES_PER_DEGREE * cos(f.lat * M_PI / 180));
+    Point p = { (int32_t)lround(lat * 1e7), (int32_t)lround(lng * 1e7), ms };
+    out.push_back(p);
+  }
+}
+
+// Metres from p to the segment a-b
+static double segmentDistanceM(const Point& p, const Point& a, const Point& b) {
+  double scale = METRES_PER_DEGREE * cos(a.lat_e7 / 1e7 * M_PI / 180);
+  double bx = (b.lng_e7 - a.lng_e7) / 1e7 * scale, by = (b.lat_e7 - a.lat_e7) / 1e7 * METRES_PER_DEGREE;
+  double px = (p.lng_e7 - a.lng_e7) / 1e7 * scale, py = (p.lat_e7 - a.lat_e7) / 1e7 * METRES_PER_DEGREE;
+  double len2 = bx * bx + by * by;
+  double t = len2 > 0 ? (px * bx + py * by) / len2 : 0;
+  t = t < 0 ? 0 : t > 1 ? 1 : t;
+  return hypot(px - t * bx, py - t * by);
+}
+
+struct Outcome {
+  size_t emitted;
+  double maxErrorM;
+};
+
+static Outcome simplify(const std::vector<Point>& raw, uint32_t toleranceCm) {
+  std::vector<Point> kept;
+  Simplifier s(toleranceCm, MAX_SPAN_MS, collect, &kept);
+  for (size_t i = 0; i < raw.size(); i++) s.push(raw[i]);
+  s.flush();
+
+  // Every emitted point is a raw one, in order, starting with the first
+  // and ending with the last
+  TEST_ASSERT_TRUE(kept.size() >= 2);
+  TEST_ASSERT_EQUAL_UINT32(raw.front().ts, kept.front().ts);
+  TEST_ASSERT_EQUAL_UINT32(raw.back().ts, kept.back().ts);
+
+  Outcome o = { kept.size(), 0 };
+  size_t seg = 0;
+  for (size_t i = 0; i < raw.size(); i++) {
+    while (seg + 1 < kept.size() - 1 && kept[seg + 1].ts <= raw[i].ts) seg++;
+    double e = segmentDistanceM(raw[i], kept[seg], kept[seg + 1]);
+    if (e > o.maxErrorM) o.maxErrorM = e;
+  }
+  return o;
+}
+
+static void check(const char* name, double noiseM, uint32_t toleranceCm, double minRatio) {
+  std::vector<Point> raw;
+  drive(noiseM, raw);
+  Outcome o = simplify(raw, toleranceCm);
+  double ratio = (double)raw.size() / o.emitted;
+
+  char line[160];
+  snprintf(line, sizeof(line), "%s, %.1f m tolerance: %u fixes -> %u points (%.1fx), max error %.2f m",
+           name, toleranceCm / 100.0, (unsigned)raw.size(), (unsigned)o.emitted, ratio, o.maxErrorM);
+  TEST_MESSAGE(line);
+
+  // The integer geometry may be off by its centimetre grid and the
+  // equirectangular approximation (well under 1% over a window)
+  TEST_ASSERT_TRUE_MESSAGE(o.maxErrorM <= toleranceCm / 100.0 * 1.01 + 0.05, "error over tolerance");
+  TEST_ASSERT_TRUE_MESSAGE(ratio >= minRatio, "compression below expectation");
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_clean_drive() {
+  check("clean", 0, 100, 10);
+  check("clean", 0, 500, 15);
+  check("clean", 0, 1000, 15);
+  check("clean", 0, 2500, 15);
+}
+
+static void test_noisy_drive() {
+  check("2 m noise", 2, 500, 3);
+  check("2 m noise", 2, 1000, 8);
+  check("2 m noise", 2, 2500, 15);
+}
+
+static void test_parked_emits_once_per_span() {
+  std::vector<Point> kept;
+  Simplifier s(1000, MAX_SPAN_MS, collect, &kept);
+  // Once a second, so the span fills before the window does
+  for (uint32_t ms = 0; ms <= 10 * 60000u; ms += 1000) {
+    Point p = { -69270790, 798612440, ms };
+    s.push(p);
+  }
+  // The first fix, then one per MAX_SPAN_MS
+  TEST_ASSERT_EQUAL(11, kept.size());
+  for (size_t i = 1; i < kept.size(); i++) TEST_ASSERT_EQUAL_UINT32(MAX_SPAN_MS, kept[i].ts - kept[i - 1].ts);
+}
+
+static void test_straight_line_bounded_by_window() {
+  std::vector<Point> kept;
+  Simplifier s(1000, 0xFFFFFFFFu, collect, &kept);
+  for (uint32_t i = 0; i < 10 * WINDOW; i++) {
+    Point p = { -69270790 + (int32_t)i * 500, 798612440, i * GPS_RATE_MS };
+    s.push(p);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(WINDOW - 1, s.held());
+  // Full windows force an emit even though the line never bends
+  TEST_ASSERT_GREATER_OR_EQUAL(10, kept.size());
+  TEST_ASSERT_LESS_OR_EQUAL(12, kept.size());
+
+  size_t before = kept.size();
+  s.flush();
+  TEST_ASSERT_EQUAL(before + 1, kept.size());
+  TEST_ASSERT_EQUAL_UINT32((10 * WINDOW - 1) * GPS_RATE_MS, kept.back().ts);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_drive);
+  RUN_TEST(test_noisy_drive);
+  RUN_TEST(test_parked_emits_once_per_span);
+  RUN_TEST(test_straight_line_bounded_by_window);
+  return UNITY_END();
+}
@@ -0,0 +1,208 @@
+// TcpSession keep-alive against the simulated SIM800.
+//
+// Each upload is what the tracker does per batch: open() the session,
+// send one HTTP request with AT+CIPSEND and wait for the response. With
+// a server that keeps the connection open every upload after the first
+// must reuse the socket; after the server closes it for idleness, the
+// bearer drops or a connect fails, the next open() must set it up again
+// and the upload still go through. The setup time saved is printed.
+//
+//   pio test -e test_native -f test_tcp_session
+
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <AtEngine.h>
+#include <TcpSession.h>
+#include <SimClock.h>
+#include <SimSim800.h>
+
+#define STEP_MS 10
+#define UPLOAD_TIMEOUT_MS 120000
+
+static const char request[] =
+  "POST /api/readings HTTP/1.1\r\nHost: ingest.example.com\r\n"
+  "Connection: keep-alive\r\nContent-Length: 2\r\n\r\n{}";
+
+static size_t answer(const uint8_t* req, size_t len, char* response, size_t size, void* ctx) {
+  (*(uint32_t*)ctx)++;
+  return snprintf(response, size, "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+}
+
+// The session on the simulated modem, past its boot time
+struct Rig {
+  SimClock clock;
+  uint32_t served;
+  SimSim800 modem;
+  AtEngine engine;
+  TcpSession session;
+  char cipsend[32];
+  bool opened;
+  AtResult openResult;
+  bool sent;
+  uint32_t received;
+
+  Rig()
+    : served(0), modem(clock, answer, &served), engine(modem.port()),
+      session(engine, clock), opened(false), openResult(AT_RESULT_OK), sent(false), received(0) {
+    session.setApn("internet");
+    session.setServer("ingest.example.com", 80);
+    engine.setDataHandler(onData, this);
+    idle(5000);  // the modem ignores everything while it boots
+  }
+
+  static void onOpen(AtResult result, const char* line, void* ctx) {
+    Rig* r = (Rig*)ctx;
+    r->opened = true;
+    r->openResult = result;
+  }
+
+  static void onSent(AtResult result, const char* line, void* ctx) {
+    ((Rig*)ctx)->sent = result == AT_RESULT_OK;
+  }
+
+  static void onData(uint8_t link, const uint8_t* data, size_t len, void* ctx) {
+    ((Rig*)ctx)->received += len;
+  }
+
+  void step() {
+    modem.poll();
+    engine.poll(clock.millis());
+    clock.advance(STEP_MS);
+  }
+
+  void idle(uint32_t ms) {
+    uint32_t end = clock.millis() + ms;
+    while ((int32_t)(clock.millis() - end) < 0) step();
+  }
+
+  // One upload; the AT result of open(), or of the send if that failed
+  AtResult upload() {
+    opened = false;
+    sent = false;
+    TEST_ASSERT_TRUE(session.open(onOpen, this));
+    uint32_t start = clock.millis();
+    while (!opened) {
+      TEST_ASSERT_LESS_THAN_MESSAGE(UPLOAD_TIMEOUT_MS, clock.millis() - start, "open() never finished");
+      step();
+    }
+    if (openResult != AT_RESULT_OK) return openResult;
+
+    uint32_t before = received;
+    session.formatSend(cipsend, sizeof(cipsend), 0, strlen(request));
+    engine.enqueue(cipsend, ">", 5000);
+    engine.enqueuePayload((const uint8_t*)request, strlen(request), "SEND OK", 10000, onSent, this);
+    while (received == before) {
+      TEST_ASSERT_LESS_THAN_MESSAGE(UPLOAD_TIMEOUT_MS, clock.millis() - start, "no response");
+      step();
+    }
+    TEST_ASSERT_TRUE(sent);
+    return AT_RESULT_OK;
+  }
+};
+
+static void report(const char* name, const TcpSession& s) {
+  char line[160];
+  snprintf(line, sizeof(line), "%s: %u connects (%u ms each), %u reuses (%u ms each), %u failures, %u ms saved",
+           name, (unsigned)s.connects(), (unsigned)s.averageConnectMs(), (unsigned)s.reuses(),
+           (unsigned)s.averageReuseMs(), (unsigned)s.failures(), (unsigned)s.savedMs());
+  TEST_MESSAGE(line);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_uploads_reuse_one_connection() {
+  Rig* rig = new Rig();
+  for (int i = 0; i < 30; i++) {
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, rig->upload());
+    TEST_ASSERT_EQUAL(i > 0, rig->session.reused());
+    rig->idle(10000);
+  }
+  report("keep-alive", rig->session);
+
+  TEST_ASSERT_EQUAL(30, rig->served);
+  TEST_ASSERT_EQUAL(1, rig->modem.connects());
+  TEST_ASSERT_EQUAL(1, rig->session.connects());
+  TEST_ASSERT_EQUAL(29, rig->session.reuses());
+  TEST_ASSERT_EQUAL(0, rig->session.failures());
+  // A probe is a fraction of the bearer and TCP setup it replaces
+  TEST_ASSERT_LESS_THAN(rig->session.averageConnectMs() / 10, rig->session.averageReuseMs());
+  TEST_ASSERT_GREATER_OR_EQUAL(29 * rig->session.averageConnectMs() * 9 / 10, rig->session.savedMs());
+  delete rig;
+}
+
+static void test_reconnects_after_idle_close() {
+  Rig* rig = new Rig();
+  rig->modem.setCloseIdleMs(30000);
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, rig->upload());
+    rig->idle(10000);
+  }
+  TEST_ASSERT_EQUAL(2, rig->session.reuses());
+
+  // The server's CLOSED arrives as a URC while nothing is in flight
+  rig->idle(30000);
+  TEST_ASSERT_FALSE(rig->session.connected());
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, rig->upload());
+  TEST_ASSERT_FALSE(rig->session.reused());
+  report("idle close", rig->session);
+
+  TEST_ASSERT_EQUAL(4, rig->served);
+  TEST_ASSERT_EQUAL(2, rig->modem.connects());
+  TEST_ASSERT_EQUAL(2, rig->session.connects());
+  TEST_ASSERT_EQUAL(0, rig->session.failures());
+  delete rig;
+}
+
+static void test_bearer_rebuilt_after_pdp_deact() {
+  Rig* rig = new Rig();
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, rig->upload());
+  uint32_t commands = rig->modem.commands();
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, rig->upload());
+  // A reuse costs one CIPSTATUS besides the send
+  TEST_ASSERT_EQUAL(commands + 2, rig->modem.commands());
+
+  rig->modem.inject(rig->clock.millis() + 1000, "+PDP: DEACT");
+  rig->idle(2000);
+  TEST_ASSERT_FALSE(rig->session.connected());
+  commands = rig->modem.commands();
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, rig->upload());
+  // CIPSHUT, CIPMUX, CIPHEAD, CSTT, CIICR, CIFSR, CIPSTART, CIPSEND
+  TEST_ASSERT_EQUAL(commands + 8, rig->modem.commands());
+  TEST_ASSERT_EQUAL(2, rig->session.connects());
+  TEST_ASSERT_EQUAL(1, rig->session.reuses());
+  delete rig;
+}
+
+static void test_failed_connects_retry_from_the_bearer() {
+  Rig* rig = new Rig();
+  rig->modem.failConnects(2);
+  TEST_ASSERT_EQUAL(AT_RESULT_ERROR, rig->upload());
+  TEST_ASSERT_FALSE(rig->session.connected());
+  uint32_t commands = rig->modem.commands();
+  TEST_ASSERT_EQUAL(AT_RESULT_ERROR, rig->upload());
+  // A refused connect takes the bearer down with it
+  TEST_ASSERT_EQUAL(commands + 7, rig->modem.commands());
+
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, rig->upload());
+    rig->idle(10000);
+  }
+  report("two refused connects", rig->session);
+
+  TEST_ASSERT_EQUAL(5, rig->served);
+  TEST_ASSERT_EQUAL(2, rig->session.failures());
+  TEST_ASSERT_EQUAL(1, rig->session.connects());
+  TEST_ASSERT_EQUAL(4, rig->session.reuses());
+  delete rig;
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_uploads_reuse_one_connection);
+  RUN_TEST(test_reconnects_after_idle_close);
+  RUN_TEST(test_bearer_rebuilt_after_pdp_deact);
+  RUN_TEST(test_failed_connects_retry_from_the_bearer);
+  return UNITY_END();
+}
@@ -0,0 +1,208 @@
+// writeTelemetryBinary() and TelemetryDecoder round trips.
+//
+// The readings are the simulated drive src/native runs, taken every 10 s
+// as the tracker keeps them (with gaps in seq, readings without GPS time
+// and the cached/estimated/fence flags), plus the extremes the deltas
+// have to wrap around. Every prefix of a document must fail to decode
+// cleanly rather than read past the end.
+//
+//   pio test -e test_native -f test_telemetry_binary
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <unity.h>
+#include <JsonWriter.h>
+#include <TelemetryBinary.h>
+#include <SimRoute.h>
+
+struct Batch {
+  std::vector<TelemetryRecord> records;
+  std::vector<TelemetryStat> stats;
+};
+
+static bool recordSource(size_t index, TelemetryRecord& out, void* ctx) {
+  const Batch& b = *(const Batch*)ctx;
+  if (index % 11 == 5) return false;  // a slot the source skips
+  out = b.records[index];
+  return true;
+}
+
+static bool statsSource(size_t index, TelemetryStat& out, void* ctx) {
+  const Batch& b = *(const Batch*)ctx;
+  if (index >= b.stats.size()) return false;
+  out = b.stats[index];
+  return true;
+}
+
+static size_t accepted(const Batch& b) {
+  size_t n = 0;
+  for (size_t i = 0; i < b.records.size(); i++) n += i % 11 != 5;
+  return n;
+}
+
+static std::vector<uint8_t> encode(const Batch& b) {
+  TelemetryBatch batch = { "ESP_GPS_001", b.records.size(), accepted(b), recordSource, (void*)&b,
+                           b.stats.empty() ? 0 : statsSource, (void*)&b };
+  std::vector<uint8_t> out(telemetryBinaryLength(batch) + 1);
+  BufferSink sink((char*)&out[0], out.size());
+  writeTelemetryBinary(sink, batch);
+  TEST_ASSERT_FALSE(sink.overflow());
+  out.resize(sink.length());
+  return out;
+}
+
+// A reading every 10 s of the simulated drive
+static void driveRecords(uint32_t minutes, Batch& b) {
+  SimRoute route(-6.927079, 79.861244, makeEpoch(2026, 3, 14, 8, 30, 0));
+  uint32_t seq = 1;
+  for (uint32_t ms = 10000; ms <= minutes * 60000u; ms += 10000) {
+    SimFix f;
+    SimRoute::track(ms, f, &route);
+    TelemetryRecord r;
+    memset(&r, 0, sizeof(r));
+    r.seq = seq;
+    seq += ms % 70000 == 0 ? 3 : 1;   // readings dropped by the store
+    r.ts = ms + 137;
+    r.utc = f.utc;
+    r.flags = f.utc ? TELEMETRY_FLAG_UTC : 0;
+    if (!f.valid) r.flags |= TELEMETRY_FLAG_CACHED;
+    else if (ms % 90000 == 0) r.flags |= TELEMETRY_FLAG_ESTIMATED;
+    else if (ms % 130000 == 0) r.flags |= TELEMETRY_FLAG_FENCE;
+    r.lat_e7 = (int32_t)lround(f.lat * 1e7);
+    r.lng_e7 = (int32_t)lround(f.lng * 1e7);
+    r.speed_e2 = (uint32_t)lround(f.speedKmh * 100);
+    r.alt_dm = (int32_t)lround(f.altitudeM * 10);
+    r.satellites = f.satellites;
+    b.records.push_back(r);
+  }
+}
+
+// Decodes 'doc' and checks it against the batch it came from
+static void assertRoundTrip(const Batch& b, const std::vector<uint8_t>& doc) {
+  TelemetryDecoder d;
+  TEST_ASSERT_TRUE(d.begin(&doc[0], doc.size()));
+  TEST_ASSERT_EQUAL_STRING("ESP_GPS_001", d.deviceId());
+  TEST_ASSERT_EQUAL(accepted(b), d.count());
+
+  for (size_t i = 0; i < b.records.size(); i++) {
+    if (i % 11 == 5) continue;
+    const TelemetryRecord& r = b.records[i];
+    DecodedRecord out;
+    TEST_ASSERT_TRUE(d.next(out));
+    TEST_ASSERT_EQUAL_HEX8(r.flags | (r.seq ? TBIN_FLAG_SEQ : 0), out.flags);
+    if (r.seq) TEST_ASSERT_EQUAL_UINT32(r.seq, out.seq);
+    TEST_ASSERT_EQUAL_UINT32(r.ts, out.ts);
+    if (r.flags & TELEMETRY_FLAG_UTC) TEST_ASSERT_EQUAL_UINT32(r.utc, out.utc);
+    TEST_ASSERT_EQUAL_INT32(dropDecimals(r.lat_e7, 1), out.lat_e6);
+    TEST_ASSERT_EQUAL_INT32(dropDecimals(r.lng_e7, 1), out.lng_e6);
+    TEST_ASSERT_EQUAL_UINT32(r.speed_e2, out.speed_e2);
+    TEST_ASSERT_EQUAL_INT32(r.alt_dm, out.alt_e1);
+    TEST_ASSERT_EQUAL(r.satellites, out.satellites);
+  }
+  DecodedRecord extra;
+  TEST_ASSERT_FALSE(d.next(extra));
+  TEST_ASSERT_EQUAL(0, d.remaining());
+
+  for (size_t i = 0; i < b.stats.size(); i++) {
+    DecodedStat s;
+    TEST_ASSERT_TRUE(d.nextStat(s));
+    TEST_ASSERT_EQUAL_STRING(b.stats[i].key, s.key);
+    TEST_ASSERT_EQUAL_UINT32(b.stats[i].value, s.value);
+  }
+  DecodedStat none;
+  TEST_ASSERT_FALSE(d.nextStat(none));
+  TEST_ASSERT_FALSE(d.error());
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_drive_round_trip() {
+  Batch b;
+  driveRecords(60, b);
+  std::vector<uint8_t> doc = encode(b);
+  assertRoundTrip(b, doc);
+
+  // Compact: header aside, well under the ~110 bytes a JSON reading takes
+  double perRecord = (double)doc.size() / accepted(b);
+  TEST_ASSERT_LESS_THAN(18, (int)perRecord);
+}
+
+static void test_extremes_round_trip() {
+  Batch b;
+  static const int32_t lats[] = { 900000000, -900000000, 0, -1, 899999995, -899999995 };
+  static const int32_t lngs[] = { 1800000000, -1800000000, -1799999995, 1799999995, 0, 5 };
+  static const uint32_t ts[] = { 0xFFFFFF00u, 0xFFFFFFFFu, 0, 100, 0x7FFFFFFFu, 0x80000000u };
+  for (int i = 0; i < 6; i++) {
+    TelemetryRecord r;
+    memset(&r, 0, sizeof(r));
+    r.seq = i == 2 ? 0 : 0xFFFFFFF0u + i * 3;   // wraps, and one without
+    r.ts = ts[i];
+    r.utc = i % 2 ? 0xFFFFFFFFu - i : (uint32_t)i;
+    r.flags = i == 4 ? 0 : TELEMETRY_FLAG_UTC;
+    r.lat_e7 = lats[i];
+    r.lng_e7 = lngs[i];
+    r.speed_e2 = i == 1 ? 0xFFFFFFFFu : i * 99999;
+    r.alt_dm = i % 2 ? -4000 : 88480;
+    r.satellites = i == 3 ? 255 : i;
+    b.records.push_back(r);
+  }
+  TelemetryStat s1 = { "uploads_ok", 0xFFFFFFFFu };
+  TelemetryStat s2 = { "a_key_that_is_exactly_32_chars_x", 7 };
+  b.stats.push_back(s1);
+  b.stats.push_back(s2);
+
+  assertRoundTrip(b, encode(b));
+}
+
+static void test_every_prefix_fails_cleanly() {
+  Batch b;
+  driveRecords(5, b);
+  TelemetryStat s = { "resets", 3 };
+  b.stats.push_back(s);
+  std::vector<uint8_t> doc = encode(b);
+
+  for (size_t len = 0; len < doc.size(); len++) {
+    // A copy the exact length, so reading past it trips the sanitizers
+    std::vector<uint8_t> prefix(doc.begin(), doc.begin() + len);
+    TelemetryDecoder d;
+    if (!d.begin(len ? &prefix[0] : 0, len)) continue;
+    DecodedRecord r;
+    size_t records = 0;
+    while (d.next(r)) records++;
+    DecodedStat st;
+    size_t stats = 0;
+    while (d.nextStat(st)) stats++;
+    TEST_ASSERT_TRUE_MESSAGE(d.error() || records < d.count() || stats < b.stats.size(),
+                             "truncated document decoded as complete");
+  }
+}
+
+static void test_bad_header_rejected() {
+  Batch b;
+  driveRecords(1, b);
+  std::vector<uint8_t> doc = encode(b);
+  TelemetryDecoder d;
+
+  std::vector<uint8_t> bad = doc;
+  bad[0] = 'X';
+  TEST_ASSERT_FALSE(d.begin(&bad[0], bad.size()));
+
+  bad = doc;
+  bad[2] = TBIN_VERSION + 1;
+  TEST_ASSERT_FALSE(d.begin(&bad[0], bad.size()));
+
+  bad = doc;
+  bad[3] = 40;  // device_id longer than 32
+  TEST_ASSERT_FALSE(d.begin(&bad[0], bad.size()));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_drive_round_trip);
+  RUN_TEST(test_extremes_round_trip);
+  RUN_TEST(test_every_prefix_fails_cleanly);
+  RUN_TEST(test_bad_header_rejected);
+  return UNITY_END();
+}
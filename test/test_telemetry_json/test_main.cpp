@@ -0,0 +1,220 @@
+// writeTelemetryJson() against the String concatenation it replaced.
+//
+// legacyRequest() is sendDataToServer() from before the serializer, with
+// std::string standing in for Arduino's String and each String(v, n) as
+// the "%.nf" it formats to. It is fed doubles, so the two paths can only
+// differ in layout, not in float rounding. Global operator new is counted
+// to show the serializer allocates nothing (std::string keeps short
+// strings inline, so the String path's count here is a lower bound); the
+// time per reading of both paths is printed for reference, not asserted.
+//
+//   pio test -e test_native -f test_telemetry_json
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include <unity.h>
+#include <TelemetryJson.h>
+
+#define READINGS 60
+#define TIMING_ROUNDS 200
+
+static size_t allocations = 0;
+static size_t allocatedBytes = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  allocatedBytes += size;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+// A reading as the old GPSData held it
+struct LegacyReading {
+  std::string datetime;
+  uint32_t timestamp;
+  double lat;
+  double lng;
+  double speed;
+  double altitude;
+  int satellites;
+};
+
+static TelemetryRecord records[READINGS];
+static LegacyReading legacy[READINGS];
+
+static void makeReadings() {
+  uint32_t utc = makeEpoch(2026, 3, 14, 8, 30, 0);
+  for (int i = 0; i < READINGS; i++) {
+    TelemetryRecord& r = records[i];
+    r.seq = 0;
+    r.ts = 12000 + i * 10000;
+    r.utc = utc + i * 10;
+    r.flags = i % 7 == 3 ? 0 : TELEMETRY_FLAG_UTC;
+    r.lat_e7 = -69270790 + i * 1370 - (i % 3) * 40;   // whole microdegrees
+    r.lng_e7 = 798612440 - i * 2210 + (i % 5) * 90;
+    r.speed_e2 = i % 4 == 0 ? 0 : 3000 + i * 17;
+    r.alt_dm = i % 9 == 0 ? -15 : 70 + i;
+    r.satellites = 4 + i % 8;
+
+    LegacyReading& l = legacy[i];
+    char datetime[20];
+    formatDatetime(r.utc, datetime);
+    l.datetime = (r.flags & TELEMETRY_FLAG_UTC) ? datetime : "N/A";
+    l.timestamp = r.ts;
+    l.lat = r.lat_e7 / 1e7;
+    l.lng = r.lng_e7 / 1e7;
+    l.speed = r.speed_e2 / 100.0;
+    l.altitude = r.alt_dm / 10.0;
+    l.satellites = r.satellites;
+  }
+}
+
+static bool source(size_t index, TelemetryRecord& out, void* ctx) {
+  out = records[index];
+  return true;
+}
+
+// Arduino's String(v, decimals)
+static std::string str(double v, int decimals) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+  return buf;
+}
+
+static std::string str(unsigned long v) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%lu", v);
+  return buf;
+}
+
+static std::string legacyRequest(const char* server, const char* endpoint) {
+  std::string jsonData = "{\"device_id\":\"ESP_GPS_001\",\"count\":";
+  jsonData += str((unsigned long)READINGS);
+  jsonData += ",\"readings\":[";
+
+  bool first = true;
+  for (int i = 0; i < READINGS; i++) {
+    if (!first) jsonData += ",";
+
+    jsonData += "{";
+    jsonData += "\"datetime\":\"" + legacy[i].datetime + "\",";
+    jsonData += "\"ts\":" + str((unsigned long)legacy[i].timestamp) + ",";
+    jsonData += "\"lat\":" + str(legacy[i].lat, 6) + ",";
+    jsonData += "\"lng\":" + str(legacy[i].lng, 6) + ",";
+    jsonData += "\"spd\":" + str(legacy[i].speed, 2) + ",";
+    jsonData += "\"alt\":" + str(legacy[i].altitude, 1) + ",";
+    jsonData += "\"sat\":" + str((unsigned long)legacy[i].satellites);
+    jsonData += "}";
+
+    first = false;
+  }
+  jsonData += "]}";
+
+  std::string httpHeader = "POST ";
+  httpHeader += endpoint;
+  httpHeader += " HTTP/1.1\r\n";
+  httpHeader += "Host: ";
+  httpHeader += server;
+  httpHeader += "\r\n";
+  httpHeader += "Content-Type: application/json\r\n";
+  httpHeader += "Content-Length: ";
+  httpHeader += str((unsigned long)jsonData.length());
+  httpHeader += "\r\n\r\n";
+
+  return httpHeader + jsonData;
+}
+
+static char requestBuffer[16384];
+
+// The serializer's path: sizing pass, then header and body into the buffer
+static size_t request(const char* server, const char* endpoint) {
+  TelemetryBatch batch = { "ESP_GPS_001", READINGS, READINGS, source, 0, 0, 0 };
+  size_t jsonLength = telemetryJsonLength(batch);
+  BufferSink sink(requestBuffer, sizeof(requestBuffer));
+  writeHttpPostHeader(sink, server, endpoint, "application/json", jsonLength);
+  writeTelemetryJson(sink, batch);
+  return sink.overflow() ? 0 : sink.length();
+}
+
+void setUp() {
+  makeReadings();
+}
+
+void tearDown() {}
+
+static void test_same_bytes_as_string_path() {
+  std::string old = legacyRequest("ingest.example.com", "/api/readings");
+  size_t length = request("ingest.example.com", "/api/readings");
+  TEST_ASSERT_TRUE(length > 0);
+  // Apart from the Connection header the new request adds
+  std::string now(requestBuffer, length);
+  size_t connection = now.find("Connection: keep-alive\r\n");
+  if (connection != std::string::npos) now.erase(connection, strlen("Connection: keep-alive\r\n"));
+  TEST_ASSERT_EQUAL_STRING(old.c_str(), now.c_str());
+}
+
+static void test_sizing_pass_matches_body() {
+  TelemetryBatch batch = { "ESP_GPS_001", READINGS, READINGS, source, 0, 0, 0 };
+  BufferSink sink(requestBuffer, sizeof(requestBuffer));
+  writeTelemetryJson(sink, batch);
+  TEST_ASSERT_FALSE(sink.overflow());
+  TEST_ASSERT_EQUAL(sink.length(), telemetryJsonLength(batch));
+
+  // Too small a buffer is flagged, never overrun
+  char small[100];
+  BufferSink tight(small, sizeof(small));
+  writeTelemetryJson(tight, batch);
+  TEST_ASSERT_TRUE(tight.overflow());
+  TEST_ASSERT_EQUAL(sizeof(small) - 1, tight.length());
+}
+
+static void test_serializer_allocates_nothing() {
+  size_t before = allocations;
+  size_t length = request("ingest.example.com", "/api/readings");
+  TEST_ASSERT_TRUE(length > 0);
+  TEST_ASSERT_EQUAL(0, allocations - before);
+
+  before = allocations;
+  size_t bytesBefore = allocatedBytes;
+  std::string old = legacyRequest("ingest.example.com", "/api/readings");
+  size_t legacyAllocations = allocations - before;
+  size_t legacyBytes = allocatedBytes - bytesBefore;
+  TEST_ASSERT_GREATER_THAN(READINGS, legacyAllocations);
+
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < TIMING_ROUNDS; i++) length += request("ingest.example.com", "/api/readings");
+  double serializerNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  start = Clock::now();
+  for (int i = 0; i < TIMING_ROUNDS; i++) length += legacyRequest("ingest.example.com", "/api/readings").size();
+  double legacyNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+  char line[160];
+  snprintf(line, sizeof(line),
+           "per reading: serializer 0 allocations, %.0f ns; String path %.1f allocations "
+           "(%.0f bytes), %.0f ns",
+           serializerNs / TIMING_ROUNDS / READINGS, (double)legacyAllocations / READINGS,
+           (double)legacyBytes / READINGS, legacyNs / TIMING_ROUNDS / READINGS);
+  TEST_MESSAGE(line);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_same_bytes_as_string_path);
+  RUN_TEST(test_sizing_pass_matches_body);
+  RUN_TEST(test_serializer_allocates_nothing);
+  return UNITY_END();
+}
@@ -0,0 +1,141 @@
+// Where the Tracker keeps its readings over hours of simulated driving.
+//
+// With the flash store mounted every reading goes straight to flash and
+// the RAM ring stays empty, uploads or not; without it the ring is the
+// only buffer and has to stay within MAX_READINGS however long the
+// server is unreachable.
+//
+//   pio test -e test_native -f test_tracker
+
+#include <unity.h>
+#include <RamFlash.h>
+#include <Ubx.h>
+#include <Tracker.h>
+#include <SimClock.h>
+#include <SimNeo7m.h>
+#include <SimRoute.h>
+#include <SimSim800.h>
+#include <SimIngest.h>
+#include <SimLed.h>
+#include <HostConsole.h>
+
+#define TRACK_FLASH_SIZE 0xB0000  // the "track" partition
+#define MINUTE 60000u
+
+static bool before(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+// The tracker on the simulated receiver, modem and server, as
+// src/native/main.cpp sets it up (without geofences)
+struct Rig {
+  SimClock clock;
+  SimRoute route;
+  SimNeo7m gps;
+  SimIngest ingest;
+  SimSim800 modem;
+  RamFlash flash;
+  RamFlash fenceFlash;
+  HostConsole console;
+  SimLed led;
+  TrackerConfig config;
+  Tracker tracker;
+  size_t peakBuffered;
+
+  Rig()
+    : route(-6.927079, 79.861244, makeEpoch(2026, 3, 14, 8, 30, 0)),
+      gps(clock, SimRoute::track, &route), modem(clock, SimIngest::handle, &ingest),
+      flash(TRACK_FLASH_SIZE), fenceFlash(4 * 4096), console(false), led(clock),
+      config(makeConfig()),
+      tracker(config, clock, console, modem.port(), gps.port(), led, flash, fenceFlash),
+      peakBuffered(0) {
+    ubxSetRate(gps.port(), 1000 / GPS_RATE_HZ);
+  }
+
+  static TrackerConfig makeConfig() {
+    TrackerConfig c = { "ingest.example.com", 80, "/api/readings", "internet", "ESP_GPS_001" };
+    return c;
+  }
+
+  // Runs the main loop until virtual minute 'untilMinute'
+  void runUntil(uint32_t untilMinute) {
+    uint32_t end = untilMinute * MINUTE;
+    while (before(clock.millis(), end)) {
+      gps.poll();
+      modem.poll();
+      tracker.pollGps();
+      tracker.loop();
+      if (tracker.buffered() > peakBuffered) peakBuffered = tracker.buffered();
+
+      uint32_t now = clock.millis();
+      uint32_t idle = tracker.sleepFor();
+      uint32_t next = now + (idle ? idle : 1);
+      uint32_t at = gps.nextEvent();
+      if (before(at, next)) next = at;
+      if (modem.nextEvent(at) && before(at, next)) next = at;
+      if (!before(now, next)) next = now + 1;
+      clock.set(next);
+    }
+  }
+};
+
+void setUp() {}
+void tearDown() {}
+
+static void test_stored_readings_never_touch_ram() {
+  Rig* rig = new Rig();
+  rig->tracker.begin(true);
+  rig->runUntil(180);
+
+  TEST_ASSERT_TRUE(rig->tracker.storeReady());
+  TEST_ASSERT_GREATER_THAN(MAX_READINGS, rig->tracker.readingsKept());
+  TEST_ASSERT_EQUAL(0, rig->peakBuffered);
+  TEST_ASSERT_GREATER_OR_EQUAL(rig->tracker.readingsKept(), rig->tracker.store().nextSeq() - 1);
+  TEST_ASSERT_EQUAL(0, rig->tracker.store().dropped());
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_UPLOAD_BATCH, rig->tracker.store().pending());
+  delete rig;
+}
+
+static void test_outage_backlog_stays_on_flash() {
+  Rig* rig = new Rig();
+  rig->ingest.failNext(1000000);
+  rig->tracker.begin(true);
+  rig->runUntil(120);
+
+  // Two hours of readings wait on flash, none in RAM
+  uint32_t kept = rig->tracker.store().nextSeq() - 1;
+  TEST_ASSERT_GREATER_OR_EQUAL(rig->tracker.readingsKept(), kept);
+  TEST_ASSERT_GREATER_THAN(MAX_READINGS, kept);
+  TEST_ASSERT_EQUAL(0, rig->peakBuffered);
+  TEST_ASSERT_EQUAL(kept, rig->tracker.store().pending());
+  TEST_ASSERT_EQUAL(0, rig->ingest.readings());
+
+  // And go out once the server is back
+  rig->ingest.failNext(0);
+  rig->runUntil(180);
+  TEST_ASSERT_EQUAL(0, rig->peakBuffered);
+  TEST_ASSERT_GREATER_OR_EQUAL(kept, rig->ingest.readings());
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_UPLOAD_BATCH, rig->tracker.store().pending());
+  delete rig;
+}
+
+static void test_ram_buffer_bounded_without_store() {
+  Rig* rig = new Rig();
+  rig->ingest.failNext(1000000);
+  rig->tracker.begin(false);
+  rig->runUntil(180);
+
+  TEST_ASSERT_FALSE(rig->tracker.storeReady());
+  TEST_ASSERT_GREATER_THAN(MAX_READINGS, rig->tracker.readingsKept());
+  TEST_ASSERT_EQUAL(MAX_READINGS, rig->peakBuffered);
+  TEST_ASSERT_EQUAL(MAX_READINGS, rig->tracker.buffered());
+  delete rig;
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_stored_readings_never_touch_ram);
+  RUN_TEST(test_outage_backlog_stays_on_flash);
+  RUN_TEST(test_ram_buffer_bounded_without_store);
+  return UNITY_END();
+}
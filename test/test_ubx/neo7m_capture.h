@@ -0,0 +1,84 @@
+#ifndef NEO7M_CAPTURE_H
+#define NEO7M_CAPTURE_H
+
+// A NEO-7M serial stream at 38400 baud after the tracker's configuration,
+// for test_ubx.
+//
+// Not recorded from hardware: the frames were assembled by hand to the
+// u-blox 7 Receiver Description (protocol version 14), where NAV-PVT is 84
+// bytes with reserved2/reserved3 at offsets 78-83. In order:
+//
+//   ACK-ACK for the CFG-MSG that turned NAV-PVT on
+//   $GPTXT banner the receiver prints before UBX output takes over
+//   NAV-PVT 08:30:18, date and time valid, no fix, 2 satellites
+//   $GPRMC, status V
+//   NAV-PVT 08:30:19, 3D fix, 9 satellites, -6.9270790 79.8612440,
+//           hMSL 7.123 m, 9722 mm/s, heading 45.12345, hAcc 2.5 m, pDOP 1.45
+//   $GPGGA for the same epoch
+//   NAV-PVT 08:30:20, 2D fix, 4 satellites, -6.9270001 79.8613317,
+//           hMSL 6 m, 9001 mm/s, heading 359.9, hAcc 12 m, pDOP 4.20
+//   $GPGSA
+//
+// kM8NavPvt is the 08:30:19 solution as a u-blox 8 receiver sends it: the
+// same 84 bytes followed by headVeh, magDec and magAcc (92 bytes).
+
+#include <stdint.h>
+
+static const uint8_t kNeo7mCapture[] = {
+  0xb5, 0x62, 0x05, 0x01, 0x02, 0x00, 0x06, 0x01, 0x0f, 0x38, 0x24, 0x47,
+  0x50, 0x54, 0x58, 0x54, 0x2c, 0x30, 0x31, 0x2c, 0x30, 0x31, 0x2c, 0x30,
+  0x32, 0x2c, 0x75, 0x2d, 0x62, 0x6c, 0x6f, 0x78, 0x20, 0x61, 0x67, 0x20,
+  0x2d, 0x20, 0x77, 0x77, 0x77, 0x2e, 0x75, 0x2d, 0x62, 0x6c, 0x6f, 0x78,
+  0x2e, 0x63, 0x6f, 0x6d, 0x2a, 0x35, 0x30, 0x0d, 0x0a, 0xb5, 0x62, 0x01,
+  0x07, 0x54, 0x00, 0x90, 0x31, 0xd3, 0x01, 0xea, 0x07, 0x03, 0x0e, 0x08,
+  0x1e, 0x12, 0x03, 0xff, 0xff, 0xff, 0xff, 0x40, 0xa2, 0xff, 0xff, 0x00,
+  0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20,
+  0x4e, 0x00, 0x00, 0x80, 0xa8, 0x12, 0x01, 0x0f, 0x27, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0xe3, 0xac, 0x24, 0x47, 0x50, 0x52, 0x4d, 0x43, 0x2c,
+  0x30, 0x38, 0x33, 0x30, 0x31, 0x38, 0x2e, 0x30, 0x30, 0x2c, 0x56, 0x2c,
+  0x2c, 0x2c, 0x2c, 0x2c, 0x2c, 0x2c, 0x31, 0x34, 0x30, 0x33, 0x32, 0x36,
+  0x2c, 0x2c, 0x2c, 0x4e, 0x2a, 0x37, 0x44, 0x0d, 0x0a, 0xb5, 0x62, 0x01,
+  0x07, 0x54, 0x00, 0x78, 0x35, 0xd3, 0x01, 0xea, 0x07, 0x03, 0x0e, 0x08,
+  0x1e, 0x13, 0x07, 0x20, 0x00, 0x00, 0x00, 0x40, 0xe2, 0x01, 0x00, 0x03,
+  0x01, 0x00, 0x09, 0xd8, 0xdb, 0x99, 0x2f, 0xfa, 0x02, 0xdf, 0xfb, 0x63,
+  0x7b, 0x01, 0x00, 0xd3, 0x1b, 0x00, 0x00, 0xc4, 0x09, 0x00, 0x00, 0xd8,
+  0x0e, 0x00, 0x00, 0xda, 0x1a, 0x00, 0x00, 0xd9, 0x1a, 0x00, 0x00, 0x0c,
+  0x00, 0x00, 0x00, 0xfa, 0x25, 0x00, 0x00, 0x59, 0xda, 0x44, 0x00, 0x9a,
+  0x01, 0x00, 0x00, 0x87, 0xd6, 0x12, 0x00, 0x91, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x64, 0xaf, 0x24, 0x47, 0x50, 0x47, 0x47, 0x41, 0x2c,
+  0x30, 0x38, 0x33, 0x30, 0x31, 0x39, 0x2e, 0x30, 0x30, 0x2c, 0x30, 0x36,
+  0x35, 0x35, 0x2e, 0x36, 0x32, 0x34, 0x37, 0x34, 0x2c, 0x53, 0x2c, 0x30,
+  0x37, 0x39, 0x35, 0x31, 0x2e, 0x36, 0x37, 0x34, 0x36, 0x34, 0x2c, 0x45,
+  0x2c, 0x31, 0x2c, 0x30, 0x39, 0x2c, 0x31, 0x2e, 0x31, 0x30, 0x2c, 0x37,
+  0x2e, 0x31, 0x2c, 0x4d, 0x2c, 0x39, 0x30, 0x2e, 0x30, 0x2c, 0x4d, 0x2c,
+  0x2c, 0x2a, 0x34, 0x43, 0x0d, 0x0a, 0xb5, 0x62, 0x01, 0x07, 0x54, 0x00,
+  0x60, 0x39, 0xd3, 0x01, 0xea, 0x07, 0x03, 0x0e, 0x08, 0x1e, 0x14, 0x07,
+  0x1e, 0x00, 0x00, 0x00, 0x78, 0xec, 0xff, 0xff, 0x02, 0x01, 0x00, 0x04,
+  0x45, 0xdf, 0x99, 0x2f, 0x0f, 0x06, 0xdf, 0xfb, 0x00, 0x77, 0x01, 0x00,
+  0x70, 0x17, 0x00, 0x00, 0xe0, 0x2e, 0x00, 0x00, 0x30, 0x75, 0x00, 0x00,
+  0x9c, 0xff, 0xff, 0xff, 0x28, 0x23, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x29, 0x23, 0x00, 0x00, 0xf0, 0x29, 0x25, 0x02, 0x84, 0x03, 0x00, 0x00,
+  0x80, 0x84, 0x1e, 0x00, 0xa4, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0xde, 0x1a, 0x24, 0x47, 0x50, 0x47, 0x53, 0x41, 0x2c, 0x41, 0x2c, 0x33,
+  0x2c, 0x30, 0x32, 0x2c, 0x30, 0x35, 0x2c, 0x31, 0x32, 0x2c, 0x2c, 0x2c,
+  0x2c, 0x2c, 0x2c, 0x2c, 0x2c, 0x2c, 0x2c, 0x34, 0x2e, 0x32, 0x30, 0x2c,
+  0x33, 0x2e, 0x31, 0x30, 0x2c, 0x32, 0x2e, 0x38, 0x30, 0x2a, 0x30, 0x38,
+  0x0d, 0x0a,
+};
+
+static const uint8_t kM8NavPvt[] = {
+  0xb5, 0x62, 0x01, 0x07, 0x5c, 0x00, 0x78, 0x35, 0xd3, 0x01, 0xea, 0x07,
+  0x03, 0x0e, 0x08, 0x1e, 0x13, 0x07, 0x20, 0x00, 0x00, 0x00, 0x40, 0xe2,
+  0x01, 0x00, 0x03, 0x01, 0x00, 0x09, 0xd8, 0xdb, 0x99, 0x2f, 0xfa, 0x02,
+  0xdf, 0xfb, 0x63, 0x7b, 0x01, 0x00, 0xd3, 0x1b, 0x00, 0x00, 0xc4, 0x09,
+  0x00, 0x00, 0xd8, 0x0e, 0x00, 0x00, 0xda, 0x1a, 0x00, 0x00, 0xd9, 0x1a,
+  0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0xfa, 0x25, 0x00, 0x00, 0x59, 0xda,
+  0x44, 0x00, 0x9a, 0x01, 0x00, 0x00, 0x87, 0xd6, 0x12, 0x00, 0x91, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x59, 0xda, 0x44, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0xe3, 0x15,
+};
+
+#endif
@@ -0,0 +1,195 @@
+// UbxParser and the NAV-PVT decoder against a NEO-7M style stream, the
+// longer u-blox 8 message, damaged frames and the simulated receiver.
+//
+//   pio test -e test_native -f test_ubx
+
+#include <string.h>
+#include <vector>
+#include <unity.h>
+#include <Ubx.h>
+#include <UbxParser.h>
+#include <SimClock.h>
+#include <SimNeo7m.h>
+#include "neo7m_capture.h"
+
+struct Decoded {
+  std::vector<UbxNavPvt> pvt;
+  std::vector<uint16_t> lengths;
+  uint32_t otherFrames;
+};
+
+// Runs 'data' through a parser and decodes every NAV-PVT in it
+static void decode(UbxParser& parser, const uint8_t* data, size_t len, Decoded& out) {
+  out.otherFrames = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (!parser.encode(data[i])) continue;
+    if (parser.msgClass() != UBX_CLASS_NAV || parser.msgId() != UBX_NAV_PVT) {
+      out.otherFrames++;
+      continue;
+    }
+    UbxNavPvt pvt;
+    TEST_ASSERT_TRUE(ubxDecodeNavPvt(parser.payload(), parser.length(), pvt));
+    out.pvt.push_back(pvt);
+    out.lengths.push_back(parser.length());
+  }
+}
+
+static void assertFirstFix(const UbxNavPvt& p) {
+  TEST_ASSERT_EQUAL(2026, p.year);
+  TEST_ASSERT_EQUAL(3, p.month);
+  TEST_ASSERT_EQUAL(14, p.day);
+  TEST_ASSERT_EQUAL(8, p.hour);
+  TEST_ASSERT_EQUAL(30, p.minute);
+  TEST_ASSERT_EQUAL(19, p.second);
+  TEST_ASSERT_EQUAL(123456, p.nano);
+  TEST_ASSERT_TRUE(p.dateValid);
+  TEST_ASSERT_TRUE(p.timeValid);
+  TEST_ASSERT_EQUAL(3, p.fixType);
+  TEST_ASSERT_TRUE(p.fixOk);
+  TEST_ASSERT_EQUAL(9, p.numSV);
+  TEST_ASSERT_EQUAL(-69270790, p.lat_e7);
+  TEST_ASSERT_EQUAL(798612440, p.lon_e7);
+  TEST_ASSERT_EQUAL(7123, p.hMSL_mm);
+  TEST_ASSERT_EQUAL(9722, p.gSpeed_mms);
+  TEST_ASSERT_EQUAL(4512345, p.headMot_e5);
+  TEST_ASSERT_EQUAL(2500, p.hAcc_mm);
+  TEST_ASSERT_EQUAL(145, p.pDOP_e2);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_neo7m_capture_decodes() {
+  UbxParser parser;
+  Decoded d;
+  decode(parser, kNeo7mCapture, sizeof(kNeo7mCapture), d);
+
+  TEST_ASSERT_EQUAL(3, d.pvt.size());
+  TEST_ASSERT_EQUAL(1, d.otherFrames);  // the ACK-ACK
+  TEST_ASSERT_EQUAL(4, parser.framesOk());
+  TEST_ASSERT_EQUAL(0, parser.checksumErrors());
+  TEST_ASSERT_EQUAL(0, parser.oversized());
+  for (size_t i = 0; i < d.lengths.size(); i++) TEST_ASSERT_EQUAL(84, d.lengths[i]);
+
+  const UbxNavPvt& none = d.pvt[0];
+  TEST_ASSERT_EQUAL(0, none.fixType);
+  TEST_ASSERT_FALSE(none.fixOk);
+  TEST_ASSERT_EQUAL(2, none.numSV);
+  TEST_ASSERT_EQUAL(18, none.second);
+  TEST_ASSERT_EQUAL(-24000, none.nano);
+  TEST_ASSERT_EQUAL(9999, none.pDOP_e2);
+
+  assertFirstFix(d.pvt[1]);
+
+  const UbxNavPvt& fix2d = d.pvt[2];
+  TEST_ASSERT_EQUAL(2, fix2d.fixType);
+  TEST_ASSERT_EQUAL(4, fix2d.numSV);
+  TEST_ASSERT_EQUAL(-69270001, fix2d.lat_e7);
+  TEST_ASSERT_EQUAL(798613317, fix2d.lon_e7);
+  TEST_ASSERT_EQUAL(35990000, fix2d.headMot_e5);
+  TEST_ASSERT_EQUAL(420, fix2d.pDOP_e2);
+}
+
+static void test_m8_length_decodes_the_same() {
+  UbxParser parser;
+  Decoded d;
+  decode(parser, kM8NavPvt, sizeof(kM8NavPvt), d);
+
+  TEST_ASSERT_EQUAL(1, d.pvt.size());
+  TEST_ASSERT_EQUAL(92, d.lengths[0]);
+  assertFirstFix(d.pvt[0]);
+}
+
+static void test_short_payload_rejected() {
+  uint8_t payload[UBX_NAV_PVT_LEN];
+  memset(payload, 0, sizeof(payload));
+  UbxNavPvt pvt;
+  TEST_ASSERT_TRUE(ubxDecodeNavPvt(payload, UBX_NAV_PVT_LEN, pvt));
+  TEST_ASSERT_FALSE(ubxDecodeNavPvt(payload, UBX_NAV_PVT_LEN - 1, pvt));
+  TEST_ASSERT_FALSE(ubxDecodeNavPvt(payload, 0, pvt));
+}
+
+static void test_corrupt_frame_dropped_and_next_kept() {
+  std::vector<uint8_t> data(kNeo7mCapture, kNeo7mCapture + sizeof(kNeo7mCapture));
+  // Flip a bit in the first fix's latitude; its checksum no longer matches
+  size_t at = 0;
+  int frames = 0;
+  for (size_t i = 0; i + 1 < data.size(); i++) {
+    if (data[i] == UBX_SYNC1 && data[i + 1] == UBX_SYNC2 && ++frames == 3) {
+      at = i;
+      break;
+    }
+  }
+  TEST_ASSERT_TRUE(at > 0);
+  data[at + 6 + 28] ^= 0x10;
+
+  UbxParser parser;
+  Decoded d;
+  decode(parser, &data[0], data.size(), d);
+
+  TEST_ASSERT_EQUAL(1, parser.checksumErrors());
+  TEST_ASSERT_EQUAL(2, d.pvt.size());
+  TEST_ASSERT_EQUAL(0, d.pvt[0].fixType);
+  TEST_ASSERT_EQUAL(2, d.pvt[1].fixType);
+}
+
+static void test_oversized_frame_skipped() {
+  // A frame claiming more than UBX_MAX_PAYLOAD, then the capture
+  std::vector<uint8_t> data;
+  const uint8_t big[] = { UBX_SYNC1, UBX_SYNC2, UBX_CLASS_NAV, 0x35, 0xFF, 0x01 };
+  data.insert(data.end(), big, big + sizeof(big));
+  data.insert(data.end(), kNeo7mCapture, kNeo7mCapture + sizeof(kNeo7mCapture));
+
+  UbxParser parser;
+  Decoded d;
+  decode(parser, &data[0], data.size(), d);
+
+  TEST_ASSERT_EQUAL(1, parser.oversized());
+  TEST_ASSERT_EQUAL(3, d.pvt.size());
+}
+
+static void still(uint32_t ms, SimFix& out, void* ctx) {
+  memset(&out, 0, sizeof(out));
+  out.valid = true;
+  out.lat = -6.927079;
+  out.lng = 79.861244;
+  out.speedKmh = 36;
+  out.courseDeg = 90;
+  out.altitudeM = 7;
+  out.satellites = 8;
+  out.utc = 1773477000 + ms / 1000;
+}
+
+static void test_sim_sends_protocol_14_length() {
+  SimClock clock;
+  SimNeo7m gps(clock, still, 0, 0);
+  ubxSetMessageRate(gps.port(), UBX_CLASS_NAV, UBX_NAV_PVT, 1);
+  ubxSetPortUbxOnly(gps.port(), 0);
+
+  UbxParser parser;
+  Decoded d;
+  for (int i = 0; i < 3000; i++) {
+    clock.advance(1);
+    gps.poll();
+    uint8_t buf[64];
+    size_t n = gps.port().read(buf, sizeof(buf));
+    decode(parser, buf, n, d);
+  }
+
+  TEST_ASSERT_EQUAL(3, d.pvt.size());
+  for (size_t i = 0; i < d.lengths.size(); i++) TEST_ASSERT_EQUAL(UBX_NAV_PVT_LEN, d.lengths[i]);
+  TEST_ASSERT_EQUAL(84, UBX_NAV_PVT_LEN);
+  TEST_ASSERT_EQUAL(-69270790, d.pvt[0].lat_e7);
+  TEST_ASSERT_EQUAL(10000, d.pvt[0].gSpeed_mms);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_neo7m_capture_decodes);
+  RUN_TEST(test_m8_length_decodes_the_same);
+  RUN_TEST(test_short_payload_rejected);
+  RUN_TEST(test_corrupt_frame_dropped_and_next_kept);
+  RUN_TEST(test_oversized_frame_skipped);
+  RUN_TEST(test_sim_sends_protocol_14_length);
+  return UNITY_END();
+}
@@ -0,0 +1,249 @@
+// AtEngine line routing under unsolicited output.
+//
+// Replays a modem that, between echoing a command and answering it, and
+// after the answer, throws in the URCs the tracker subscribes to and
+// +IPD / +RECEIVE data frames whose payloads are full of "OK", "ERROR"
+// and "CLOSED". The stream reaches the engine in random-sized pieces
+// (fixed seed). Every answer must complete the command it belongs to,
+// every URC reach its handlers in order, and every data byte the data
+// handler; then random garbage must neither crash the engine nor grow a
+// line past its buffer, and a normal command must work again after it.
+//
+//   pio test -e test_native -f test_urc
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unity.h>
+#include <AtEngine.h>
+#include <MockSerialPort.h>
+
+#define ROUNDS 2000
+#define GARBAGE_BYTES 200000
+
+static uint32_t seed;
+
+static uint32_t pick(uint32_t n) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed % n;
+}
+
+// The URCs registered in TcpSession and Tracker, as the SIM800 words them
+static const char* const urcLines[] = {
+  "+PDP: DEACT", "CLOSED", "0, CLOSED", "1, CLOSED", "RING",
+  "UNDER-VOLTAGE WARNNING", "UNDER-VOLTAGE POWER DOWN", "OVER-VOLTAGE WARNNING",
+  "NORMAL POWER DOWN",
+};
+
+// Text a payload is made of; a leak into line parsing would show
+static const char* const payloadBits[] = {
+  "\r\nOK\r\n", "\r\nERROR\r\n", "CLOSED", "+CSQ: 9,0", "\r\n", "HTTP/1.1 200 OK",
+  "+IPD,12:", ">", "{\"ack\":17}", "\0\xff\x80",
+};
+
+struct Log {
+  std::vector<std::string> urcs;
+  std::vector<std::string> completions;
+  std::vector<AtResult> results;
+  std::string data[2];  // per link
+  size_t longestLine;
+};
+
+static void onUrc(const char* line, void* ctx) {
+  Log* log = (Log*)ctx;
+  log->urcs.push_back(line);
+  if (strlen(line) > log->longestLine) log->longestLine = strlen(line);
+}
+
+static void onData(uint8_t link, const uint8_t* data, size_t len, void* ctx) {
+  Log* log = (Log*)ctx;
+  TEST_ASSERT_LESS_THAN(2, link);
+  log->data[link].append((const char*)data, len);
+}
+
+static void onDone(AtResult result, const char* line, void* ctx) {
+  Log* log = (Log*)ctx;
+  log->results.push_back(result);
+  log->completions.push_back(line);
+  if (strlen(line) > log->longestLine) log->longestLine = strlen(line);
+}
+
+static void subscribe(AtEngine& engine, Log& log) {
+  static const char* const patterns[] = {
+    "CLOSED", "#, CLOSED", "+PDP: DEACT", "UNDER-VOLTAGE", "OVER-VOLTAGE",
+    "NORMAL POWER DOWN", "RING",
+  };
+  for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+    TEST_ASSERT_TRUE(engine.addUrcHandler(patterns[i], onUrc, &log));
+  }
+  engine.setDataHandler(onData, &log);
+}
+
+// Hands 'stream' to the engine in random pieces, polling between them
+static void deliver(AtEngine& engine, MockSerialPort& port, uint32_t& now, const std::string& stream) {
+  for (size_t at = 0; at < stream.size();) {
+    size_t n = 1 + pick(24);
+    if (n > stream.size() - at) n = stream.size() - at;
+    port.feed((const uint8_t*)stream.data() + at, n);
+    at += n;
+    engine.poll(now);
+    now += 10;
+  }
+  engine.poll(now);
+}
+
+// Appends zero to two URCs or data frames, recording what must come out
+static void addNoise(std::string& stream, Log& expected) {
+  uint32_t count = pick(3);
+  for (uint32_t i = 0; i < count; i++) {
+    if (pick(2)) {
+      const char* urc = urcLines[pick(sizeof(urcLines) / sizeof(urcLines[0]))];
+      stream += "\r\n";
+      stream += urc;
+      stream += "\r\n";
+      expected.urcs.push_back(urc);
+      continue;
+    }
+    std::string payload;
+    uint32_t pieces = 1 + pick(6);
+    for (uint32_t p = 0; p < pieces; p++) {
+      size_t which = pick(sizeof(payloadBits) / sizeof(payloadBits[0]));
+      const char* bit = payloadBits[which];
+      payload.append(bit, which == sizeof(payloadBits) / sizeof(payloadBits[0]) - 1 ? 3 : strlen(bit));
+    }
+    char header[32];
+    uint32_t link = pick(3);
+    if (link == 2) {
+      snprintf(header, sizeof(header), "\r\n+IPD,%u:", (unsigned)payload.size());
+      link = 0;
+    } else {
+      snprintf(header, sizeof(header), "\r\n+RECEIVE,%u,%u:\r\n", (unsigned)link, (unsigned)payload.size());
+    }
+    stream += header;
+    stream += payload;
+    expected.data[link] += payload;
+  }
+}
+
+void setUp() {
+  seed = 0x2545F491;
+}
+
+void tearDown() {}
+
+static void test_answers_urcs_and_data_are_kept_apart() {
+  MockSerialPort port;
+  AtEngine engine(port);
+  Log log = Log(), expected = Log();
+  subscribe(engine, log);
+  uint32_t now = 0;
+
+  for (int i = 0; i < ROUNDS; i++) {
+    size_t before = expected.completions.size();
+    char answer[24];
+    snprintf(answer, sizeof(answer), "+CSQ: %u,0", (unsigned)pick(32));
+    TEST_ASSERT_TRUE(engine.enqueue("AT+CSQ", "+CSQ:", 5000, onDone, &log));
+    engine.poll(now);
+    TEST_ASSERT_EQUAL_STRING("AT+CSQ\r\n", port.sent().c_str());
+    port.clearSent();
+
+    std::string stream = "AT+CSQ\r";
+    addNoise(stream, expected);
+    stream += "\r\n";
+    stream += answer;
+    stream += "\r\n";
+    addNoise(stream, expected);
+    stream += "\r\nOK\r\n";
+    addNoise(stream, expected);
+    expected.completions.push_back(answer);
+    deliver(engine, port, now, stream);
+
+    TEST_ASSERT_FALSE(engine.busy());
+    TEST_ASSERT_EQUAL(before + 1, log.completions.size());
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, log.results.back());
+    TEST_ASSERT_EQUAL_STRING(answer, log.completions.back().c_str());
+  }
+
+  TEST_ASSERT_EQUAL(expected.urcs.size(), log.urcs.size());
+  for (size_t i = 0; i < log.urcs.size(); i++) {
+    TEST_ASSERT_EQUAL_STRING(expected.urcs[i].c_str(), log.urcs[i].c_str());
+  }
+  TEST_ASSERT_GREATER_THAN(ROUNDS, log.urcs.size());
+  for (int link = 0; link < 2; link++) {
+    TEST_ASSERT_EQUAL(expected.data[link].size(), log.data[link].size());
+    TEST_ASSERT_TRUE(expected.data[link] == log.data[link]);
+  }
+}
+
+static void test_overlong_lines_are_truncated() {
+  MockSerialPort port;
+  AtEngine engine(port);
+  Log log = Log();
+  subscribe(engine, log);
+  uint32_t now = 0;
+
+  TEST_ASSERT_TRUE(engine.enqueue("AT+CSQ", "+CSQ:", 5000, onDone, &log));
+  engine.poll(now);
+  std::string stream = "AT+CSQ\r\r\nUNDER-VOLTAGE WARNNING " + std::string(1000, 'x') + "\r\n";
+  stream += std::string(5000, 'y') + "\r\n+CSQ: 21,0\r\n\r\nOK\r\n";
+  deliver(engine, port, now, stream);
+
+  TEST_ASSERT_EQUAL(1, log.urcs.size());
+  TEST_ASSERT_EQUAL(AT_LINE_BUFFER_SIZE - 1, log.urcs[0].size());
+  TEST_ASSERT_EQUAL(1, log.completions.size());
+  TEST_ASSERT_EQUAL_STRING("+CSQ: 21,0", log.completions[0].c_str());
+}
+
+static void test_garbage_never_breaks_the_engine() {
+  MockSerialPort port;
+  AtEngine engine(port);
+  Log log = Log();
+  subscribe(engine, log);
+  uint32_t now = 0;
+
+  static const char* const fragments[] = {
+    "\r\n", "\r", "\n", ":", ">", "+IPD,", "+RECEIVE,", "+RECEIVE,1,", "CLOSED", "1, CLOSED",
+    "OK", "ERROR", "+PDP: DEACT", "+CSQ:", "9", "4000", ",", "RING",
+  };
+  std::string garbage;
+  while (garbage.size() < GARBAGE_BYTES) {
+    if (pick(3)) {
+      garbage += fragments[pick(sizeof(fragments) / sizeof(fragments[0]))];
+    } else {
+      garbage += (char)pick(256);
+    }
+  }
+
+  // Commands keep coming and timing out while it streams in
+  for (size_t at = 0; at < garbage.size(); at += 256) {
+    if (!engine.busy()) engine.enqueue("AT+CSQ", "+CSQ:", 200, onDone, &log);
+    deliver(engine, port, now, garbage.substr(at, 256));
+  }
+  TEST_ASSERT_LESS_THAN(AT_LINE_BUFFER_SIZE, log.longestLine);
+  TEST_ASSERT_GREATER_THAN(0, log.urcs.size());
+
+  // Whatever state it was left in, a frame's worth of filler and a line
+  // end bring it back
+  engine.abort();
+  deliver(engine, port, now, std::string(AT_MAX_DATA_FRAME + 1, 'x') + "\r\n");
+  size_t before = log.completions.size();
+  port.clearSent();
+  TEST_ASSERT_TRUE(engine.enqueue("AT+CSQ", "+CSQ:", 5000, onDone, &log));
+  engine.poll(now);
+  TEST_ASSERT_EQUAL_STRING("AT+CSQ\r\n", port.sent().c_str());
+  deliver(engine, port, now, "AT+CSQ\r\r\nRING\r\n\r\n+CSQ: 14,0\r\n\r\nOK\r\n");
+  TEST_ASSERT_EQUAL(before + 1, log.completions.size());
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, log.results.back());
+  TEST_ASSERT_EQUAL_STRING("+CSQ: 14,0", log.completions.back().c_str());
+  TEST_ASSERT_EQUAL_STRING("RING", log.urcs.back().c_str());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_answers_urcs_and_data_are_kept_apart);
+  RUN_TEST(test_overlong_lines_are_truncated);
+  RUN_TEST(test_garbage_never_breaks_the_engine);
+  return UNITY_END();
+}
@@ -0,0 +1,394 @@
+#!/usr/bin/env python3
+"""Reference ingest server for the tracker's uploads.
+
+Accepts the JSON document and the binary application/x-gps-telemetry
+form (versions 1 to 3) on any POST path, over keep-alive HTTP/1.1.
+Bodies may be sent with "Content-Encoding: deflate"; JSON ones are then
+compressed with the preset dictionary below.
+
+Readings are stored once per (device_id, seq): a batch sent again after a
+lost response is answered normally but adds nothing. Readings without a
+seq (RAM-only buffering) are always stored.
+
+Device stats sent along with a batch are logged.
+
+Each accepted request is answered with 200 and {"ack":N}, N being the
+highest seq of the request now stored (0 if it carried none). Malformed
+bodies get 400 and no ack, so the device keeps the readings.
+
+With --fences, acks also carry "fences":V, the version of the geofence
+set, and GET /fences returns it compiled into the image the device
+keeps in flash (lib/Geofence/FenceImage.h). A device holding another
+version fetches it after its upload. The file is JSON:
+
+    {"version": 3, "fences": [
+        {"id": 1, "circle": [lat, lng, radius_m]},
+        {"id": 2, "polygon": [[lat, lng], [lat, lng], [lat, lng], ...]}]}
+
+without "version", the image's CRC serves as one. Readings taken where
+the device crossed a fence are flagged ("fence" in binary uploads, a
+"(fence)" datetime suffix in JSON).
+
+    python3 tools/ingest_server.py [--port 8080] [--db readings.jsonl] [--fences fences.json]
+"""
+
+import argparse
+import json
+import math
+import struct
+import threading
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+TBIN_CONTENT_TYPE = "application/x-gps-telemetry"
+TBIN_FLAG_UTC = 0x01
+TBIN_FLAG_CACHED = 0x02
+TBIN_FLAG_SEQ = 0x04
+TBIN_FLAG_ESTIMATED = 0x08
+TBIN_FLAG_FENCE = 0x10
+
+# lib/Geofence/FenceImage.h
+FENCE_IMAGE_MAGIC = 0x31464E47
+FENCE_CIRCLE = 1
+FENCE_POLYGON = 2
+FENCE_MAX_FENCES = 1024  # FENCE_MAX_FENCES in FenceEngine.h
+FENCE_HEADER = struct.Struct("<IIIIHHHHiiIIII")
+FENCE_ENTRY = struct.Struct("<IBBHiiiiI")
+
+# Must match telemetryJsonDictionary in lib/Telemetry/TelemetryJson.cpp
+JSON_DICTIONARY = (
+    b'{"device_id":"ESP_GPS_001","count":60,"readings":['
+    b'{"seq":1000,"datetime":"N/A","ts":0,"lat":0.000000,"lng":0.000000,'
+    b'"spd":0.00,"alt":0.0,"sat":0},'
+    b'{"seq":1001,"datetime":"2026-01-01 00:00:00 (cached)","ts":10000,'
+    b'"lat":-6.900000,"lng":79.800000,"spd":0.00,"alt":10.0,"sat":0},'
+    b'{"seq":1002,"datetime":"2026-01-01 00:00:10","ts":20000,'
+    b'"lat":-6.927079,"lng":79.861244,"spd":12.34,"alt":7.5,"sat":8},'
+)
+
+
+class DecodeError(Exception):
+    pass
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        if self.pos >= len(self.data):
+            raise DecodeError("truncated")
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def bytes(self, n):
+        if self.pos + n > len(self.data):
+            raise DecodeError("truncated")
+        b = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return b
+
+    def varint(self):
+        v = 0
+        for shift in range(0, 35, 7):
+            b = self.byte()
+            v |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return v & 0xFFFFFFFF
+        raise DecodeError("varint too long")
+
+    def delta(self, prev):
+        raw = self.varint()
+        d = (raw >> 1) ^ -(raw & 1)
+        return (prev + d) & 0xFFFFFFFF
+
+
+def signed32(v):
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def decode_binary(body):
+    """Returns (device_id, readings, stats) from a TBIN document."""
+    r = Reader(body)
+    if r.bytes(2) != b"GT":
+        raise DecodeError("bad magic")
+    version = r.byte()
+    if version < 1 or version > 3:
+        raise DecodeError("unsupported version %d" % version)
+    id_len = r.byte()
+    if id_len > 32:
+        raise DecodeError("device id too long")
+    device_id = r.bytes(id_len).decode("ascii", "replace")
+    count = r.varint()
+
+    readings = []
+    seq = ts = utc = lat = lng = alt = 0
+    for _ in range(count):
+        flags = r.byte()
+        reading = {}
+        if flags & TBIN_FLAG_SEQ:
+            seq = r.delta(seq)
+            reading["seq"] = seq
+        ts = r.delta(ts)
+        if flags & TBIN_FLAG_UTC:
+            utc = r.delta(utc)
+            reading["utc"] = utc
+        lat = r.delta(lat)
+        lng = r.delta(lng)
+        speed = r.varint()
+        alt = r.delta(alt)
+        reading.update({
+            "ts": ts,
+            "lat": signed32(lat) / 1e6,
+            "lng": signed32(lng) / 1e6,
+            "spd": speed / 100.0,
+            "alt": signed32(alt) / 10.0,
+            "sat": r.varint(),
+            "cached": bool(flags & TBIN_FLAG_CACHED),
+            "estimated": bool(flags & TBIN_FLAG_ESTIMATED),
+            "fence": bool(flags & TBIN_FLAG_FENCE),
+        })
+        readings.append(reading)
+
+    stats = {}
+    if version >= 3:
+        for _ in range(r.varint()):
+            key_len = r.byte()
+            if key_len > 32:
+                raise DecodeError("stats key too long")
+            key = r.bytes(key_len).decode("ascii", "replace")
+            stats[key] = r.varint()
+    return device_id, readings, stats
+
+
+def decode_json(body):
+    try:
+        doc = json.loads(body)
+        return str(doc["device_id"]), list(doc["readings"]), dict(doc.get("stats", {}))
+    except (ValueError, KeyError, TypeError) as e:
+        raise DecodeError(str(e))
+
+
+def inflate(body):
+    # zdict is only used if the stream asks for a dictionary
+    d = zlib.decompressobj(zdict=JSON_DICTIONARY)
+    try:
+        data = d.decompress(body) + d.flush()
+    except zlib.error as e:
+        raise DecodeError("deflate: %s" % e)
+    if not d.eof:
+        raise DecodeError("deflate: truncated")
+    return data
+
+
+def e7(degrees):
+    """Degrees to 1e-7 degrees, rounded half away from zero like lround()."""
+    v = math.floor(abs(degrees) * 1e7 + 0.5)
+    return int(-v if degrees < 0 else v)
+
+
+def compile_fences(fences, version):
+    """Compiles fences into the device's image (lib/Geofence/FenceImage.h).
+
+    The grid has about two cells per fence, square on the ground, over the
+    bounding box of them all; lib/Sim/SimFences.cpp builds the same bytes.
+    """
+    if len(fences) > FENCE_MAX_FENCES:
+        raise ValueError("at most %d fences" % FENCE_MAX_FENCES)
+    entries = []  # [id, type, vertices, minLat, minLng, maxLat, maxLng, data]
+    for f in fences:
+        if "circle" in f:
+            lat, lng, radius = (float(v) for v in f["circle"])
+            # 1% margin for the device's approximate distances
+            d_lat = radius * 1.01 / 111319.5
+            d_lng = d_lat / math.cos(lat * math.pi / 180.0)
+            box = [e7(lat - d_lat), e7(lng - d_lng), e7(lat + d_lat), e7(lng + d_lng)]
+            data = struct.pack("<iii", e7(lat), e7(lng), int(math.floor(radius * 100 + 0.5)))
+            entries.append([int(f["id"]), FENCE_CIRCLE, 0] + box + [data])
+        else:
+            points = [(e7(float(p[0])), e7(float(p[1]))) for p in f["polygon"]]
+            if len(points) < 3:
+                raise ValueError("fence %s: a polygon needs three vertices" % f["id"])
+            lats = [p[0] for p in points]
+            lngs = [p[1] for p in points]
+            box = [min(lats), min(lngs), max(lats), max(lngs)]
+            data = b"".join(struct.pack("<ii", *p) for p in points)
+            entries.append([int(f["id"]), FENCE_POLYGON, len(points)] + box + [data])
+
+    n = len(entries)
+    if n:
+        min_lat = min(e[3] for e in entries)
+        min_lng = min(e[4] for e in entries)
+        max_lat = max(e[5] for e in entries)
+        max_lng = max(e[6] for e in entries)
+    else:
+        min_lat = min_lng = max_lat = max_lng = 0
+    span_lat = max_lat - min_lat + 1
+    span_lng = max_lng - min_lng + 1
+    cells = min(max(n * 2.0, 1), 16384)
+    mid_lat = (min_lat + max_lat) / 2e7
+    height = span_lat * 0.0111319
+    width = span_lng * 0.0111319 * math.cos(mid_lat * math.pi / 180.0)
+    cell_m = math.sqrt(height * width / cells)
+    rows = int(math.ceil(height / cell_m)) if cell_m > 0 else 1
+    cols = int(math.ceil(width / cell_m)) if cell_m > 0 else 1
+    rows = min(max(rows, 1), 1024)
+    cols = min(max(cols, 1), 1024)
+    cell_lat = (span_lat + rows - 1) // rows
+    cell_lng = (span_lng + cols - 1) // cols
+
+    lists = [[] for _ in range(rows * cols)]
+    for i, e in enumerate(entries):
+        r1 = min((e[5] - min_lat) // cell_lat, rows - 1)
+        c1 = min((e[6] - min_lng) // cell_lng, cols - 1)
+        for r in range((e[3] - min_lat) // cell_lat, r1 + 1):
+            for c in range((e[4] - min_lng) // cell_lng, c1 + 1):
+                lists[r * cols + c].append(i)
+
+    ids_offset = FENCE_HEADER.size + (len(lists) + 1) * 4
+    ids = sum(len(cell) for cell in lists)
+    fences_offset = (ids_offset + ids * 2 + 3) & ~3
+    data_at = fences_offset + n * FENCE_ENTRY.size
+
+    body = bytearray()
+    start = 0
+    for cell in lists:
+        body += struct.pack("<I", start)
+        start += len(cell)
+    body += struct.pack("<I", start)
+    for cell in lists:
+        body += struct.pack("<%dH" % len(cell), *cell)
+    body += bytes(fences_offset - FENCE_HEADER.size - len(body))
+    data = bytearray()
+    for e in entries:
+        body += FENCE_ENTRY.pack(e[0], e[1], 0, e[2], e[3], e[4], e[5], e[6], data_at + len(data))
+        data += e[7]
+    body += data
+
+    length = FENCE_HEADER.size + len(body)
+    crc = zlib.crc32(bytes(body))
+    if version is None:
+        version = crc or 1
+    header = FENCE_HEADER.pack(FENCE_IMAGE_MAGIC, version, length, crc, n, cols, rows, 0,
+                               min_lat, min_lng, cell_lat, cell_lng, ids_offset, fences_offset)
+    return version, header + bytes(body)
+
+
+def load_fences(path):
+    """Returns (version, image) from a fences JSON file."""
+    with open(path) as f:
+        doc = json.load(f)
+    return compile_fences(doc["fences"], doc.get("version"))
+
+
+class Store:
+    """Readings kept in memory, optionally appended to a JSON lines file."""
+
+    def __init__(self, path=None):
+        self.lock = threading.Lock()
+        self.seen = set()
+        self.readings = []
+        self.duplicates = 0
+        self.file = open(path, "a") if path else None
+
+    def add(self, device_id, readings):
+        """Stores the new readings; returns the highest seq among them all."""
+        ack = 0
+        with self.lock:
+            for reading in readings:
+                seq = reading.get("seq", 0)
+                if seq:
+                    ack = max(ack, seq)
+                    if (device_id, seq) in self.seen:
+                        self.duplicates += 1
+                        continue
+                    self.seen.add((device_id, seq))
+                row = dict(reading, device_id=device_id)
+                self.readings.append(row)
+                if self.file:
+                    self.file.write(json.dumps(row) + "\n")
+            if self.file:
+                self.file.flush()
+        return ack
+
+
+class IngestHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    store = None
+    fences = None  # (version, image)
+
+    def do_GET(self):
+        if self.path != "/fences" or not self.fences:
+            self.reply(404, {"error": "not found"})
+            return
+        image = self.fences[1]
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(image)))
+        self.end_headers()
+        self.wfile.write(image)
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        content_type = self.headers.get("Content-Type", "")
+        try:
+            if self.headers.get("Content-Encoding", "") == "deflate":
+                body = inflate(body)
+            if content_type.startswith(TBIN_CONTENT_TYPE):
+                device_id, readings, stats = decode_binary(body)
+            else:
+                device_id, readings, stats = decode_json(body)
+        except DecodeError as e:
+            self.log_message("rejected: %s", e)
+            self.reply(400, {"error": str(e)})
+            return
+        ack = self.store.add(device_id, readings)
+        self.log_message("%s: %d readings, ack %d (%d duplicates so far)",
+                         device_id, len(readings), ack, self.store.duplicates)
+        for reading in readings:
+            if reading.get("fence") or "(fence)" in str(reading.get("datetime", "")):
+                self.log_message("%s: fence crossed at %s, %s", device_id,
+                                 reading.get("lat"), reading.get("lng"))
+        if stats:
+            self.log_message("%s stats: %s", device_id,
+                             " ".join("%s=%s" % kv for kv in sorted(stats.items())))
+        doc = {"ack": ack}
+        if self.fences:
+            doc["fences"] = self.fences[0]
+        self.reply(200, doc)
+
+    def reply(self, status, doc):
+        payload = json.dumps(doc, separators=(",", ":")).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(payload)))
+        self.end_headers()
+        self.wfile.write(payload)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--db", help="append stored readings to this JSON lines file")
+    parser.add_argument("--fences", help="geofences to hand out (JSON, see above)")
+    args = parser.parse_args()
+
+    IngestHandler.store = Store(args.db)
+    if args.fences:
+        IngestHandler.fences = load_fences(args.fences)
+        print("Fences version %d, %d byte image" % (IngestHandler.fences[0],
+                                                   len(IngestHandler.fences[1])))
+    server = ThreadingHTTPServer((args.host, args.port), IngestHandler)
+    print("Listening on %s:%d" % (args.host, args.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()